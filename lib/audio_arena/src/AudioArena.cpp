@@ -0,0 +1,104 @@
+#include <Arduino.h>
+#include <esp_heap_caps.h>
+#include <esp_idf_version.h>
+#if ESP_IDF_VERSION_MAJOR >= 5
+#include <esp_memory_utils.h>
+#else
+#include <soc/soc_memory_layout.h>
+#endif
+#include <freertos/FreeRTOS.h>
+#include "AudioArena.h"
+
+AudioArena::Region AudioArena::m_regions[2] = {};
+AudioArena::Entry AudioArena::m_entries[AudioArena::kMaxEntries] = {};
+int AudioArena::m_entry_count = 0;
+
+static portMUX_TYPE arena_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static uint32_t caps_for(AudioArena::Placement where)
+{
+  return (where == AudioArena::kPsram)
+      ? (MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT)
+      : (MALLOC_CAP_INTERNAL | MALLOC_CAP_DMA | MALLOC_CAP_8BIT);
+}
+
+static bool is_psram(const void *p)
+{
+  return esp_ptr_external_ram(p);
+}
+
+void AudioArena::begin(size_t internal_bytes, size_t psram_bytes)
+{
+  const size_t sizes[2] = { internal_bytes, psram_bytes };
+  for (int i = 0; i < 2; ++i) {
+    Region &r = m_regions[i];
+    if (r.base || sizes[i] == 0) {
+      continue;
+    }
+    const size_t size = (sizes[i] + kAlign - 1) & ~(kAlign - 1);
+    r.base = static_cast<uint8_t *>(heap_caps_aligned_alloc(kAlign, size, caps_for(static_cast<Placement>(i))));
+    if (!r.base && i == kPsram) {
+      // no PSRAM fitted
+      r.base = static_cast<uint8_t *>(heap_caps_aligned_alloc(kAlign, size, MALLOC_CAP_8BIT));
+    }
+    r.size = r.base ? size : 0;
+    r.used = 0;
+    r.in_psram = r.base && is_psram(r.base);
+    if (!r.base) {
+      Serial.printf("ARENA: failed to reserve %u bytes %s\n", static_cast<unsigned>(size),
+                    (i == kPsram) ? "PSRAM" : "internal");
+    }
+  }
+}
+
+void *AudioArena::alloc(const char *name, size_t bytes, Placement where)
+{
+  const size_t size = (bytes + kAlign - 1) & ~(kAlign - 1);
+  Region &r = m_regions[where];
+  void *p = nullptr;
+  portENTER_CRITICAL(&arena_lock);
+  if (r.base && r.size - r.used >= size) {
+    p = r.base + r.used;
+    r.used += size;
+  }
+  portEXIT_CRITICAL(&arena_lock);
+  const bool from_heap = (p == nullptr);
+  if (from_heap) {
+    p = heap_caps_malloc(bytes, caps_for(where));
+    if (!p) {
+      p = malloc(bytes);
+    }
+  }
+  if (!p) {
+    Serial.printf("ARENA: %s: %u bytes not available\n", name, static_cast<unsigned>(bytes));
+    return nullptr;
+  }
+  portENTER_CRITICAL(&arena_lock);
+  if (m_entry_count < kMaxEntries) {
+    m_entries[m_entry_count++] = { name, p, bytes, where, from_heap, is_psram(p) };
+  }
+  portEXIT_CRITICAL(&arena_lock);
+  return p;
+}
+
+void AudioArena::print_map()
+{
+  static const char *const kRegionNames[2] = { "internal", "psram" };
+  for (int i = 0; i < 2; ++i) {
+    const Region &r = m_regions[i];
+    Serial.printf("ARENA: %-8s region %6u/%6u bytes used at %p%s\n", kRegionNames[i],
+                  static_cast<unsigned>(r.used), static_cast<unsigned>(r.size), r.base,
+                  (i == kPsram && r.base && !r.in_psram) ? " (no PSRAM, internal heap)" : "");
+  }
+  for (int i = 0; i < m_entry_count; ++i) {
+    const Entry &e = m_entries[i];
+    const Region &r = m_regions[e.where];
+    Serial.printf("ARENA:   %-20s %6u bytes %-8s ", e.name, static_cast<unsigned>(e.bytes),
+                  e.in_psram ? "psram" : "internal");
+    if (e.from_heap) {
+      Serial.printf("heap %p (region full)\n", e.ptr);
+    } else {
+      Serial.printf("+%u\n", static_cast<unsigned>(static_cast<uint8_t *>(e.ptr) - r.base));
+    }
+  }
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Startup-time placement of the audio buffers
+ *
+ * Two regions are reserved once at boot: internal, DMA-capable RAM for the
+ * hot buffers the audio paths touch every frame, and PSRAM for large history
+ * and recording buffers. Buffers are carved off in order and live until
+ * reboot, so the heap is left alone afterwards and cannot fragment. A
+ * request that no longer fits (or arrives before begin()) falls back to a
+ * plain heap_caps_malloc with the same placement; the memory map flags it.
+ * Without PSRAM the PSRAM region comes from the internal heap.
+ */
+class AudioArena
+{
+public:
+  enum Placement : uint8_t {
+    kInternal,   // hot, DMA-touched
+    kPsram,      // large, sequentially accessed
+  };
+  static constexpr size_t kAlign = 16;   // whole cache lines
+  static constexpr int kMaxEntries = 24;
+
+  static void begin(size_t internal_bytes, size_t psram_bytes);
+  // nullptr when even the heap fallback fails
+  static void *alloc(const char *name, size_t bytes, Placement where);
+  static void print_map();
+
+private:
+  struct Region {
+    uint8_t *base;
+    size_t size;
+    size_t used;
+    bool in_psram;
+  };
+  struct Entry {
+    const char *name;
+    void *ptr;
+    size_t bytes;
+    Placement where;
+    bool from_heap;
+    bool in_psram;
+  };
+
+  static Region m_regions[2];
+  static Entry m_entries[kMaxEntries];
+  static int m_entry_count;
+};
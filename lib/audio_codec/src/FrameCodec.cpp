@@ -0,0 +1,195 @@
+#include "FrameCodec.h"
+
+namespace {
+
+const int16_t kStepTable[89] = {
+  7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+  50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230,
+  253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963,
+  1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327,
+  3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442,
+  11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794,
+  32767
+};
+
+const int8_t kIndexTable[16] = {
+  -1, -1, -1, -1, 2, 4, 6, 8,
+  -1, -1, -1, -1, 2, 4, 6, 8
+};
+
+inline int16_t u8_to_s16(uint8_t v)
+{
+  return static_cast<int16_t>((static_cast<int16_t>(v) - 128) << 8);
+}
+
+inline uint8_t s16_to_u8(int32_t v)
+{
+  v = (v + 128) >> 8;
+  if (v > 127) v = 127;
+  if (v < -128) v = -128;
+  return static_cast<uint8_t>(v + 128);
+}
+
+}  // namespace
+
+const LinkMode FrameCodec::kModes[FrameCodec::kNumModes] = {
+  { kCodecPcm8, 1, 236 },     // 15ms, 236 B: full 16 kHz PCM
+  { kCodecAdpcm4, 1, 320 },   // 20ms, 163 B
+  { kCodecAdpcm4, 2, 320 },   // 20ms, 83 B: 8 kHz
+  { kCodecAdpcm4, 2, 160 },   // 10ms, 43 B: short packets for a lossy link
+};
+
+const LinkMode FrameCodec::kRedundantMode = { kCodecAdpcm4, 2, 0 };
+
+size_t FrameCodec::payload_size(const LinkMode &mode, size_t samples)
+{
+  const size_t coded = samples / mode.rate_div;
+  if (mode.codec == kCodecAdpcm4) {
+    return kAdpcmStateSize + (coded + 1) / 2;
+  }
+  return coded;
+}
+
+size_t FrameCodec::decoded_samples(const LinkMode &mode, size_t payload_len)
+{
+  if (mode.codec == kCodecAdpcm4) {
+    if (payload_len <= kAdpcmStateSize) {
+      return 0;
+    }
+    return (payload_len - kAdpcmStateSize) * 2 * mode.rate_div;
+  }
+  return payload_len * mode.rate_div;
+}
+
+void FrameCodec::reset()
+{
+  m_enc_predictor = 0;
+  m_enc_index = 0;
+  m_decim_prev = 0;
+  m_up_prev = 0;
+}
+
+size_t FrameCodec::encode(const LinkMode &mode, const uint8_t *pcm, size_t n, uint8_t *out)
+{
+  uint8_t *p = out;
+  if (mode.codec == kCodecAdpcm4) {
+    *p++ = static_cast<uint8_t>(m_enc_predictor & 0xff);
+    *p++ = static_cast<uint8_t>((m_enc_predictor >> 8) & 0xff);
+    *p++ = static_cast<uint8_t>(m_enc_index);
+  }
+  uint8_t nibble_acc = 0;
+  bool high = false;
+  for (size_t i = 0; i < n; i += mode.rate_div) {
+    int16_t x;
+    if (mode.rate_div == 2) {
+      // [1 2 1]/4 lowpass ahead of the 2:1 decimation
+      const int16_t a = u8_to_s16(pcm[i]);
+      const int16_t b = u8_to_s16(pcm[i + 1]);
+      x = static_cast<int16_t>((m_decim_prev + 2 * a + b) >> 2);
+      m_decim_prev = b;
+    } else {
+      x = u8_to_s16(pcm[i]);
+    }
+    if (mode.codec == kCodecAdpcm4) {
+      const uint8_t code = adpcm_encode_sample(x, m_enc_predictor, m_enc_index);
+      if (high) {
+        *p++ = static_cast<uint8_t>(nibble_acc | (code << 4));
+      } else {
+        nibble_acc = code;
+      }
+      high = !high;
+    } else {
+      *p++ = s16_to_u8(x);
+    }
+  }
+  if (high) {
+    *p++ = nibble_acc;
+  }
+  return static_cast<size_t>(p - out);
+}
+
+size_t FrameCodec::decode(const LinkMode &mode, const uint8_t *in, size_t len, uint8_t *pcm, size_t max_samples)
+{
+  const size_t samples = decoded_samples(mode, len);
+  if (samples == 0 || samples > max_samples) {
+    return 0;
+  }
+  size_t coded = samples / mode.rate_div;
+  int16_t predictor = 0;
+  int8_t index = 0;
+  if (mode.codec == kCodecAdpcm4) {
+    predictor = static_cast<int16_t>(in[0] | (in[1] << 8));
+    index = static_cast<int8_t>(in[2]);
+    if (index < 0 || index > 88) {
+      return 0;
+    }
+    in += kAdpcmStateSize;
+  }
+  uint8_t *p = pcm;
+  for (size_t i = 0; i < coded; ++i) {
+    int16_t x;
+    if (mode.codec == kCodecAdpcm4) {
+      const uint8_t code = (i & 1) ? (in[i >> 1] >> 4) : (in[i >> 1] & 0x0f);
+      x = adpcm_decode_sample(code, predictor, index);
+    } else {
+      x = u8_to_s16(in[i]);
+    }
+    if (mode.rate_div == 2) {
+      // linear interpolation back to 16 kHz
+      *p++ = s16_to_u8((static_cast<int32_t>(m_up_prev) + x) >> 1);
+    }
+    *p++ = s16_to_u8(x);
+    m_up_prev = x;
+  }
+  return samples;
+}
+
+uint8_t FrameCodec::adpcm_encode_sample(int16_t x, int16_t &predictor, int8_t &index)
+{
+  const int32_t step = kStepTable[index];
+  int32_t diff = static_cast<int32_t>(x) - predictor;
+  uint8_t code = 0;
+  if (diff < 0) {
+    code = 8;
+    diff = -diff;
+  }
+  int32_t delta = step >> 3;
+  if (diff >= step) {
+    code |= 4;
+    diff -= step;
+    delta += step;
+  }
+  if (diff >= (step >> 1)) {
+    code |= 2;
+    diff -= step >> 1;
+    delta += step >> 1;
+  }
+  if (diff >= (step >> 2)) {
+    code |= 1;
+    delta += step >> 2;
+  }
+  // track the decoder exactly so both sides stay in step
+  int32_t p = predictor + ((code & 8) ? -delta : delta);
+  if (p > 32767) p = 32767;
+  if (p < -32768) p = -32768;
+  predictor = static_cast<int16_t>(p);
+  int i = index + kIndexTable[code];
+  index = static_cast<int8_t>((i < 0) ? 0 : ((i > 88) ? 88 : i));
+  return code;
+}
+
+int16_t FrameCodec::adpcm_decode_sample(uint8_t code, int16_t &predictor, int8_t &index)
+{
+  const int32_t step = kStepTable[index];
+  int32_t delta = step >> 3;
+  if (code & 4) delta += step;
+  if (code & 2) delta += step >> 1;
+  if (code & 1) delta += step >> 2;
+  int32_t p = predictor + ((code & 8) ? -delta : delta);
+  if (p > 32767) p = 32767;
+  if (p < -32768) p = -32768;
+  predictor = static_cast<int16_t>(p);
+  int i = index + kIndexTable[code];
+  index = static_cast<int8_t>((i < 0) ? 0 : ((i > 88) ? 88 : i));
+  return predictor;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Operating point of the audio link
+ *
+ * Input and output are always 16 kHz 8-bit offset-binary PCM; the mode picks
+ * the coding on air. frame_samples counts 16 kHz input samples per packet.
+ */
+struct LinkMode {
+  uint8_t codec;
+  uint8_t rate_div;         // 1 = 16 kHz, 2 = 8 kHz on air
+  uint16_t frame_samples;
+};
+
+/**
+ * @brief Encoder/decoder for one audio frame in a given LinkMode
+ *
+ * ADPCM frames start with the predictor and step index so every frame can be
+ * decoded on its own; a lost frame never corrupts the next one. Resampler
+ * state is carried across frames.
+ */
+class FrameCodec
+{
+public:
+  enum : uint8_t {
+    kCodecPcm8 = 0,     // 8-bit offset binary
+    kCodecAdpcm4 = 1,   // IMA ADPCM, 4 bits per sample, low nibble first
+  };
+  static constexpr size_t kAdpcmStateSize = 3;
+  static constexpr int kNumModes = 4;
+  static constexpr size_t kMaxFrameSamples = 320;
+
+  // mode ladder, ordered from best quality to least airtime
+  static const LinkMode kModes[kNumModes];
+  // coding of the redundant copy of the previous frame (8 kHz ADPCM)
+  static const LinkMode kRedundantMode;
+
+  // on-air payload size of a full frame
+  static size_t payload_size(const LinkMode &mode, size_t samples);
+  // number of 16 kHz samples carried by a payload, 0 if malformed
+  static size_t decoded_samples(const LinkMode &mode, size_t payload_len);
+
+  void reset();
+  // n must be a multiple of 2 * rate_div; returns payload bytes written
+  size_t encode(const LinkMode &mode, const uint8_t *pcm, size_t n, uint8_t *out);
+  // returns 16 kHz samples written to pcm (at most max_samples)
+  size_t decode(const LinkMode &mode, const uint8_t *in, size_t len, uint8_t *pcm, size_t max_samples);
+
+private:
+  // encoder: ADPCM state and last odd input sample for the decimator
+  int16_t m_enc_predictor = 0;
+  int8_t m_enc_index = 0;
+  int16_t m_decim_prev = 0;
+  // decoder: last output sample for the interpolator
+  int16_t m_up_prev = 0;
+
+  static uint8_t adpcm_encode_sample(int16_t x, int16_t &predictor, int8_t &index);
+  static int16_t adpcm_decode_sample(uint8_t code, int16_t &predictor, int8_t &index);
+};
@@ -1,15 +1,78 @@
 #pragma once
 
-#include <Arduino.h>
+#include <stdint.h>
+#include <string.h>
 #include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
 
 /**
- * @brief Circular buffer for 8 bit unsigned PCM samples
- * 
+ * @brief Sample formats the output buffer can hold
+ *
+ * Concealment, slew limiting and comfort noise run on linear int16 values;
+ * samples are only converted on the way in and out of the ring.
  */
+template <typename SampleT>
+struct PcmSample;
+
+// 8 bit offset binary, as decoded by FrameCodec
+template <>
+struct PcmSample<uint8_t>
+{
+  static constexpr int kShift = 8;
+  static inline int to_linear(uint8_t s) { return (static_cast<int>(s) - 128) * 256; }
+  static inline uint8_t from_linear(int v)
+  {
+    if (v < -32768) v = -32768;
+    if (v > 32767) v = 32767;
+    return static_cast<uint8_t>((v >> 8) + 128);
+  }
+};
+
+template <>
+struct PcmSample<int16_t>
+{
+  static constexpr int kShift = 0;
+  static inline int to_linear(int16_t s) { return s; }
+  static inline int16_t from_linear(int v)
+  {
+    if (v < -32768) v = -32768;
+    if (v > 32767) v = 32767;
+    return static_cast<int16_t>(v);
+  }
+};
+
+/**
+ * @brief Jitter buffer ring for decoded PCM samples
+ *
+ * Capacity is a power of two so the heads wrap with a mask, and the storage
+ * lives inside the object: place the object where the samples should go.
+ */
+template <typename SampleT, int Capacity>
 class OutputBuffer
 {
+  static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
 private:
+  using Pcm = PcmSample<SampleT>;
+  static constexpr int kMask = Capacity - 1;
+  static constexpr int kComfortNoiseHoldSamples = 8000;
+  // gap concealment eases toward silence by at most this per sample
+  static constexpr int kConcealStep = 4 * 256;
+  // slew limit right after recovering from a gap
+  static constexpr int kRecoverMaxStep = 12 * 256;
+  // noise rounds to the nearest output step
+  static constexpr int kHalfStep = (1 << Pcm::kShift) >> 1;
+  // Drift compensation: playout rate follows the smoothed fill level
+  // (PI control, limited to +-300ppm). The P term gives 1ppm per sample of
+  // error; the I term learns the clock offset (time constant ~130s) so the
+  // fill settles on the target instead of 1 sample per ppm away from it,
+  // and keeps it across talkspurts.
+  static constexpr int kFillAvgShift = 6;   // EWMA over ~64 remove_samples() calls
+  static constexpr int kMaxDriftPpm = 300;
+  static constexpr int kDriftIntegralShift = 21;   // ppm per (sample of error * sample played)
+  static constexpr int64_t kMaxDriftIntegral = int64_t(kMaxDriftPpm) << kDriftIntegralShift;
+  static constexpr int64_t kPpmToStepQ32 = 4295;   // 2^32 / 1e6
+
   // how many samples should we buffer before outputting data?
   int m_number_samples_to_buffer;
   // where are we reading from
@@ -18,96 +81,209 @@ private:
   int m_write_head;
   // keep track of how many samples we have
   int m_available_samples;
-  // the total size of the buffer
-  int m_buffer_size;
   // are we currently buffering samples?
   bool m_buffering;
+  // talker signalled end of talkspurt: play out the tail, then re-prefill
+  bool m_draining;
+  // tail samples still to play; the next talkspurt may already be queued behind them
+  int m_drain_samples;
   // diagnostics
   uint32_t m_underrun_events;
   uint32_t m_overflow_events;
-  // last emitted sample for smooth concealment / recovery
-  uint8_t m_last_output_sample;
+  // last emitted sample (linear) for smooth concealment / recovery
+  int m_last_output;
   int m_recover_samples;
-  // the sample buffer
-  uint8_t *m_buffer;
+  // comfort noise requested by SID frames (RMS in the int16 domain)
+  uint16_t m_comfort_noise_rms;
+  int m_comfort_noise_samples;
+  uint32_t m_noise_seed;
+  // fractional resampler state
+  int32_t m_fill_avg_q8;
+  int64_t m_drift_integral;    // ppm << kDriftIntegralShift
+  int m_playout_ppm;
+  uint32_t m_resample_phase;   // Q32 position between read head and next sample
+  uint64_t m_resample_step;    // Q32, 1.0 = nominal rate
   // thread safety
   SemaphoreHandle_t m_semaphore;
+  // the sample buffer
+  SampleT m_buffer[Capacity];
 
-public:
-  OutputBuffer(int number_samples_to_buffer) : m_number_samples_to_buffer(number_samples_to_buffer)
+  int add_comfort_noise(int center)
+  {
+    m_noise_seed ^= m_noise_seed << 13;
+    m_noise_seed ^= m_noise_seed >> 17;
+    m_noise_seed ^= m_noise_seed << 5;
+    // uniform noise has RMS = amplitude / sqrt(3)
+    const int32_t amp = (static_cast<int32_t>(m_comfort_noise_rms) * 443) >> 8;
+    const int32_t r = static_cast<int32_t>(m_noise_seed & 0xFFFF) - 32768;
+    return center + ((r * amp) >> 15) + kHalfStep;
+  }
+
+  void reset_state()
   {
-    // create a semaphore and make it available for locking
-    m_semaphore = xSemaphoreCreateBinary();
-    xSemaphoreGive(m_semaphore);
     // set reading and writing to the beginning of the buffer
     m_read_head = 0;
     m_write_head = 0;
     m_available_samples = 0;
     // we'll start off buffering data as we have no samples yet
     m_buffering = true;
+    m_draining = false;
+    m_drain_samples = 0;
     m_underrun_events = 0;
     m_overflow_events = 0;
-    m_last_output_sample = 128;
+    m_last_output = 0;
     m_recover_samples = 0;
-    // make sufficient space for the bufferring and incoming data
-    m_buffer_size = 3 * number_samples_to_buffer;
-    m_buffer = (uint8_t *)malloc(m_buffer_size);
-    memset(m_buffer, 0, m_buffer_size);
-    if (!m_buffer)
+    m_comfort_noise_rms = 0;
+    m_comfort_noise_samples = 0;
+    m_noise_seed = 0x2545F491u;
+    m_fill_avg_q8 = m_number_samples_to_buffer << 8;
+    m_drift_integral = 0;
+    m_playout_ppm = 0;
+    m_resample_phase = 0;
+    m_resample_step = 1ull << 32;
+    memset(m_buffer, 0, sizeof(m_buffer));
+  }
+
+  static int ease_to_silence(int s)
+  {
+    if (s > kConcealStep) return s - kConcealStep;
+    if (s < -kConcealStep) return s + kConcealStep;
+    return 0;
+  }
+
+  void push(SampleT s)
+  {
+    m_buffer[m_write_head] = s;
+    m_write_head = (m_write_head + 1) & kMask;
+    if (m_available_samples < Capacity) {
+      m_available_samples++;
+    } else {
+      // drop the oldest sample on overflow to keep buffer state consistent
+      m_read_head = (m_read_head + 1) & kMask;
+      ++m_overflow_events;
+    }
+  }
+
+  // Sender and receiver sample clocks differ by tens of ppm, which slowly
+  // walks the fill level into underrun or overflow over a long talkspurt.
+  void update_playout_rate(int count)
+  {
+    m_fill_avg_q8 += ((m_available_samples << 8) - m_fill_avg_q8) >> kFillAvgShift;
+    const int error = (m_fill_avg_q8 >> 8) - m_number_samples_to_buffer;
+    m_drift_integral += error * count;
+    if (m_drift_integral > kMaxDriftIntegral) m_drift_integral = kMaxDriftIntegral;
+    if (m_drift_integral < -kMaxDriftIntegral) m_drift_integral = -kMaxDriftIntegral;
+    int ppm = error + static_cast<int>(m_drift_integral >> kDriftIntegralShift);
+    if (ppm > kMaxDriftPpm) ppm = kMaxDriftPpm;
+    if (ppm < -kMaxDriftPpm) ppm = -kMaxDriftPpm;
+    m_playout_ppm = ppm;
+    m_resample_step = static_cast<uint64_t>((1ll << 32) + ppm * kPpmToStepQ32);
+  }
+
+public:
+  OutputBuffer(int number_samples_to_buffer) : m_number_samples_to_buffer(number_samples_to_buffer)
+  {
+    // create a semaphore and make it available for locking
+    m_semaphore = xSemaphoreCreateBinary();
+    xSemaphoreGive(m_semaphore);
+    reset_state();
+  }
+
+  // back to the state after construction, keeping the prefill target
+  void reset()
+  {
+    xSemaphoreTake(m_semaphore, portMAX_DELAY);
+    reset_state();
+    xSemaphoreGive(m_semaphore);
+  }
+
+  // keep the silence between talkspurts from going dead: uniform noise at the
+  // given RMS is mixed into concealment until the next SID or ~0.5s passes
+  void set_comfort_noise(uint16_t rms)
+  {
+    xSemaphoreTake(m_semaphore, portMAX_DELAY);
+    m_comfort_noise_rms = rms;
+    m_comfort_noise_samples = (rms > 0) ? kComfortNoiseHoldSamples : 0;
+    xSemaphoreGive(m_semaphore);
+  }
+
+  // End of talkspurt: whatever is buffered (even below the prefill target) is
+  // played out, then the buffer goes straight back to prefill without counting
+  // an underrun, so the next talker doesn't start on stale samples. Audio that
+  // arrives meanwhile waits behind the tail and is prefilled like any other.
+  void end_of_stream()
+  {
+    xSemaphoreTake(m_semaphore, portMAX_DELAY);
+    m_comfort_noise_samples = 0;
+    if (m_available_samples > 0) {
+      m_buffering = false;
+      m_draining = true;
+      m_drain_samples = m_available_samples;
+    } else {
+      m_buffering = true;
+      m_draining = false;
+    }
+    xSemaphoreGive(m_semaphore);
+  }
+
+  void add_samples(const SampleT *samples, int count)
+  {
+    xSemaphoreTake(m_semaphore, portMAX_DELAY);
+    for (int i = 0; i < count; i++)
     {
-      Serial.println("Failed to allocate buffer");
+      push(samples[i]);
     }
+    xSemaphoreGive(m_semaphore);
   }
 
-  // we're adding samples that are 8 bit as they are coming from the transport
-  void add_samples(const uint8_t *samples, int count)
+  // Stand-in for a lost frame so later audio keeps its timing: eases from the
+  // last queued sample toward silence, like buffering concealment.
+  void add_concealment(int count)
   {
     xSemaphoreTake(m_semaphore, portMAX_DELAY);
-    // copy the samples into the buffer wrapping around as needed
+    int s = (m_available_samples > 0)
+        ? Pcm::to_linear(m_buffer[(m_write_head - 1) & kMask])
+        : m_last_output;
     for (int i = 0; i < count; i++)
     {
-      m_buffer[m_write_head] = samples[i];
-      m_write_head = (m_write_head + 1) % m_buffer_size;
-      if (m_available_samples < m_buffer_size) {
-        m_available_samples++;
-      } else {
-        // drop the oldest sample on overflow to keep buffer state consistent
-        m_read_head = (m_read_head + 1) % m_buffer_size;
-        ++m_overflow_events;
-      }
+      s = ease_to_silence(s);
+      push(Pcm::from_linear(s));
     }
     xSemaphoreGive(m_semaphore);
   }
 
-  // convert the samples to 16 bit as they are going to the output
-//void remove_samples(uint16_t *samples, int count)
-  void remove_samples(uint8_t *samples, int count)
+  void remove_samples(SampleT *samples, int count)
   {
-    //Serial.println("remove samples");
     xSemaphoreTake(m_semaphore, portMAX_DELAY);
+    if (!m_buffering) {
+      update_playout_rate(count);
+    }
     for (int i = 0; i < count; i++)
     {
-      samples[i] = m_last_output_sample;
       // if we have no samples and we aren't already buffering then we need to start buffering
       if (m_available_samples == 0 && !m_buffering)
       {
         m_buffering = true;
-        ++m_underrun_events;
+        if (m_draining) {
+          m_draining = false;
+        } else {
+          ++m_underrun_events;
+        }
         m_recover_samples = 32;
+        m_fill_avg_q8 = m_number_samples_to_buffer << 8;
+        m_resample_phase = 0;
       }
       // are we buffering?
       if (m_buffering && m_available_samples < m_number_samples_to_buffer)
       {
-        // conceal gap smoothly by easing toward center instead of hard 128.
-        int s = static_cast<int>(m_last_output_sample);
-        int d = 128 - s;
-        if (d > 4) d = 4;
-        if (d < -4) d = -4;
-        s += d;
-        if (s < 0) s = 0;
-        if (s > 255) s = 255;
-        samples[i] = static_cast<uint8_t>(s);
-        m_last_output_sample = samples[i];
+        // conceal gap smoothly by easing toward silence instead of a hard step
+        m_last_output = ease_to_silence(m_last_output);
+        int s = m_last_output;
+        if (m_comfort_noise_samples > 0) {
+          --m_comfort_noise_samples;
+          s = add_comfort_noise(s);
+        }
+        samples[i] = Pcm::from_linear(s);
       }
       else
       {
@@ -117,24 +293,48 @@ public:
           m_recover_samples = 32;
         }
         // send buffered sample and move the read head forward
-        uint8_t raw = m_buffer[m_read_head];
-        m_read_head = (m_read_head + 1) % m_buffer_size;
-        m_available_samples--;
+        int out;
+        int consumed;
+        if (m_available_samples >= 2) {
+          // linear interpolation at the fractional playout position
+          const int s0 = Pcm::to_linear(m_buffer[m_read_head]);
+          const int s1 = Pcm::to_linear(m_buffer[(m_read_head + 1) & kMask]);
+          out = s0 + static_cast<int>((static_cast<int64_t>(s1 - s0) * m_resample_phase) >> 32);
+          const uint64_t next = static_cast<uint64_t>(m_resample_phase) + m_resample_step;
+          const int advance = static_cast<int>(next >> 32);
+          m_resample_phase = static_cast<uint32_t>(next);
+          m_read_head = (m_read_head + advance) & kMask;
+          m_available_samples -= advance;
+          consumed = advance;
+        } else {
+          out = Pcm::to_linear(m_buffer[m_read_head]);
+          m_read_head = (m_read_head + 1) & kMask;
+          m_available_samples--;
+          consumed = 1;
+          m_resample_phase = 0;
+        }
 
-        int out = static_cast<int>(raw);
         if (m_recover_samples > 0) {
           // Slew-limit immediately after recovery to avoid sharp click.
-          const int prev = static_cast<int>(m_last_output_sample);
-          int diff = out - prev;
-          const int kMaxStep = 12;
-          if (diff > kMaxStep) out = prev + kMaxStep;
-          if (diff < -kMaxStep) out = prev - kMaxStep;
+          const int prev = m_last_output;
+          if (out > prev + kRecoverMaxStep) out = prev + kRecoverMaxStep;
+          if (out < prev - kRecoverMaxStep) out = prev - kRecoverMaxStep;
           --m_recover_samples;
         }
-        if (out < 0) out = 0;
-        if (out > 255) out = 255;
-        samples[i] = static_cast<uint8_t>(out);
-        m_last_output_sample = samples[i];
+        samples[i] = Pcm::from_linear(out);
+        // remember what was actually emitted
+        m_last_output = Pcm::to_linear(samples[i]);
+        if (m_draining) {
+          m_drain_samples -= consumed;
+          if (m_drain_samples <= 0) {
+            // tail done: whatever follows belongs to the next talkspurt
+            m_draining = false;
+            m_buffering = true;
+            m_recover_samples = 32;
+            m_fill_avg_q8 = m_number_samples_to_buffer << 8;
+            m_resample_phase = 0;
+          }
+        }
       }
     }
     xSemaphoreGive(m_semaphore);
@@ -148,9 +348,18 @@ public:
     return v;
   }
 
-  int get_buffer_size()
+  // current playout rate correction in ppm (positive = playing faster)
+  int get_playout_ppm()
   {
-    return m_buffer_size;
+    xSemaphoreTake(m_semaphore, portMAX_DELAY);
+    int v = m_playout_ppm;
+    xSemaphoreGive(m_semaphore);
+    return v;
+  }
+
+  static constexpr int get_buffer_size()
+  {
+    return Capacity;
   }
 
   int get_target_buffer_samples()
@@ -167,8 +376,8 @@ public:
     if (target_samples < 1) {
       target_samples = 1;
     }
-    if (target_samples >= m_buffer_size) {
-      target_samples = m_buffer_size - 1;
+    if (target_samples >= Capacity) {
+      target_samples = Capacity - 1;
     }
     m_number_samples_to_buffer = target_samples;
     xSemaphoreGive(m_semaphore);
@@ -184,3 +393,6 @@ public:
     xSemaphoreGive(m_semaphore);
   }
 };
+
+// receive path: 8 bit PCM, room for over 0.5s at 16kHz
+using RxOutputBuffer = OutputBuffer<uint8_t, 8192>;
@@ -0,0 +1,351 @@
+#include "AudioQuality.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+constexpr uint16_t AudioQuality::kBandHz[AudioQuality::kBands];
+
+namespace {
+
+constexpr int kCorrWindow = 4096;
+constexpr int kCorrFft = 16384;     // >= window + 2 * kMaxDelay
+constexpr int kWelchFft = 512;
+constexpr int kThdFft = 4096;
+constexpr int kSegment = 256;       // 16 ms at 16 kHz
+constexpr float kPi = 3.14159265358979f;
+
+// in-place radix-2 FFT on interleaved re/im
+void fft(float *x, int n, bool inverse)
+{
+  for (int i = 1, j = 0; i < n; ++i) {
+    int bit = n >> 1;
+    for (; j & bit; bit >>= 1) {
+      j ^= bit;
+    }
+    j ^= bit;
+    if (i < j) {
+      float t = x[2 * i];
+      x[2 * i] = x[2 * j];
+      x[2 * j] = t;
+      t = x[2 * i + 1];
+      x[2 * i + 1] = x[2 * j + 1];
+      x[2 * j + 1] = t;
+    }
+  }
+  for (int len = 2; len <= n; len <<= 1) {
+    const float step = (inverse ? 2.0f : -2.0f) * kPi / len;
+    for (int k = 0; k < len / 2; ++k) {
+      const float wr = cosf(step * k);
+      const float wi = sinf(step * k);
+      for (int i = k; i < n; i += len) {
+        const int j = i + len / 2;
+        const float tr = x[2 * j] * wr - x[2 * j + 1] * wi;
+        const float ti = x[2 * j] * wi + x[2 * j + 1] * wr;
+        x[2 * j] = x[2 * i] - tr;
+        x[2 * j + 1] = x[2 * i + 1] - ti;
+        x[2 * i] += tr;
+        x[2 * i + 1] += ti;
+      }
+    }
+  }
+}
+
+float hann(int i, int n)
+{
+  return 0.5f - 0.5f * cosf(2.0f * kPi * i / n);
+}
+
+float to_db(float power_ratio)
+{
+  return 10.0f * log10f(power_ratio > 1e-12f ? power_ratio : 1e-12f);
+}
+
+// lag of received against stimulus with the best correlation
+bool find_delay(const int16_t *s, size_t s_len, const int16_t *r, size_t r_len,
+                float *a, float *b, int32_t &lag, float &corr)
+{
+  const int window = (s_len < static_cast<size_t>(kCorrWindow)) ? static_cast<int>(s_len) : kCorrWindow;
+  // start the window into the stimulus so negative lags (lost start) are found too
+  const int s0 = (s_len - window < static_cast<size_t>(AudioQuality::kMaxDelay))
+      ? static_cast<int>(s_len - window) : AudioQuality::kMaxDelay;
+  memset(a, 0, sizeof(float) * 2 * kCorrFft);
+  memset(b, 0, sizeof(float) * 2 * kCorrFft);
+  for (int i = 0; i < kCorrFft && static_cast<size_t>(i) < r_len; ++i) {
+    a[2 * i] = r[i];
+  }
+  for (int i = 0; i < window; ++i) {
+    b[2 * i] = s[s0 + i];
+  }
+  fft(a, kCorrFft, false);
+  fft(b, kCorrFft, false);
+  for (int i = 0; i < kCorrFft; ++i) {
+    // a * conj(b)
+    const float re = a[2 * i] * b[2 * i] + a[2 * i + 1] * b[2 * i + 1];
+    const float im = a[2 * i + 1] * b[2 * i] - a[2 * i] * b[2 * i + 1];
+    a[2 * i] = re;
+    a[2 * i + 1] = im;
+  }
+  fft(a, kCorrFft, true);
+  const int k_max = (s0 + AudioQuality::kMaxDelay < kCorrFft - window) ? s0 + AudioQuality::kMaxDelay
+                                                                       : kCorrFft - window;
+  int best = -1;
+  for (int k = 0; k <= k_max; ++k) {
+    if (best < 0 || a[2 * k] > a[2 * best]) {
+      best = k;
+    }
+  }
+  if (best < 0 || a[2 * best] <= 0.0f) {
+    return false;
+  }
+  double ss = 0.0;
+  double rr = 0.0;
+  for (int i = 0; i < window; ++i) {
+    ss += static_cast<double>(s[s0 + i]) * s[s0 + i];
+    const size_t ri = static_cast<size_t>(best + i);
+    if (ri < r_len) {
+      rr += static_cast<double>(r[ri]) * r[ri];
+    }
+  }
+  lag = best - s0;
+  corr = (ss > 0.0 && rr > 0.0) ? static_cast<float>(a[2 * best] / kCorrFft / sqrt(ss * rr)) : 0.0f;
+  return true;
+}
+
+// first sample above an eighth of the peak, 0 if all silent
+size_t find_onset(const int16_t *r, size_t r_len)
+{
+  int peak = 0;
+  for (size_t i = 0; i < r_len; ++i) {
+    const int v = (r[i] < 0) ? -r[i] : r[i];
+    peak = (v > peak) ? v : peak;
+  }
+  for (size_t i = 0; peak > 0 && i < r_len; ++i) {
+    if (8 * ((r[i] < 0) ? -r[i] : r[i]) >= peak) {
+      return i;
+    }
+  }
+  return 0;
+}
+
+}  // namespace
+
+bool AudioQuality::analyse(const int16_t *stimulus, size_t stimulus_len,
+                           const int16_t *received, size_t received_len,
+                           uint32_t sample_rate, uint32_t tone_hz, Report &out)
+{
+  memset(&out, 0, sizeof(out));
+  out.thd_n_db = NAN;
+  for (int b = 0; b < kBands; ++b) {
+    out.response_db[b] = NAN;
+  }
+  if (stimulus_len < static_cast<size_t>(kWelchFft) || received_len < static_cast<size_t>(kWelchFft)) {
+    return false;
+  }
+  float *a = static_cast<float *>(malloc(sizeof(float) * 2 * kCorrFft));
+  float *b = static_cast<float *>(malloc(sizeof(float) * 2 * kCorrFft));
+  if (!a || !b) {
+    free(a);
+    free(b);
+    return false;
+  }
+  // skip leading silence (jitter buffer prefill): a periodic stimulus would
+  // otherwise line up just as well with it as with the audio
+  const size_t onset = find_onset(received, received_len);
+  received += onset;
+  received_len -= onset;
+  int32_t lag = 0;
+  float corr = 0.0f;
+  if (!find_delay(stimulus, stimulus_len, received, received_len, a, b, lag, corr)) {
+    free(a);
+    free(b);
+    return false;
+  }
+  out.delay_samples = lag + static_cast<int32_t>(onset);
+  out.correlation = corr;
+
+  // overlap: stimulus[n] against received[n + lag]
+  const size_t first = (lag < 0) ? static_cast<size_t>(-lag) : 0;
+  size_t end = stimulus_len;
+  if (static_cast<int64_t>(end) + lag > static_cast<int64_t>(received_len)) {
+    end = static_cast<size_t>(static_cast<int64_t>(received_len) - lag);
+  }
+  if (end <= first + kWelchFft) {
+    free(a);
+    free(b);
+    return false;
+  }
+  const size_t count = end - first;
+  const int16_t *x = stimulus + first;
+  const int16_t *y = received + first + lag;
+  out.samples = static_cast<uint32_t>(count);
+
+  // gain fit with DC removed from both: the received 8 bit offset and comfort
+  // noise, and the stimulus mean over the overlap (pink noise wanders)
+  double x_mean = 0.0;
+  double y_mean = 0.0;
+  for (size_t i = 0; i < count; ++i) {
+    x_mean += x[i];
+    y_mean += y[i];
+  }
+  x_mean /= count;
+  y_mean /= count;
+  double xx = 0.0;
+  double xy = 0.0;
+  for (size_t i = 0; i < count; ++i) {
+    xx += (x[i] - x_mean) * (x[i] - x_mean);
+    xy += (x[i] - x_mean) * (y[i] - y_mean);
+  }
+  const double g = (xx > 0.0) ? xy / xx : 0.0;
+  out.gain_db = (g > 0.0) ? static_cast<float>(20.0 * log10(g)) : -120.0f;
+
+  double sig = 0.0;
+  double err = 0.0;
+  double seg_sum = 0.0;
+  int segs = 0;
+  const double seg_floor = xx / count * kSegment * 1e-3;
+  for (size_t s = 0; s + kSegment <= count; s += kSegment) {
+    double seg_sig = 0.0;
+    double seg_err = 0.0;
+    for (size_t i = s; i < s + kSegment; ++i) {
+      const double ref = g * (x[i] - x_mean);
+      const double e = (y[i] - y_mean) - ref;
+      seg_sig += ref * ref;
+      seg_err += e * e;
+    }
+    sig += seg_sig;
+    err += seg_err;
+    // skip near-silent stimulus segments
+    if (seg_sig / (g * g > 0.0 ? g * g : 1.0) > seg_floor) {
+      float db = to_db(static_cast<float>(seg_sig / (seg_err > 0.0 ? seg_err : 1e-9)));
+      db = (db < -10.0f) ? -10.0f : ((db > 35.0f) ? 35.0f : db);
+      seg_sum += db;
+      ++segs;
+    }
+  }
+  out.snr_db = to_db(static_cast<float>(sig / (err > 0.0 ? err : 1e-9)));
+  out.seg_snr_db = segs ? static_cast<float>(seg_sum / segs) : NAN;
+
+  // frequency response: Welch cross spectrum, H = |Sxy| / Sxx per band
+  {
+    float *sxx = b;                      // kWelchFft / 2 bins
+    float *sxy = b + kWelchFft;          // re/im pairs
+    memset(b, 0, sizeof(float) * 3 * kWelchFft);
+    float *fx = a;
+    float *fy = a + 2 * kWelchFft;
+    for (size_t s = 0; s + kWelchFft <= count; s += kWelchFft / 2) {
+      for (int i = 0; i < kWelchFft; ++i) {
+        const float w = hann(i, kWelchFft);
+        fx[2 * i] = static_cast<float>(x[s + i] - x_mean) * w;
+        fx[2 * i + 1] = 0.0f;
+        fy[2 * i] = static_cast<float>(y[s + i] - y_mean) * w;
+        fy[2 * i + 1] = 0.0f;
+      }
+      fft(fx, kWelchFft, false);
+      fft(fy, kWelchFft, false);
+      for (int k = 0; k < kWelchFft / 2; ++k) {
+        sxx[k] += fx[2 * k] * fx[2 * k] + fx[2 * k + 1] * fx[2 * k + 1];
+        sxy[2 * k] += fy[2 * k] * fx[2 * k] + fy[2 * k + 1] * fx[2 * k + 1];
+        sxy[2 * k + 1] += fy[2 * k + 1] * fx[2 * k] - fy[2 * k] * fx[2 * k + 1];
+      }
+    }
+    float band_sxx[kBands] = {};
+    float max_sxx = 0.0f;
+    for (int band = 0; band < kBands; ++band) {
+      const float lo = kBandHz[band] * 0.7071f;
+      float hi = kBandHz[band] * 1.4142f;
+      if (hi > sample_rate * 0.47f) {
+        hi = sample_rate * 0.47f;
+      }
+      float pxx = 0.0f;
+      float mag = 0.0f;
+      for (int k = 1; k < kWelchFft / 2; ++k) {
+        const float f = static_cast<float>(k) * sample_rate / kWelchFft;
+        if (f >= lo && f < hi) {
+          pxx += sxx[k];
+          mag += sqrtf(sxy[2 * k] * sxy[2 * k] + sxy[2 * k + 1] * sxy[2 * k + 1]);
+        }
+      }
+      band_sxx[band] = pxx;
+      if (pxx > max_sxx) {
+        max_sxx = pxx;
+      }
+      if (pxx > 0.0f) {
+        out.response_db[band] = 20.0f * log10f(mag > 0.0f ? mag / pxx : 1e-6f);
+      }
+    }
+    int ref = -1;
+    for (int band = 0; band < kBands; ++band) {
+      if (band_sxx[band] < max_sxx * 1e-4f) {
+        out.response_db[band] = NAN;
+      } else if (kBandHz[band] == 1000) {
+        ref = band;
+      }
+    }
+    if (ref >= 0) {
+      const float ref_db = out.response_db[ref];
+      for (int band = 0; band < kBands; ++band) {
+        out.response_db[band] -= ref_db;
+      }
+    }
+  }
+
+  // THD+N: everything but the fundamental, 40 Hz up to Nyquist
+  if (tone_hz > 0 && count >= static_cast<size_t>(kThdFft)) {
+    float *p = b;
+    memset(p, 0, sizeof(float) * kThdFft / 2);
+    for (size_t s = 0; s + kThdFft <= count; s += kThdFft) {
+      for (int i = 0; i < kThdFft; ++i) {
+        a[2 * i] = static_cast<float>(y[s + i] - y_mean) * hann(i, kThdFft);
+        a[2 * i + 1] = 0.0f;
+      }
+      fft(a, kThdFft, false);
+      for (int k = 0; k < kThdFft / 2; ++k) {
+        p[k] += a[2 * k] * a[2 * k] + a[2 * k + 1] * a[2 * k + 1];
+      }
+    }
+    const int f0 = static_cast<int>((static_cast<uint64_t>(tone_hz) * kThdFft + sample_rate / 2) / sample_rate);
+    const int k_lo = static_cast<int>(40u * kThdFft / sample_rate) + 1;
+    double fund = 0.0;
+    double rest = 0.0;
+    for (int k = k_lo; k < kThdFft / 2; ++k) {
+      if (k >= f0 - 3 && k <= f0 + 3) {
+        fund += p[k];
+      } else {
+        rest += p[k];
+      }
+    }
+    if (fund > 0.0) {
+      out.thd_n_db = to_db(static_cast<float>(rest / fund));
+    }
+  }
+
+  free(a);
+  free(b);
+  return true;
+}
+
+size_t AudioQuality::format(const Report &r, char *buf, size_t len)
+{
+  char thd[16] = "-";
+  if (!isnan(r.thd_n_db)) {
+    snprintf(thd, sizeof(thd), "%.1fdB", r.thd_n_db);
+  }
+  int n = snprintf(buf, len,
+                   "AQ: delay=%ld samples corr=%.3f gain=%.1fdB SNR=%.1fdB segSNR=%.1fdB THD+N=%s (%lu samples)\n"
+                   "AQ: response dB re 1 kHz:",
+                   static_cast<long>(r.delay_samples), r.correlation, r.gain_db, r.snr_db, r.seg_snr_db,
+                   thd, static_cast<unsigned long>(r.samples));
+  for (int band = 0; band < kBands && n > 0 && static_cast<size_t>(n) < len; ++band) {
+    if (isnan(r.response_db[band])) {
+      n += snprintf(buf + n, len - n, " %u:-", kBandHz[band]);
+    } else {
+      n += snprintf(buf + n, len - n, " %u:%+.1f", kBandHz[band], r.response_db[band]);
+    }
+  }
+  if (n > 0 && static_cast<size_t>(n) < len) {
+    n += snprintf(buf + n, len - n, "\n");
+  }
+  return (n > 0) ? static_cast<size_t>(n) : 0;
+}
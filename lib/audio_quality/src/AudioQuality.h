@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Compares received audio against the stimulus that was sent
+ *
+ * Finds the alignment delay by cross-correlation, fits the gain and reports
+ * SNR, segmental SNR, THD+N (tone stimulus) and the frequency response in
+ * octave bands (broadband stimulus: noise, MLS, sweep). Plain C++ without
+ * platform code, so the receiving device and the host tool
+ * (tools/audio_quality.cpp) give the same numbers. Working buffers (about
+ * 260 KB) come from malloc.
+ */
+class AudioQuality
+{
+public:
+  static constexpr int kBands = 7;
+  static constexpr uint16_t kBandHz[kBands] = { 125, 250, 500, 1000, 2000, 4000, 6300 };
+  // alignment search, either direction
+  static constexpr int32_t kMaxDelay = 4096;
+
+  struct Report {
+    int32_t delay_samples;      // received lags the stimulus by this much (a tone: modulo its period)
+    float correlation;          // normalised peak, 1 = same waveform
+    float gain_db;
+    float snr_db;
+    float seg_snr_db;           // mean over 16 ms segments clamped to -10..35 dB
+    float thd_n_db;             // NAN unless the stimulus is a tone
+    float response_db[kBands];  // relative to 1 kHz; NAN where the stimulus has no energy
+    uint32_t samples;           // compared after alignment
+  };
+
+  // false if the signals are too short or memory ran out
+  static bool analyse(const int16_t *stimulus, size_t stimulus_len,
+                      const int16_t *received, size_t received_len,
+                      uint32_t sample_rate, uint32_t tone_hz, Report &out);
+  // "AQ:" lines, for Serial or stdout
+  static size_t format(const Report &r, char *buf, size_t len);
+};
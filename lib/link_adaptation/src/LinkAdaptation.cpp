@@ -0,0 +1,145 @@
+#include "LinkAdaptation.h"
+
+namespace {
+
+// RSSI needed to enter / stay in each mode; the gap is the hysteresis
+const int8_t kEnterRssi[] = { -75, -82, -88, -127 };
+const int8_t kLeaveRssi[] = { -81, -88, -94, -127 };
+constexpr int kRssiLevels = sizeof(kEnterRssi) / sizeof(kEnterRssi[0]);
+
+int8_t enter_rssi(int mode)
+{
+  return kEnterRssi[(mode < kRssiLevels) ? mode : kRssiLevels - 1];
+}
+
+int8_t leave_rssi(int mode)
+{
+  return kLeaveRssi[(mode < kRssiLevels) ? mode : kRssiLevels - 1];
+}
+
+}  // namespace
+
+LinkAdaptation::LinkAdaptation(int num_modes)
+{
+  m_num_modes = num_modes;
+  m_mode = 0;
+}
+
+void LinkAdaptation::reset(uint32_t now_ms)
+{
+  m_mode = (m_fixed_mode >= 0) ? m_fixed_mode : 0;
+  m_clean_periods = 0;
+  m_period_start_ms = now_ms;
+  m_last_report_ms = now_ms;
+  m_last_down_ms = now_ms - kUpHoldoffMs;
+  m_have_report = false;
+  m_ever_reported = false;
+  m_send_total = 0;
+  m_send_failed = 0;
+}
+
+void LinkAdaptation::set_fixed_mode(int mode)
+{
+  m_fixed_mode = (mode >= 0 && mode < m_num_modes) ? mode : -1;
+  if (m_fixed_mode >= 0) {
+    m_mode = m_fixed_mode;
+  }
+}
+
+void LinkAdaptation::on_report(uint16_t loss_permille, int8_t rssi, uint32_t now_ms)
+{
+  if (!m_have_report || loss_permille > m_period_loss) {
+    m_period_loss = loss_permille;
+  }
+  // unknown RSSI never masks a real reading
+  if (rssi != kRssiUnknown && (m_period_rssi == kRssiUnknown || rssi < m_period_rssi)) {
+    m_period_rssi = rssi;
+  }
+  m_have_report = true;
+  m_ever_reported = true;
+  m_last_report_ms = now_ms;
+}
+
+void LinkAdaptation::on_send_result(bool ok)
+{
+  ++m_send_total;
+  if (!ok) {
+    ++m_send_failed;
+  }
+}
+
+bool LinkAdaptation::update(uint32_t now_ms)
+{
+  if (now_ms - m_period_start_ms < kPeriodMs) {
+    return false;
+  }
+  m_period_start_ms = now_ms;
+
+  uint16_t loss = m_have_report ? m_period_loss : 0;
+  if (m_send_total > 0) {
+    const uint16_t local = static_cast<uint16_t>((m_send_failed * 1000) / m_send_total);
+    if (local > loss) {
+      loss = local;
+    }
+  }
+  const int8_t rssi = m_have_report ? m_period_rssi : kRssiUnknown;
+  const bool have_report = m_have_report;
+  const bool transmitting = m_send_total > 0;
+  m_have_report = false;
+  m_period_loss = 0;
+  m_period_rssi = kRssiUnknown;
+  m_send_total = 0;
+  m_send_failed = 0;
+  m_last_loss = loss;
+  m_last_rssi = rssi;
+
+  if (m_fixed_mode >= 0) {
+    return false;
+  }
+
+  if (!transmitting) {
+    // hold the mode between talkspurts; the report timeout restarts with the next one
+    m_last_report_ms = now_ms;
+    return false;
+  }
+  if (!have_report) {
+    // nobody heard us (or nobody listens): save airtime
+    if (m_ever_reported && now_ms - m_last_report_ms >= kReportTimeoutMs) {
+      m_last_report_ms = now_ms;
+      m_clean_periods = 0;
+      return step(+1, now_ms);
+    }
+    return false;
+  }
+
+  const bool rssi_bad = (rssi != kRssiUnknown) && (rssi < leave_rssi(m_mode));
+  if (loss >= kDownLossPermille || rssi_bad) {
+    m_clean_periods = 0;
+    return step(+1, now_ms);
+  }
+
+  const bool rssi_ok = (rssi == kRssiUnknown) || (m_mode > 0 && rssi >= enter_rssi(m_mode - 1));
+  if (loss <= kUpLossPermille && rssi_ok) {
+    ++m_clean_periods;
+  } else {
+    m_clean_periods = 0;
+  }
+  if (m_clean_periods >= kUpPeriods && now_ms - m_last_down_ms >= kUpHoldoffMs) {
+    m_clean_periods = 0;
+    return step(-1, now_ms);
+  }
+  return false;
+}
+
+bool LinkAdaptation::step(int delta, uint32_t now_ms)
+{
+  const int next = m_mode + delta;
+  if (next < 0 || next >= m_num_modes) {
+    return false;
+  }
+  if (delta > 0) {
+    m_last_down_ms = now_ms;
+  }
+  m_mode = next;
+  return true;
+}
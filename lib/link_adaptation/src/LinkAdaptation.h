@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * @brief Picks the link mode from listener reports
+ *
+ * Reports (loss in permille, RSSI) are folded into the worst listener of
+ * each evaluation period. Stepping down to a more robust mode takes one bad
+ * period; stepping up needs several clean periods and clear RSSI margin,
+ * and is held off for a while after a step down. Without any reports the
+ * controller drifts toward the mode with the least airtime while sending;
+ * between talkspurts the mode is held.
+ * Time is passed in, so it runs unchanged on the host.
+ */
+class LinkAdaptation
+{
+public:
+  static constexpr int8_t kRssiUnknown = -127;
+  static constexpr uint32_t kPeriodMs = 1000;
+  static constexpr uint32_t kReportTimeoutMs = 3000;
+  static constexpr uint32_t kUpHoldoffMs = 5000;
+  static constexpr int kUpPeriods = 3;
+  static constexpr uint16_t kDownLossPermille = 50;
+  static constexpr uint16_t kUpLossPermille = 10;
+
+  explicit LinkAdaptation(int num_modes);
+  void reset(uint32_t now_ms);
+  void set_fixed_mode(int mode);   // -1 = adaptive
+  void on_report(uint16_t loss_permille, int8_t rssi, uint32_t now_ms);
+  // locally observed send failures count as loss as well
+  void on_send_result(bool ok);
+  // run once per loop; returns true when the mode changed
+  bool update(uint32_t now_ms);
+  int get_mode() const { return m_mode; }
+  uint16_t get_worst_loss() const { return m_last_loss; }
+  int8_t get_worst_rssi() const { return m_last_rssi; }
+
+private:
+  int m_num_modes;
+  int m_mode;
+  int m_fixed_mode = -1;
+  int m_clean_periods = 0;
+  uint32_t m_period_start_ms = 0;
+  uint32_t m_last_report_ms = 0;
+  uint32_t m_last_down_ms = 0;
+  bool m_have_report = false;
+  bool m_ever_reported = false;
+  uint16_t m_period_loss = 0;
+  int8_t m_period_rssi = kRssiUnknown;
+  uint32_t m_send_total = 0;
+  uint32_t m_send_failed = 0;
+  uint16_t m_last_loss = 0;
+  int8_t m_last_rssi = kRssiUnknown;
+
+  bool step(int delta, uint32_t now_ms);
+};
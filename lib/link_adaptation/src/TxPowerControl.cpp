@@ -0,0 +1,121 @@
+#include "TxPowerControl.h"
+
+#include <math.h>
+
+TxPowerControl::TxPowerControl(int8_t min_qdbm, int8_t max_qdbm, int8_t target_rssi)
+  : m_min_qdbm(min_qdbm), m_max_qdbm(max_qdbm), m_target_rssi(target_rssi), m_qdbm(max_qdbm)
+{
+}
+
+void TxPowerControl::reset(uint32_t now_ms)
+{
+  m_qdbm = m_max_qdbm;
+  m_sent = false;
+  m_have_report = false;
+  m_settling = false;
+  m_period_start_ms = now_ms;
+  m_last_report_ms = now_ms;
+}
+
+void TxPowerControl::set_enabled(bool enabled)
+{
+  m_enabled = enabled;
+  if (!enabled) {
+    m_qdbm = m_max_qdbm;
+  }
+}
+
+void TxPowerControl::on_report(uint16_t loss_permille, int8_t rssi, uint32_t now_ms)
+{
+  if (!m_have_report || loss_permille > m_period_loss) {
+    m_period_loss = loss_permille;
+  }
+  if (rssi != kRssiUnknown && (m_period_rssi == kRssiUnknown || rssi < m_period_rssi)) {
+    m_period_rssi = rssi;
+  }
+  m_have_report = true;
+  m_last_report_ms = now_ms;
+}
+
+bool TxPowerControl::update(uint32_t now_ms)
+{
+  if (now_ms - m_period_start_ms < kPeriodMs) {
+    return false;
+  }
+  m_period_start_ms = now_ms;
+  const bool have_report = m_have_report;
+  const bool sent = m_sent;
+  const uint16_t loss = have_report ? m_period_loss : 0;
+  const int8_t rssi = have_report ? m_period_rssi : kRssiUnknown;
+  m_have_report = false;
+  m_sent = false;
+  m_period_loss = 0;
+  m_period_rssi = kRssiUnknown;
+  m_last_loss = loss;
+  m_last_rssi = rssi;
+
+  if (!m_enabled) {
+    return false;
+  }
+  if (!sent) {
+    m_last_report_ms = now_ms;
+    return false;
+  }
+  if (!have_report) {
+    if (now_ms - m_last_report_ms >= kReportTimeoutMs) {
+      // nobody hears us any more
+      m_settling = false;
+      return set(m_max_qdbm);
+    }
+    return false;
+  }
+  if (loss >= kMaxLossPermille) {
+    m_settling = false;
+    return set(m_max_qdbm);
+  }
+  const bool rssi_low = rssi != kRssiUnknown && rssi < m_target_rssi - kHysteresisDb;
+  if (loss >= kUpLossPermille || rssi_low) {
+    m_settling = false;
+    int step = kUpStepQdbm;
+    if (rssi_low) {
+      // close the whole shortfall in one go
+      const int short_qdbm = 4 * (m_target_rssi - rssi);
+      if (short_qdbm > step) {
+        step = short_qdbm;
+      }
+    }
+    return set(m_qdbm + step);
+  }
+  if (m_settling) {
+    // this period's reports still mix in the previous power level
+    m_settling = false;
+    return false;
+  }
+  if (rssi != kRssiUnknown && rssi > m_target_rssi + kHysteresisDb) {
+    m_settling = true;
+    return set(m_qdbm - kDownStepQdbm);
+  }
+  return false;
+}
+
+bool TxPowerControl::set(int qdbm)
+{
+  if (qdbm < m_min_qdbm) {
+    qdbm = m_min_qdbm;
+  }
+  if (qdbm > m_max_qdbm) {
+    qdbm = m_max_qdbm;
+  }
+  if (qdbm == m_qdbm) {
+    return false;
+  }
+  m_qdbm = static_cast<int8_t>(qdbm);
+  return true;
+}
+
+uint16_t TxPowerControl::estimate_tx_current_ma(int8_t qdbm)
+{
+  const float mw = powf(10.0f, (qdbm / 4.0f) / 10.0f);
+  const float max_mw = 125.9f;   // 21 dBm
+  return static_cast<uint16_t>(120.0f + 220.0f * (mw / max_mw) + 0.5f);
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * @brief Closed-loop transmit power from listener reports
+ *
+ * Power is in 0.25 dBm units (esp_wifi_set_max_tx_power). Each period the
+ * worst listener's RSSI is compared with the target: above target plus
+ * hysteresis the power creeps down a little, and only every other period so
+ * the next report sees the change; loss or RSSI below target minus
+ * hysteresis steps it up at once, straight to maximum on heavy loss. Sending
+ * without any report for a while also returns to maximum. Between
+ * talkspurts the power is held. Time is passed in, so it runs unchanged on
+ * the host.
+ */
+class TxPowerControl
+{
+public:
+  static constexpr int8_t kRssiUnknown = -127;
+  static constexpr uint32_t kPeriodMs = 1000;
+  static constexpr uint32_t kReportTimeoutMs = 3000;
+  static constexpr int kHysteresisDb = 3;
+  static constexpr int kDownStepQdbm = 8;     // 2 dB
+  static constexpr int kUpStepQdbm = 24;      // 6 dB
+  static constexpr uint16_t kUpLossPermille = 30;
+  static constexpr uint16_t kMaxLossPermille = 150;
+
+  TxPowerControl(int8_t min_qdbm, int8_t max_qdbm, int8_t target_rssi);
+  void reset(uint32_t now_ms);
+  void set_enabled(bool enabled);
+  bool get_enabled() const { return m_enabled; }
+  void on_report(uint16_t loss_permille, int8_t rssi, uint32_t now_ms);
+  // an audio frame went out
+  void on_send() { m_sent = true; }
+  // run once per loop; returns true when the power changed
+  bool update(uint32_t now_ms);
+  int8_t get_qdbm() const { return m_qdbm; }
+  // the radio rounds to its own steps; follow what it applied
+  void set_applied_qdbm(int8_t qdbm) { m_qdbm = qdbm; }
+  int8_t get_worst_rssi() const { return m_last_rssi; }
+  uint16_t get_worst_loss() const { return m_last_loss; }
+
+  // rough ESP32-S3 TX supply current at a power level, for savings estimates:
+  // ~120 mA without the PA plus a PA share linear in output mW, 340 mA at 21 dBm
+  static uint16_t estimate_tx_current_ma(int8_t qdbm);
+
+private:
+  int8_t m_min_qdbm;
+  int8_t m_max_qdbm;
+  int8_t m_target_rssi;
+  int8_t m_qdbm;
+  bool m_enabled = true;
+  bool m_sent = false;
+  bool m_have_report = false;
+  bool m_settling = false;
+  uint32_t m_period_start_ms = 0;
+  uint32_t m_last_report_ms = 0;
+  uint16_t m_period_loss = 0;
+  int8_t m_period_rssi = kRssiUnknown;
+  uint16_t m_last_loss = 0;
+  int8_t m_last_rssi = kRssiUnknown;
+
+  bool set(int qdbm);
+};
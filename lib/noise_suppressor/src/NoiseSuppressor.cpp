@@ -0,0 +1,194 @@
+#include "NoiseSuppressor.h"
+
+#include <math.h>
+#include <string.h>
+
+namespace {
+
+constexpr int kInputShift = 8;            // headroom bits for the fixed-point FFT
+constexpr int kPowerShift = 10;           // bin power scaling into uint32
+constexpr int kOverSubtractQ4 = 32;       // 2.0x noise over-subtraction
+constexpr int32_t kGainFloor = 4000;      // ~ -18dB, Q15
+constexpr int32_t kGainUnity = 32767;
+
+inline uint32_t min_u32(uint32_t a, uint32_t b)
+{
+  return (a < b) ? a : b;
+}
+
+}  // namespace
+
+NoiseSuppressor::NoiseSuppressor()
+{
+  const float pi = 3.14159265358979f;
+  for (int n = 0; n < kFftSize; ++n) {
+    // periodic sqrt-Hann: squared windows of overlapping hops sum to 1
+    m_window[n] = static_cast<int16_t>(sinf(pi * n / kFftSize) * 32767.0f + 0.5f);
+  }
+  for (int k = 0; k < kFftSize / 2; ++k) {
+    m_cos[k] = static_cast<int16_t>(lrintf(cosf(2.0f * pi * k / kFftSize) * 32767.0f));
+    m_sin[k] = static_cast<int16_t>(lrintf(sinf(2.0f * pi * k / kFftSize) * 32767.0f));
+  }
+  m_bypass = false;
+  m_have_power = false;
+  m_subwindow_frames = 0;
+  m_subwindow_index = 0;
+  for (int k = 0; k < kBins; ++k) {
+    m_smoothed_power[k] = 0;
+    m_subwindow_min[k] = UINT32_MAX;
+    m_history_min[k] = UINT32_MAX;
+    m_gain[k] = kGainUnity;
+    for (int u = 0; u < kMinSubwindows; ++u) {
+      m_min_history[u][k] = UINT32_MAX;
+    }
+  }
+  reset();
+}
+
+void NoiseSuppressor::reset()
+{
+  memset(m_input, 0, sizeof(m_input));
+  memset(m_overlap, 0, sizeof(m_overlap));
+}
+
+void NoiseSuppressor::set_bypass(bool bypass)
+{
+  if (m_bypass && !bypass) {
+    // stale history would be overlapped into the first hop after re-enabling
+    reset();
+  }
+  m_bypass = bypass;
+}
+
+void NoiseSuppressor::process_hop(int16_t *samples)
+{
+  if (m_bypass || !samples) {
+    return;
+  }
+  memcpy(m_input + kHopSize, samples, kHopSize * sizeof(int16_t));
+  process_frame();
+  for (int n = 0; n < kHopSize; ++n) {
+    const int32_t y = (m_re[n] * m_window[n]) >> 15;
+    int32_t out = m_overlap[n] + y;
+    if (out > 32767) out = 32767;
+    if (out < -32768) out = -32768;
+    samples[n] = static_cast<int16_t>(out);
+    m_overlap[n] = (m_re[n + kHopSize] * m_window[n + kHopSize]) >> 15;
+  }
+  memcpy(m_input, m_input + kHopSize, kHopSize * sizeof(int16_t));
+}
+
+void NoiseSuppressor::process_frame()
+{
+  for (int n = 0; n < kFftSize; ++n) {
+    m_re[n] = (static_cast<int32_t>(m_input[n]) * m_window[n]) >> (15 - kInputShift);
+    m_im[n] = 0;
+  }
+  fft(m_re, m_im);
+
+  // Minimum statistics: smoothed power, minimum tracked over subwindows.
+  const bool subwindow_done = (++m_subwindow_frames >= kMinSubwindowFrames);
+  for (int k = 0; k < kBins; ++k) {
+    const int64_t re = m_re[k];
+    const int64_t im = m_im[k];
+    uint64_t p64 = static_cast<uint64_t>(re * re + im * im) >> kPowerShift;
+    const uint32_t p = (p64 > UINT32_MAX) ? UINT32_MAX : static_cast<uint32_t>(p64);
+
+    uint32_t s = m_smoothed_power[k];
+    if (!m_have_power) {
+      s = p;
+    } else {
+      s = static_cast<uint32_t>(static_cast<int64_t>(s) + ((static_cast<int64_t>(p) - s) >> 2));
+    }
+    m_smoothed_power[k] = s;
+    m_subwindow_min[k] = min_u32(m_subwindow_min[k], s);
+
+    // minimum underestimates the mean noise power; compensate by 2x
+    const uint64_t noise = static_cast<uint64_t>(min_u32(m_history_min[k], m_subwindow_min[k])) * 2;
+    const uint64_t over = (noise * kOverSubtractQ4) >> 4;
+
+    int32_t target = kGainFloor;
+    if (p > over) {
+      target = static_cast<int32_t>(((static_cast<uint64_t>(p) - over) << 15) / p);
+      if (target < kGainFloor) target = kGainFloor;
+      if (target > kGainUnity) target = kGainUnity;
+    }
+    // fast attack, slow release to limit musical noise
+    int32_t g = m_gain[k];
+    g += (target > g) ? ((target - g) >> 1) : ((target - g) >> 3);
+    m_gain[k] = g;
+
+    m_re[k] = static_cast<int32_t>((static_cast<int64_t>(m_re[k]) * g) >> 15);
+    m_im[k] = static_cast<int32_t>((static_cast<int64_t>(m_im[k]) * g) >> 15);
+    if (k > 0 && k < kFftSize / 2) {
+      const int m = kFftSize - k;
+      m_re[m] = static_cast<int32_t>((static_cast<int64_t>(m_re[m]) * g) >> 15);
+      m_im[m] = static_cast<int32_t>((static_cast<int64_t>(m_im[m]) * g) >> 15);
+    }
+  }
+  m_have_power = true;
+
+  if (subwindow_done) {
+    m_subwindow_frames = 0;
+    for (int k = 0; k < kBins; ++k) {
+      m_min_history[m_subwindow_index][k] = m_subwindow_min[k];
+      m_subwindow_min[k] = UINT32_MAX;
+    }
+    m_subwindow_index = (m_subwindow_index + 1) % kMinSubwindows;
+    for (int k = 0; k < kBins; ++k) {
+      uint32_t v = UINT32_MAX;
+      for (int u = 0; u < kMinSubwindows; ++u) {
+        v = min_u32(v, m_min_history[u][k]);
+      }
+      m_history_min[k] = v;
+    }
+  }
+
+  // inverse transform via conjugation; the forward scaling by 1/N cancels
+  // the kInputShift pre-gain so m_re ends up back in the int16 domain
+  for (int n = 0; n < kFftSize; ++n) {
+    m_im[n] = -m_im[n];
+  }
+  fft(m_re, m_im);
+}
+
+// In-place radix-2 decimation-in-time FFT, scaled by 1/2 per stage (1/N overall).
+void NoiseSuppressor::fft(int32_t *re, int32_t *im)
+{
+  for (int i = 1, j = 0; i < kFftSize; ++i) {
+    int bit = kFftSize >> 1;
+    for (; j & bit; bit >>= 1) {
+      j ^= bit;
+    }
+    j ^= bit;
+    if (i < j) {
+      const int32_t tr = re[i];
+      re[i] = re[j];
+      re[j] = tr;
+      const int32_t ti = im[i];
+      im[i] = im[j];
+      im[j] = ti;
+    }
+  }
+
+  for (int len = 2; len <= kFftSize; len <<= 1) {
+    const int half = len >> 1;
+    const int step = kFftSize / len;
+    for (int i = 0; i < kFftSize; i += len) {
+      for (int k = 0; k < half; ++k) {
+        const int64_t wr = m_cos[k * step];
+        const int64_t wi = -m_sin[k * step];
+        const int a = i + k;
+        const int b = a + half;
+        const int32_t tr = static_cast<int32_t>((re[b] * wr - im[b] * wi) >> 15);
+        const int32_t ti = static_cast<int32_t>((re[b] * wi + im[b] * wr) >> 15);
+        const int32_t ar = re[a];
+        const int32_t ai = im[a];
+        re[a] = (ar + tr) >> 1;
+        im[a] = (ai + ti) >> 1;
+        re[b] = (ar - tr) >> 1;
+        im[b] = (ai - ti) >> 1;
+      }
+    }
+  }
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Fixed-point spectral noise suppressor for 16 kHz PCM
+ *
+ * 256-point FFT with 50% overlap-add (sqrt-Hann analysis and synthesis),
+ * minimum-statistics noise estimate and smoothed spectral-subtraction gain.
+ * Audio is processed one hop (128 samples, 8ms) at a time and the output
+ * lags the input by one hop.
+ */
+class NoiseSuppressor
+{
+public:
+  static constexpr int kFftSize = 256;
+  static constexpr int kHopSize = kFftSize / 2;
+  static constexpr int kBins = kFftSize / 2 + 1;
+
+  NoiseSuppressor();
+  // clear overlap-add history (noise estimate is kept across talkspurts)
+  void reset();
+  void set_bypass(bool bypass);
+  bool is_bypassed() const { return m_bypass; }
+  // process exactly kHopSize samples in place
+  void process_hop(int16_t *samples);
+
+private:
+  // min search window: 8 subwindows x 24 frames x 8ms ~ 1.5s
+  static constexpr int kMinSubwindows = 8;
+  static constexpr int kMinSubwindowFrames = 24;
+
+  void process_frame();
+  void fft(int32_t *re, int32_t *im);
+
+  bool m_bypass;
+  bool m_have_power;
+  int m_subwindow_frames;
+  int m_subwindow_index;
+  // sqrt-Hann window and twiddles, Q15
+  int16_t m_window[kFftSize];
+  int16_t m_cos[kFftSize / 2];
+  int16_t m_sin[kFftSize / 2];
+  // analysis history: previous hop followed by current hop
+  int16_t m_input[kFftSize];
+  // synthesis tail carried into the next hop
+  int32_t m_overlap[kHopSize];
+  int32_t m_re[kFftSize];
+  int32_t m_im[kFftSize];
+  // noise estimation state per bin
+  uint32_t m_smoothed_power[kBins];
+  uint32_t m_subwindow_min[kBins];
+  uint32_t m_history_min[kBins];
+  uint32_t m_min_history[kMinSubwindows][kBins];
+  // smoothed suppression gain per bin, Q15
+  int32_t m_gain[kBins];
+};
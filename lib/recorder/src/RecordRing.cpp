@@ -0,0 +1,114 @@
+#include "RecordRing.h"
+
+#include <string.h>
+
+static void put_le16(uint8_t *p, uint16_t v)
+{
+  p[0] = static_cast<uint8_t>(v);
+  p[1] = static_cast<uint8_t>(v >> 8);
+}
+
+static void put_le32(uint8_t *p, uint32_t v)
+{
+  put_le16(p, static_cast<uint16_t>(v));
+  put_le16(p + 2, static_cast<uint16_t>(v >> 16));
+}
+
+void RecordRing::init(uint8_t *memory, size_t bytes)
+{
+  m_memory = memory;
+  m_blocks = memory ? static_cast<int>(bytes / kBlockSize) : 0;
+  if (m_blocks < 2) {
+    m_blocks = 0;
+  }
+  reset();
+}
+
+void RecordRing::reset()
+{
+  m_head = 0;
+  m_count = 0;
+  m_seq = 0;
+  m_stats = {};
+  if (m_blocks) {
+    open_block();
+  }
+}
+
+void RecordRing::open_block()
+{
+  uint8_t *b = fill_block();
+  memcpy(b, "ESRB", 4);
+  put_le32(b + 4, m_seq++);
+  put_le16(b + 8, 0);
+  put_le16(b + 10, 0);
+  m_fill_used = kBlockHeaderSize;
+}
+
+void RecordRing::close_block()
+{
+  uint8_t *b = fill_block();
+  put_le16(b + 8, static_cast<uint16_t>(m_fill_used));
+  // zero the tail so nothing stale reaches flash
+  memset(b + m_fill_used, 0, kBlockSize - m_fill_used);
+  if (m_count + 1 < m_blocks) {
+    ++m_count;
+    ++m_stats.blocks_committed;
+    if (m_count > m_stats.max_queued) {
+      m_stats.max_queued = static_cast<uint16_t>(m_count);
+    }
+  } else {
+    // writer is behind: reuse this block
+    ++m_stats.dropped_blocks;
+  }
+  open_block();
+}
+
+void RecordRing::append(uint8_t type, uint8_t flags, uint16_t sender, uint32_t t_ms, const uint8_t *data, size_t len)
+{
+  if (!m_blocks) {
+    return;
+  }
+  do {
+    if (kBlockSize - m_fill_used < kRecordHeaderSize + (len ? 1 : 0)) {
+      close_block();
+    }
+    size_t part = kBlockSize - m_fill_used - kRecordHeaderSize;
+    if (part > len) {
+      part = len;
+    }
+    uint8_t *r = fill_block() + m_fill_used;
+    r[0] = type;
+    r[1] = flags;
+    put_le16(r + 2, sender);
+    put_le32(r + 4, t_ms);
+    put_le16(r + 8, static_cast<uint16_t>(part));
+    if (part) {
+      memcpy(r + kRecordHeaderSize, data, part);
+    }
+    m_fill_used += kRecordHeaderSize + part;
+    ++m_stats.records;
+    data += part;
+    len -= part;
+  } while (len > 0);
+}
+
+void RecordRing::commit()
+{
+  if (m_blocks && m_fill_used > kBlockHeaderSize) {
+    close_block();
+  }
+}
+
+const uint8_t *RecordRing::front() const
+{
+  return m_count ? m_memory + static_cast<size_t>(m_head) * kBlockSize : nullptr;
+}
+
+void RecordRing::pop()
+{
+  if (m_count) {
+    m_head = (m_head + 1) % m_blocks;
+    --m_count;
+  }
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Block ring holding the recording until it reaches flash
+ *
+ * Records (audio, talkspurt start/end) are packed into fixed-size blocks in
+ * caller-provided memory. A block that fills up is handed to the writer as
+ * a whole, so flash only ever sees full, block-aligned writes. When every
+ * other block is still waiting for the writer, the block being filled is
+ * thrown away instead: the producer never waits. The block sequence number
+ * keeps counting, so readers see the gap.
+ *
+ * Block: "ESRB", seq (LE32), used bytes including this header (LE16), 2
+ * reserved. Record: type, flags (direction), sender (LE16), time ms (LE32),
+ * payload length (LE16), payload. Records never straddle blocks; long audio
+ * is split.
+ *
+ * No locking here; the caller serialises producer and writer calls. The
+ * block returned by front() may be written out without the lock held.
+ */
+class RecordRing
+{
+public:
+  static constexpr size_t kBlockSize = 4096;
+  static constexpr size_t kBlockHeaderSize = 12;
+  static constexpr size_t kRecordHeaderSize = 10;
+  enum RecordType : uint8_t {
+    kAudio = 1,            // 8 bit offset binary PCM at SAMPLE_RATE
+    kTalkspurtStart = 2,
+    kTalkspurtEnd = 3,
+  };
+
+  struct Stats {
+    uint32_t records;
+    uint32_t blocks_committed;
+    uint32_t dropped_blocks;
+    uint16_t max_queued;     // most full blocks waiting at once
+  };
+
+  // memory holds bytes / kBlockSize blocks, at least two
+  void init(uint8_t *memory, size_t bytes);
+  void reset();
+  int capacity() const { return m_blocks; }
+
+  // producer side
+  void append(uint8_t type, uint8_t flags, uint16_t sender, uint32_t t_ms, const uint8_t *data, size_t len);
+  // hands a partly filled block to the writer (end of recording)
+  void commit();
+
+  // writer side: oldest full block, nullptr if none
+  const uint8_t *front() const;
+  void pop();
+  int queued() const { return m_count; }
+
+  const Stats &stats() const { return m_stats; }
+
+private:
+  uint8_t *m_memory = nullptr;
+  int m_blocks = 0;
+  int m_head = 0;       // oldest full block
+  int m_count = 0;      // full blocks waiting for the writer
+  size_t m_fill_used = 0;
+  uint32_t m_seq = 0;
+  Stats m_stats = {};
+
+  uint8_t *fill_block() const { return m_memory + static_cast<size_t>((m_head + m_count) % m_blocks) * kBlockSize; }
+  void open_block();
+  void close_block();
+};
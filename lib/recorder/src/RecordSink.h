@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Where the recorder's writer puts full blocks. Returns bytes written.
+class RecordSink
+{
+public:
+  virtual ~RecordSink() {}
+  virtual size_t write(const uint8_t *data, size_t len) = 0;
+  virtual void close() {}
+};
+
+/**
+ * @brief Host stand-in for the flash file
+ *
+ * Keeps what is written in caller-provided memory and refuses writes once
+ * it is full, like a filesystem out of space. A per-write delay hook lets
+ * host runs model slow flash.
+ */
+class MemoryRecordSink : public RecordSink
+{
+public:
+  MemoryRecordSink(uint8_t *memory, size_t capacity) : m_memory(memory), m_capacity(capacity) {}
+
+  size_t write(const uint8_t *data, size_t len) override
+  {
+    if (m_size + len > m_capacity) {
+      return 0;
+    }
+    memcpy(m_memory + m_size, data, len);
+    m_size += len;
+    ++m_writes;
+    if (m_on_write) {
+      m_on_write(len);
+    }
+    return len;
+  }
+  void close() override { m_closed = true; }
+
+  void set_write_hook(void (*on_write)(size_t len)) { m_on_write = on_write; }
+  const uint8_t *data() const { return m_memory; }
+  size_t size() const { return m_size; }
+  uint32_t writes() const { return m_writes; }
+  bool closed() const { return m_closed; }
+
+private:
+  uint8_t *m_memory;
+  size_t m_capacity;
+  size_t m_size = 0;
+  uint32_t m_writes = 0;
+  bool m_closed = false;
+  void (*m_on_write)(size_t len) = nullptr;
+};
@@ -0,0 +1,161 @@
+#include <Arduino.h>
+#include <esp_timer.h>
+#include "Recorder.h"
+
+Recorder::Recorder(uint8_t *ring_memory, size_t ring_bytes)
+{
+  m_ring.init(ring_memory, ring_bytes);
+}
+
+bool Recorder::start(fs::FS &fs, const char *path)
+{
+  if (m_recording || m_closing || m_ring.capacity() == 0) {
+    return false;
+  }
+  fs.remove(path);
+  m_file_sink.m_file = fs.open(path, FILE_WRITE);
+  if (!m_file_sink.m_file) {
+    Serial.printf("REC: cannot open %s\n", path);
+    return false;
+  }
+  if (!start(&m_file_sink)) {
+    return false;
+  }
+  Serial.printf("REC: recording to %s (%d KB ring)\n", path, m_ring.capacity() * 4);
+  return true;
+}
+
+bool Recorder::start(RecordSink *sink)
+{
+  if (m_recording || m_closing || m_ring.capacity() == 0 || !sink) {
+    return false;
+  }
+  portENTER_CRITICAL(&m_lock);
+  m_sink = sink;
+  m_ring.reset();
+  m_stats = {};
+  m_recording = true;
+  portEXIT_CRITICAL(&m_lock);
+  m_start_ms = millis();
+  if (!m_writer) {
+    xTaskCreatePinnedToCore(writer_task, "rec_writer", 4096, this, 1, &m_writer, 0);
+  }
+  return true;
+}
+
+void Recorder::stop()
+{
+  portENTER_CRITICAL(&m_lock);
+  const bool was_recording = m_recording;
+  m_recording = false;
+  if (was_recording) {
+    m_ring.commit();
+    m_closing = true;
+  }
+  portEXIT_CRITICAL(&m_lock);
+}
+
+void Recorder::audio(Direction dir, uint16_t sender, const uint8_t *samples, size_t count)
+{
+  if (!m_recording) {
+    return;
+  }
+  const uint32_t now_ms = millis();
+  portENTER_CRITICAL(&m_lock);
+  if (m_recording) {
+    m_ring.append(RecordRing::kAudio, dir, sender, now_ms, samples, count);
+  }
+  portEXIT_CRITICAL(&m_lock);
+}
+
+void Recorder::talkspurt(Direction dir, uint16_t sender, bool start)
+{
+  if (!m_recording) {
+    return;
+  }
+  const uint32_t now_ms = millis();
+  portENTER_CRITICAL(&m_lock);
+  if (m_recording) {
+    m_ring.append(start ? RecordRing::kTalkspurtStart : RecordRing::kTalkspurtEnd, dir, sender, now_ms, nullptr, 0);
+  }
+  portEXIT_CRITICAL(&m_lock);
+}
+
+void Recorder::writer_task(void *param)
+{
+  Recorder *self = static_cast<Recorder *>(param);
+  for (;;) {
+    self->write_pending();
+    vTaskDelay(pdMS_TO_TICKS(kWriterIdleMs));
+  }
+}
+
+void Recorder::write_pending()
+{
+  for (;;) {
+    portENTER_CRITICAL(&m_lock);
+    const uint8_t *block = m_ring.front();
+    const bool drained = !block && m_closing;
+    portEXIT_CRITICAL(&m_lock);
+    if (drained) {
+      m_sink->close();
+      m_closing = false;
+      log_stats();
+    }
+    if (!block) {
+      break;
+    }
+    // the block at the front is ours until pop()
+    const uint32_t t0 = static_cast<uint32_t>(esp_timer_get_time());
+    const size_t written = m_sink->write(block, RecordRing::kBlockSize);
+    const uint32_t dt = static_cast<uint32_t>(esp_timer_get_time()) - t0;
+    portENTER_CRITICAL(&m_lock);
+    m_ring.pop();
+    m_stats.write_us_total += dt;
+    if (dt > m_stats.write_us_max) {
+      m_stats.write_us_max = dt;
+    }
+    if (written == RecordRing::kBlockSize) {
+      m_stats.bytes_written += written;
+    } else {
+      // flash full or failing: stop and throw away the rest
+      ++m_stats.write_errors;
+      while (m_ring.front()) {
+        m_ring.pop();
+        ++m_stats.dropped_blocks;
+      }
+      if (m_recording) {
+        m_recording = false;
+        m_closing = true;
+      }
+    }
+    portEXIT_CRITICAL(&m_lock);
+  }
+}
+
+void Recorder::snapshot_stats(Stats &out)
+{
+  portENTER_CRITICAL(&m_lock);
+  out = m_stats;
+  out.dropped_blocks += m_ring.stats().dropped_blocks;
+  out.max_queued = m_ring.stats().max_queued;
+  portEXIT_CRITICAL(&m_lock);
+}
+
+void Recorder::log_stats()
+{
+  Stats s;
+  snapshot_stats(s);
+  const uint32_t secs = (millis() - m_start_ms) / 1000;
+  Serial.printf("REC: %s %lus, %lu KB written, write %lu KB/s (slowest block %lums), queued max %u/%d, "
+                "dropped %lu blocks, errors %lu\n",
+                m_recording ? "recording" : (m_closing ? "closing" : "stopped"),
+                static_cast<unsigned long>(secs),
+                static_cast<unsigned long>(s.bytes_written / 1024),
+                static_cast<unsigned long>(s.write_us_total
+                    ? (static_cast<uint64_t>(s.bytes_written) * 1000000u / 1024u) / s.write_us_total : 0),
+                static_cast<unsigned long>(s.write_us_max / 1000),
+                static_cast<unsigned>(s.max_queued), m_ring.capacity(),
+                static_cast<unsigned long>(s.dropped_blocks),
+                static_cast<unsigned long>(s.write_errors));
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <FS.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "RecordRing.h"
+#include "RecordSink.h"
+
+/**
+ * @brief Streams TX and RX audio to a file in the background
+ *
+ * The audio paths hand over samples and talkspurt markers; they are packed
+ * into a RecordRing (PSRAM) under a short spinlock and never wait for
+ * flash. A low-priority writer task moves full blocks into the file, or
+ * into any RecordSink; without the task (host tests) the caller runs
+ * write_pending() itself. tools/rec_to_wav.py splits a recording into WAV
+ * files per talkspurt.
+ */
+class Recorder
+{
+public:
+  enum Direction : uint8_t {
+    kRx = 0,
+    kTx = 1,
+  };
+
+  struct Stats {
+    uint32_t bytes_written;
+    uint32_t write_us_total;
+    uint32_t write_us_max;     // slowest block write
+    uint32_t dropped_blocks;   // ring full, flash too slow
+    uint32_t write_errors;
+    uint16_t max_queued;       // most blocks waiting at once
+  };
+
+  static constexpr uint32_t kWriterIdleMs = 20;
+
+  Recorder(uint8_t *ring_memory, size_t ring_bytes);
+  bool start(fs::FS &fs, const char *path);
+  // records into sink, which must outlive the recording
+  bool start(RecordSink *sink);
+  // closes the sink once the ring has drained
+  void stop();
+  bool recording() const { return m_recording; }
+
+  void audio(Direction dir, uint16_t sender, const uint8_t *samples, size_t count);
+  void talkspurt(Direction dir, uint16_t sender, bool start);
+
+  void snapshot_stats(Stats &out);
+  void log_stats();
+  // moves every full block to the sink: the writer task's loop body, to be
+  // called directly only where that task does not run (host tests)
+  void write_pending();
+
+private:
+  class FileSink : public RecordSink
+  {
+  public:
+    size_t write(const uint8_t *data, size_t len) override { return m_file.write(data, len); }
+    void close() override { m_file.close(); }
+    fs::File m_file;
+  };
+
+  RecordRing m_ring;
+  FileSink m_file_sink;
+  RecordSink *m_sink = nullptr;
+  portMUX_TYPE m_lock = portMUX_INITIALIZER_UNLOCKED;
+  TaskHandle_t m_writer = nullptr;
+  volatile bool m_recording = false;
+  volatile bool m_closing = false;
+  uint32_t m_start_ms = 0;
+  Stats m_stats = {};
+
+  static void writer_task(void *param);
+};
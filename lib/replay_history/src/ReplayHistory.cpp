@@ -0,0 +1,89 @@
+#include "ReplayHistory.h"
+
+#include <string.h>
+
+void ReplayHistory::init(uint8_t *memory, size_t bytes)
+{
+  uint32_t capacity = 0;
+  if (memory) {
+    capacity = 1;
+    while (capacity * 2 <= bytes && capacity < 0x80000000u) {
+      capacity *= 2;
+    }
+  }
+  portENTER_CRITICAL(&m_lock);
+  m_memory = memory;
+  m_capacity = (capacity >= 4096) ? capacity : 0;
+  m_write_pos = 0;
+  m_open = false;
+  memset(m_index, 0, sizeof(m_index));
+  portEXIT_CRITICAL(&m_lock);
+}
+
+void ReplayHistory::append(uint16_t sender, uint32_t t_ms, const uint8_t *samples, size_t count)
+{
+  if (!m_capacity || count == 0 || count > m_capacity) {
+    return;
+  }
+  portENTER_CRITICAL(&m_lock);
+  if (!m_open || slot(m_next_id - 1).sender != sender || t_ms - m_last_ms > kGapMs) {
+    // the new talkspurt takes the slot of the oldest
+    slot(m_next_id) = { m_next_id, m_write_pos, 0, t_ms, sender };
+    ++m_next_id;
+    m_open = true;
+  }
+  const uint32_t ofs = m_write_pos & (m_capacity - 1);
+  const size_t first = (count < m_capacity - ofs) ? count : (m_capacity - ofs);
+  memcpy(m_memory + ofs, samples, first);
+  if (count > first) {
+    memcpy(m_memory, samples + first, count - first);
+  }
+  m_write_pos += static_cast<uint32_t>(count);
+  slot(m_next_id - 1).length += static_cast<uint32_t>(count);
+  m_last_ms = t_ms;
+  portEXIT_CRITICAL(&m_lock);
+}
+
+void ReplayHistory::end()
+{
+  portENTER_CRITICAL(&m_lock);
+  m_open = false;
+  portEXIT_CRITICAL(&m_lock);
+}
+
+bool ReplayHistory::get(uint32_t age, Talkspurt &out)
+{
+  bool found = false;
+  portENTER_CRITICAL(&m_lock);
+  if (age < kMaxTalkspurts && age + 1 < m_next_id) {
+    const uint32_t id = m_next_id - 1 - age;
+    const Talkspurt &ts = slot(id);
+    if (ts.id == id && held(ts.start)) {
+      out = ts;
+      found = true;
+    }
+  }
+  portEXIT_CRITICAL(&m_lock);
+  return found;
+}
+
+size_t ReplayHistory::read(const Talkspurt &ts, uint32_t offset, uint8_t *dst, size_t count)
+{
+  size_t n = 0;
+  portENTER_CRITICAL(&m_lock);
+  // an open talkspurt may have grown since get()
+  const Talkspurt &cur = slot(ts.id);
+  const uint32_t length = (cur.id == ts.id) ? cur.length : ts.length;
+  const uint32_t pos = ts.start + offset;
+  if (offset < length && held(pos)) {
+    n = (count < length - offset) ? count : (length - offset);
+    const uint32_t ofs = pos & (m_capacity - 1);
+    const size_t first = (n < m_capacity - ofs) ? n : (m_capacity - ofs);
+    memcpy(dst, m_memory + ofs, first);
+    if (n > first) {
+      memcpy(dst + first, m_memory, n - first);
+    }
+  }
+  portEXIT_CRITICAL(&m_lock);
+  return n;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <freertos/FreeRTOS.h>
+
+/**
+ * @brief The last received talkspurts, kept for local replay
+ *
+ * Decoded RX audio goes into one circular sample buffer (PSRAM) and a small
+ * index ring notes where each talkspurt starts. Talkspurts carry a running
+ * id: the index slot is id % kMaxTalkspurts, and a talkspurt is gone once
+ * its slot is reused or its first sample overwritten. Lookup and eviction
+ * are O(1) and nothing is ever moved; the RX path only copies one frame.
+ */
+class ReplayHistory
+{
+public:
+  static constexpr uint32_t kMaxTalkspurts = 64;
+  // a pause this long without an EOT starts a new talkspurt
+  static constexpr uint32_t kGapMs = 3000;
+
+  struct Talkspurt {
+    uint32_t id;
+    uint32_t start;     // sample position, counts up from 0
+    uint32_t length;    // samples
+    uint32_t t_ms;      // millis() at the first sample
+    uint16_t sender;
+  };
+
+  // uses the largest power of two bytes that fits
+  void init(uint8_t *memory, size_t bytes);
+  size_t capacity() const { return m_capacity; }
+
+  // RX path: decoded 8 bit samples from sender
+  void append(uint16_t sender, uint32_t t_ms, const uint8_t *samples, size_t count);
+  // EOT: the next audio starts a new talkspurt
+  void end();
+
+  // age 0 = newest; false if evicted or never received
+  bool get(uint32_t age, Talkspurt &out);
+  // copies up to count samples from offset; 0 at the end or once overwritten
+  size_t read(const Talkspurt &ts, uint32_t offset, uint8_t *dst, size_t count);
+
+private:
+  uint8_t *m_memory = nullptr;
+  uint32_t m_capacity = 0;
+  uint32_t m_write_pos = 0;
+  uint32_t m_next_id = 1;
+  bool m_open = false;
+  uint32_t m_last_ms = 0;
+  Talkspurt m_index[kMaxTalkspurts] = {};
+  portMUX_TYPE m_lock = portMUX_INITIALIZER_UNLOCKED;
+
+  Talkspurt &slot(uint32_t id) { return m_index[id % kMaxTalkspurts]; }
+  bool held(uint32_t pos) const { return m_write_pos - pos <= m_capacity; }
+};
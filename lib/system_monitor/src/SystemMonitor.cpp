@@ -0,0 +1,204 @@
+#include <Arduino.h>
+#include <esp_freertos_hooks.h>
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+#include <string.h>
+#include "SystemMonitor.h"
+
+#if !configGENERATE_RUN_TIME_STATS
+namespace {
+
+// gaps between idle loop passes shorter than this count as idle time
+constexpr uint32_t kIdleGapUs = 50;
+
+struct IdleClock {
+  uint32_t last_us;
+  uint32_t idle_us;
+};
+
+// written only by the idle task of each core
+volatile IdleClock idle_clock[SystemMonitor::kCores];
+
+bool idle_hook()
+{
+  volatile IdleClock &c = idle_clock[xPortGetCoreID()];
+  const uint32_t now = static_cast<uint32_t>(esp_timer_get_time());
+  const uint32_t gap = now - c.last_us;
+  if (gap < kIdleGapUs) {
+    c.idle_us += gap;
+  }
+  c.last_us = now;
+  // keep spinning instead of waiting for an interrupt
+  return false;
+}
+
+}  // namespace
+#endif
+
+SystemMonitor::SystemMonitor(uint32_t interval_ms)
+  : m_interval_ms(interval_ms)
+{
+}
+
+void SystemMonitor::begin()
+{
+  if (m_running) {
+    return;
+  }
+#if !configGENERATE_RUN_TIME_STATS
+  for (int core = 0; core < kCores; ++core) {
+    m_prev_idle_us[core] = idle_clock[core].idle_us;
+    esp_register_freertos_idle_hook_for_cpu(idle_hook, core);
+  }
+#endif
+  m_last_ms = millis();
+  m_last_us = static_cast<uint32_t>(esp_timer_get_time());
+  m_prev_count = 0;
+  m_running = true;
+}
+
+void SystemMonitor::end()
+{
+  if (!m_running) {
+    return;
+  }
+#if !configGENERATE_RUN_TIME_STATS
+  for (int core = 0; core < kCores; ++core) {
+    esp_deregister_freertos_idle_hook_for_cpu(idle_hook, core);
+  }
+#endif
+  m_running = false;
+}
+
+bool SystemMonitor::update(uint32_t now_ms)
+{
+  if (!m_running || now_ms - m_last_ms < m_interval_ms) {
+    return false;
+  }
+  m_last_ms = now_ms;
+  const uint32_t now_us = static_cast<uint32_t>(esp_timer_get_time());
+  const uint32_t elapsed_us = now_us - m_last_us;
+  m_last_us = now_us;
+
+  sample_tasks();
+  sample_cores(elapsed_us);
+  sample_heap(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT, m_snapshot.internal);
+  m_snapshot.have_psram = heap_caps_get_total_size(MALLOC_CAP_SPIRAM) > 0;
+  if (m_snapshot.have_psram) {
+    sample_heap(MALLOC_CAP_SPIRAM, m_snapshot.psram);
+  }
+  return true;
+}
+
+void SystemMonitor::sample_tasks()
+{
+#if configUSE_TRACE_FACILITY
+  TaskStatus_t status[kMaxTasks];
+  uint32_t total = 0;
+  const int count = static_cast<int>(uxTaskGetSystemState(status, kMaxTasks, &total));
+  if (count == 0) {
+    // more tasks than kMaxTasks: keep the last snapshot
+    return;
+  }
+  const uint32_t total_delta = total - m_prev_total;
+  m_prev_total = total;
+  RunTime current[kMaxTasks];
+  m_snapshot.task_count = count;
+  for (int i = 0; i < count; ++i) {
+    const TaskStatus_t &s = status[i];
+    TaskInfo &t = m_snapshot.tasks[i];
+    strncpy(t.name, s.pcTaskName, sizeof(t.name) - 1);
+    t.name[sizeof(t.name) - 1] = '\0';
+    t.core = (s.xCoreID < kCores) ? static_cast<int8_t>(s.xCoreID) : -1;
+    t.priority = static_cast<uint8_t>(s.uxCurrentPriority);
+    // ESP-IDF stacks are counted in bytes
+    t.stack_free = s.usStackHighWaterMark;
+    t.cpu_percent = kCpuUnknown;
+    current[i].handle = s.xHandle;
+    current[i].counter = s.ulRunTimeCounter;
+#if configGENERATE_RUN_TIME_STATS
+    for (int j = 0; j < m_prev_count && total_delta > 0; ++j) {
+      if (m_prev[j].handle == s.xHandle) {
+        const uint32_t delta = s.ulRunTimeCounter - m_prev[j].counter;
+        t.cpu_percent = static_cast<uint8_t>((static_cast<uint64_t>(delta) * 100 + total_delta / 2) / total_delta);
+        break;
+      }
+    }
+#endif
+  }
+  memcpy(m_prev, current, sizeof(RunTime) * count);
+  m_prev_count = count;
+#else
+  m_snapshot.task_count = 0;
+#endif
+}
+
+void SystemMonitor::sample_cores(uint32_t elapsed_us)
+{
+  for (int core = 0; core < kCores; ++core) {
+#if configGENERATE_RUN_TIME_STATS
+    // 100% minus the idle task's share
+    const TaskHandle_t idle = xTaskGetIdleTaskHandleForCPU(core);
+    uint8_t idle_percent = 100;
+    for (int i = 0; i < m_prev_count; ++i) {
+      if (m_prev[i].handle == idle) {
+        idle_percent = m_snapshot.tasks[i].cpu_percent;
+        break;
+      }
+    }
+    m_snapshot.core_load[core] = (idle_percent <= 100) ? static_cast<uint8_t>(100 - idle_percent) : kCpuUnknown;
+#else
+    const uint32_t idle_us = idle_clock[core].idle_us;
+    uint32_t idle_delta = idle_us - m_prev_idle_us[core];
+    m_prev_idle_us[core] = idle_us;
+    if (idle_delta > elapsed_us) {
+      idle_delta = elapsed_us;
+    }
+    m_snapshot.core_load[core] = elapsed_us
+        ? static_cast<uint8_t>(100 - (static_cast<uint64_t>(idle_delta) * 100 + elapsed_us / 2) / elapsed_us)
+        : 0;
+#endif
+  }
+}
+
+void SystemMonitor::sample_heap(uint32_t caps, HeapInfo &out)
+{
+  out.free = heap_caps_get_free_size(caps);
+  out.largest_block = heap_caps_get_largest_free_block(caps);
+  out.min_free = heap_caps_get_minimum_free_size(caps);
+  out.fragmentation = out.free
+      ? static_cast<uint8_t>(100 - (static_cast<uint64_t>(out.largest_block) * 100) / out.free)
+      : 0;
+}
+
+void SystemMonitor::log() const
+{
+  const Snapshot &s = m_snapshot;
+  Serial.printf("SYSMON: cpu");
+  for (int core = 0; core < kCores; ++core) {
+    Serial.printf(" %u%%", static_cast<unsigned>(s.core_load[core]));
+  }
+  Serial.printf(" | int free=%lu largest=%lu min=%lu frag=%u%%",
+                static_cast<unsigned long>(s.internal.free),
+                static_cast<unsigned long>(s.internal.largest_block),
+                static_cast<unsigned long>(s.internal.min_free),
+                static_cast<unsigned>(s.internal.fragmentation));
+  if (s.have_psram) {
+    Serial.printf(" | psram free=%lu largest=%lu min=%lu frag=%u%%",
+                  static_cast<unsigned long>(s.psram.free),
+                  static_cast<unsigned long>(s.psram.largest_block),
+                  static_cast<unsigned long>(s.psram.min_free),
+                  static_cast<unsigned>(s.psram.fragmentation));
+  }
+  Serial.println();
+  for (int i = 0; i < s.task_count; ++i) {
+    const TaskInfo &t = s.tasks[i];
+    Serial.printf("SYSMON TASK: %-16s core=%c prio=%2u stack_free=%5lu",
+                  t.name, (t.core < 0) ? '-' : static_cast<char>('0' + t.core),
+                  static_cast<unsigned>(t.priority), static_cast<unsigned long>(t.stack_free));
+    if (t.cpu_percent != kCpuUnknown) {
+      Serial.printf(" cpu=%u%%", static_cast<unsigned>(t.cpu_percent));
+    }
+    Serial.println();
+  }
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+/**
+ * @brief Periodic CPU, stack and heap figures
+ *
+ * Every interval the monitor takes a snapshot: load per core, free stack
+ * (high-water mark) and, when FreeRTOS run-time stats are compiled in, CPU
+ * share per task, plus free / largest free block / lowest free for the
+ * internal heap and PSRAM.
+ *
+ * Without run-time stats (the Arduino default) core load comes from idle
+ * hooks that keep the idle tasks spinning and add up the short gaps between
+ * their calls; time taken by other tasks shows up as long gaps. The idle
+ * cores then no longer wait for interrupts, so the monitor costs some power
+ * while it runs.
+ */
+class SystemMonitor
+{
+public:
+  static constexpr int kMaxTasks = 24;
+  static constexpr int kCores = portNUM_PROCESSORS;
+  static constexpr uint8_t kCpuUnknown = 0xff;
+
+  struct TaskInfo {
+    char name[configMAX_TASK_NAME_LEN];
+    int8_t core;                // -1 = not pinned
+    uint8_t priority;
+    uint8_t cpu_percent;        // kCpuUnknown without run-time stats
+    uint32_t stack_free;        // bytes, lowest since the task started
+  };
+
+  struct HeapInfo {
+    uint32_t free;
+    uint32_t largest_block;
+    uint32_t min_free;
+    uint8_t fragmentation;      // 100 - largest block as % of free
+  };
+
+  struct Snapshot {
+    uint8_t core_load[kCores];  // percent
+    int task_count;
+    TaskInfo tasks[kMaxTasks];
+    HeapInfo internal;
+    HeapInfo psram;
+    bool have_psram;
+  };
+
+  explicit SystemMonitor(uint32_t interval_ms);
+  void begin();
+  void end();
+  bool running() const { return m_running; }
+  // run from a loop; returns true when a new snapshot was taken
+  bool update(uint32_t now_ms);
+  const Snapshot &snapshot() const { return m_snapshot; }
+  void log() const;
+
+private:
+  struct RunTime {
+    TaskHandle_t handle;
+    uint32_t counter;
+  };
+
+  uint32_t m_interval_ms;
+  bool m_running = false;
+  uint32_t m_last_ms = 0;
+  uint32_t m_last_us = 0;
+  Snapshot m_snapshot = {};
+  RunTime m_prev[kMaxTasks] = {};
+  int m_prev_count = 0;
+  uint32_t m_prev_total = 0;
+  uint32_t m_prev_idle_us[kCores] = {};
+
+  void sample_tasks();
+  void sample_cores(uint32_t elapsed_us);
+  static void sample_heap(uint32_t caps, HeapInfo &out);
+};
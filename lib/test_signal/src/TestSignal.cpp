@@ -0,0 +1,166 @@
+#include "TestSignal.h"
+
+#include <math.h>
+#include <string.h>
+
+// one period plus a guard entry for the interpolation
+static const int16_t kSineTable[257] = {
+  0, 804, 1608, 2410, 3212, 4011, 4808, 5602, 6393, 7179, 7962, 8739,
+  9512, 10278, 11039, 11793, 12539, 13279, 14010, 14732, 15446, 16151, 16846, 17530,
+  18204, 18868, 19519, 20159, 20787, 21403, 22005, 22594, 23170, 23731, 24279, 24811,
+  25329, 25832, 26319, 26790, 27245, 27683, 28105, 28510, 28898, 29268, 29621, 29956,
+  30273, 30571, 30852, 31113, 31356, 31580, 31785, 31971, 32137, 32285, 32412, 32521,
+  32609, 32678, 32728, 32757, 32767, 32757, 32728, 32678, 32609, 32521, 32412, 32285,
+  32137, 31971, 31785, 31580, 31356, 31113, 30852, 30571, 30273, 29956, 29621, 29268,
+  28898, 28510, 28105, 27683, 27245, 26790, 26319, 25832, 25329, 24811, 24279, 23731,
+  23170, 22594, 22005, 21403, 20787, 20159, 19519, 18868, 18204, 17530, 16846, 16151,
+  15446, 14732, 14010, 13279, 12539, 11793, 11039, 10278, 9512, 8739, 7962, 7179,
+  6393, 5602, 4808, 4011, 3212, 2410, 1608, 804, 0, -804, -1608, -2410,
+  -3212, -4011, -4808, -5602, -6393, -7179, -7962, -8739, -9512, -10278, -11039, -11793,
+  -12539, -13279, -14010, -14732, -15446, -16151, -16846, -17530, -18204, -18868, -19519, -20159,
+  -20787, -21403, -22005, -22594, -23170, -23731, -24279, -24811, -25329, -25832, -26319, -26790,
+  -27245, -27683, -28105, -28510, -28898, -29268, -29621, -29956, -30273, -30571, -30852, -31113,
+  -31356, -31580, -31785, -31971, -32137, -32285, -32412, -32521, -32609, -32678, -32728, -32757,
+  -32767, -32757, -32728, -32678, -32609, -32521, -32412, -32285, -32137, -31971, -31785, -31580,
+  -31356, -31113, -30852, -30571, -30273, -29956, -29621, -29268, -28898, -28510, -28105, -27683,
+  -27245, -26790, -26319, -25832, -25329, -24811, -24279, -23731, -23170, -22594, -22005, -21403,
+  -20787, -20159, -19519, -18868, -18204, -17530, -16846, -16151, -15446, -14732, -14010, -13279,
+  -12539, -11793, -11039, -10278, -9512, -8739, -7962, -7179, -6393, -5602, -4808, -4011,
+  -3212, -2410, -1608, -804, 0
+};
+
+int16_t Nco::sine_q15(uint32_t phase)
+{
+  const uint32_t i = phase >> 24;
+  const int32_t frac = static_cast<int32_t>((phase >> 8) & 0xffff);
+  const int32_t a = kSineTable[i];
+  const int32_t b = kSineTable[i + 1];
+  return static_cast<int16_t>(a + (((b - a) * frac) >> 16));
+}
+
+void Nco::set_frequency(uint32_t hz, uint32_t sample_rate)
+{
+  m_inc = static_cast<uint32_t>(((static_cast<uint64_t>(hz) << 32) + sample_rate / 2) / sample_rate);
+}
+
+bool SilenceSource::read(int16_t *samples, size_t count)
+{
+  memset(samples, 0, count * sizeof(int16_t));
+  return true;
+}
+
+ToneSource::ToneSource(const char *name, const uint16_t *freqs_hz, int count, int16_t level, uint32_t sample_rate)
+  : m_name(name), m_count(count < kMaxTones ? count : kMaxTones)
+{
+  for (int i = 0; i < m_count; ++i) {
+    m_nco[i].set_frequency(freqs_hz[i], sample_rate);
+  }
+  m_gain_q15 = static_cast<int16_t>(m_count ? level / m_count : 0);
+}
+
+void ToneSource::reset()
+{
+  for (int i = 0; i < m_count; ++i) {
+    m_nco[i].reset();
+  }
+}
+
+bool ToneSource::read(int16_t *samples, size_t count)
+{
+  for (size_t n = 0; n < count; ++n) {
+    int32_t acc = 0;
+    for (int i = 0; i < m_count; ++i) {
+      acc += m_nco[i].next();
+    }
+    samples[n] = static_cast<int16_t>((acc * m_gain_q15) >> 15);
+  }
+  return true;
+}
+
+SweepSource::SweepSource(uint16_t start_hz, uint16_t end_hz, uint32_t period_ms, int16_t level, uint32_t sample_rate)
+  : m_level(level)
+{
+  m_nco.set_frequency(start_hz, sample_rate);
+  m_start_inc = m_nco.increment();
+  m_nco.set_frequency(end_hz, sample_rate);
+  m_end_inc = m_nco.increment();
+  // growth per sample, worked out once; the per-sample path stays integer
+  const uint32_t period_samples = period_ms * (sample_rate / 1000);
+  const double ratio = exp(log(static_cast<double>(end_hz) / start_hz) / (period_samples ? period_samples : 1));
+  m_ratio_q30 = static_cast<uint32_t>(ratio * (1u << 30) + 0.5);
+  reset();
+}
+
+void SweepSource::reset()
+{
+  m_nco.reset();
+  m_nco.set_increment(m_start_inc);
+}
+
+bool SweepSource::read(int16_t *samples, size_t count)
+{
+  for (size_t n = 0; n < count; ++n) {
+    samples[n] = static_cast<int16_t>((static_cast<int32_t>(m_nco.next()) * m_level) >> 15);
+    uint32_t inc = static_cast<uint32_t>((static_cast<uint64_t>(m_nco.increment()) * m_ratio_q30) >> 30);
+    if (inc >= m_end_inc) {
+      // phase stays continuous into the next sweep
+      inc = m_start_inc;
+    }
+    m_nco.set_increment(inc);
+  }
+  return true;
+}
+
+NoiseSource::NoiseSource(Color color, int16_t level) : m_color(color), m_level(level)
+{
+  reset();
+}
+
+void NoiseSource::reset()
+{
+  m_rand = 0x2545f491u;
+  m_counter = 0;
+  m_row_sum = 0;
+  for (int i = 0; i < kPinkRows; ++i) {
+    m_rows[i] = static_cast<int32_t>(next_rand()) >> 21;
+    m_row_sum += m_rows[i];
+  }
+}
+
+bool NoiseSource::read(int16_t *samples, size_t count)
+{
+  for (size_t n = 0; n < count; ++n) {
+    int32_t x;
+    if (m_color == kWhite) {
+      x = static_cast<int16_t>(next_rand() >> 16);
+    } else {
+      // row k changes every 2^(k+1) samples; one white row on top
+      ++m_counter;
+      const int k = __builtin_ctz(m_counter);
+      if (k < kPinkRows) {
+        const int32_t v = static_cast<int32_t>(next_rand()) >> 21;
+        m_row_sum += v - m_rows[k];
+        m_rows[k] = v;
+      }
+      x = m_row_sum + (static_cast<int32_t>(next_rand()) >> 21);
+      // 13 rows of +-1024: scale so even the worst case stays in range
+      x = (x * 9) >> 2;
+    }
+    samples[n] = static_cast<int16_t>((x * m_level) >> 15);
+  }
+  return true;
+}
+
+bool MlsSource::read(int16_t *samples, size_t count)
+{
+  for (size_t n = 0; n < count; ++n) {
+    // Galois LFSR, x^15 + x^14 + 1
+    const uint16_t bit = m_lfsr & 1;
+    m_lfsr >>= 1;
+    if (bit) {
+      m_lfsr ^= 0x6000;
+    }
+    samples[n] = bit ? m_level : static_cast<int16_t>(-m_level);
+  }
+  return true;
+}
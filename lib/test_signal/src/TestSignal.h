@@ -0,0 +1,119 @@
+#pragma once
+
+#include "TxSource.h"
+
+/**
+ * @brief Synthetic TX test signals, all in fixed point
+ *
+ * Levels are peak amplitudes in int16 units. Every signal restarts on
+ * reset(), so each talkspurt carries the same audio.
+ */
+
+// Phase accumulator oscillator: 32 bit phase, 256 entry sine table with
+// linear interpolation (within 4 LSB of an exact sine).
+class Nco
+{
+public:
+  void set_frequency(uint32_t hz, uint32_t sample_rate);
+  void set_increment(uint32_t inc) { m_inc = inc; }
+  uint32_t increment() const { return m_inc; }
+  void reset() { m_phase = 0; }
+  // Q15 sine, advances one sample
+  int16_t next()
+  {
+    const int16_t s = sine_q15(m_phase);
+    m_phase += m_inc;
+    return s;
+  }
+  static int16_t sine_q15(uint32_t phase);
+
+private:
+  uint32_t m_phase = 0;
+  uint32_t m_inc = 0;
+};
+
+class SilenceSource : public TxSource
+{
+public:
+  const char *name() const override { return "silence"; }
+  bool read(int16_t *samples, size_t count) override;
+};
+
+class ToneSource : public TxSource
+{
+public:
+  static constexpr int kMaxTones = 4;
+  // tones share the level equally
+  ToneSource(const char *name, const uint16_t *freqs_hz, int count, int16_t level, uint32_t sample_rate);
+  const char *name() const override { return m_name; }
+  void reset() override;
+  bool read(int16_t *samples, size_t count) override;
+
+private:
+  const char *m_name;
+  Nco m_nco[kMaxTones];
+  int m_count;
+  int16_t m_gain_q15;
+};
+
+// Exponential sine sweep from start to end over period, then again
+class SweepSource : public TxSource
+{
+public:
+  SweepSource(uint16_t start_hz, uint16_t end_hz, uint32_t period_ms, int16_t level, uint32_t sample_rate);
+  const char *name() const override { return "sweep"; }
+  void reset() override;
+  bool read(int16_t *samples, size_t count) override;
+
+private:
+  Nco m_nco;
+  uint32_t m_start_inc;
+  uint32_t m_end_inc;
+  uint32_t m_ratio_q30;   // per-sample increment growth
+  int16_t m_level;
+};
+
+class NoiseSource : public TxSource
+{
+public:
+  enum Color : uint8_t {
+    kWhite,
+    kPink,    // Voss-McCartney, -3 dB/octave
+  };
+  NoiseSource(Color color, int16_t level);
+  const char *name() const override { return m_color == kWhite ? "white" : "pink"; }
+  void reset() override;
+  bool read(int16_t *samples, size_t count) override;
+
+private:
+  static constexpr int kPinkRows = 12;
+  Color m_color;
+  int16_t m_level;
+  uint32_t m_rand = 1;
+  uint32_t m_counter = 0;
+  int32_t m_rows[kPinkRows] = {};
+  int32_t m_row_sum = 0;
+
+  uint32_t next_rand()
+  {
+    m_rand ^= m_rand << 13;
+    m_rand ^= m_rand >> 17;
+    m_rand ^= m_rand << 5;
+    return m_rand;
+  }
+};
+
+// Maximum length sequence, order 15 (32767 samples, about 2 s at 16 kHz)
+class MlsSource : public TxSource
+{
+public:
+  static constexpr uint32_t kPeriod = 32767;
+  explicit MlsSource(int16_t level) : m_level(level) {}
+  const char *name() const override { return "mls"; }
+  void reset() override { m_lfsr = 1; }
+  bool read(int16_t *samples, size_t count) override;
+
+private:
+  int16_t m_level;
+  uint16_t m_lfsr = 1;
+};
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Where the TX path takes its audio from
+ *
+ * The microphone is one source; the test signals in TestSignal.h and
+ * WavFileSource are others, so repeatable audio can be pushed through the
+ * real transport without anyone talking.
+ */
+class TxSource
+{
+public:
+  virtual ~TxSource() {}
+  virtual const char *name() const = 0;
+  // called at key-up: signals start again from the beginning
+  virtual void reset() {}
+  // fills count samples at SAMPLE_RATE; false if none are ready yet
+  virtual bool read(int16_t *samples, size_t count) = 0;
+  // paced by its own hardware; otherwise the caller paces it
+  virtual bool realtime() const { return false; }
+};
@@ -0,0 +1,114 @@
+#include <Arduino.h>
+#include "WavFileSource.h"
+
+static uint32_t le32(const uint8_t *p)
+{
+  return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+static uint16_t le16(const uint8_t *p)
+{
+  return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+WavFileSource::WavFileSource(fs::FS &fs, const char *path, uint32_t sample_rate)
+  : m_fs(fs), m_path(path), m_sample_rate(sample_rate)
+{
+}
+
+void WavFileSource::reset()
+{
+  if (m_file) {
+    m_file.close();
+  }
+  m_valid = open();
+  m_buffer_len = 0;
+  m_buffer_pos = 0;
+}
+
+bool WavFileSource::open()
+{
+  m_file = m_fs.open(m_path, FILE_READ);
+  if (!m_file) {
+    Serial.printf("TXSRC: cannot open %s\n", m_path);
+    return false;
+  }
+  uint8_t hdr[12];
+  if (m_file.read(hdr, 12) != 12 || memcmp(hdr, "RIFF", 4) != 0 || memcmp(hdr + 8, "WAVE", 4) != 0) {
+    Serial.printf("TXSRC: %s is not a WAV file\n", m_path);
+    return false;
+  }
+  bool have_fmt = false;
+  uint32_t pos = 12;
+  for (;;) {
+    uint8_t chunk[8];
+    if (m_file.read(chunk, 8) != 8) {
+      Serial.printf("TXSRC: %s has no data chunk\n", m_path);
+      return false;
+    }
+    const uint32_t size = le32(chunk + 4);
+    pos += 8;
+    if (memcmp(chunk, "fmt ", 4) == 0 && size >= 16) {
+      uint8_t fmt[16];
+      m_file.read(fmt, 16);
+      const uint16_t format = le16(fmt);
+      const uint16_t channels = le16(fmt + 2);
+      const uint32_t rate = le32(fmt + 4);
+      m_bits = static_cast<uint8_t>(le16(fmt + 14));
+      if (format != 1 || channels != 1 || rate != m_sample_rate || (m_bits != 8 && m_bits != 16)) {
+        Serial.printf("TXSRC: %s: need mono 8/16 bit PCM at %lu Hz (have fmt %u, %u ch, %lu Hz, %u bit)\n",
+                      m_path, static_cast<unsigned long>(m_sample_rate), format, channels,
+                      static_cast<unsigned long>(rate), m_bits);
+        return false;
+      }
+      have_fmt = true;
+    } else if (memcmp(chunk, "data", 4) == 0 && have_fmt) {
+      m_data_start = pos;
+      m_data_bytes = size & ~static_cast<uint32_t>(m_bits / 8 - 1);
+      m_data_pos = 0;
+      Serial.printf("TXSRC: %s, %lu ms\n", m_path,
+                    static_cast<unsigned long>(m_data_bytes / (m_bits / 8) * 1000 / m_sample_rate));
+      return m_data_bytes > 0;
+    }
+    // chunks are padded to even sizes
+    pos += size + (size & 1);
+    m_file.seek(pos);
+  }
+}
+
+bool WavFileSource::refill()
+{
+  if (m_data_pos >= m_data_bytes) {
+    // loop
+    m_data_pos = 0;
+    m_file.seek(m_data_start);
+  }
+  size_t want = m_data_bytes - m_data_pos;
+  if (want > kReadBytes) {
+    want = kReadBytes;
+  }
+  m_buffer_len = m_file.read(m_buffer, want);
+  m_buffer_pos = 0;
+  m_data_pos += m_buffer_len;
+  return m_buffer_len > 0;
+}
+
+bool WavFileSource::read(int16_t *samples, size_t count)
+{
+  if (!m_valid) {
+    memset(samples, 0, count * sizeof(int16_t));
+    return true;
+  }
+  const size_t step = m_bits / 8;
+  for (size_t n = 0; n < count; ++n) {
+    if (m_buffer_pos + step > m_buffer_len && !refill()) {
+      m_valid = false;
+      memset(samples + n, 0, (count - n) * sizeof(int16_t));
+      break;
+    }
+    const uint8_t *p = m_buffer + m_buffer_pos;
+    samples[n] = (step == 2) ? static_cast<int16_t>(le16(p)) : static_cast<int16_t>((p[0] - 128) << 8);
+    m_buffer_pos += step;
+  }
+  return true;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <FS.h>
+#include "TxSource.h"
+
+/**
+ * @brief Plays a WAV file from flash as TX audio, looping
+ *
+ * Mono PCM, 8 or 16 bit, at the TX sample rate; anything else is refused
+ * with a log line. The file is opened at reset() (key-up) and read in
+ * small blocks; 16 kHz 16 bit needs 32 KB/s from flash.
+ */
+class WavFileSource : public TxSource
+{
+public:
+  WavFileSource(fs::FS &fs, const char *path, uint32_t sample_rate);
+  const char *name() const override { return "wav"; }
+  void reset() override;
+  bool read(int16_t *samples, size_t count) override;
+
+private:
+  static constexpr size_t kReadBytes = 512;
+  fs::FS &m_fs;
+  const char *m_path;
+  uint32_t m_sample_rate;
+  fs::File m_file;
+  bool m_valid = false;
+  uint8_t m_bits = 16;
+  uint32_t m_data_start = 0;
+  uint32_t m_data_bytes = 0;
+  uint32_t m_data_pos = 0;
+  uint8_t m_buffer[kReadBytes];
+  size_t m_buffer_len = 0;
+  size_t m_buffer_pos = 0;
+
+  bool open();
+  bool refill();
+};
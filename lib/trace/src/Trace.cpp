@@ -0,0 +1,70 @@
+#include <Arduino.h>
+#include "Trace.h"
+
+Trace::Entry Trace::m_ring[Trace::kCapacity];
+std::atomic<uint32_t> Trace::m_head(0);
+std::atomic<bool> Trace::m_enabled(TRACE_ENABLE != 0);
+
+namespace {
+
+struct EventName {
+  const char *name;
+  char phase;   // Chrome trace phase: B/E slice, i instant
+};
+
+const EventName kEventNames[kTraceEventCount] = {
+  { "mic_read", 'i' },
+  { "tx_frame", 'i' },
+  { "esp_now_send", 'B' },
+  { "esp_now_send", 'E' },
+  { "tx_done", 'i' },
+  { "rx_callback", 'B' },
+  { "rx_callback", 'E' },
+  { "rx_frame", 'i' },
+  { "rx_conceal", 'i' },
+  { "play_raw", 'i' },
+};
+
+}  // namespace
+
+void Trace::dump()
+{
+  const bool was_enabled = get_enabled();
+  set_enabled(false);
+  // let writers that already claimed a slot finish it
+  vTaskDelay(pdMS_TO_TICKS(2));
+  const uint32_t head = m_head.load(std::memory_order_relaxed);
+  const uint32_t count = (head < kCapacity) ? head : kCapacity;
+  Serial.printf("TRACE BEGIN events=%lu overwritten=%lu\n",
+                static_cast<unsigned long>(count),
+                static_cast<unsigned long>(head - count));
+  for (int id = 0; id < kTraceEventCount; ++id) {
+    Serial.printf("TRACE NAME %d %s %c\n", id, kEventNames[id].name, kEventNames[id].phase);
+  }
+  for (uint32_t i = head - count; i != head; ++i) {
+    const Entry &e = m_ring[i & (kCapacity - 1)];
+    Serial.printf("TRACE %lu %u %u %u\n",
+                  static_cast<unsigned long>(e.t_us),
+                  static_cast<unsigned>(e.id),
+                  static_cast<unsigned>(e.core),
+                  static_cast<unsigned>(e.arg));
+  }
+  Serial.println("TRACE END");
+  clear();
+  set_enabled(was_enabled);
+}
+
+uint32_t Trace::measure_overhead_cycles(bool enabled)
+{
+  constexpr uint32_t kRuns = 1000;
+  const bool was_enabled = get_enabled();
+  set_enabled(enabled);
+  const uint32_t c0 = ESP.getCycleCount();
+  for (uint32_t i = 0; i < kRuns; ++i) {
+    record(kTraceMicRead, static_cast<uint16_t>(i));
+  }
+  const uint32_t cycles = ESP.getCycleCount() - c0;
+  clear();
+  set_enabled(was_enabled);
+  return cycles / kRuns;
+}
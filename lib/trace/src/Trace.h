@@ -0,0 +1,78 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include "config.h"
+
+// Trace points along the TX and RX audio paths. Begin/End pairs become
+// duration slices in the Chrome trace, the rest instant events.
+enum TraceEventId : uint8_t {
+  kTraceMicRead,         // arg: samples captured
+  kTraceTxFrame,         // frame packetized, arg: seq
+  kTraceTxSendBegin,     // esp_now_send, arg: length
+  kTraceTxSendEnd,       // arg: esp_err_t
+  kTraceTxDone,          // send callback
+  kTraceRxBegin,         // receive callback, arg: length
+  kTraceRxEnd,
+  kTraceRxFrame,         // decoded into OutputBuffer, arg: samples
+  kTraceRxConceal,       // gap concealed, arg: samples
+  kTracePlayRaw,         // chunk queued to the speaker, arg: buffer fill
+  kTraceEventCount,
+};
+
+/**
+ * @brief Fixed-size in-memory event ring
+ *
+ * Any task or core claims a slot with one atomic increment, so recording
+ * never locks; the oldest events are overwritten. Timestamps come from
+ * esp_timer (microseconds, same clock on both cores). dump() pauses
+ * recording and prints the ring over serial; tools/trace_to_chrome.py
+ * turns that into Chrome/Perfetto trace JSON.
+ */
+class Trace
+{
+public:
+  static constexpr uint32_t kCapacity = 2048;   // power of two, 8 bytes each
+
+  struct Entry {
+    uint32_t t_us;
+    uint8_t id;
+    uint8_t core;
+    uint16_t arg;
+  };
+
+  static inline void record(uint8_t id, uint16_t arg)
+  {
+    if (!m_enabled.load(std::memory_order_relaxed)) {
+      return;
+    }
+    const uint32_t i = m_head.fetch_add(1, std::memory_order_relaxed);
+    Entry &e = m_ring[i & (kCapacity - 1)];
+    e.t_us = static_cast<uint32_t>(esp_timer_get_time());
+    e.id = id;
+    e.core = static_cast<uint8_t>(xPortGetCoreID());
+    e.arg = arg;
+  }
+
+  static void set_enabled(bool enabled) { m_enabled.store(enabled, std::memory_order_relaxed); }
+  static bool get_enabled() { return m_enabled.load(std::memory_order_relaxed); }
+  static void clear() { m_head.store(0, std::memory_order_relaxed); }
+  // prints the ring oldest first, then resumes recording if it was on
+  static void dump();
+  // average CPU cycles per record() call, recording or switched off;
+  // clears the ring
+  static uint32_t measure_overhead_cycles(bool enabled);
+
+private:
+  static Entry m_ring[kCapacity];
+  static std::atomic<uint32_t> m_head;
+  static std::atomic<bool> m_enabled;
+};
+
+#if TRACE_ENABLE
+#define TRACE_EVENT(id, arg) Trace::record((id), static_cast<uint16_t>(arg))
+#else
+#define TRACE_EVENT(id, arg) do {} while (0)
+#endif
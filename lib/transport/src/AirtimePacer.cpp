@@ -0,0 +1,116 @@
+#include "AirtimePacer.h"
+
+#include <string.h>
+
+namespace {
+
+// 802.11 preamble/PLCP plus MAC header and ESP-NOW vendor element
+constexpr uint32_t kPreambleUs = 192;
+constexpr uint32_t kFrameOverheadBytes = 43;
+
+inline bool time_before(uint32_t a, uint32_t b)
+{
+  return static_cast<int32_t>(a - b) < 0;
+}
+
+}  // namespace
+
+void AirtimePacer::configure(uint16_t budget_permille, uint16_t phy_kbps)
+{
+  m_budget_permille = (budget_permille == 0) ? 1 : budget_permille;
+  m_phy_kbps = (phy_kbps == 0) ? 1 : phy_kbps;
+  // room for a short burst of full-size frames
+  m_bucket_us = static_cast<int32_t>(2 * airtime_us(kMaxPacketSize));
+  m_tokens_us = m_bucket_us;
+}
+
+uint32_t AirtimePacer::airtime_us(size_t len) const
+{
+  return kPreambleUs + ((static_cast<uint32_t>(len) + kFrameOverheadBytes) * 8u * 1000u) / m_phy_kbps;
+}
+
+void AirtimePacer::refill(uint32_t now_us)
+{
+  const uint32_t elapsed = now_us - m_tokens_at_us;
+  m_tokens_at_us = now_us;
+  const int64_t t = m_tokens_us + (static_cast<int64_t>(elapsed) * m_budget_permille) / 1000;
+  m_tokens_us = (t > m_bucket_us) ? m_bucket_us : static_cast<int32_t>(t);
+}
+
+void AirtimePacer::push(const uint8_t *data, size_t len, uint32_t now_us)
+{
+  if (len > kMaxPacketSize || full()) {
+    return;
+  }
+  Slot &slot = m_slots[(m_head + m_count) % kQueueSlots];
+  slot.enqueue_us = now_us;
+  slot.len = static_cast<uint16_t>(len);
+  memcpy(slot.data, data, len);
+  ++m_count;
+}
+
+uint32_t AirtimePacer::head_due_us() const
+{
+  const Slot &slot = m_slots[m_head];
+  uint32_t due = slot.enqueue_us;
+  if (m_released) {
+    const uint32_t spaced = m_last_release_us + m_cadence_us;
+    if (time_before(due, spaced)) {
+      due = spaced;
+    }
+  }
+  // wait until the bucket holds this frame's airtime
+  const int32_t need = static_cast<int32_t>(airtime_us(slot.len));
+  int32_t since_refill = static_cast<int32_t>(due - m_tokens_at_us);
+  if (since_refill < 0) {
+    since_refill = 0;
+  }
+  int64_t now_tokens = m_tokens_us + (static_cast<int64_t>(since_refill) * m_budget_permille) / 1000;
+  if (now_tokens > m_bucket_us) {
+    now_tokens = m_bucket_us;
+  }
+  if (now_tokens < need) {
+    due += static_cast<uint32_t>(((need - now_tokens) * 1000 + m_budget_permille - 1) / m_budget_permille);
+  }
+  const uint32_t deadline = slot.enqueue_us + m_cadence_us;
+  return time_before(deadline, due) ? deadline : due;
+}
+
+size_t AirtimePacer::pop(uint8_t *out, uint32_t now_us)
+{
+  if (empty()) {
+    return 0;
+  }
+  const Slot &slot = m_slots[m_head];
+  refill(now_us);
+  const int32_t need = static_cast<int32_t>(airtime_us(slot.len));
+  const uint32_t delay = now_us - slot.enqueue_us;
+  if (m_tokens_us < need) {
+    ++m_stats.over_budget;
+  }
+  if (delay >= m_cadence_us) {
+    ++m_stats.deadline_sends;
+  }
+  m_tokens_us -= need;
+  if (m_tokens_us < -m_bucket_us) {
+    m_tokens_us = -m_bucket_us;
+  }
+  m_last_release_us = now_us;
+  m_released = true;
+  ++m_stats.frames;
+  m_stats.delay_us_total += delay;
+  if (delay > m_stats.delay_us_max) {
+    m_stats.delay_us_max = delay;
+  }
+  const size_t len = slot.len;
+  memcpy(out, slot.data, len);
+  m_head = (m_head + 1) % kQueueSlots;
+  --m_count;
+  return len;
+}
+
+void AirtimePacer::snapshot_and_reset_stats(Stats &out)
+{
+  out = m_stats;
+  m_stats = {};
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Schedules outgoing audio frames at an even cadence
+ *
+ * Frames wait in a small queue and are released one frame duration apart,
+ * and only while the airtime token bucket has budget. A frame that arrives
+ * late re-anchors the cadence. No frame is held longer than one frame
+ * duration: at that deadline it goes out regardless. Time (microseconds) is passed in; locking is the
+ * caller's job.
+ */
+class AirtimePacer
+{
+public:
+  static constexpr int kQueueSlots = 4;
+  static constexpr size_t kMaxPacketSize = 250;
+
+  struct Stats {
+    uint32_t frames;
+    uint32_t delay_us_total;
+    uint32_t delay_us_max;
+    uint32_t over_budget;    // frames sent at the deadline without enough tokens
+    uint32_t deadline_sends; // frames released at the one-frame deadline
+    uint32_t overflows;      // queue full, head sent early to make room
+  };
+
+  void configure(uint16_t budget_permille, uint16_t phy_kbps);
+  void set_cadence_us(uint32_t cadence_us) { m_cadence_us = cadence_us; }
+  // estimated time on air for a packet of len bytes
+  uint32_t airtime_us(size_t len) const;
+
+  bool empty() const { return m_count == 0; }
+  bool full() const { return m_count == kQueueSlots; }
+  // caller makes room (pop) first when full()
+  void push(const uint8_t *data, size_t len, uint32_t now_us);
+  void count_overflow() { ++m_stats.overflows; }
+  // when the queue head may go out; only valid if !empty()
+  uint32_t head_due_us() const;
+  // remove the queue head into out (kMaxPacketSize bytes), returns its length
+  size_t pop(uint8_t *out, uint32_t now_us);
+
+  void snapshot_and_reset_stats(Stats &out);
+
+private:
+  struct Slot {
+    uint32_t enqueue_us;
+    uint16_t len;
+    uint8_t data[kMaxPacketSize];
+  };
+  Slot m_slots[kQueueSlots];
+  int m_head = 0;
+  int m_count = 0;
+  uint32_t m_cadence_us = 15000;
+  uint16_t m_budget_permille = 1000;
+  uint16_t m_phy_kbps = 1000;
+  // token bucket in microseconds of airtime
+  int32_t m_tokens_us = 0;
+  int32_t m_bucket_us = 0;
+  uint32_t m_tokens_at_us = 0;
+  uint32_t m_last_release_us = 0;
+  bool m_released = false;
+  Stats m_stats = {};
+
+  void refill(uint32_t now_us);
+};
@@ -0,0 +1,70 @@
+#include "ChannelActivity.h"
+
+ChannelActivity::ChannelActivity(uint32_t hold_ms) : m_hold_ms(hold_ms)
+{
+}
+
+void ChannelActivity::reset()
+{
+  m_current = {};
+  m_other = {};
+  m_rx_overlap = false;
+  m_tx_overlap = false;
+}
+
+bool ChannelActivity::live(const Talker &t, uint32_t now_ms) const
+{
+  return t.active && now_ms - t.last_ms < m_hold_ms;
+}
+
+void ChannelActivity::on_frame(uint16_t origin, uint32_t now_ms)
+{
+  if (m_transmitting && !m_tx_overlap) {
+    m_tx_overlap = true;
+    ++m_stats.tx_collisions;
+  }
+  if (live(m_current, now_ms) && m_current.origin != origin) {
+    // interleaved talkers swap places on every frame
+    if (!m_rx_overlap) {
+      m_rx_overlap = true;
+      ++m_stats.rx_collisions;
+    }
+    m_other = m_current;
+  } else if (!live(m_other, now_ms) || m_other.origin == origin) {
+    m_rx_overlap = false;
+    m_other.active = false;
+  }
+  m_current.active = true;
+  m_current.origin = origin;
+  m_current.last_ms = now_ms;
+}
+
+void ChannelActivity::on_end(uint16_t origin)
+{
+  if (m_current.origin == origin) {
+    m_current.active = false;
+  }
+  if (m_other.origin == origin) {
+    m_other.active = false;
+  }
+  if (!m_current.active || !m_other.active) {
+    m_rx_overlap = false;
+  }
+}
+
+bool ChannelActivity::busy(uint32_t now_ms) const
+{
+  return live(m_current, now_ms) || live(m_other, now_ms);
+}
+
+void ChannelActivity::set_transmitting(bool transmitting)
+{
+  m_transmitting = transmitting;
+  m_tx_overlap = false;
+}
+
+void ChannelActivity::snapshot_and_reset_stats(Stats &out)
+{
+  out = m_stats;
+  m_stats = {};
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * @brief Channel-busy state from frames heard from other stations
+ *
+ * The channel is busy while another origin's audio or SID frames keep
+ * arriving (DTX pauses included) and until its end of talkspurt. Two talkers
+ * overlapping count as one collision per overlap, either seen as a listener
+ * or while we are transmitting ourselves. Time (milliseconds) is passed in;
+ * locking is the caller's job.
+ */
+class ChannelActivity
+{
+public:
+  struct Stats {
+    uint32_t rx_collisions;   // two other stations talking at once
+    uint32_t tx_collisions;   // another station heard during our talkspurt
+  };
+
+  // hold_ms: how long one frame keeps the channel busy
+  explicit ChannelActivity(uint32_t hold_ms);
+  void reset();
+  // audio or SID frame from another station
+  void on_frame(uint16_t origin, uint32_t now_ms);
+  // end of talkspurt from origin
+  void on_end(uint16_t origin);
+  bool busy(uint32_t now_ms) const;
+  void set_transmitting(bool transmitting);
+  void snapshot_and_reset_stats(Stats &out);
+
+private:
+  struct Talker {
+    bool active;
+    uint16_t origin;
+    uint32_t last_ms;
+  };
+  uint32_t m_hold_ms;
+  // most recent talker and the one it overlapped, if any
+  Talker m_current = {};
+  Talker m_other = {};
+  bool m_rx_overlap = false;
+  bool m_transmitting = false;
+  bool m_tx_overlap = false;
+  Stats m_stats = {};
+
+  bool live(const Talker &t, uint32_t now_ms) const;
+};
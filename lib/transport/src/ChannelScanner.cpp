@@ -0,0 +1,89 @@
+#include "ChannelScanner.h"
+
+ChannelScanner::ChannelScanner(uint32_t dwell_ms, uint32_t resume_idle_ms)
+  : m_dwell_ms(dwell_ms), m_resume_idle_ms(resume_idle_ms)
+{
+}
+
+void ChannelScanner::start(uint8_t channel, uint32_t now_ms)
+{
+  if (channel < kFirstChannel || channel > kLastChannel) {
+    channel = kFirstChannel;
+  }
+  m_state = kScanning;
+  m_channel = channel;
+  m_sweep_start = channel;
+  m_sweep_done = false;
+  m_dwell_start_ms = now_ms;
+  m_dwell_extended = false;
+  m_dwell_audio = 0;
+}
+
+void ChannelScanner::on_frame(bool audio, uint32_t now_ms)
+{
+  if (m_state == kIdle) {
+    return;
+  }
+  Entry &e = m_table[m_channel - kFirstChannel];
+  ++e.frames;
+  e.last_seen_ms = now_ms ? now_ms : 1;
+  if (audio) {
+    ++e.audio_frames;
+  }
+  if (m_state == kLocked) {
+    // SIDs in a speech pause keep the lock too
+    m_last_activity_ms = now_ms;
+    return;
+  }
+  if (!audio) {
+    m_dwell_extended = true;
+    return;
+  }
+  if (++m_dwell_audio >= kLockAudioFrames) {
+    m_state = kLocked;
+    m_last_activity_ms = now_ms;
+  }
+}
+
+uint8_t ChannelScanner::update(uint32_t now_ms)
+{
+  if (m_state == kIdle) {
+    return 0;
+  }
+  if (m_hold) {
+    m_last_activity_ms = now_ms;
+    m_dwell_start_ms = now_ms;
+    return 0;
+  }
+  if (m_state == kLocked) {
+    if (now_ms - m_last_activity_ms < m_resume_idle_ms) {
+      return 0;
+    }
+    m_state = kScanning;
+    return next_channel(now_ms);
+  }
+  const uint32_t dwell = m_dwell_extended ? 2 * m_dwell_ms : m_dwell_ms;
+  if (now_ms - m_dwell_start_ms < dwell) {
+    return 0;
+  }
+  return next_channel(now_ms);
+}
+
+uint8_t ChannelScanner::next_channel(uint32_t now_ms)
+{
+  m_channel = (m_channel >= kLastChannel) ? kFirstChannel : static_cast<uint8_t>(m_channel + 1);
+  if (m_channel == m_sweep_start) {
+    m_sweep_done = true;
+  }
+  m_dwell_start_ms = now_ms;
+  m_dwell_extended = false;
+  m_dwell_audio = 0;
+  return m_channel;
+}
+
+bool ChannelScanner::take_sweep_done()
+{
+  const bool done = m_sweep_done;
+  m_sweep_done = false;
+  return done;
+}
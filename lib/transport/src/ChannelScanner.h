@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * @brief Dwell-time schedule for scanning the WiFi channels for talkers
+ *
+ * Steps through channels 1-13, staying dwell_ms on each (twice that if a
+ * non-audio ESPTalkie frame hints at a talker in a pause). Audio frames on
+ * the current channel lock the scan there until the channel has been quiet
+ * for resume_idle_ms. Keeps a per-channel activity table. The caller does
+ * the retuning and passes time (milliseconds) in; locking is its job too.
+ */
+class ChannelScanner
+{
+public:
+  static constexpr uint8_t kFirstChannel = 1;
+  static constexpr uint8_t kLastChannel = 13;
+  static constexpr int kNumChannels = kLastChannel - kFirstChannel + 1;
+  // audio frames in one dwell that count as speech
+  static constexpr uint16_t kLockAudioFrames = 2;
+
+  enum State : uint8_t {
+    kIdle,
+    kScanning,
+    kLocked,
+  };
+
+  struct Entry {
+    uint32_t frames;
+    uint32_t audio_frames;
+    uint32_t last_seen_ms;   // 0 = never
+  };
+
+  ChannelScanner(uint32_t dwell_ms, uint32_t resume_idle_ms);
+  // starts dwelling on channel
+  void start(uint8_t channel, uint32_t now_ms);
+  void stop() { m_state = kIdle; }
+  State state() const { return m_state; }
+  uint8_t channel() const { return m_channel; }
+  // valid ESPTalkie frame heard while tuned to channel()
+  void on_frame(bool audio, uint32_t now_ms);
+  // while held (own talkspurt) the scan stays on the current channel
+  void set_hold(bool hold) { m_hold = hold; }
+  // channel to tune to now, 0 to stay
+  uint8_t update(uint32_t now_ms);
+  const Entry &entry(uint8_t channel) const { return m_table[channel - kFirstChannel]; }
+  // true once after each pass over all channels
+  bool take_sweep_done();
+
+private:
+  uint32_t m_dwell_ms;
+  uint32_t m_resume_idle_ms;
+  State m_state = kIdle;
+  uint8_t m_channel = kFirstChannel;
+  uint8_t m_sweep_start = kFirstChannel;
+  bool m_sweep_done = false;
+  bool m_hold = false;
+  uint32_t m_dwell_start_ms = 0;
+  bool m_dwell_extended = false;
+  uint16_t m_dwell_audio = 0;
+  uint32_t m_last_activity_ms = 0;
+  Entry m_table[kNumChannels] = {};
+
+  uint8_t next_channel(uint32_t now_ms);
+};
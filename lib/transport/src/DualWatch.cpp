@@ -0,0 +1,60 @@
+#include "DualWatch.h"
+
+DualWatch::DualWatch(uint32_t interval_ms, uint32_t listen_ms, uint32_t resume_idle_ms)
+  : m_interval_ms(interval_ms), m_listen_ms(listen_ms), m_resume_idle_ms(resume_idle_ms)
+{
+}
+
+void DualWatch::start(uint8_t main_channel, uint8_t priority_channel, uint32_t now_ms)
+{
+  m_main = main_channel;
+  m_priority = priority_channel;
+  m_state = (main_channel == priority_channel) ? kOff : kMain;
+  m_since_ms = now_ms;
+}
+
+void DualWatch::on_frame(uint32_t now_ms)
+{
+  if (m_state == kListening) {
+    m_state = kPriority;
+    m_last_activity_ms = now_ms;
+  } else if (m_state == kPriority) {
+    m_last_activity_ms = now_ms;
+  }
+}
+
+uint8_t DualWatch::update(uint32_t now_ms)
+{
+  switch (m_state) {
+  case kMain:
+    if (m_hold) {
+      // the interval restarts after our talkspurt
+      m_since_ms = now_ms;
+      return 0;
+    }
+    if (now_ms - m_since_ms < m_interval_ms) {
+      return 0;
+    }
+    m_state = kListening;
+    m_since_ms = now_ms;
+    return m_priority;
+  case kListening:
+    if (!m_hold && now_ms - m_since_ms < m_listen_ms) {
+      return 0;
+    }
+    break;
+  case kPriority:
+    if (m_hold) {
+      m_last_activity_ms = now_ms;
+    }
+    if (now_ms - m_last_activity_ms < m_resume_idle_ms) {
+      return 0;
+    }
+    break;
+  default:
+    return 0;
+  }
+  m_state = kMain;
+  m_since_ms = now_ms;
+  return m_main;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * @brief Schedule for watching a priority channel while parked on another
+ *
+ * Every interval_ms the radio visits the priority channel for listen_ms.
+ * Audio or SID frames heard there switch us over until the priority channel
+ * has been quiet for resume_idle_ms; otherwise we go straight back. While
+ * held (own talkspurt) we stay where we are, leaving a listen window early.
+ * The caller does the retuning and passes time (milliseconds) in; locking
+ * is its job too.
+ */
+class DualWatch
+{
+public:
+  enum State : uint8_t {
+    kOff,
+    kMain,
+    kListening,   // short visit to the priority channel
+    kPriority,    // switched over to priority traffic
+  };
+
+  DualWatch(uint32_t interval_ms, uint32_t listen_ms, uint32_t resume_idle_ms);
+  void start(uint8_t main_channel, uint8_t priority_channel, uint32_t now_ms);
+  void stop() { m_state = kOff; }
+  State state() const { return m_state; }
+  uint8_t main_channel() const { return m_main; }
+  uint8_t priority_channel() const { return m_priority; }
+  // audio or SID frame heard on the channel we are tuned to
+  void on_frame(uint32_t now_ms);
+  void set_hold(bool hold) { m_hold = hold; }
+  // channel to tune to now, 0 to stay
+  uint8_t update(uint32_t now_ms);
+
+private:
+  uint32_t m_interval_ms;
+  uint32_t m_listen_ms;
+  uint32_t m_resume_idle_ms;
+  State m_state = kOff;
+  uint8_t m_main = 1;
+  uint8_t m_priority = 1;
+  bool m_hold = false;
+  uint32_t m_since_ms = 0;
+  uint32_t m_last_activity_ms = 0;
+};
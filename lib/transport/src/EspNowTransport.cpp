@@ -2,8 +2,13 @@
 #include <WiFi.h>
 #include <esp_now.h>
 #include <esp_wifi.h>
+#include <esp_idf_version.h>
+#include <esp_timer.h>
 #include "OutputBuffer.h"
 #include "EspNowTransport.h"
+#include "Trace.h"
+#include "Recorder.h"
+#include "ReplayHistory.h"
 #include "config.h"
 
 const int MAX_ESP_NOW_PACKET_SIZE = 250;
@@ -11,49 +16,799 @@ const uint8_t broadcastAddress[] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
 
 static EspNowTransport *instance = NULL;
 
+#if ESP_IDF_VERSION_MAJOR < 5 && ESPNOW_RSSI_PROMISCUOUS_FALLBACK
+// RSSI of the last ESP-NOW action frame, consumed by the receive callback.
+// Both callbacks run in the WiFi task, promiscuous first.
+static volatile int8_t pending_rssi = EspNowTransport::kRssiUnknown;
+static uint8_t pending_mac[6];
+
 static void promiscuous_rx_cb(void *buf, wifi_promiscuous_pkt_type_t type)
 {
+    const uint32_t start = ESP.getCycleCount();
     if (!instance || type != WIFI_PKT_MGMT) {
         return;
     }
     const wifi_promiscuous_pkt_t *ppkt = static_cast<wifi_promiscuous_pkt_t *>(buf);
-    instance->setRSSI(ppkt->rx_ctrl.rssi);
+    const uint8_t *frame = ppkt->payload;
+    // action frame, vendor specific category, Espressif OUI
+    if (ppkt->rx_ctrl.sig_len >= 28 && frame[0] == 0xD0 && frame[24] == 0x7F &&
+        frame[25] == 0x18 && frame[26] == 0xFE && frame[27] == 0x34) {
+        memcpy(pending_mac, frame + 10, 6);
+        pending_rssi = ppkt->rx_ctrl.rssi;
+    }
+    instance->count_callback(true, ESP.getCycleCount() - start);
 }
+#endif
 
-void receiveCallback(const uint8_t *macAddr, const uint8_t *data, int dataLen)
+#if ESP_IDF_VERSION_MAJOR >= 5
+static void receiveCallback(const esp_now_recv_info_t *info, const uint8_t *data, int dataLen)
 {
-    (void)macAddr;
+    const uint32_t start = ESP.getCycleCount();
     if (!instance) {
         return;
     }
-    int header_size = instance->m_header_size;
-    // first m_header_size bytes of m_buffer are the expected header
-    if ((dataLen > header_size) && (dataLen<=MAX_ESP_NOW_PACKET_SIZE) && (memcmp(data,instance->m_buffer,header_size) == 0)) {
+    const int8_t rssi = info->rx_ctrl ? static_cast<int8_t>(info->rx_ctrl->rssi) : EspNowTransport::kRssiUnknown;
+    TRACE_EVENT(kTraceRxBegin, dataLen);
+    instance->handle_receive(info->src_addr, rssi, data, dataLen);
+    TRACE_EVENT(kTraceRxEnd, 0);
+    instance->count_callback(false, ESP.getCycleCount() - start);
+}
+#else
+static void receiveCallback(const uint8_t *macAddr, const uint8_t *data, int dataLen)
+{
+    const uint32_t start = ESP.getCycleCount();
+    if (!instance) {
+        return;
+    }
+    int8_t rssi = EspNowTransport::kRssiUnknown;
+#if ESPNOW_RSSI_PROMISCUOUS_FALLBACK
+    if (memcmp(pending_mac, macAddr, 6) == 0) {
+        rssi = pending_rssi;
+    }
+    pending_rssi = EspNowTransport::kRssiUnknown;
+#endif
+    TRACE_EVENT(kTraceRxBegin, dataLen);
+    instance->handle_receive(macAddr, rssi, data, dataLen);
+    TRACE_EVENT(kTraceRxEnd, 0);
+    instance->count_callback(false, ESP.getCycleCount() - start);
+}
+#endif
+
+#if ESP_IDF_VERSION_MAJOR >= 5 && ESP_IDF_VERSION_MINOR >= 5
+static void sendCallback(const wifi_tx_info_t *info, esp_now_send_status_t status)
+#else
+static void sendCallback(const uint8_t *macAddr, esp_now_send_status_t status)
+#endif
+{
+    TRACE_EVENT(kTraceTxDone, status);
+    if (instance) {
+        instance->on_send_done();
+    }
+}
+
+static void pacer_timer_cb(void *arg)
+{
+    static_cast<EspNowTransport *>(arg)->pacer_release();
+}
+
+static void relay_timer_cb(void *arg)
+{
+    static_cast<EspNowTransport *>(arg)->wake_relay_task();
+}
+
+static void arm_timer(esp_timer_handle_t timer, uint32_t due_us, uint32_t now_us)
+{
+    const int32_t wait_us = static_cast<int32_t>(due_us - now_us);
+    esp_timer_stop(timer);
+    esp_timer_start_once(timer, (wait_us > 0) ? static_cast<uint64_t>(wait_us) : 0);
+}
+
+// Splits an audio payload into the primary frame and the optional redundant
+// copy of the previous frame. Returns false if the layout is inconsistent.
+static bool split_audio_payload(uint8_t mode_byte, const uint8_t *payload, int len,
+                                const uint8_t *&primary, int &primary_len,
+                                const uint8_t *&redundant, int &redundant_len)
+{
+    primary = payload;
+    primary_len = len;
+    redundant = nullptr;
+    redundant_len = 0;
+    if (mode_byte & Transport::kModeRedundantFlag) {
+        if (len < 1 || payload[0] == 0 || payload[0] + 1 > len) {
+            return false;
+        }
+        primary = payload + 1;
+        primary_len = payload[0];
+        redundant = primary + primary_len;
+        redundant_len = len - 1 - primary_len;
+    }
+    const size_t samples = FrameCodec::decoded_samples(FrameCodec::kModes[mode_byte & ~Transport::kModeRedundantFlag],
+                                                       primary_len);
+    return samples > 0 && samples <= FrameCodec::kMaxFrameSamples;
+}
+
+void EspNowTransport::handle_receive(const uint8_t *mac, int8_t rssi, const uint8_t *data, int dataLen)
+{
+    xSemaphoreTake(m_rx_mutex, portMAX_DELAY);
+    receive(mac, rssi, data, dataLen);
+    xSemaphoreGive(m_rx_mutex);
+}
+
+void EspNowTransport::receive(const uint8_t *mac, int8_t rssi, const uint8_t *data, int dataLen)
+{
+    // first m_magic_size bytes of m_buffer are the expected magic, followed by the frame type
+    if ((dataLen > m_header_size) && (dataLen<=MAX_ESP_NOW_PACKET_SIZE) && (memcmp(data,m_buffer,m_magic_size) == 0)) {
+      const uint8_t frame_type = data[m_magic_size];
+      const uint16_t origin = static_cast<uint16_t>(data[m_magic_size + kOffsetOrigin] |
+                                                    (data[m_magic_size + kOffsetOrigin + 1] << 8));
+      if (origin == m_node_id) {
+        add_stat(m_stats.rx_echo_packets);
+        return;
+      }
+      if (m_repeater) {
+        relay(data, dataLen, origin, frame_type);
+      }
+      if (m_scanning) {
+        portENTER_CRITICAL(&m_lock);
+        m_scanner.on_frame(frame_type == Transport::kFrameTypeAudio, millis());
+        portEXIT_CRITICAL(&m_lock);
+      }
+      if (frame_type == Transport::kFrameTypeSid) {
+        // frames held for reordering belong before the pause
+        drain_reorder();
+        note_activity(origin, false);
+        m_output_buffer->set_comfort_noise(static_cast<uint16_t>(data[m_header_size]) << 4);
+        // DTX pause: don't count the silence as a receive gap
+        m_last_rx_ms = 0;
+        return;
+      }
+      if (frame_type == Transport::kFrameTypeEot) {
+        drain_reorder();
+        note_activity(origin, true);
+        // act on the first copy of a repeated EOT only
+        const int16_t eot_id = data[m_header_size];
+        // a station that gave way must not end the talker's stream
+        if (eot_id != m_last_eot_id && origin == m_talker_id) {
+          m_last_eot_id = eot_id;
+          m_output_buffer->end_of_stream();
+          if (m_history) {
+            m_history->end();
+          }
+          if (m_rec_open) {
+            m_recorder->talkspurt(Recorder::kRx, m_rec_talker, false);
+            m_rec_open = false;
+          }
+        }
+        m_last_rx_ms = 0;
+        return;
+      }
+      if (frame_type == Transport::kFrameTypeLinkReport) {
+        handle_link_report(data + m_header_size, dataLen - m_header_size);
+        return;
+      }
+      if (frame_type != Transport::kFrameTypeAudio) {
+        add_stat(m_stats.rx_bad_header_packets);
+        return;
+      }
+      const uint8_t *info = data + m_header_size;
+      const int payload_len = dataLen - m_header_size - kAudioInfoSize;
+      if (payload_len <= 0 || payload_len > static_cast<int>(ReorderWindow::kMaxPayload)) {
+        add_stat(m_stats.rx_invalid_len_packets);
+        return;
+      }
+      if ((info[0] & ~kModeRedundantFlag) >= FrameCodec::kNumModes) {
+        add_stat(m_stats.rx_bad_header_packets);
+        return;
+      }
+      const uint8_t *primary;
+      const uint8_t *redundant;
+      int primary_len;
+      int redundant_len;
+      if (!split_audio_payload(info[0], info + kAudioInfoSize, payload_len,
+                               primary, primary_len, redundant, redundant_len)) {
+        add_stat(m_stats.rx_invalid_len_packets);
+        return;
+      }
       uint32_t now_ms = millis();
-      if (instance->m_last_rx_ms != 0) {
-        uint32_t gap_ms = now_ms - instance->m_last_rx_ms;
+      if (m_last_rx_ms != 0) {
+        uint32_t gap_ms = now_ms - m_last_rx_ms;
         if (gap_ms > 30) {
-          instance->m_rx_gap_events++;
+          add_stat(m_stats.rx_gap_events);
         }
-        if (gap_ms > instance->m_rx_max_gap_ms) {
-          instance->m_rx_max_gap_ms = gap_ms;
+        portENTER_CRITICAL(&m_stats_lock);
+        if (gap_ms > m_stats.rx_max_gap_ms) {
+          m_stats.rx_max_gap_ms = gap_ms;
         }
+        portEXIT_CRITICAL(&m_stats_lock);
+      }
+      m_last_rx_ms = now_ms;
+      m_last_audio_ms = now_ms;
+      m_last_eot_id = -1;
+      m_rx_link_mode = info[0] & ~kModeRedundantFlag;
+      note_activity(origin, false);
+      if (rssi != kRssiUnknown && mac) {
+        portENTER_CRITICAL(&m_lock);
+        m_links.update(mac, rssi, now_ms);
+        portEXIT_CRITICAL(&m_lock);
+      }
+
+      const uint16_t seq = static_cast<uint16_t>(info[1] | (info[2] << 8));
+      if (update_talker(origin, rssi) || m_reorder.needs_resync(seq)) {
+        // new talker or sequence restart: play out what is held and start over
+        drain_reorder();
+        m_reorder.reset();
       }
-      instance->m_last_rx_ms = now_ms;
-      instance->m_output_buffer->add_samples(data + header_size, dataLen - header_size);
-      instance->m_rx_ok_packets++;
-      instance->m_rx_ok_bytes += static_cast<uint32_t>(dataLen - header_size);
-    } else if (dataLen <= header_size || dataLen > MAX_ESP_NOW_PACKET_SIZE) {
-      instance->m_rx_invalid_len_packets++;
+      while (!m_reorder.fits(seq)) {
+        play_release(m_reorder.make_room());
+      }
+      const ReorderWindow::Result result = m_reorder.insert(seq, info[0], info + kAudioInfoSize, payload_len, now_ms);
+      if (result == ReorderWindow::kAccepted) {
+        portENTER_CRITICAL(&m_stats_lock);
+        m_stats.rx_ok_packets++;
+        m_stats.rx_ok_bytes += static_cast<uint32_t>(payload_len);
+        portEXIT_CRITICAL(&m_stats_lock);
+      }
+      release_reorder(now_ms);
+    } else if (dataLen <= m_header_size || dataLen > MAX_ESP_NOW_PACKET_SIZE) {
+      add_stat(m_stats.rx_invalid_len_packets);
+    } else {
+      add_stat(m_stats.rx_bad_header_packets);
+    }
+}
+
+void EspNowTransport::play_release(const ReorderWindow::Release &r)
+{
+    const uint8_t *primary;
+    const uint8_t *redundant;
+    int primary_len;
+    int redundant_len;
+    if (r.kind == ReorderWindow::kFrame) {
+        const ReorderWindow::Frame &f = *r.frame;
+        split_audio_payload(f.mode, f.data, f.len, primary, primary_len, redundant, redundant_len);
+        const size_t samples = m_decoder.decode(FrameCodec::kModes[f.mode & ~kModeRedundantFlag], primary, primary_len,
+                                                m_decode_buffer, FrameCodec::kMaxFrameSamples);
+        m_rx_frame_samples = static_cast<uint16_t>(samples);
+        m_output_buffer->add_samples(m_decode_buffer, static_cast<int>(samples));
+        record_rx(samples);
+        TRACE_EVENT(kTraceRxFrame, samples);
+        portENTER_CRITICAL(&m_lock);
+        m_report_received++;
+        portEXIT_CRITICAL(&m_lock);
+        return;
+    }
+    if (r.kind != ReorderWindow::kGap) {
+        return;
+    }
+    portENTER_CRITICAL(&m_lock);
+    m_report_lost++;
+    portEXIT_CRITICAL(&m_lock);
+    // the next frame may carry a low-rate copy of the missing one
+    const ReorderWindow::Frame *next = m_reorder.peek(static_cast<uint16_t>(r.seq + 1));
+    if (next && (next->mode & kModeRedundantFlag) &&
+        split_audio_payload(next->mode, next->data, next->len, primary, primary_len, redundant, redundant_len) &&
+        redundant_len > 0) {
+        const size_t recovered = m_red_decoder.decode(FrameCodec::kRedundantMode, redundant, redundant_len,
+                                                      m_decode_buffer, FrameCodec::kMaxFrameSamples);
+        if (recovered > 0) {
+            m_output_buffer->add_samples(m_decode_buffer, static_cast<int>(recovered));
+            record_rx(recovered);
+            TRACE_EVENT(kTraceRxFrame, recovered);
+            add_stat(m_stats.rx_recovered_frames);
+            return;
+        }
+    }
+    // keep the timing: conceal one frame's worth
+    const int samples = m_rx_frame_samples ? m_rx_frame_samples : FrameCodec::kModes[0].frame_samples;
+    m_output_buffer->add_concealment(samples);
+    TRACE_EVENT(kTraceRxConceal, samples);
+    add_stat(m_stats.rx_concealed_frames);
+}
+
+void EspNowTransport::record_rx(size_t samples)
+{
+    if (m_history) {
+        m_history->append(m_talker_id, millis(), m_decode_buffer, samples);
+    }
+    if (!m_recorder || !m_recorder->recording()) {
+        m_rec_open = false;
+        return;
+    }
+    if (!m_rec_open || m_rec_talker != m_talker_id) {
+        if (m_rec_open) {
+            m_recorder->talkspurt(Recorder::kRx, m_rec_talker, false);
+        }
+        m_rec_talker = m_talker_id;
+        m_rec_open = true;
+        m_recorder->talkspurt(Recorder::kRx, m_rec_talker, true);
+    }
+    m_recorder->audio(Recorder::kRx, m_rec_talker, m_decode_buffer, samples);
+}
+
+void EspNowTransport::reset_receiver()
+{
+    xSemaphoreTake(m_rx_mutex, portMAX_DELAY);
+    m_reorder.reset();
+    m_decoder.reset();
+    m_red_decoder.reset();
+    m_last_eot_id = -1;
+    m_last_rx_ms = 0;
+    portENTER_CRITICAL(&m_lock);
+    m_seq_valid = false;
+    portEXIT_CRITICAL(&m_lock);
+    xSemaphoreGive(m_rx_mutex);
+}
+
+void EspNowTransport::set_reorder_hold_ms(uint32_t ms)
+{
+    xSemaphoreTake(m_rx_mutex, portMAX_DELAY);
+    m_reorder.set_max_hold_ms(ms);
+    xSemaphoreGive(m_rx_mutex);
+}
+
+void EspNowTransport::release_reorder(uint32_t now_ms)
+{
+    for (;;) {
+        const ReorderWindow::Release r = m_reorder.pop(now_ms, false);
+        if (r.kind == ReorderWindow::kNone) {
+            break;
+        }
+        play_release(r);
+    }
+    fold_reorder_stats();
+}
+
+void EspNowTransport::drain_reorder()
+{
+    for (;;) {
+        const ReorderWindow::Release r = m_reorder.pop(0, true);
+        if (r.kind == ReorderWindow::kNone) {
+            break;
+        }
+        play_release(r);
+    }
+    fold_reorder_stats();
+}
+
+void EspNowTransport::fold_reorder_stats()
+{
+    ReorderWindow::Stats rs;
+    m_reorder.snapshot_and_reset_stats(rs);
+    portENTER_CRITICAL(&m_stats_lock);
+    m_stats.rx_reordered_frames += rs.reordered;
+    m_stats.rx_duplicate_frames += rs.duplicates;
+    m_stats.rx_late_frames += rs.late;
+    portEXIT_CRITICAL(&m_stats_lock);
+}
+
+void EspNowTransport::note_activity(uint16_t origin, bool end)
+{
+    portENTER_CRITICAL(&m_lock);
+    if (end) {
+        m_activity.on_end(origin);
+    } else {
+        m_activity.on_frame(origin, millis());
+        m_watch.on_frame(millis());
+    }
+    portEXIT_CRITICAL(&m_lock);
+}
+
+bool EspNowTransport::channel_busy(uint32_t now_ms)
+{
+    portENTER_CRITICAL(&m_lock);
+    const bool busy = m_activity.busy(now_ms);
+    portEXIT_CRITICAL(&m_lock);
+    return busy;
+}
+
+void EspNowTransport::set_transmitting(bool transmitting)
+{
+    portENTER_CRITICAL(&m_lock);
+    m_activity.set_transmitting(transmitting);
+    m_scanner.set_hold(transmitting);
+    m_watch.set_hold(transmitting);
+    portEXIT_CRITICAL(&m_lock);
+}
+
+bool EspNowTransport::update_talker(uint16_t origin, int8_t rssi)
+{
+    bool changed = false;
+    portENTER_CRITICAL(&m_lock);
+    if (!m_seq_valid || origin != m_talker_id) {
+        // new talker: loss is counted from its first packet
+        m_talker_id = origin;
+        m_seq_valid = true;
+        m_report_received = 0;
+        m_report_lost = 0;
+        changed = true;
+    }
+    if (rssi != kRssiUnknown) {
+        m_report_rssi = rssi;
+    }
+    portEXIT_CRITICAL(&m_lock);
+    return changed;
+}
+
+void EspNowTransport::handle_link_report(const uint8_t *payload, int len)
+{
+    if (len < kLinkReportSize || (payload[0] | (payload[1] << 8)) != m_node_id) {
+        return;
+    }
+    const uint16_t loss = static_cast<uint16_t>(payload[2] | (payload[3] << 8));
+    const int8_t rssi = static_cast<int8_t>(payload[4]);
+    const uint32_t now_ms = millis();
+    portENTER_CRITICAL(&m_lock);
+    m_adapt.on_report(loss, rssi, now_ms);
+    m_power.on_report(loss, rssi, now_ms);
+    portEXIT_CRITICAL(&m_lock);
+    add_stat(m_stats.rx_link_reports);
+}
+
+void EspNowTransport::service(uint32_t now_ms)
+{
+    // frames held for a missing predecessor must not wait for the next packet,
+    // which may never come (lost last frames, a talker gone without EOT)
+    xSemaphoreTake(m_rx_mutex, portMAX_DELAY);
+    release_reorder(now_ms);
+    xSemaphoreGive(m_rx_mutex);
+
+    // listener side: report loss and RSSI of the current talker
+    if (m_seq_valid && now_ms - m_last_report_ms >= kLinkReportIntervalMs) {
+        uint8_t payload[kLinkReportSize];
+        bool send_report = false;
+        portENTER_CRITICAL(&m_lock);
+        const uint32_t total = m_report_received + m_report_lost;
+        if (total > 0 && now_ms - m_last_audio_ms < kLinkReportIntervalMs) {
+            const uint16_t loss = static_cast<uint16_t>((m_report_lost * 1000) / total);
+            payload[0] = static_cast<uint8_t>(m_talker_id & 0xff);
+            payload[1] = static_cast<uint8_t>(m_talker_id >> 8);
+            payload[2] = static_cast<uint8_t>(loss & 0xff);
+            payload[3] = static_cast<uint8_t>(loss >> 8);
+            payload[4] = static_cast<uint8_t>(m_report_rssi);
+            send_report = true;
+        }
+        m_report_received = 0;
+        m_report_lost = 0;
+        portEXIT_CRITICAL(&m_lock);
+        m_last_report_ms = now_ms;
+        if (send_report) {
+            send_control(kFrameTypeLinkReport, payload, sizeof(payload));
+        }
+    }
+
+    if (m_scanning) {
+        service_scan(now_ms);
+    } else if (m_watch_priority != 0) {
+        service_watch(now_ms);
+    }
+
+    // talker side: follow the listeners
+    portENTER_CRITICAL(&m_lock);
+    const int old_mode = m_adapt.get_mode();
+    const bool changed = m_adapt.update(now_ms);
+    const int mode = m_adapt.get_mode();
+    const uint16_t loss = m_adapt.get_worst_loss();
+    const int8_t rssi = m_adapt.get_worst_rssi();
+    portEXIT_CRITICAL(&m_lock);
+    if (changed) {
+        set_link_mode(static_cast<uint8_t>(mode));
+        Serial.printf("LINK ADAPT: mode %d -> %d (loss=%u.%u%% rssi=%d)\n",
+                      old_mode, mode, loss / 10, loss % 10, rssi);
+    }
+
+    portENTER_CRITICAL(&m_lock);
+    const bool power_changed = m_power.update(now_ms);
+    const int8_t qdbm = m_power.get_qdbm();
+    portEXIT_CRITICAL(&m_lock);
+    if (power_changed) {
+        apply_tx_power(qdbm);
+    }
+}
+
+void EspNowTransport::relay(const uint8_t *data, int len, uint16_t origin, uint8_t frame_type)
+{
+    if (!m_relay_timer) {
+        return;
+    }
+    // per-origin key: audio sequence, SID counter or talkspurt id
+    uint16_t id;
+    if (frame_type == kFrameTypeAudio && len > m_header_size + kAudioInfoSize) {
+        id = static_cast<uint16_t>(data[m_header_size + 1] | (data[m_header_size + 2] << 8));
+    } else if (frame_type == kFrameTypeSid && len >= m_header_size + 2) {
+        id = data[m_header_size + 1];
+    } else if (frame_type == kFrameTypeEot) {
+        id = data[m_header_size];
+    } else {
+        // link reports describe a single hop
+        return;
+    }
+    const uint32_t now_us = static_cast<uint32_t>(esp_timer_get_time());
+    portENTER_CRITICAL(&m_relay_lock);
+    const bool arm = m_relay.empty();
+    const FloodRelay::Verdict verdict = m_relay.offer(data, static_cast<size_t>(len), m_magic_size + kOffsetTtl,
+                                                      origin, frame_type, id, now_us);
+    const uint32_t due_us = m_relay.empty() ? now_us : m_relay.head_due_us();
+    portEXIT_CRITICAL(&m_relay_lock);
+    if (verdict == FloodRelay::kRelay && arm && m_relay_timer) {
+        arm_timer(m_relay_timer, due_us, now_us);
+    }
+}
+
+void EspNowTransport::relay_task(void *param)
+{
+    EspNowTransport *self = static_cast<EspNowTransport *>(param);
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        self->relay_release();
+    }
+}
+
+void EspNowTransport::wake_relay_task()
+{
+    xTaskNotifyGive(m_relay_task);
+}
+
+void EspNowTransport::relay_release()
+{
+    for (;;) {
+        const uint32_t now_us = static_cast<uint32_t>(esp_timer_get_time());
+        size_t len = 0;
+        uint32_t due_us = 0;
+        portENTER_CRITICAL(&m_relay_lock);
+        if (!m_relay.empty() && static_cast<int32_t>(now_us - m_relay.head_due_us()) >= 0) {
+            len = m_relay.pop(m_relay_tx, now_us);
+        }
+        const bool more = !m_relay.empty();
+        if (more) {
+            due_us = m_relay.head_due_us();
+        }
+        portEXIT_CRITICAL(&m_relay_lock);
+        if (len > 0) {
+            relay_transmit(m_relay_tx, len);
+        }
+        if (!more) {
+            return;
+        }
+        if (len == 0) {
+            arm_timer(m_relay_timer, due_us, now_us);
+            return;
+        }
+    }
+}
+
+void EspNowTransport::relay_transmit(const uint8_t *data, size_t len)
+{
+    xSemaphoreTake(m_radio_mutex, portMAX_DELAY);
+    const uint8_t home = m_wifi_channel;
+    const uint8_t ch = m_relay_channel;
+    const bool retune = ch != 0 && ch != home;
+    if (retune) {
+        // our own frames already queued leave on our channel
+        wait_tx_idle();
+        esp_wifi_set_channel(ch, WIFI_SECOND_CHAN_NONE);
+    }
+    const esp_err_t result = esp_now_send(broadcastAddress, data, len);
+    if (result == ESP_OK) {
+        ++m_tx_sent;
     } else {
-      instance->m_rx_bad_header_packets++;
+        add_stat(m_stats.tx_failures);
     }
+    if (retune) {
+        // the frame has to be on air before we go back to listening
+        wait_tx_idle();
+        esp_wifi_set_channel(home, WIFI_SECOND_CHAN_NONE);
+    }
+    xSemaphoreGive(m_radio_mutex);
+}
+
+void EspNowTransport::wait_tx_idle()
+{
+    const uint32_t start = millis();
+    while (static_cast<int32_t>(m_tx_sent - m_tx_done) > 0 && millis() - start < kRelaySendTimeoutMs) {
+        vTaskDelay(1);
+    }
+    // a lost send callback must not make every later relay wait
+    m_tx_sent = m_tx_done;
+}
+
+void EspNowTransport::set_repeater(bool enable)
+{
+    portENTER_CRITICAL(&m_relay_lock);
+    m_relay.reset();
+    portEXIT_CRITICAL(&m_relay_lock);
+    m_repeater = enable;
+}
+
+void EspNowTransport::snapshot_relay_stats(FloodRelay::Stats &out)
+{
+    portENTER_CRITICAL(&m_relay_lock);
+    m_relay.snapshot_and_reset_stats(out);
+    portEXIT_CRITICAL(&m_relay_lock);
+}
+
+void EspNowTransport::apply_tx_power(int8_t qdbm)
+{
+    esp_wifi_set_max_tx_power(qdbm);
+    int8_t applied = qdbm;
+    esp_wifi_get_max_tx_power(&applied);
+    portENTER_CRITICAL(&m_lock);
+    m_power.set_applied_qdbm(applied);
+    const int8_t rssi = m_power.get_worst_rssi();
+    const uint16_t loss = m_power.get_worst_loss();
+    portEXIT_CRITICAL(&m_lock);
+    Serial.printf("TX POWER: %d.%02d dBm (worst rssi=%d loss=%u.%u%%), est TX current %umA vs %umA at max\n",
+                  applied / 4, (applied % 4) * 25, rssi, loss / 10, loss % 10,
+                  TxPowerControl::estimate_tx_current_ma(applied),
+                  TxPowerControl::estimate_tx_current_ma(TX_POWER_MAX_QDBM));
+}
+
+void EspNowTransport::set_tx_power_control(bool enable)
+{
+    portENTER_CRITICAL(&m_lock);
+    m_power.set_enabled(enable);
+    const int8_t qdbm = m_power.get_qdbm();
+    portEXIT_CRITICAL(&m_lock);
+    if (m_started) {
+        apply_tx_power(qdbm);
+    }
+}
+
+bool EspNowTransport::get_tx_power_control()
+{
+    portENTER_CRITICAL(&m_lock);
+    const bool enabled = m_power.get_enabled();
+    portEXIT_CRITICAL(&m_lock);
+    return enabled;
+}
+
+void EspNowTransport::count_callback(bool promiscuous, uint32_t cycles)
+{
+    portENTER_CRITICAL(&m_stats_lock);
+    if (promiscuous) {
+        m_stats.promiscuous_callbacks++;
+    } else {
+        m_stats.rx_callbacks++;
+    }
+    m_stats.callback_cycles += cycles;
+    portEXIT_CRITICAL(&m_stats_lock);
 }
 
 void EspNowTransport::setWifiChannel(uint16_t ch)
 {
-    m_wifi_channel  = ch;
-    esp_wifi_set_channel(m_wifi_channel, WIFI_SECOND_CHAN_NONE);
+    m_scanning = false;
+    portENTER_CRITICAL(&m_lock);
+    m_scanner.stop();
+    m_watch.start(static_cast<uint8_t>(ch), m_watch_priority, millis());
+    portEXIT_CRITICAL(&m_lock);
+    m_watch_state = DualWatch::kMain;
+    tune(static_cast<uint8_t>(ch));
+}
+
+void EspNowTransport::set_dual_watch(uint8_t ch)
+{
+    if (ch > ChannelScanner::kLastChannel) {
+        ch = 0;
+    }
+    portENTER_CRITICAL(&m_lock);
+    if (ch == 0) {
+        m_watch.stop();
+    } else {
+        m_watch.start(m_wifi_channel, ch, millis());
+    }
+    portEXIT_CRITICAL(&m_lock);
+    m_watch_priority = ch;
+    m_watch_state = DualWatch::kMain;
+}
+
+void EspNowTransport::tune(uint8_t ch)
+{
+    // waits out a cross-channel relay in progress
+    xSemaphoreTake(m_radio_mutex, portMAX_DELAY);
+    const uint32_t start = static_cast<uint32_t>(esp_timer_get_time());
+    m_wifi_channel = ch;
+    esp_wifi_set_channel(ch, WIFI_SECOND_CHAN_NONE);
+    const uint32_t us = static_cast<uint32_t>(esp_timer_get_time()) - start;
+    xSemaphoreGive(m_radio_mutex);
+    ++m_hops;
+    m_hop_us_total += us;
+    if (us > m_hop_us_max) {
+        m_hop_us_max = us;
+    }
+}
+
+void EspNowTransport::start_scan()
+{
+    const uint32_t now_ms = millis();
+    portENTER_CRITICAL(&m_lock);
+    m_scanner.start(m_wifi_channel, now_ms);
+    portEXIT_CRITICAL(&m_lock);
+    m_sweep_start_ms = now_ms;
+    m_hops = 0;
+    m_hop_us_total = 0;
+    m_hop_us_max = 0;
+    m_scanning = true;
+    Serial.printf("SCAN: start on ch %u, dwell %ums\n", m_wifi_channel, static_cast<unsigned>(SCAN_DWELL_MS));
+}
+
+void EspNowTransport::service_watch(uint32_t now_ms)
+{
+    portENTER_CRITICAL(&m_lock);
+    const uint8_t ch = m_watch.update(now_ms);
+    const DualWatch::State state = m_watch.state();
+    portEXIT_CRITICAL(&m_lock);
+    if (ch != 0) {
+        tune(ch);
+    }
+    const uint32_t now_us = static_cast<uint32_t>(esp_timer_get_time());
+    if (state == DualWatch::kListening && m_watch_state == DualWatch::kMain) {
+        m_watch_left_us = now_us;
+    } else if (state == DualWatch::kMain && m_watch_state == DualWatch::kListening) {
+        // playout on the main channel conceals this gap
+        const uint32_t away_us = now_us - m_watch_left_us;
+        ++m_watch_visits;
+        m_watch_away_us_total += away_us;
+        if (away_us > m_watch_away_us_max) {
+            m_watch_away_us_max = away_us;
+        }
+        if (m_watch_visits % 16 == 0) {
+            const uint32_t frame_us = (m_rx_frame_samples ? m_rx_frame_samples : FrameCodec::kModes[0].frame_samples) *
+                                      (1000000u / SAMPLE_RATE);
+            const uint32_t avg_us = m_watch_away_us_total / m_watch_visits;
+            Serial.printf("DUALWATCH: visits=%lu away avg=%luus max=%luus (~%lu.%lu frames concealed per visit)\n",
+                          static_cast<unsigned long>(m_watch_visits),
+                          static_cast<unsigned long>(avg_us),
+                          static_cast<unsigned long>(m_watch_away_us_max),
+                          static_cast<unsigned long>(avg_us / frame_us),
+                          static_cast<unsigned long>((avg_us % frame_us) * 10 / frame_us));
+        }
+    } else if (state == DualWatch::kPriority && m_watch_state == DualWatch::kListening) {
+        Serial.printf("DUALWATCH: traffic on priority ch %u after %lums in the window, switched\n",
+                      m_watch.priority_channel(),
+                      static_cast<unsigned long>((now_us - m_watch_left_us) / 1000));
+    } else if (state == DualWatch::kMain && m_watch_state == DualWatch::kPriority) {
+        Serial.printf("DUALWATCH: priority ch idle, back to ch %u\n", m_watch.main_channel());
+    }
+    m_watch_state = state;
+}
+
+void EspNowTransport::service_scan(uint32_t now_ms)
+{
+    portENTER_CRITICAL(&m_lock);
+    const ChannelScanner::State before = m_scanner.state();
+    const uint8_t ch = m_scanner.update(now_ms);
+    const ChannelScanner::State after = m_scanner.state();
+    const bool sweep_done = m_scanner.take_sweep_done();
+    ChannelScanner::Entry table[ChannelScanner::kNumChannels];
+    if (sweep_done) {
+        for (int i = 0; i < ChannelScanner::kNumChannels; ++i) {
+            table[i] = m_scanner.entry(ChannelScanner::kFirstChannel + i);
+        }
+    }
+    portEXIT_CRITICAL(&m_lock);
+    if (before != ChannelScanner::kLocked && after == ChannelScanner::kLocked) {
+        Serial.printf("SCAN: speech on ch %u, locked\n", m_wifi_channel);
+    }
+    if (ch != 0) {
+        if (before == ChannelScanner::kLocked) {
+            Serial.printf("SCAN: ch %u idle, resuming\n", m_wifi_channel);
+        }
+        tune(ch);
+    }
+    if (sweep_done) {
+        // activity table: frames (audio frames) heard per channel so far
+        Serial.printf("SCAN: sweep %lums, hop avg=%luus max=%luus:",
+                      static_cast<unsigned long>(now_ms - m_sweep_start_ms),
+                      static_cast<unsigned long>(m_hops ? m_hop_us_total / m_hops : 0),
+                      static_cast<unsigned long>(m_hop_us_max));
+        for (int i = 0; i < ChannelScanner::kNumChannels; ++i) {
+            if (table[i].frames > 0) {
+                Serial.printf(" ch%d=%lu(%lu)", ChannelScanner::kFirstChannel + i,
+                              static_cast<unsigned long>(table[i].frames),
+                              static_cast<unsigned long>(table[i].audio_frames));
+            }
+        }
+        Serial.println();
+        m_sweep_start_ms = now_ms;
+    }
 }
 
 
@@ -61,7 +816,6 @@ void EspNowTransport::setWifiChannel(uint16_t ch)
 bool EspNowTransport::begin()
 {
     // Set Wifi channel
-    esp_wifi_set_promiscuous(true);
     esp_wifi_set_channel(m_wifi_channel, WIFI_SECOND_CHAN_NONE);
 #ifdef ESPNOW_LONG_RANGE
     esp_wifi_set_protocol(WIFI_IF_STA, WIFI_PROTOCOL_LR);
@@ -69,12 +823,59 @@ bool EspNowTransport::begin()
     esp_err_t result = esp_now_init();
     if (result == ESP_OK) {
         Serial.println("ESPNow Init Success");
+        esp_wifi_get_mac(WIFI_IF_STA, m_own_mac);
+        // low MAC bytes as the origin id in every frame header
+        set_node_id(static_cast<uint16_t>((m_own_mac[4] << 8) | m_own_mac[5]));
+        // only a started transport receives; others can be fed handle_receive() directly
+        instance = this;
         esp_now_register_recv_cb(receiveCallback);
+        esp_now_register_send_cb(sendCallback);
+        m_started = true;
+        apply_tx_power(m_power.get_qdbm());
+#if ESP_IDF_VERSION_MAJOR < 5 && ESPNOW_RSSI_PROMISCUOUS_FALLBACK
+        // only management frames reach the callback; it keeps ESP-NOW action frames
+        wifi_promiscuous_filter_t filter = {};
+        filter.filter_mask = WIFI_PROMIS_FILTER_MASK_MGMT;
+        esp_wifi_set_promiscuous_filter(&filter);
         esp_wifi_set_promiscuous_rx_cb(&promiscuous_rx_cb);
+        esp_wifi_set_promiscuous(true);
+#else
+        esp_wifi_set_promiscuous(false);
+#endif
     } else {
         Serial.printf("ESPNow Init failed: %s\n", esp_err_to_name(result));
         return false;
     }
+#if TX_PACER_ENABLE
+    m_pacer.configure(TX_PACER_AIRTIME_PERMILLE, TX_PACER_PHY_KBPS);
+    if (!m_pacer_timer) {
+        esp_timer_create_args_t timer_args = {};
+        timer_args.callback = &pacer_timer_cb;
+        timer_args.arg = this;
+        timer_args.dispatch_method = ESP_TIMER_TASK;
+        timer_args.name = "espnow_pacer";
+        if (esp_timer_create(&timer_args, &m_pacer_timer) != ESP_OK) {
+            Serial.println("Pacer timer create failed, sending unpaced");
+            m_pacer_timer = nullptr;
+        }
+    }
+#endif
+    if (!m_relay_task &&
+        xTaskCreatePinnedToCore(relay_task, "espnow_relay", 3072, this, 5, &m_relay_task, 0) != pdPASS) {
+        Serial.println("Relay task create failed, repeater disabled");
+        m_relay_task = nullptr;
+    }
+    if (m_relay_task && !m_relay_timer) {
+        esp_timer_create_args_t timer_args = {};
+        timer_args.callback = &relay_timer_cb;
+        timer_args.arg = this;
+        timer_args.dispatch_method = ESP_TIMER_TASK;
+        timer_args.name = "espnow_relay";
+        if (esp_timer_create(&timer_args, &m_relay_timer) != ESP_OK) {
+            Serial.println("Relay timer create failed, repeater disabled");
+            m_relay_timer = nullptr;
+        }
+    }
     // this will broadcast a message to everyone in range
     esp_now_peer_info_t peerInfo = {};
     memcpy(&peerInfo.peer_addr, broadcastAddress, 6);
@@ -88,53 +889,178 @@ bool EspNowTransport::begin()
     return true;
 }
 
-EspNowTransport::EspNowTransport(OutputBuffer *output_buffer, uint8_t wifi_channel) : Transport(output_buffer, MAX_ESP_NOW_PACKET_SIZE)
+EspNowTransport::EspNowTransport(RxOutputBuffer *output_buffer, uint8_t wifi_channel)
+  : Transport(output_buffer, MAX_ESP_NOW_PACKET_SIZE),
+    m_scanner(SCAN_DWELL_MS, SCAN_RESUME_IDLE_MS),
+    m_watch(DUAL_WATCH_INTERVAL_MS, DUAL_WATCH_LISTEN_MS, DUAL_WATCH_RESUME_IDLE_MS),
+    m_power(TX_POWER_MIN_QDBM, TX_POWER_MAX_QDBM, TX_POWER_TARGET_RSSI)
 {
-  instance = this;  
   m_wifi_channel = wifi_channel;
+  m_rx_mutex = xSemaphoreCreateMutex();
+  m_radio_mutex = xSemaphoreCreateMutex();
+  set_redundancy(TX_REDUNDANCY_ENABLE);
+  set_hop_limit(REPEATER_HOP_LIMIT);
+  set_relay_channel(REPEATER_CHANNEL);
+  m_repeater = REPEATER_ENABLE;
+  set_dual_watch(DUAL_WATCH_PRIORITY_CHANNEL);
+  m_power.reset(millis());
+  m_power.set_enabled(TX_POWER_CONTROL_ENABLE);
+  m_adapt.set_fixed_mode(LINK_ADAPT_FIXED_MODE);
+  m_adapt.reset(millis());
+  set_link_mode(static_cast<uint8_t>(m_adapt.get_mode()));
 }
 
 int16_t EspNowTransport::getRSSI(void)
 {
-  return m_rssi;
+  SenderLinkTable::Entry link;
+  if (!get_link(link)) {
+    return kRssiUnknown;
+  }
+  return link.rssi.get_ewma();
+}
+
+bool EspNowTransport::get_link(SenderLinkTable::Entry &out)
+{
+  bool found = false;
+  portENTER_CRITICAL(&m_lock);
+  const SenderLinkTable::Entry *e = m_links.most_recent(millis(), kRssiTimeoutMs);
+  if (e) {
+    out = *e;
+    found = true;
+  }
+  portEXIT_CRITICAL(&m_lock);
+  return found;
+}
+
+void EspNowTransport::send_packet(const uint8_t *data, size_t len)
+{
+#if TX_PACER_ENABLE
+  if (m_pacer_timer && len > static_cast<size_t>(m_magic_size) && data[m_magic_size] == kFrameTypeAudio) {
+    pace(data, len);
+    return;
+  }
+  // control frames must not overtake queued audio (EOT in particular)
+  flush_pacer();
+#endif
+  transmit(data, len);
 }
 
-void EspNowTransport::send()
+void EspNowTransport::transmit(const uint8_t *data, size_t len)
 {
-  m_tx_packets++;
-  esp_err_t result = esp_now_send(broadcastAddress, m_buffer, m_index + m_header_size);
+  xSemaphoreTake(m_radio_mutex, portMAX_DELAY);
+  transmit_locked(data, len);
+  xSemaphoreGive(m_radio_mutex);
+}
+
+void EspNowTransport::transmit_locked(const uint8_t *data, size_t len)
+{
+  add_stat(m_stats.tx_packets);
+  TRACE_EVENT(kTraceTxSendBegin, len);
+  esp_err_t result = esp_now_send(broadcastAddress, data, len);
+  TRACE_EVENT(kTraceTxSendEnd, result);
+  if (result == ESP_OK) {
+    ++m_tx_sent;
+  }
 //  Serial.printf("m_index : %d\n", m_index);
 //  for (int i = 0; i < m_index; i++) 
 //    Serial.println(m_buffer[i]);
+  if (len > static_cast<size_t>(m_magic_size) && data[m_magic_size] == kFrameTypeAudio) {
+    portENTER_CRITICAL(&m_lock);
+    m_adapt.on_send_result(result == ESP_OK);
+    m_power.on_send();
+    portEXIT_CRITICAL(&m_lock);
+  }
   if (result != ESP_OK) {
-    m_tx_failures++;
+    add_stat(m_stats.tx_failures);
     Serial.printf("Failed to send: %s\n", esp_err_to_name(result));
   }
 }
 
-void EspNowTransport::snapshot_and_reset_stats(uint32_t &rx_ok,
-                                               uint32_t &rx_ok_bytes,
-                                               uint32_t &rx_bad_header,
-                                               uint32_t &rx_invalid_len,
-                                               uint32_t &rx_gap_events,
-                                               uint32_t &rx_max_gap_ms,
-                                               uint32_t &tx_packets,
-                                               uint32_t &tx_failures)
-{
-  rx_ok = m_rx_ok_packets;
-  rx_ok_bytes = m_rx_ok_bytes;
-  rx_bad_header = m_rx_bad_header_packets;
-  rx_invalid_len = m_rx_invalid_len_packets;
-  rx_gap_events = m_rx_gap_events;
-  rx_max_gap_ms = m_rx_max_gap_ms;
-  tx_packets = m_tx_packets;
-  tx_failures = m_tx_failures;
-  m_rx_ok_packets = 0;
-  m_rx_ok_bytes = 0;
-  m_rx_bad_header_packets = 0;
-  m_rx_invalid_len_packets = 0;
-  m_rx_gap_events = 0;
-  m_rx_max_gap_ms = 0;
-  m_tx_packets = 0;
-  m_tx_failures = 0;
+void EspNowTransport::pace(const uint8_t *data, size_t len)
+{
+  const uint32_t now_us = static_cast<uint32_t>(esp_timer_get_time());
+  uint8_t early[AirtimePacer::kMaxPacketSize];
+  size_t early_len = 0;
+  portENTER_CRITICAL(&m_pacer_lock);
+  m_pacer.set_cadence_us(static_cast<uint32_t>((static_cast<uint64_t>(m_frame_samples) * 1000000u) / SAMPLE_RATE));
+  if (m_pacer.full()) {
+    early_len = m_pacer.pop(early, now_us);
+    m_pacer.count_overflow();
+  }
+  const bool arm = m_pacer.empty();
+  m_pacer.push(data, len, now_us);
+  const uint32_t due_us = m_pacer.head_due_us();
+  portEXIT_CRITICAL(&m_pacer_lock);
+  if (early_len > 0) {
+    transmit(early, early_len);
+  }
+  if (arm) {
+    arm_timer(m_pacer_timer, due_us, now_us);
+  }
+}
+
+void EspNowTransport::pacer_release()
+{
+  const uint32_t now_us = static_cast<uint32_t>(esp_timer_get_time());
+  if (xSemaphoreTake(m_radio_mutex, 0) != pdTRUE) {
+    // a relay has the radio on another channel; don't block the timer task
+    arm_timer(m_pacer_timer, now_us + kRadioBusyRetryUs, now_us);
+    return;
+  }
+  size_t len = 0;
+  uint32_t due_us = 0;
+  portENTER_CRITICAL(&m_pacer_lock);
+  if (!m_pacer.empty() && static_cast<int32_t>(now_us - m_pacer.head_due_us()) >= 0) {
+    len = m_pacer.pop(m_pacer_tx, now_us);
+  }
+  const bool more = !m_pacer.empty();
+  if (more) {
+    due_us = m_pacer.head_due_us();
+  }
+  portEXIT_CRITICAL(&m_pacer_lock);
+  if (len > 0) {
+    transmit_locked(m_pacer_tx, len);
+  }
+  xSemaphoreGive(m_radio_mutex);
+  if (more) {
+    arm_timer(m_pacer_timer, due_us, now_us);
+  }
+}
+
+void EspNowTransport::flush_pacer()
+{
+  if (!m_pacer_timer) {
+    return;
+  }
+  uint8_t packet[AirtimePacer::kMaxPacketSize];
+  for (;;) {
+    portENTER_CRITICAL(&m_pacer_lock);
+    const size_t len = m_pacer.pop(packet, static_cast<uint32_t>(esp_timer_get_time()));
+    portEXIT_CRITICAL(&m_pacer_lock);
+    if (len == 0) {
+      break;
+    }
+    transmit(packet, len);
+  }
+}
+
+void EspNowTransport::snapshot_pacer_stats(AirtimePacer::Stats &out)
+{
+  portENTER_CRITICAL(&m_pacer_lock);
+  m_pacer.snapshot_and_reset_stats(out);
+  portEXIT_CRITICAL(&m_pacer_lock);
+}
+
+void EspNowTransport::snapshot_and_reset_stats(EspNowTransportStats &out)
+{
+  ChannelActivity::Stats activity;
+  portENTER_CRITICAL(&m_lock);
+  m_activity.snapshot_and_reset_stats(activity);
+  portEXIT_CRITICAL(&m_lock);
+  portENTER_CRITICAL(&m_stats_lock);
+  out = m_stats;
+  m_stats = {};
+  portEXIT_CRITICAL(&m_stats_lock);
+  out.rx_collisions = activity.rx_collisions;
+  out.tx_collisions = activity.tx_collisions;
 }
@@ -1,39 +1,230 @@
 #pragma once
 
 #include "Transport.h"
+#include "LinkQuality.h"
+#include "LinkAdaptation.h"
+#include "TxPowerControl.h"
+#include "AirtimePacer.h"
+#include "ReorderWindow.h"
+#include "FloodRelay.h"
+#include "ChannelActivity.h"
+#include "ChannelScanner.h"
+#include "DualWatch.h"
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
 #include <esp_now.h>
+#include <esp_timer.h>
 
-class OutputBuffer;
+class Recorder;
+class ReplayHistory;
+
+struct EspNowTransportStats {
+    uint32_t rx_ok_packets;
+    uint32_t rx_ok_bytes;
+    uint32_t rx_bad_header_packets;
+    uint32_t rx_invalid_len_packets;
+    uint32_t rx_gap_events;
+    uint32_t rx_max_gap_ms;
+    uint32_t tx_packets;
+    uint32_t tx_failures;
+    uint32_t rx_link_reports;
+    uint32_t rx_recovered_frames;   // lost frames played from the redundant copy
+    uint32_t rx_concealed_frames;   // lost frames filled with concealment
+    uint32_t rx_reordered_frames;
+    uint32_t rx_duplicate_frames;
+    uint32_t rx_late_frames;        // arrived after their slot was given up
+    uint32_t rx_echo_packets;       // our own frames heard back from a repeater
+    uint32_t rx_collisions;         // two other stations talking at once
+    uint32_t tx_collisions;         // another station heard while we transmit
+    // WiFi task load: callbacks run and CPU cycles spent in them
+    uint32_t rx_callbacks;
+    uint32_t promiscuous_callbacks;
+    uint32_t callback_cycles;
+};
 
 class EspNowTransport: public Transport {
+public:
+    // sender considered gone after this long without an accepted packet
+    static constexpr uint32_t kRssiTimeoutMs = 2000;
+    static constexpr int8_t kRssiUnknown = -127;
+    static constexpr uint32_t kLinkReportIntervalMs = 1000;
+    // talker node id (LE16), loss permille (LE16), RSSI
+    static constexpr int kLinkReportSize = 5;
+    // how long a frame waits for a missing predecessor
+    static constexpr uint32_t kReorderHoldMs = 30;
+    // cross-channel relay: longest wait for queued frames to leave before retuning
+    static constexpr uint32_t kRelaySendTimeoutMs = 10;
+    // pacer retry while a cross-channel relay has the radio
+    static constexpr uint32_t kRadioBusyRetryUs = 1000;
+    // channel stays busy this long after another station's last frame (> SID interval)
+    static constexpr uint32_t kChannelBusyHoldMs = 300;
+
 private:
-    uint8_t m_wifi_channel;
-    int16_t m_rssi = -127;
-    volatile uint32_t m_rx_ok_packets = 0;
-    volatile uint32_t m_rx_ok_bytes = 0;
-    volatile uint32_t m_rx_bad_header_packets = 0;
-    volatile uint32_t m_rx_invalid_len_packets = 0;
-    volatile uint32_t m_rx_gap_events = 0;
-    volatile uint32_t m_rx_max_gap_ms = 0;
+    // written by tune() with m_radio_mutex held
+    volatile uint8_t m_wifi_channel;
+    // ESP-NOW is up; radio settings can be applied
+    bool m_started = false;
+    // counters are bumped from the WiFi, esp_timer, relay and app tasks
+    EspNowTransportStats m_stats = {};
+    portMUX_TYPE m_stats_lock = portMUX_INITIALIZER_UNLOCKED;
     volatile uint32_t m_last_rx_ms = 0;
-    volatile uint32_t m_tx_packets = 0;
-    volatile uint32_t m_tx_failures = 0;
+    // talkspurt id of the last EOT handled, -1 if none
+    int16_t m_last_eot_id = -1;
+    uint32_t m_last_audio_ms = 0;
+    // RSSI of accepted audio packets per sender
+    SenderLinkTable m_links;
+    // guards state shared between the WiFi task and the app task
+    portMUX_TYPE m_lock = portMUX_INITIALIZER_UNLOCKED;
+    // receive side: decoder and loss tracking of the current talker
+    FrameCodec m_decoder;
+    FrameCodec m_red_decoder;
+    uint8_t m_decode_buffer[FrameCodec::kMaxFrameSamples];
+    // received talkspurts go to the replay history and recorder as they are played
+    ReplayHistory *m_history = nullptr;
+    Recorder *m_recorder = nullptr;
+    uint16_t m_rec_talker = 0;
+    bool m_rec_open = false;
+    volatile uint8_t m_rx_link_mode = 0;
+    volatile uint16_t m_rx_frame_samples = 0;
+    uint16_t m_talker_id = 0;
+    bool m_seq_valid = false;
+    // receive path (reorder window, decoders, playout) runs in the WiFi task,
+    // held frames are also released from service()
+    SemaphoreHandle_t m_rx_mutex;
+    ReorderWindow m_reorder{kReorderHoldMs};
+    ChannelActivity m_activity{kChannelBusyHoldMs};
+    // channel scan: hops are timed to keep the dwell honest
+    volatile bool m_scanning = false;
+    ChannelScanner m_scanner;
+    uint32_t m_sweep_start_ms = 0;
+    uint32_t m_hops = 0;
+    uint32_t m_hop_us_total = 0;
+    uint32_t m_hop_us_max = 0;
+    // dual-watch: short visits to a priority channel, switching over on traffic
+    volatile uint8_t m_watch_priority = 0;
+    DualWatch m_watch;
+    DualWatch::State m_watch_state = DualWatch::kOff;
+    uint32_t m_watch_left_us = 0;
+    uint32_t m_watch_visits = 0;
+    uint32_t m_watch_away_us_total = 0;
+    uint32_t m_watch_away_us_max = 0;
+    uint32_t m_report_received = 0;
+    uint32_t m_report_lost = 0;
+    int8_t m_report_rssi = kRssiUnknown;
+    uint32_t m_last_report_ms = 0;
+    // transmit side: mode selection from listener reports
+    uint8_t m_own_mac[6] = {};
+    LinkAdaptation m_adapt{FrameCodec::kNumModes};
+    TxPowerControl m_power;
+
+    // transmit side: audio frames go out through the pacer, released by a one-shot timer
+    AirtimePacer m_pacer;
+    portMUX_TYPE m_pacer_lock = portMUX_INITIALIZER_UNLOCKED;
+    esp_timer_handle_t m_pacer_timer = nullptr;
+    uint8_t m_pacer_tx[AirtimePacer::kMaxPacketSize];
+
+    // repeater: first copies of other nodes' frames are re-broadcast from a one-shot timer
+    volatile bool m_repeater = false;
+    volatile uint8_t m_relay_channel = 0;
+    FloodRelay m_relay;
+    portMUX_TYPE m_relay_lock = portMUX_INITIALIZER_UNLOCKED;
+    esp_timer_handle_t m_relay_timer = nullptr;
+    // the timer wakes this task, which may retune and wait for the frame to leave
+    TaskHandle_t m_relay_task = nullptr;
+    uint8_t m_relay_tx[FloodRelay::kMaxPacketSize];
+    // Whoever changes channel or sends holds this: a cross-channel relay
+    // keeps it from the retune until the frame has left and we are back, so
+    // our own frames never go out on the relay channel.
+    SemaphoreHandle_t m_radio_mutex;
+    // successful esp_now_send() calls (m_radio_mutex) and send callbacks (WiFi task)
+    uint32_t m_tx_sent = 0;
+    volatile uint32_t m_tx_done = 0;
+
+    void add_stat(uint32_t &counter, uint32_t n = 1)
+    {
+        portENTER_CRITICAL(&m_stats_lock);
+        counter += n;
+        portEXIT_CRITICAL(&m_stats_lock);
+    }
+    void transmit(const uint8_t *data, size_t len);
+    // transmit() with m_radio_mutex held
+    void transmit_locked(const uint8_t *data, size_t len);
+    // waits (m_radio_mutex held) until every frame handed to ESP-NOW has left
+    void wait_tx_idle();
+    static void relay_task(void *param);
+    void pace(const uint8_t *data, size_t len);
+    void flush_pacer();
+    void relay(const uint8_t *data, int len, uint16_t origin, uint8_t frame_type);
+    void relay_transmit(const uint8_t *data, size_t len);
+    // retune the radio, timing the switch
+    void tune(uint8_t ch);
+    void service_scan(uint32_t now_ms);
+    void service_watch(uint32_t now_ms);
+    void apply_tx_power(int8_t qdbm);
+    // true when origin is a different talker than the last packet's
+    bool update_talker(uint16_t origin, int8_t rssi);
+    // feeds the channel-busy state; end = EOT from origin
+    void note_activity(uint16_t origin, bool end);
+    // handle_receive() with m_rx_mutex held
+    void receive(const uint8_t *mac, int8_t rssi, const uint8_t *data, int len);
+    void play_release(const ReorderWindow::Release &r);
+    // plays what the reorder window lets go by now_ms
+    void release_reorder(uint32_t now_ms);
+    void record_rx(size_t samples);
+    void drain_reorder();
+    void fold_reorder_stats();
+    void handle_link_report(const uint8_t *payload, int len);
 protected:
-    void send();
+    void send_packet(const uint8_t *data, size_t len) override;
 public:
-    EspNowTransport(OutputBuffer *output_buffer, uint8_t wifi_channel);
+    EspNowTransport(RxOutputBuffer *output_buffer, uint8_t wifi_channel);
     virtual bool begin() override;
-    friend void receiveCallback(const uint8_t *macAddr, const uint8_t *data, int dataLen);
-    void        setRSSI(int16_t rssi) { m_rssi = rssi;}
+    // called from the WiFi task for every ESP-NOW packet
+    void        handle_receive(const uint8_t *mac, int8_t rssi, const uint8_t *data, int len);
+    // forget the current talker: fresh decoders and reorder window
+    void        reset_receiver();
+    // how long a frame waits for a missing predecessor (kReorderHoldMs by default)
+    void        set_reorder_hold_ms(uint32_t ms);
+    void        count_callback(bool promiscuous, uint32_t cycles);
+    // link reports, mode selection and release of frames held past
+    // kReorderHoldMs; call regularly from the app task
+    void        service(uint32_t now_ms);
+    uint8_t     get_rx_link_mode() const { return m_rx_link_mode; }
+    // 16 kHz samples in the last audio frame received
+    uint16_t    get_rx_frame_samples() const { return m_rx_frame_samples; }
     int16_t     getRSSI(void) override;
+    // copy of the most recently heard sender, false if none within kRssiTimeoutMs
+    bool        get_link(SenderLinkTable::Entry &out);
     uint16_t    getWifiChannel(void) { return m_wifi_channel;}
     void        setWifiChannel(uint16_t ch);
-    void        snapshot_and_reset_stats(uint32_t &rx_ok,
-                                         uint32_t &rx_ok_bytes,
-                                         uint32_t &rx_bad_header,
-                                         uint32_t &rx_invalid_len,
-                                         uint32_t &rx_gap_events,
-                                         uint32_t &rx_max_gap_ms,
-                                         uint32_t &tx_packets,
-                                         uint32_t &tx_failures);
+    // scan all channels for talkers, locking on speech (setWifiChannel ends it)
+    void        start_scan();
+    bool        is_scanning() const { return m_scanning; }
+    // visit channel ch every DUAL_WATCH_INTERVAL_MS and switch on traffic; 0 = off
+    void        set_dual_watch(uint8_t ch);
+    // lower TX power to what the worst listener needs; off = always maximum
+    void        set_tx_power_control(bool enable);
+    bool        get_tx_power_control();
+    void        set_recorder(Recorder *recorder) { m_recorder = recorder; }
+    void        set_history(ReplayHistory *history) { m_history = history; }
+    uint8_t     get_dual_watch() const { return m_watch_priority; }
+    void        snapshot_and_reset_stats(EspNowTransportStats &out);
+    // another station is talking
+    bool        channel_busy(uint32_t now_ms);
+    // our talkspurt: frames heard from others meanwhile count as collisions
+    void        set_transmitting(bool transmitting);
+    void        snapshot_pacer_stats(AirtimePacer::Stats &out);
+    // pacer timer callback (esp_timer task)
+    void        pacer_release();
+    // re-broadcast other nodes' frames; channel 0 relays on our own channel
+    void        set_repeater(bool enable);
+    bool        get_repeater() const { return m_repeater; }
+    void        set_relay_channel(uint8_t ch) { m_relay_channel = ch; }
+    void        snapshot_relay_stats(FloodRelay::Stats &out);
+    // relay task: sends the relay queue head once due
+    void        relay_release();
+    // relay timer callback (esp_timer task)
+    void        wake_relay_task();
+    // ESP-NOW send callback (WiFi task)
+    void        on_send_done() { m_tx_done = m_tx_done + 1; }
 };
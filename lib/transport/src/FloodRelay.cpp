@@ -0,0 +1,113 @@
+#include "FloodRelay.h"
+
+#include <string.h>
+
+namespace {
+
+inline bool time_before(uint32_t a, uint32_t b)
+{
+  return static_cast<int32_t>(a - b) < 0;
+}
+
+}  // namespace
+
+FloodRelay::FloodRelay(uint32_t seed) : m_rand(seed ? seed : 1)
+{
+  reset();
+}
+
+void FloodRelay::reset()
+{
+  m_cache_next = 0;
+  m_cache_count = 0;
+  m_head = 0;
+  m_count = 0;
+  m_stats = {};
+}
+
+uint32_t FloodRelay::next_rand()
+{
+  m_rand ^= m_rand << 13;
+  m_rand ^= m_rand >> 17;
+  m_rand ^= m_rand << 5;
+  return m_rand;
+}
+
+bool FloodRelay::first_seen(uint16_t origin, uint8_t type, uint16_t id)
+{
+  for (int i = 0; i < m_cache_count; ++i) {
+    const Key &k = m_cache[i];
+    if (k.origin == origin && k.id == id && k.type == type) {
+      return false;
+    }
+  }
+  // oldest key is overwritten; a looped copy arrives long before that
+  m_cache[m_cache_next] = {origin, id, type};
+  m_cache_next = (m_cache_next + 1) % kCacheSize;
+  if (m_cache_count < kCacheSize) {
+    ++m_cache_count;
+  }
+  return true;
+}
+
+FloodRelay::Verdict FloodRelay::offer(const uint8_t *packet, size_t len, size_t ttl_offset,
+                                      uint16_t origin, uint8_t type, uint16_t id, uint32_t now_us)
+{
+  if (!first_seen(origin, type, id)) {
+    ++m_stats.duplicates;
+    return kDuplicate;
+  }
+  if (ttl_offset >= len || packet[ttl_offset] == 0 || len > kMaxPacketSize) {
+    ++m_stats.expired;
+    return kExpired;
+  }
+  if (m_count == kQueueSlots) {
+    ++m_stats.dropped;
+    return kDropped;
+  }
+  Slot &slot = m_slots[(m_head + m_count) % kQueueSlots];
+  slot.enqueue_us = now_us;
+  slot.due_us = now_us + next_rand() % kMaxHoldoffUs;
+  if (m_count > 0) {
+    // stay in order behind the previous copy
+    const uint32_t prev_due = m_slots[(m_head + m_count - 1) % kQueueSlots].due_us;
+    if (time_before(slot.due_us, prev_due)) {
+      slot.due_us = prev_due;
+    }
+  }
+  slot.len = static_cast<uint16_t>(len);
+  memcpy(slot.data, packet, len);
+  --slot.data[ttl_offset];
+  ++m_count;
+  return kRelay;
+}
+
+uint32_t FloodRelay::head_due_us() const
+{
+  return m_slots[m_head].due_us;
+}
+
+size_t FloodRelay::pop(uint8_t *out, uint32_t now_us)
+{
+  if (m_count == 0) {
+    return 0;
+  }
+  const Slot &slot = m_slots[m_head];
+  const size_t len = slot.len;
+  memcpy(out, slot.data, len);
+  const uint32_t delay = now_us - slot.enqueue_us;
+  m_stats.delay_us_total += delay;
+  if (delay > m_stats.delay_us_max) {
+    m_stats.delay_us_max = delay;
+  }
+  ++m_stats.relayed;
+  m_head = (m_head + 1) % kQueueSlots;
+  --m_count;
+  return len;
+}
+
+void FloodRelay::snapshot_and_reset_stats(Stats &out)
+{
+  out = m_stats;
+  m_stats = {};
+}
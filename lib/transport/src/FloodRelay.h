@@ -0,0 +1,79 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Duplicate suppression and relay queue for a repeater
+ *
+ * Every frame carries its origin node id and a hop budget (TTL). A frame is
+ * relayed once, the first time its (origin, type, id) key is seen and only
+ * while TTL remains, so flooding terminates on any topology including loops.
+ * Relayed copies wait in a small FIFO with a short random hold-off, which
+ * keeps two repeaters that heard the same frame from colliding. Time
+ * (microseconds) is passed in; locking is the caller's job.
+ */
+class FloodRelay
+{
+public:
+  static constexpr int kCacheSize = 64;
+  static constexpr int kQueueSlots = 6;
+  static constexpr size_t kMaxPacketSize = 250;
+  static constexpr uint32_t kMaxHoldoffUs = 2000;
+
+  enum Verdict : uint8_t {
+    kRelay,       // queued for re-broadcast
+    kDuplicate,   // key already seen
+    kExpired,     // first copy but no hops left
+    kDropped,     // queue full
+  };
+
+  struct Stats {
+    uint32_t relayed;
+    uint32_t duplicates;
+    uint32_t expired;
+    uint32_t dropped;
+    // time from receive to re-broadcast
+    uint32_t delay_us_total;
+    uint32_t delay_us_max;
+  };
+
+  explicit FloodRelay(uint32_t seed = 1);
+  void reset();
+  // true the first time the key is seen; remembers it
+  bool first_seen(uint16_t origin, uint8_t type, uint16_t id);
+  // packet[ttl_offset] holds the remaining hops; the queued copy has it decremented
+  Verdict offer(const uint8_t *packet, size_t len, size_t ttl_offset,
+                uint16_t origin, uint8_t type, uint16_t id, uint32_t now_us);
+
+  bool empty() const { return m_count == 0; }
+  // when the queue head may go out; only valid if !empty()
+  uint32_t head_due_us() const;
+  // remove the queue head into out (kMaxPacketSize bytes), returns its length
+  size_t pop(uint8_t *out, uint32_t now_us);
+
+  void snapshot_and_reset_stats(Stats &out);
+
+private:
+  struct Key {
+    uint16_t origin;
+    uint16_t id;
+    uint8_t type;
+  };
+  struct Slot {
+    uint32_t enqueue_us;
+    uint32_t due_us;
+    uint16_t len;
+    uint8_t data[kMaxPacketSize];
+  };
+  Key m_cache[kCacheSize];
+  int m_cache_next = 0;
+  int m_cache_count = 0;
+  Slot m_slots[kQueueSlots];
+  int m_head = 0;
+  int m_count = 0;
+  uint32_t m_rand;
+  Stats m_stats = {};
+
+  uint32_t next_rand();
+};
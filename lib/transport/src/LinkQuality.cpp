@@ -0,0 +1,107 @@
+#include "LinkQuality.h"
+
+void LinkQualityEstimator::reset()
+{
+  m_ewma_q4 = 0;
+  m_pos = 0;
+  m_filled = 0;
+  m_count = 0;
+}
+
+void LinkQualityEstimator::add(int8_t rssi)
+{
+  if (m_count == 0) {
+    m_ewma_q4 = rssi * 16;
+  } else {
+    m_ewma_q4 += (rssi * 16 - m_ewma_q4) / 8;
+  }
+  m_window[m_pos] = rssi;
+  m_pos = (m_pos + 1) % kWindow;
+  if (m_filled < kWindow) {
+    ++m_filled;
+  }
+  ++m_count;
+}
+
+int8_t LinkQualityEstimator::get_min() const
+{
+  int8_t v = 127;
+  for (int i = 0; i < m_filled; ++i) {
+    if (m_window[i] < v) v = m_window[i];
+  }
+  return m_filled ? v : -127;
+}
+
+int8_t LinkQualityEstimator::get_max() const
+{
+  int8_t v = -128;
+  for (int i = 0; i < m_filled; ++i) {
+    if (m_window[i] > v) v = m_window[i];
+  }
+  return m_filled ? v : -127;
+}
+
+void SenderLinkTable::reset()
+{
+  for (int i = 0; i < kMaxSenders; ++i) {
+    m_entries[i].used = false;
+  }
+}
+
+SenderLinkTable::Entry *SenderLinkTable::update(const uint8_t *mac, int8_t rssi, uint32_t now_ms)
+{
+  Entry *slot = nullptr;
+  for (int i = 0; i < kMaxSenders; ++i) {
+    Entry &e = m_entries[i];
+    if (e.used && memcmp(e.mac, mac, 6) == 0) {
+      slot = &e;
+      break;
+    }
+  }
+  if (!slot) {
+    // free slot first, otherwise the sender heard least recently
+    slot = &m_entries[0];
+    for (int i = 0; i < kMaxSenders; ++i) {
+      Entry &e = m_entries[i];
+      if (!e.used) {
+        slot = &e;
+        break;
+      }
+      if (static_cast<int32_t>(e.last_seen_ms - slot->last_seen_ms) < 0) {
+        slot = &e;
+      }
+    }
+    slot->used = true;
+    memcpy(slot->mac, mac, 6);
+    slot->rssi.reset();
+  }
+  slot->last_seen_ms = now_ms;
+  slot->rssi.add(rssi);
+  return slot;
+}
+
+const SenderLinkTable::Entry *SenderLinkTable::most_recent(uint32_t now_ms, uint32_t timeout_ms) const
+{
+  const Entry *best = nullptr;
+  for (int i = 0; i < kMaxSenders; ++i) {
+    const Entry &e = m_entries[i];
+    if (!e.used || now_ms - e.last_seen_ms > timeout_ms) {
+      continue;
+    }
+    if (!best || static_cast<int32_t>(e.last_seen_ms - best->last_seen_ms) > 0) {
+      best = &e;
+    }
+  }
+  return best;
+}
+
+const SenderLinkTable::Entry *SenderLinkTable::find(const uint8_t *mac) const
+{
+  for (int i = 0; i < kMaxSenders; ++i) {
+    const Entry &e = m_entries[i];
+    if (e.used && memcmp(e.mac, mac, 6) == 0) {
+      return &e;
+    }
+  }
+  return nullptr;
+}
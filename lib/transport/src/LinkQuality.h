@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * @brief RSSI statistics for one sender
+ *
+ * EWMA (alpha 1/8) plus min/max over the last kWindow packets.
+ */
+class LinkQualityEstimator
+{
+public:
+  static constexpr int kWindow = 32;
+
+  void reset();
+  void add(int8_t rssi);
+  int16_t get_ewma() const { return static_cast<int16_t>(m_ewma_q4 / 16); }
+  int8_t get_min() const;
+  int8_t get_max() const;
+  uint32_t get_count() const { return m_count; }
+
+private:
+  int32_t m_ewma_q4 = 0;
+  int8_t m_window[kWindow] = {};
+  int m_pos = 0;
+  int m_filled = 0;
+  uint32_t m_count = 0;
+};
+
+/**
+ * @brief Link statistics per sender MAC, least recently heard entry is evicted
+ */
+class SenderLinkTable
+{
+public:
+  static constexpr int kMaxSenders = 4;
+
+  struct Entry {
+    bool used;
+    uint8_t mac[6];
+    uint32_t last_seen_ms;
+    LinkQualityEstimator rssi;
+  };
+
+  void reset();
+  Entry *update(const uint8_t *mac, int8_t rssi, uint32_t now_ms);
+  // most recently heard sender within timeout_ms, or nullptr
+  const Entry *most_recent(uint32_t now_ms, uint32_t timeout_ms) const;
+  const Entry *find(const uint8_t *mac) const;
+
+private:
+  Entry m_entries[kMaxSenders] = {};
+};
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <string.h>
+#include "Transport.h"
+
+/**
+ * @brief Transport whose packets stay in memory instead of going on air
+ *
+ * Frames are built exactly as EspNowTransport builds them and queued; the
+ * caller hands them to a receiver's handle_receive(). Used to run the
+ * TX -> RX chain without a radio or a second device.
+ */
+class LoopbackTransport : public Transport
+{
+public:
+  static constexpr int kMaxPackets = 8;
+  static constexpr size_t kMaxPacketSize = 250;
+
+  LoopbackTransport() : Transport(nullptr, kMaxPacketSize) {}
+  bool begin() override { return true; }
+  int16_t getRSSI() override { return 0; }
+  uint16_t getWifiChannel() override { return 0; }
+  void setWifiChannel(uint16_t) override {}
+
+  int packet_count() const { return m_count; }
+  const uint8_t *packet(int i) const { return m_packets[i]; }
+  size_t packet_length(int i) const { return m_lengths[i]; }
+  // the queue is full once kMaxPackets are held; later packets are dropped
+  void clear() { m_count = 0; }
+  uint32_t dropped() const { return m_dropped; }
+
+protected:
+  void send_packet(const uint8_t *data, size_t len) override
+  {
+    if (m_count >= kMaxPackets || len > kMaxPacketSize) {
+      ++m_dropped;
+      return;
+    }
+    memcpy(m_packets[m_count], data, len);
+    m_lengths[m_count] = len;
+    ++m_count;
+  }
+
+private:
+  uint8_t m_packets[kMaxPackets][kMaxPacketSize];
+  size_t m_lengths[kMaxPackets] = {};
+  int m_count = 0;
+  uint32_t m_dropped = 0;
+};
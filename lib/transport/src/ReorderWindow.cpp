@@ -0,0 +1,142 @@
+#include "ReorderWindow.h"
+
+#include <string.h>
+
+void ReorderWindow::reset()
+{
+  for (int i = 0; i < kSlots; ++i) {
+    m_used[i] = false;
+  }
+  m_held = 0;
+  m_started = false;
+  m_released_bits = 0;
+}
+
+bool ReorderWindow::needs_resync(uint16_t seq) const
+{
+  if (!m_started) {
+    return false;
+  }
+  const int16_t d = static_cast<int16_t>(seq - m_next);
+  return d >= 2 * kSlots || d < -32;
+}
+
+bool ReorderWindow::fits(uint16_t seq) const
+{
+  if (!m_started) {
+    return true;
+  }
+  const int16_t d = static_cast<int16_t>(seq - m_next);
+  return d < kSlots;
+}
+
+ReorderWindow::Result ReorderWindow::insert(uint16_t seq, uint8_t mode, const uint8_t *payload, size_t len,
+                                            uint32_t now_ms)
+{
+  if (len > kMaxPayload) {
+    return kTooLarge;
+  }
+  if (!m_started) {
+    m_started = true;
+    m_next = seq;
+    m_newest = seq;
+  }
+  const int16_t d = static_cast<int16_t>(seq - m_next);
+  if (d < 0) {
+    const int back = -d - 1;
+    if (back < 32 && (m_released_bits & (1u << back))) {
+      ++m_stats.duplicates;
+      return kDuplicate;
+    }
+    ++m_stats.late;
+    return kLate;
+  }
+  if (d >= kSlots) {
+    return kTooLarge;
+  }
+  const int slot = seq % kSlots;
+  if (m_used[slot]) {
+    ++m_stats.duplicates;
+    return kDuplicate;
+  }
+  if (static_cast<int16_t>(seq - m_newest) < 0) {
+    ++m_stats.reordered;
+  } else {
+    m_newest = seq;
+  }
+  Frame &f = m_frames[slot];
+  f.seq = seq;
+  f.mode = mode;
+  f.len = static_cast<uint8_t>(len);
+  f.arrival_ms = now_ms;
+  memcpy(f.data, payload, len);
+  m_used[slot] = true;
+  ++m_held;
+  return kAccepted;
+}
+
+ReorderWindow::Release ReorderWindow::pop(uint32_t now_ms, bool drain)
+{
+  Release r = { kNone, m_next, nullptr };
+  if (!m_started || m_held == 0) {
+    return r;
+  }
+  return release(now_ms, drain);
+}
+
+ReorderWindow::Release ReorderWindow::make_room()
+{
+  Release r = { kNone, m_next, nullptr };
+  if (!m_started) {
+    return r;
+  }
+  return release(0, true);
+}
+
+ReorderWindow::Release ReorderWindow::release(uint32_t now_ms, bool drain)
+{
+  Release r = { kNone, m_next, nullptr };
+  const int slot = m_next % kSlots;
+  if (m_used[slot]) {
+    m_used[slot] = false;
+    --m_held;
+    r.kind = kFrame;
+    r.frame = &m_frames[slot];
+    advance(true);
+    return r;
+  }
+  bool give_up = drain || static_cast<uint16_t>(m_newest - m_next) >= kSlots - 1;
+  for (int i = 0; i < kSlots && !give_up; ++i) {
+    // signed: a frame stored after the caller read the clock has not waited at all
+    if (m_used[i] && static_cast<int32_t>(now_ms - m_frames[i].arrival_ms) >= static_cast<int32_t>(m_max_hold_ms)) {
+      give_up = true;
+    }
+  }
+  if (give_up) {
+    r.kind = kGap;
+    ++m_stats.gaps;
+    advance(false);
+  }
+  return r;
+}
+
+const ReorderWindow::Frame *ReorderWindow::peek(uint16_t seq) const
+{
+  const int slot = seq % kSlots;
+  if (m_used[slot] && m_frames[slot].seq == seq) {
+    return &m_frames[slot];
+  }
+  return nullptr;
+}
+
+void ReorderWindow::advance(bool released)
+{
+  m_released_bits = (m_released_bits << 1) | (released ? 1u : 0u);
+  ++m_next;
+}
+
+void ReorderWindow::snapshot_and_reset_stats(Stats &out)
+{
+  out = m_stats;
+  m_stats = {};
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Puts received audio frames back into sequence order
+ *
+ * Frames are stored in kSlots slots indexed by seq % kSlots (O(1) insert)
+ * and released in order. A missing frame is given up on (released as a gap
+ * for concealment) once the window is full, once the oldest held frame has
+ * waited max_hold_ms (checked on every pop(), so the owner should also pop
+ * on a timer when no packets arrive), or when the stream is drained. Frames behind the
+ * release point are dropped: as duplicates if that sequence number was
+ * already released, as late otherwise. Time is passed in.
+ */
+class ReorderWindow
+{
+public:
+  static constexpr int kSlots = 8;
+  static constexpr size_t kMaxPayload = 238;
+
+  struct Frame {
+    uint16_t seq;
+    uint8_t mode;
+    uint8_t len;
+    uint32_t arrival_ms;
+    uint8_t data[kMaxPayload];
+  };
+
+  enum Kind : uint8_t { kNone, kFrame, kGap };
+  struct Release {
+    Kind kind;
+    uint16_t seq;
+    const Frame *frame;   // valid until the next insert()
+  };
+
+  enum Result : uint8_t { kAccepted, kDuplicate, kLate, kTooLarge };
+
+  struct Stats {
+    uint32_t reordered;   // filled a hole behind a newer frame
+    uint32_t duplicates;
+    uint32_t late;        // arrived after its slot was given up
+    uint32_t gaps;
+  };
+
+  explicit ReorderWindow(uint32_t max_hold_ms) : m_max_hold_ms(max_hold_ms) {}
+  void set_max_hold_ms(uint32_t max_hold_ms) { m_max_hold_ms = max_hold_ms; }
+  void reset();
+  // a jump this far ahead is a new stream, not loss: drain and reset first
+  bool needs_resync(uint16_t seq) const;
+  // true if seq can be stored without giving up older slots
+  bool fits(uint16_t seq) const;
+  Result insert(uint16_t seq, uint8_t mode, const uint8_t *payload, size_t len, uint32_t now_ms);
+  // next in-order release; drain gives up on missing frames immediately
+  Release pop(uint32_t now_ms, bool drain);
+  // release the oldest slot (frame or gap) so a frame further ahead fits
+  Release make_room();
+  const Frame *peek(uint16_t seq) const;
+  bool empty() const { return m_held == 0; }
+  void snapshot_and_reset_stats(Stats &out);
+
+private:
+  Frame m_frames[kSlots];
+  bool m_used[kSlots] = {};
+  int m_held = 0;
+  bool m_started = false;
+  uint16_t m_next = 0;
+  uint16_t m_newest = 0;
+  // bit i set: frame m_next - 1 - i was released (not a gap)
+  uint32_t m_released_bits = 0;
+  uint32_t m_max_hold_ms;
+  Stats m_stats = {};
+
+  Release release(uint32_t now_ms, bool drain);
+  void advance(bool released);
+};
@@ -1,19 +1,19 @@
 #include "Arduino.h"
 #include "Transport.h"
+#include "AudioArena.h"
+#include "Trace.h"
 
-Transport::Transport(OutputBuffer *output_buffer, size_t buffer_size)
+Transport::Transport(RxOutputBuffer *output_buffer, size_t buffer_size)
 {
   m_output_buffer = output_buffer;
     m_buffer_size = buffer_size;
-    m_buffer = (uint8_t *)malloc(m_buffer_size);
+    m_buffer = (uint8_t *)AudioArena::alloc("tx frame", m_buffer_size, AudioArena::kInternal);
     m_index = 0;
     m_header_size = 0;
 }
 
 void Transport::add_sample(int16_t sample)
 {
-    static bool gate_open = false;
-    static int32_t hold = 0;
     constexpr int32_t gate_open_th = 520;
     constexpr int32_t gate_close_th = 360;
     constexpr int32_t gate_hold_samples = 192;  // ~12ms @16k
@@ -21,24 +21,24 @@ void Transport::add_sample(int16_t sample)
     int32_t x = sample;
     int32_t level = (x >= 0) ? x : -x;
 
-    if (gate_open) {
+    if (m_gate_open) {
         if (level < gate_close_th) {
-            if (hold > 0) {
-                --hold;
+            if (m_gate_hold > 0) {
+                --m_gate_hold;
             } else {
-                gate_open = false;
+                m_gate_open = false;
             }
         } else {
-            hold = gate_hold_samples;
+            m_gate_hold = gate_hold_samples;
         }
     } else {
         if (level > gate_open_th) {
-            gate_open = true;
-            hold = gate_hold_samples;
+            m_gate_open = true;
+            m_gate_hold = gate_hold_samples;
         }
     }
 
-    if (!gate_open) {
+    if (!m_gate_open) {
         x = 0;
     }
 
@@ -50,10 +50,14 @@ void Transport::add_sample(int16_t sample)
 
 void Transport::add_sample_u8(uint8_t sample)
 {
-    m_buffer[m_index+m_header_size] = sample;
+    if (m_index == 0) {
+        m_frame_mode = m_link_mode;
+        m_frame_samples = get_frame_samples();
+    }
+    m_stage[m_index] = sample;
     m_index++;
-    // have we reached a full packet?
-    if ((m_index + m_header_size) == m_buffer_size) {
+    // have we reached a full frame?
+    if (m_index == m_frame_samples) {
         send();
         m_index = 0;
     }
@@ -62,18 +66,152 @@ void Transport::add_sample_u8(uint8_t sample)
 void Transport::flush()
 {
     if (m_index >0 ) {
+        // the encoder works on whole (decimated) sample pairs
+        const int align = 2 * FrameCodec::kModes[m_frame_mode].rate_div;
+        while (m_index % align) {
+            m_stage[m_index] = m_stage[m_index - 1];
+            m_index++;
+        }
         send();
         m_index = 0;
     }
 }
 
+void Transport::restart()
+{
+    m_index = 0;
+    m_seq = 0;
+    m_talkspurt_id = 0;
+    m_encoder.reset();
+    m_red_encoder.reset();
+    m_red_len = 0;
+}
+
+void Transport::set_link_mode(uint8_t mode)
+{
+    if (mode < FrameCodec::kNumModes) {
+        m_link_mode = mode;
+    }
+}
+
+void Transport::set_frame_samples(uint16_t samples)
+{
+    // whole decimated ADPCM byte pairs
+    m_frame_samples_limit = samples & ~3u;
+}
+
+uint16_t Transport::get_frame_samples() const
+{
+    const LinkMode &mode = FrameCodec::kModes[m_link_mode];
+    const uint16_t limit = m_frame_samples_limit;
+    uint16_t samples = (limit > 0 && limit < mode.frame_samples) ? limit : mode.frame_samples;
+    if (m_redundancy) {
+        // primary, its length byte and the redundant copy share one packet
+        const size_t room = m_buffer_size - m_header_size - kAudioInfoSize - 1;
+        while (samples > 4 &&
+               FrameCodec::payload_size(mode, samples) +
+               FrameCodec::payload_size(FrameCodec::kRedundantMode, samples) > room) {
+            samples -= 4;
+        }
+    }
+    return samples;
+}
+
+void Transport::send()
+{
+    const LinkMode &mode = FrameCodec::kModes[m_frame_mode];
+    uint8_t *info = m_buffer + m_header_size;
+    TRACE_EVENT(kTraceTxFrame, m_seq);
+    info[1] = static_cast<uint8_t>(m_seq & 0xff);
+    info[2] = static_cast<uint8_t>(m_seq >> 8);
+    ++m_seq;
+    if (!m_redundancy) {
+        info[0] = m_frame_mode;
+        m_red_len = 0;
+        const size_t len = m_encoder.encode(mode, m_stage, m_index, info + kAudioInfoSize);
+        send_packet(m_buffer, m_header_size + kAudioInfoSize + len);
+        return;
+    }
+    uint8_t *payload = info + kAudioInfoSize;
+    const size_t len = m_encoder.encode(mode, m_stage, m_index, payload + 1);
+    payload[0] = static_cast<uint8_t>(len);
+    size_t total = 1 + len;
+    // after a mode change the old copy may not fit; it is simply left out
+    const size_t room = m_buffer_size - m_header_size - kAudioInfoSize;
+    if (m_red_len > 0 && total + m_red_len <= room) {
+        memcpy(payload + total, m_red_buf, m_red_len);
+        total += m_red_len;
+    }
+    info[0] = m_frame_mode | kModeRedundantFlag;
+    send_packet(m_buffer, m_header_size + kAudioInfoSize + total);
+    m_red_len = m_red_encoder.encode(FrameCodec::kRedundantMode, m_stage, m_index, m_red_buf);
+}
+
+void Transport::send_control(uint8_t frame_type, const uint8_t *payload, size_t len)
+{
+    uint8_t packet[32];
+    if (m_magic_size + kFrameInfoSize + len > sizeof(packet)) {
+        return;
+    }
+    memcpy(packet, m_buffer, m_header_size);
+    packet[m_magic_size] = frame_type;
+    if (frame_type == kFrameTypeLinkReport) {
+        // describes a single hop, never repeated
+        packet[m_magic_size + kOffsetTtl] = 0;
+    }
+    memcpy(packet + m_magic_size + kFrameInfoSize, payload, len);
+    send_packet(packet, m_magic_size + kFrameInfoSize + len);
+}
+
+void Transport::send_sid(uint16_t noise_rms)
+{
+    // level in 16-LSB steps of the int16 domain
+    const uint16_t level = noise_rms >> 4;
+    // the counter lets repeaters tell successive SIDs apart
+    const uint8_t payload[2] = {(level > 255) ? static_cast<uint8_t>(255) : static_cast<uint8_t>(level),
+                                m_sid_counter++};
+    send_control(kFrameTypeSid, payload, sizeof(payload));
+}
+
+void Transport::end_talkspurt()
+{
+    flush();
+    for (int i = 0; i < kEotRepeat; ++i) {
+        send_control(kFrameTypeEot, &m_talkspurt_id, 1);
+    }
+    ++m_talkspurt_id;
+    // the first frame of the next talkspurt has no predecessor to protect
+    m_red_len = 0;
+}
+
 int Transport::set_header(const int header_size, const uint8_t *header)
 {
-    if ((header_size<m_buffer_size) && (header)) {
-        m_header_size = header_size;
+    if ((header_size + kFrameInfoSize < m_buffer_size) && (header)) {
+        m_magic_size = header_size;
+        m_header_size = header_size + kFrameInfoSize;
         memcpy(m_buffer, header, header_size);
+        m_buffer[m_magic_size] = kFrameTypeAudio;
+        set_node_id(m_node_id);
+        set_hop_limit(m_hop_limit);
         return 0;
     } else {
         return -1;
     }
 }
+
+void Transport::set_node_id(uint16_t id)
+{
+    m_node_id = id;
+    if (m_header_size > 0) {
+        m_buffer[m_magic_size + kOffsetOrigin] = static_cast<uint8_t>(id & 0xff);
+        m_buffer[m_magic_size + kOffsetOrigin + 1] = static_cast<uint8_t>(id >> 8);
+    }
+}
+
+void Transport::set_hop_limit(uint8_t hops)
+{
+    m_hop_limit = hops;
+    if (m_header_size > 0) {
+        m_buffer[m_magic_size + kOffsetTtl] = hops;
+    }
+}
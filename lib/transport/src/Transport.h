@@ -1,28 +1,100 @@
 #pragma once
 #include <stdlib.h>
 #include <stdint.h>
-
-class OutputBuffer;
+#include "FrameCodec.h"
+#include "OutputBuffer.h"
 
 class Transport
 {
+public:
+  // frame type byte following the magic header
+  enum : uint8_t {
+    kFrameTypeAudio = 0x01,
+    kFrameTypeSid = 0x02,   // silence descriptor: comfort noise level
+    kFrameTypeEot = 0x03,   // end of talkspurt: talkspurt id
+    kFrameTypeLinkReport = 0x04,  // listener -> talker: loss and RSSI
+  };
+  // frame type, origin node id (little endian), remaining repeater hops
+  static constexpr int kFrameInfoSize = 4;
+  static constexpr int kOffsetOrigin = 1;
+  static constexpr int kOffsetTtl = 3;
+  // audio frames: link mode, then 16-bit sequence number (little endian)
+  static constexpr int kAudioInfoSize = 3;
+  // set in the mode byte when the payload is: primary length, primary frame,
+  // previous frame coded as FrameCodec::kRedundantMode
+  static constexpr uint8_t kModeRedundantFlag = 0x80;
+  // EOT is unacknowledged broadcast, so it is repeated
+  static constexpr int kEotRepeat = 3;
+
 protected:
-  // audio buffer for samples we need to send
+  // packet buffer; starts with the magic and frame info
   uint8_t *m_buffer = NULL;
   int m_buffer_size = 0;
+  // 16 kHz samples waiting to be encoded into the next frame
+  uint8_t m_stage[FrameCodec::kMaxFrameSamples];
   int m_index = 0;
+  FrameCodec m_encoder;
+  // requested mode, applied at the next frame boundary
+  volatile uint8_t m_link_mode = 0;
+  uint8_t m_frame_mode = 0;
+  // frame length cap from the latency profile, 0 = mode default
+  volatile uint16_t m_frame_samples_limit = 0;
+  uint16_t m_frame_samples = 0;
+  uint16_t m_seq = 0;
+  // low-rate copy of the last frame sent, carried in the next packet
+  volatile bool m_redundancy = false;
+  FrameCodec m_red_encoder;
+  uint8_t m_red_buf[96];
+  size_t m_red_len = 0;
+  // magic bytes used for packet filtering
+  int m_magic_size = 0;
+  // magic + frame info, i.e. offset of the first sample
   int m_header_size;
+  // amplitude gate state for add_sample()
+  bool m_gate_open = false;
+  int32_t m_gate_hold = 0;
+  uint8_t m_talkspurt_id = 0;
+  uint8_t m_sid_counter = 0;
+  uint16_t m_node_id = 0;
+  uint8_t m_hop_limit = 0;
 
-  OutputBuffer *m_output_buffer = NULL;
+  RxOutputBuffer *m_output_buffer = NULL;
 
-  virtual void send() = 0;
+  void send();
+  void send_control(uint8_t frame_type, const uint8_t *payload, size_t len);
+  virtual void send_packet(const uint8_t *data, size_t len) = 0;
 
 public:
-  Transport(OutputBuffer *output_buffer, size_t buffer_size);
+  Transport(RxOutputBuffer *output_buffer, size_t buffer_size);
   int set_header(const int header_size, const uint8_t *header);
+  // origin id stamped on every frame sent; receivers key talkers on it
+  void set_node_id(uint16_t id);
+  uint16_t get_node_id() const { return m_node_id; }
+  // hops a repeater may still forward our frames
+  void set_hop_limit(uint8_t hops);
   void add_sample(int16_t sample);
   void add_sample_u8(uint8_t sample);
   void flush();
+  // drop samples staged for the next frame
+  void discard() { m_index = 0; }
+  // fresh encoder state and sequence, as after construction
+  void restart();
+  // index into FrameCodec::kModes
+  void set_link_mode(uint8_t mode);
+  uint8_t get_link_mode() const { return m_link_mode; }
+  // shorter frames cut packetization delay at the cost of more packets per second
+  void set_frame_samples(uint16_t samples);
+  // frame length in use (16 kHz samples)
+  uint16_t get_frame_samples() const;
+  // each packet also carries the previous frame at 8 kHz ADPCM
+  void set_redundancy(bool enable) { m_redundancy = enable; }
+  bool get_redundancy() const { return m_redundancy; }
+  // sequence number of the next audio frame
+  uint16_t get_seq() const { return m_seq; }
+  // flush and tell receivers the talkspurt is over
+  void end_talkspurt();
+  // noise_rms: background level in the int16 domain
+  void send_sid(uint16_t noise_rms);
   virtual bool        begin() = 0;
   virtual int16_t     getRSSI() = 0;
 //  virtual void        setRSSI() = 0;
@@ -0,0 +1,144 @@
+#include "TxFrontEnd.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+TxFrontEnd::TxFrontEnd(bool compressor) : m_compressor(compressor)
+{
+}
+
+void TxFrontEnd::begin_session()
+{
+  m_history_count = 0;
+  m_dither_lfsr = 0x12345678u;
+}
+
+void TxFrontEnd::convert_i16_to_u8(const int16_t *in, uint8_t *out, size_t n)
+{
+  if (!in || !out || n == 0) {
+    return;
+  }
+
+  if (!m_compressor) {
+    // Minimal conversion only: signed 16-bit PCM -> unsigned 8-bit PCM.
+    for (size_t i = 0; i < n; ++i) {
+      int v = 128 + (static_cast<int>(in[i]) >> 8);
+      if (v < 0) v = 0;
+      if (v > 255) v = 255;
+      out[i] = static_cast<uint8_t>(v);
+    }
+    return;
+  }
+
+  // TX-side refinement for 8-bit linear PCM:
+  // - gentle peak compression to use quantization range better
+  // - small TPDF-like dither before quantization to reduce "grainy" artifacts
+  uint32_t &lfsr = m_dither_lfsr;
+  constexpr int kDrivePct = 108;
+  constexpr int kKnee = 11000;
+  constexpr int kCeil = 22000;
+  constexpr int kDitherAmp = 96;  // about 0.75 LSB in 8-bit domain
+
+  auto next_rand = [&]() -> int {
+    lfsr ^= lfsr << 13;
+    lfsr ^= lfsr >> 17;
+    lfsr ^= lfsr << 5;
+    return static_cast<int>(lfsr & 0xFF);
+  };
+
+  for (size_t i = 0; i < n; ++i) {
+    int x = static_cast<int>(in[i]);
+    x = (x * kDrivePct) / 100;
+
+    int ax = abs(x);
+    if (ax > kKnee) {
+      const int sign = (x >= 0) ? 1 : -1;
+      const int over = ax - kKnee;
+      int y = kKnee + (over / 3);
+      if (y > kCeil) y = kCeil;
+      x = sign * y;
+    }
+
+    const int dither = (next_rand() - next_rand()) * kDitherAmp / 255;
+    x += dither;
+
+    int v = 128 + ((x + 128) >> 8);
+    if (v < 0) v = 0;
+    if (v > 255) v = 255;
+    out[i] = static_cast<uint8_t>(v);
+  }
+}
+
+void TxFrontEnd::apply_pitch_mode(uint8_t mode, uint8_t *buf, size_t n)
+{
+  switch (mode) {
+  case kPitchM2:
+    octave_up(buf, n);
+    break;
+  case kPitchM3:
+    triple_speed(buf, n);
+    break;
+  case kPitchM1:
+  default:
+    break;
+  }
+}
+
+void TxFrontEnd::octave_up(uint8_t *buf, size_t n)
+{
+  // Naive chipmunk shift:
+  // Compress 2 chunks worth of timeline (prev + current) into current chunk size.
+  // This raises pitch and speech speed by about +1 octave with very low CPU cost.
+  if (!buf || n == 0 || n > kMaxChunk) {
+    return;
+  }
+
+  memcpy(m_curr, buf, n);
+  if (m_history_count == 0) {
+    memcpy(m_prev1, m_curr, n);
+    m_history_count = 1;
+    return;
+  }
+
+  for (size_t i = 0; i < n; ++i) {
+    const size_t src = i * 2;
+    buf[i] = (src < n) ? m_prev1[src] : m_curr[src - n];
+  }
+
+  memcpy(m_prev1, m_curr, n);
+}
+
+void TxFrontEnd::triple_speed(uint8_t *buf, size_t n)
+{
+  // Compress 3 chunks worth of timeline (prev2 + prev1 + current) into current chunk size.
+  // This raises pitch and speech speed by about 3x with very low CPU cost.
+  if (!buf || n == 0 || n > kMaxChunk) {
+    return;
+  }
+
+  memcpy(m_curr, buf, n);
+  if (m_history_count < 2) {
+    if (m_history_count == 0) {
+      memcpy(m_prev1, m_curr, n);
+    } else {
+      memcpy(m_prev2, m_prev1, n);
+      memcpy(m_prev1, m_curr, n);
+    }
+    ++m_history_count;
+    return;
+  }
+
+  for (size_t i = 0; i < n; ++i) {
+    const size_t src = i * 3;
+    if (src < n) {
+      buf[i] = m_prev2[src];
+    } else if (src < (2 * n)) {
+      buf[i] = m_prev1[src - n];
+    } else {
+      buf[i] = m_curr[src - (2 * n)];
+    }
+  }
+
+  memcpy(m_prev2, m_prev1, n);
+  memcpy(m_prev1, m_curr, n);
+}
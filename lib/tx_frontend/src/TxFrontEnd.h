@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief TX audio ahead of the transport: 16 -> 8 bit conversion and pitch mode
+ *
+ * The conversion optionally runs the 8-bit compressor with dither
+ * (TX_8BIT_COMPRESSOR_ENABLE). The pitch modes squeeze two or three chunks
+ * of timeline into one and keep the previous chunks as history, so one
+ * instance serves one talkspurt at a time; begin_session() at key-up
+ * restarts the history and the dither, and a talkspurt repeats exactly.
+ */
+class TxFrontEnd
+{
+public:
+  // pitch modes, as Application numbers them
+  static constexpr uint8_t kPitchM1 = 1;   // as captured
+  static constexpr uint8_t kPitchM2 = 2;   // about +1 octave, double speed
+  static constexpr uint8_t kPitchM3 = 3;   // about 3x pitch and speed
+  // longest chunk the pitch modes handle; longer ones pass unchanged
+  static constexpr size_t kMaxChunk = 256;
+
+  explicit TxFrontEnd(bool compressor);
+  void begin_session();
+  void convert_i16_to_u8(const int16_t *in, uint8_t *out, size_t n);
+  void apply_pitch_mode(uint8_t mode, uint8_t *buf, size_t n);
+
+private:
+  void octave_up(uint8_t *buf, size_t n);
+  void triple_speed(uint8_t *buf, size_t n);
+
+  bool m_compressor;
+  uint32_t m_dither_lfsr = 0x12345678u;
+  uint8_t m_history_count = 0;
+  uint8_t m_prev2[kMaxChunk];
+  uint8_t m_prev1[kMaxChunk];
+  uint8_t m_curr[kMaxChunk];
+};
@@ -0,0 +1,35 @@
+#include "DtxGate.h"
+
+DtxGate::DtxGate(uint32_t sid_interval_ms) : m_sid_interval_ms(sid_interval_ms)
+{
+}
+
+void DtxGate::reset()
+{
+  m_in_silence = false;
+  m_voiced_chunks = 0;
+  m_silent_chunks = 0;
+  m_sid_frames = 0;
+}
+
+DtxGate::Action DtxGate::step(bool voiced, uint32_t now_ms)
+{
+  if (voiced) {
+    m_in_silence = false;
+    ++m_voiced_chunks;
+    return kSendAudio;
+  }
+  ++m_silent_chunks;
+  if (!m_in_silence) {
+    m_in_silence = true;
+    m_last_sid_ms = now_ms;
+    ++m_sid_frames;
+    return kFlushAndSendSid;
+  }
+  if (now_ms - m_last_sid_ms >= m_sid_interval_ms) {
+    m_last_sid_ms = now_ms;
+    ++m_sid_frames;
+    return kSendSid;
+  }
+  return kSkip;
+}
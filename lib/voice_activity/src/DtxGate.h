@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * @brief Discontinuous transmission decision per TX chunk
+ *
+ * Voiced chunks go out as audio. The first silent chunk after speech
+ * flushes the partial frame and sends a silence descriptor right away;
+ * after that one SID goes out every sid_interval_ms. Time (milliseconds)
+ * is passed in.
+ */
+class DtxGate
+{
+public:
+  enum Action : uint8_t {
+    kSendAudio,
+    kFlushAndSendSid,
+    kSendSid,
+    kSkip,
+  };
+
+  explicit DtxGate(uint32_t sid_interval_ms);
+  // start of a talkspurt; counters restart too
+  void reset();
+  Action step(bool voiced, uint32_t now_ms);
+
+  uint32_t voiced_chunks() const { return m_voiced_chunks; }
+  uint32_t silent_chunks() const { return m_silent_chunks; }
+  uint32_t sid_frames() const { return m_sid_frames; }
+
+private:
+  uint32_t m_sid_interval_ms;
+  bool m_in_silence = false;
+  uint32_t m_last_sid_ms = 0;
+  uint32_t m_voiced_chunks = 0;
+  uint32_t m_silent_chunks = 0;
+  uint32_t m_sid_frames = 0;
+};
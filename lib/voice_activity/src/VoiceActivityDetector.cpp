@@ -0,0 +1,103 @@
+#include "VoiceActivityDetector.h"
+
+namespace {
+
+constexpr uint32_t kMinNoiseEnergy = 16;       // RMS 4
+constexpr uint32_t kAbsSpeechEnergy = 40000;   // RMS 200 (about -44dBFS)
+constexpr uint32_t kSpeechOverNoise = 4;       // +6dB over background
+constexpr uint32_t kNoisyOverNoise = 16;       // +12dB when the frame looks noise-like
+constexpr uint32_t kMaxSpeechZcrQ8 = 128;      // 0.5 crossings per sample
+
+uint16_t isqrt32(uint32_t v)
+{
+  uint32_t r = 0;
+  uint32_t bit = 1u << 30;
+  while (bit > v) {
+    bit >>= 2;
+  }
+  while (bit != 0) {
+    if (v >= r + bit) {
+      v -= r + bit;
+      r = (r >> 1) + bit;
+    } else {
+      r >>= 1;
+    }
+    bit >>= 2;
+  }
+  return static_cast<uint16_t>(r);
+}
+
+}  // namespace
+
+VoiceActivityDetector::VoiceActivityDetector(int hangover_frames)
+  : m_hangover_frames(hangover_frames),
+    m_hangover(hangover_frames),
+    m_have_noise(false),
+    m_last_speech(false),
+    m_noise_energy(kMinNoiseEnergy),
+    m_frame_rms(0)
+{
+}
+
+void VoiceActivityDetector::reset()
+{
+  m_hangover = m_hangover_frames;
+}
+
+uint16_t VoiceActivityDetector::get_noise_rms() const
+{
+  return isqrt32(m_noise_energy);
+}
+
+bool VoiceActivityDetector::process(const int16_t *samples, size_t n)
+{
+  if (!samples || n == 0) {
+    return is_active();
+  }
+
+  uint64_t sum_sq = 0;
+  uint32_t crossings = 0;
+  int16_t prev = samples[0];
+  for (size_t i = 0; i < n; ++i) {
+    const int32_t x = samples[i];
+    sum_sq += static_cast<uint64_t>(x * x);
+    if ((x ^ prev) < 0) {
+      ++crossings;
+    }
+    prev = static_cast<int16_t>(x);
+  }
+  const uint32_t energy = static_cast<uint32_t>(sum_sq / n);
+  const uint32_t zcr_q8 = static_cast<uint32_t>((static_cast<uint64_t>(crossings) << 8) / n);
+  m_frame_rms = isqrt32(energy);
+
+  // background tracks down fast and up slowly (~4s at 8ms frames)
+  if (!m_have_noise) {
+    m_noise_energy = energy;
+    m_have_noise = true;
+  } else if (energy < m_noise_energy) {
+    m_noise_energy -= (m_noise_energy - energy) >> 3;
+  } else {
+    m_noise_energy += (energy - m_noise_energy) >> 9;
+  }
+  if (m_noise_energy < kMinNoiseEnergy) {
+    m_noise_energy = kMinNoiseEnergy;
+  }
+
+  const uint64_t noise = m_noise_energy;
+  bool speech = false;
+  if (energy >= kAbsSpeechEnergy) {
+    if (zcr_q8 <= kMaxSpeechZcrQ8) {
+      speech = (energy > noise * kSpeechOverNoise);
+    } else {
+      speech = (energy > noise * kNoisyOverNoise);
+    }
+  }
+
+  m_last_speech = speech;
+  if (speech) {
+    m_hangover = m_hangover_frames;
+  } else if (m_hangover > 0) {
+    --m_hangover;
+  }
+  return is_active();
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Frame-based voice activity detector for 16 kHz PCM
+ *
+ * Combines frame energy against an adaptive background estimate with the
+ * zero-crossing rate, and holds the decision for a hangover period after
+ * the last active frame. All state is per instance.
+ */
+class VoiceActivityDetector
+{
+public:
+  explicit VoiceActivityDetector(int hangover_frames);
+  // start a new talkspurt: the decision starts active and the hangover is rearmed
+  void reset();
+  // returns true while the frame (or hangover) counts as speech
+  bool process(const int16_t *samples, size_t n);
+  bool is_active() const { return m_hangover > 0; }
+  // raw decision for the last frame, without hangover
+  bool is_speech() const { return m_last_speech; }
+  // tracked background level, RMS in the int16 domain
+  uint16_t get_noise_rms() const;
+  uint16_t get_frame_rms() const { return m_frame_rms; }
+
+private:
+  int m_hangover_frames;
+  int m_hangover;
+  bool m_have_noise;
+  bool m_last_speech;
+  // background mean-square energy
+  uint32_t m_noise_energy;
+  uint16_t m_frame_rms;
+};
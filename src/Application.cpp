@@ -2,36 +2,117 @@
 #include <WiFi.h>
 #include <M5Unified.h>
 #include <math.h>
+#include <new>
 #include <string.h>
 #include <SPIFFS.h>
 #include <esp_wifi.h>
 
 #include "Application.h"
+#include "AudioArena.h"
+#include "AudioQuality.h"
 #include "DisplaySync.h"
+#include "DtxGate.h"
 #include "EspNowTransport.h"
+#include "NoiseSuppressor.h"
 #include "OutputBuffer.h"
+#include "Recorder.h"
+#include "ReplayHistory.h"
+#include "TestSignal.h"
+#include "Trace.h"
+#include "TxFrontEnd.h"
 #include "UiLayout.h"
+#include "VoiceActivityDetector.h"
+#include "WavFileSource.h"
 #include "config.h"
 
 namespace {
 
-static uint32_t s_tx_session_id = 1;
-static uint16_t s_tx_fade_samples_remaining = 0;
+// capture conversion and pitch mode; TX loop and PTT local playback share it
+static TxFrontEnd s_tx_frontend(TX_8BIT_COMPRESSOR_ENABLE);
+static_assert(Application::kTxPitchModeM1 == TxFrontEnd::kPitchM1 && Application::kTxPitchModeM2 == TxFrontEnd::kPitchM2 &&
+                  Application::kTxPitchModeM3 == TxFrontEnd::kPitchM3,
+              "pitch modes are TxFrontEnd's");
 constexpr size_t kMicWavWriteCacheSize = 8192;
 constexpr size_t kRxPlayChunkSamples = RX_PLAY_CHUNK_SAMPLES;
 constexpr size_t kRxPlayChunkBytes = kRxPlayChunkSamples;
+
+struct LatencyProfile {
+    const char *name;
+    uint16_t frame_samples;        // 0 = link mode default
+    uint16_t jitter_target_samples;
+    uint16_t play_chunk_samples;
+    uint16_t reorder_hold_ms;      // must stay well inside the jitter target
+};
+
+const LatencyProfile kLatencyProfiles[Application::kLatencyProfileCount] = {
+    { "throughput", 0, 120 * 16, RX_PLAY_CHUNK_SAMPLES, EspNowTransport::kReorderHoldMs },
+    { "low", (SAMPLE_RATE / 1000) * LOW_LATENCY_FRAME_MS, (SAMPLE_RATE / 1000) * LOW_LATENCY_JITTER_MS,
+      LOW_LATENCY_PLAY_CHUNK_SAMPLES, LOW_LATENCY_REORDER_HOLD_MS },
+};
+static_assert(LOW_LATENCY_PLAY_CHUNK_SAMPLES <= RX_PLAY_CHUNK_SAMPLES, "play buffers are RX_PLAY_CHUNK_SAMPLES long");
 static uint8_t s_mic_wav_write_cache[kMicWavWriteCacheSize];
 
-static void begin_tx_session()
+// storage for an object the firmware cannot run without: halt with the
+// reason rather than construct into nullptr
+static void *alloc_or_abort(const char *name, size_t bytes, AudioArena::Placement where)
 {
-    ++s_tx_session_id;
-    if (s_tx_session_id == 0) {
-        s_tx_session_id = 1;
+    void *p = AudioArena::alloc(name, bytes, where);
+    if (!p) {
+        Serial.printf("ARENA: cannot place %s (%u bytes), halting\n", name, static_cast<unsigned>(bytes));
+        Serial.flush();
+        abort();
     }
-    // Short fade-in to suppress click/pop at TX start.
-    s_tx_fade_samples_remaining = 128; // about 8ms @16kHz
+    return p;
 }
 
+static void begin_tx_session()
+{
+    s_tx_frontend.begin_session();
+}
+
+// Mic history kept while VOX is listening, replayed ahead of live audio on key-up.
+struct PreRollRing {
+    int16_t *buf = nullptr;
+    size_t capacity = 0;
+    size_t head = 0;
+    size_t count = 0;
+
+    bool allocate(size_t samples)
+    {
+        buf = reinterpret_cast<int16_t *>(AudioArena::alloc("vox pre-roll", samples * sizeof(int16_t), AudioArena::kPsram));
+        capacity = buf ? samples : 0;
+        head = 0;
+        count = 0;
+        return buf != nullptr;
+    }
+
+    void push(const int16_t *samples, size_t n)
+    {
+        for (size_t i = 0; i < n; ++i) {
+            buf[head] = samples[i];
+            head = (head + 1) % capacity;
+            if (count < capacity) {
+                ++count;
+            }
+        }
+    }
+
+    // pop the oldest n samples; returns how many were available
+    size_t pop(int16_t *out, size_t n)
+    {
+        if (n > count) {
+            n = count;
+        }
+        size_t tail = (head + capacity - count) % capacity;
+        for (size_t i = 0; i < n; ++i) {
+            out[i] = buf[tail];
+            tail = (tail + 1) % capacity;
+        }
+        count -= n;
+        return n;
+    }
+};
+
 static void application_task(void *param)
 {
     auto *application = reinterpret_cast<Application *>(param);
@@ -65,253 +146,6 @@ static void write_wav_header(File &f, uint32_t sample_rate, uint16_t bits_per_sa
     f.write(reinterpret_cast<const uint8_t *>(&data_bytes), 4);
 }
 
-static void apply_octave_up_simple_u8_block(uint8_t *buf, size_t n)
-{
-    // Naive chipmunk shift:
-    // Compress 2 chunks worth of timeline (prev + current) into current chunk size.
-    // This raises pitch and speech speed by about +1 octave with very low CPU cost.
-    static bool has_prev = false;
-    static uint8_t prev[256];
-    static uint8_t curr[256];
-    static uint32_t last_session_id = 0;
-
-    if (!buf || n == 0 || n > sizeof(prev)) {
-        return;
-    }
-    if (last_session_id != s_tx_session_id) {
-        has_prev = false;
-        last_session_id = s_tx_session_id;
-    }
-
-    memcpy(curr, buf, n);
-    if (!has_prev) {
-        memcpy(prev, curr, n);
-        has_prev = true;
-        return;
-    }
-
-    for (size_t i = 0; i < n; ++i) {
-        const size_t src = i * 2;
-        buf[i] = (src < n) ? prev[src] : curr[src - n];
-    }
-
-    memcpy(prev, curr, n);
-}
-
-static void apply_triple_speed_simple_u8_block(uint8_t *buf, size_t n)
-{
-    // Compress 3 chunks worth of timeline (prev2 + prev1 + current) into current chunk size.
-    // This raises pitch and speech speed by about 3x with very low CPU cost.
-    static uint8_t prev2[256];
-    static uint8_t prev1[256];
-    static uint8_t curr[256];
-    static uint8_t history_count = 0;
-    static uint32_t last_session_id = 0;
-
-    if (!buf || n == 0 || n > sizeof(prev1)) {
-        return;
-    }
-    if (last_session_id != s_tx_session_id) {
-        history_count = 0;
-        last_session_id = s_tx_session_id;
-    }
-
-    memcpy(curr, buf, n);
-    if (history_count < 2) {
-        if (history_count == 0) {
-            memcpy(prev1, curr, n);
-        } else {
-            memcpy(prev2, prev1, n);
-            memcpy(prev1, curr, n);
-        }
-        ++history_count;
-        return;
-    }
-
-    for (size_t i = 0; i < n; ++i) {
-        const size_t src = i * 3;
-        if (src < n) {
-            buf[i] = prev2[src];
-        } else if (src < (2 * n)) {
-            buf[i] = prev1[src - n];
-        } else {
-            buf[i] = curr[src - (2 * n)];
-        }
-    }
-
-    memcpy(prev2, prev1, n);
-    memcpy(prev1, curr, n);
-}
-
-static void apply_quad_speed_simple_u8_block(uint8_t *buf, size_t n)
-{
-    // Compress 4 chunks of timeline (prev3 + prev2 + prev1 + current) into current chunk size.
-    // This raises pitch and speech speed by about 4x with very low CPU cost.
-    static uint8_t prev3[256];
-    static uint8_t prev2[256];
-    static uint8_t prev1[256];
-    static uint8_t curr[256];
-    static uint8_t history_count = 0;
-    static uint32_t last_session_id = 0;
-
-    if (!buf || n == 0 || n > sizeof(prev1)) {
-        return;
-    }
-    if (last_session_id != s_tx_session_id) {
-        history_count = 0;
-        last_session_id = s_tx_session_id;
-    }
-
-    memcpy(curr, buf, n);
-    if (history_count < 3) {
-        if (history_count == 0) {
-            memcpy(prev1, curr, n);
-        } else if (history_count == 1) {
-            memcpy(prev2, prev1, n);
-            memcpy(prev1, curr, n);
-        } else {
-            memcpy(prev3, prev2, n);
-            memcpy(prev2, prev1, n);
-            memcpy(prev1, curr, n);
-        }
-        ++history_count;
-        return;
-    }
-
-    for (size_t i = 0; i < n; ++i) {
-        const size_t src = i * 4;
-        if (src < n) {
-            buf[i] = prev3[src];
-        } else if (src < (2 * n)) {
-            buf[i] = prev2[src - n];
-        } else if (src < (3 * n)) {
-            buf[i] = prev1[src - (2 * n)];
-        } else {
-            buf[i] = curr[src - (3 * n)];
-        }
-    }
-
-    memcpy(prev3, prev2, n);
-    memcpy(prev2, prev1, n);
-    memcpy(prev1, curr, n);
-}
-
-static void apply_tx_pitch_mode_u8_block(uint8_t mode, uint8_t *buf, size_t n)
-{
-    switch (mode) {
-        case Application::kTxPitchModeM2:
-            apply_octave_up_simple_u8_block(buf, n);
-            break;
-        case Application::kTxPitchModeM3:
-            apply_triple_speed_simple_u8_block(buf, n);
-            break;
-        case Application::kTxPitchModeM1:
-        default:
-            break;
-    }
-}
-
-static void convert_i16_to_u8_tx_compatible(const int16_t* in, uint8_t* out, size_t n)
-{
-    if (!in || !out || n == 0) {
-        return;
-    }
-
-#if TX_8BIT_COMPRESSOR_ENABLE
-    // TX-side refinement for 8-bit linear PCM:
-    // - gentle peak compression to use quantization range better
-    // - small TPDF-like dither before quantization to reduce "grainy" artifacts
-    static uint32_t lfsr = 0x12345678u;
-    constexpr int kDrivePct = 108;
-    constexpr int kKnee = 11000;
-    constexpr int kCeil = 22000;
-    constexpr int kDitherAmp = 96;  // about 0.75 LSB in 8-bit domain
-
-    auto next_rand = [&]() -> int {
-        lfsr ^= lfsr << 13;
-        lfsr ^= lfsr >> 17;
-        lfsr ^= lfsr << 5;
-        return static_cast<int>(lfsr & 0xFF);
-    };
-
-    for (size_t i = 0; i < n; ++i) {
-        int x = static_cast<int>(in[i]);
-        x = (x * kDrivePct) / 100;
-
-        int ax = abs(x);
-        if (ax > kKnee) {
-            const int sign = (x >= 0) ? 1 : -1;
-            const int over = ax - kKnee;
-            int y = kKnee + (over / 3);
-            if (y > kCeil) y = kCeil;
-            x = sign * y;
-        }
-
-        const int dither = (next_rand() - next_rand()) * kDitherAmp / 255;
-        x += dither;
-
-        int v = 128 + ((x + 128) >> 8);
-        if (v < 0) v = 0;
-        if (v > 255) v = 255;
-        out[i] = static_cast<uint8_t>(v);
-    }
-#else
-    // Minimal conversion only: signed 16-bit PCM -> unsigned 8-bit PCM.
-    for (size_t i = 0; i < n; ++i) {
-        int v = 128 + (static_cast<int>(in[i]) >> 8);
-        if (v < 0) v = 0;
-        if (v > 255) v = 255;
-        out[i] = static_cast<uint8_t>(v);
-    }
-#endif
-}
-
-static void apply_tx_frontend_i16_to_u8_block(const int16_t* in, uint8_t* out, size_t n)
-{
-    if (!in || !out || n == 0) {
-        return;
-    }
-
-    // Front-end processing before 8-bit transport:
-    // - short fade-in to suppress TX-start click
-    // - near-linear conversion (limiter effectively disabled)
-    constexpr int kCenter = 128;
-    constexpr int kFadeTotalSamples = 128;  // about 8ms @16kHz
-    constexpr int kNoiseGate = 0;           // disabled (caused choppy voice)
-    constexpr int kKnee = 32000;   // practically disables compression
-    constexpr int kCeil = 32000;
-    constexpr int kGainPct = 96;   // slight trim for headroom
-
-    for (size_t i = 0; i < n; ++i) {
-        int x = static_cast<int>(in[i]);
-        x = (x * kGainPct) / 100;
-
-        if (s_tx_fade_samples_remaining > 0) {
-            const int done = kFadeTotalSamples - static_cast<int>(s_tx_fade_samples_remaining);
-            x = (x * done) / kFadeTotalSamples;
-            --s_tx_fade_samples_remaining;
-        }
-
-        int ax = abs(x);
-        if (kNoiseGate > 0 && ax < kNoiseGate) {
-            x = 0;
-            ax = 0;
-        }
-        if (ax > kKnee) {
-            const int sign = (x >= 0) ? 1 : -1;
-            const int over = ax - kKnee;
-            int y = kKnee + (over / 4);
-            if (y > kCeil) y = kCeil;
-            x = sign * y;
-        }
-
-        int v = kCenter + ((x + 128) >> 8);
-        if (v < 0) v = 0;
-        if (v > 255) v = 255;
-        out[i] = static_cast<uint8_t>(v);
-    }
-}
-
 static uint8_t default_pitch_mode_from_config()
 {
 #if TX_PITCH_MODE == TX_PITCH_MODE_OCTAVE_UP_SIMPLE
@@ -731,17 +565,177 @@ static void dump_mic_wav_to_spiffs_10s()
     Serial.printf("WAV dump completed: /mic_10s.wav (%lu bytes)\n", static_cast<unsigned long>(data_bytes));
 }
 
+// Receive counters plus WiFi task callback load and RSSI of the current talker.
+uint32_t log_link_stats(EspNowTransport *transport, uint32_t elapsed_ms)
+{
+    EspNowTransportStats st;
+    transport->snapshot_and_reset_stats(st);
+    const uint32_t cycles_per_ms = ESP.getCpuFreqMHz() * 1000;
+    const float cb_load = (elapsed_ms > 0)
+        ? (100.0f * st.callback_cycles) / (static_cast<float>(cycles_per_ms) * elapsed_ms)
+        : 0.0f;
+    SenderLinkTable::Entry link;
+    if (transport->get_link(link)) {
+        Serial.printf("LINK: rx=%lu bad=%lu len=%lu gaps=%lu max_gap=%lums cb=%lu promisc=%lu wifi_cb=%.3f%% "
+                      "recovered=%lu concealed=%lu reordered=%lu dup=%lu late=%lu collisions rx=%lu tx=%lu "
+                      "mode=%u rssi=%d min=%d max=%d from %02x:%02x:%02x:%02x:%02x:%02x\n",
+                      static_cast<unsigned long>(st.rx_ok_packets),
+                      static_cast<unsigned long>(st.rx_bad_header_packets),
+                      static_cast<unsigned long>(st.rx_invalid_len_packets),
+                      static_cast<unsigned long>(st.rx_gap_events),
+                      static_cast<unsigned long>(st.rx_max_gap_ms),
+                      static_cast<unsigned long>(st.rx_callbacks),
+                      static_cast<unsigned long>(st.promiscuous_callbacks),
+                      cb_load,
+                      static_cast<unsigned long>(st.rx_recovered_frames),
+                      static_cast<unsigned long>(st.rx_concealed_frames),
+                      static_cast<unsigned long>(st.rx_reordered_frames),
+                      static_cast<unsigned long>(st.rx_duplicate_frames),
+                      static_cast<unsigned long>(st.rx_late_frames),
+                      static_cast<unsigned long>(st.rx_collisions),
+                      static_cast<unsigned long>(st.tx_collisions),
+                      static_cast<unsigned>(transport->get_rx_link_mode()),
+                      link.rssi.get_ewma(), link.rssi.get_min(), link.rssi.get_max(),
+                      link.mac[0], link.mac[1], link.mac[2], link.mac[3], link.mac[4], link.mac[5]);
+    } else {
+        Serial.printf("LINK: rx=%lu bad=%lu len=%lu cb=%lu promisc=%lu wifi_cb=%.3f%% collisions tx=%lu rssi=n/a\n",
+                      static_cast<unsigned long>(st.rx_ok_packets),
+                      static_cast<unsigned long>(st.rx_bad_header_packets),
+                      static_cast<unsigned long>(st.rx_invalid_len_packets),
+                      static_cast<unsigned long>(st.rx_callbacks),
+                      static_cast<unsigned long>(st.promiscuous_callbacks),
+                      cb_load,
+                      static_cast<unsigned long>(st.tx_collisions));
+    }
+    return st.rx_ok_packets;
+}
+
+// Frames re-broadcast for other nodes and how long each waited here.
+void log_relay_stats(EspNowTransport *transport)
+{
+    FloodRelay::Stats st;
+    transport->snapshot_relay_stats(st);
+    Serial.printf("RELAY: relayed=%lu dup=%lu expired=%lu dropped=%lu hop_delay avg=%luus max=%luus\n",
+                  static_cast<unsigned long>(st.relayed),
+                  static_cast<unsigned long>(st.duplicates),
+                  static_cast<unsigned long>(st.expired),
+                  static_cast<unsigned long>(st.dropped),
+                  static_cast<unsigned long>(st.relayed ? st.delay_us_total / st.relayed : 0),
+                  static_cast<unsigned long>(st.delay_us_max));
+}
+
+// Estimated one-way delay of the path as configured, using the measured
+// jitter buffer fill. Capture is one mic chunk plus the noise suppressor hop.
+void log_latency(const LatencyProfile &profile, EspNowTransport *transport, RxOutputBuffer *output_buffer,
+                 uint32_t rx_packets, uint32_t elapsed_ms)
+{
+    const uint32_t capture_us = (128u * 1000000u / SAMPLE_RATE) * (TX_NOISE_SUPPRESSOR_ENABLE ? 2 : 1);
+    const uint32_t frame_us = transport->get_rx_frame_samples() * (1000000u / SAMPLE_RATE);
+    const uint32_t jitter_us = output_buffer->get_available_samples() * (1000000u / SAMPLE_RATE);
+    // one chunk playing plus one queued in the speaker
+    const uint32_t playout_us = 2u * profile.play_chunk_samples * (1000000u / SAMPLE_RATE);
+    const uint32_t total_us = capture_us + frame_us + jitter_us + playout_us;
+    const uint32_t pps = (elapsed_ms > 0) ? (rx_packets * 1000u + elapsed_ms / 2) / elapsed_ms : 0;
+    Serial.printf("LATENCY: profile=%s capture=%lums frame=%lu.%lums jitter=%lums playout=%lums total~%lums rx_pps=%lu\n",
+                  profile.name,
+                  static_cast<unsigned long>(capture_us / 1000),
+                  static_cast<unsigned long>(frame_us / 1000),
+                  static_cast<unsigned long>((frame_us % 1000) / 100),
+                  static_cast<unsigned long>(jitter_us / 1000),
+                  static_cast<unsigned long>(playout_us / 1000),
+                  static_cast<unsigned long>(total_us / 1000),
+                  static_cast<unsigned long>(pps));
+}
+
+// The microphone as a TX source; pre-roll, VOX and the voice front end stay in the TX loop.
+class MicTxSource : public TxSource
+{
+public:
+    const char *name() const override { return "mic"; }
+    bool read(int16_t *samples, size_t count) override
+    {
+        return M5.Mic.record(samples, count, SAMPLE_RATE, false);
+    }
+    bool realtime() const override { return true; }
+};
+
+// one source per AUDIO_DIAG_SRC_*; also builds fresh reference stimuli for measureTalkspurt()
+TxSource *make_tx_source(uint8_t source)
+{
+    static const uint16_t kTone[] = { TEST_SIGNAL_TONE_HZ };
+    static const uint16_t kMultiTone[] = { TEST_SIGNAL_MULTITONE_HZ };
+    switch (source) {
+    case AUDIO_DIAG_SRC_MIC:
+        return new MicTxSource();
+    case AUDIO_DIAG_SRC_SILENCE:
+        return new SilenceSource();
+    case AUDIO_DIAG_SRC_TONE:
+        return new ToneSource("tone", kTone, 1, TEST_SIGNAL_LEVEL, SAMPLE_RATE);
+    case AUDIO_DIAG_SRC_MULTITONE:
+        return new ToneSource("multitone", kMultiTone, sizeof(kMultiTone) / sizeof(kMultiTone[0]),
+                              TEST_SIGNAL_LEVEL, SAMPLE_RATE);
+    case AUDIO_DIAG_SRC_SWEEP:
+        return new SweepSource(TEST_SIGNAL_SWEEP_START_HZ, TEST_SIGNAL_SWEEP_END_HZ, TEST_SIGNAL_SWEEP_MS,
+                               TEST_SIGNAL_LEVEL, SAMPLE_RATE);
+    case AUDIO_DIAG_SRC_WHITE:
+        return new NoiseSource(NoiseSource::kWhite, TEST_SIGNAL_LEVEL);
+    case AUDIO_DIAG_SRC_PINK:
+        return new NoiseSource(NoiseSource::kPink, TEST_SIGNAL_LEVEL);
+    case AUDIO_DIAG_SRC_MLS:
+        return new MlsSource(TEST_SIGNAL_LEVEL);
+    case AUDIO_DIAG_SRC_WAV:
+        return new WavFileSource(SPIFFS, TEST_SIGNAL_WAV_PATH, SAMPLE_RATE);
+    default:
+        return nullptr;
+    }
+}
+
 }  // namespace
 
 Application::Application() :
     m_transport(nullptr),
     m_output_buffer(nullptr),
+    m_noise_suppressor(nullptr),
+    m_vad(nullptr),
+    m_vox_vad(nullptr),
+    m_recorder(nullptr),
+    m_history(nullptr),
+    m_ns_bypass(!TX_NOISE_SUPPRESSOR_ENABLE),
+    m_vox_enabled(VOX_MODE_ENABLE),
+    m_latency_profile(LATENCY_PROFILE),
     m_channel(ESP_NOW_WIFI_CHANNEL),
     m_speaker_volume(132),
-    m_tx_pitch_mode(default_pitch_mode_from_config())
+    m_tx_pitch_mode(default_pitch_mode_from_config()),
+    m_overlay_hidden(false),
+    m_replay_request(-1),
+    m_replay_age(-1),
+    m_tx_source(kTxSourceMic)
 {
-    m_output_buffer = new OutputBuffer(120 * 16);
+    AudioArena::begin(AUDIO_ARENA_INTERNAL_BYTES, AUDIO_ARENA_PSRAM_BYTES);
+    // the ring lives inside the object: the live one is touched by playout
+    // every chunk, keep it in internal RAM
+    m_output_buffer = new (alloc_or_abort("output buffer", sizeof(RxOutputBuffer), AudioArena::kInternal))
+        RxOutputBuffer(120 * 16);
     m_transport = new EspNowTransport(m_output_buffer, static_cast<uint8_t>(m_channel));
+    constexpr size_t kRecorderRingBytes = RECORDER_RING_BLOCKS * RecordRing::kBlockSize;
+    m_recorder = new Recorder(
+        reinterpret_cast<uint8_t *>(AudioArena::alloc("recorder ring", kRecorderRingBytes, AudioArena::kPsram)),
+        kRecorderRingBytes);
+    m_transport->set_recorder(m_recorder);
+    m_history = new ReplayHistory();
+    m_history->init(reinterpret_cast<uint8_t *>(
+                        AudioArena::alloc("replay history", REPLAY_HISTORY_BYTES, AudioArena::kPsram)),
+                    REPLAY_HISTORY_BYTES);
+    m_transport->set_history(m_history);
+    static_assert(kTxSourceCount == AUDIO_DIAG_SRC_WAV + 1, "one TX source per AUDIO_DIAG_SRC_*");
+    for (uint8_t i = 0; i < kTxSourceCount; ++i) {
+        m_tx_sources[i] = make_tx_source(i);
+    }
+    m_noise_suppressor = new NoiseSuppressor();
+    m_noise_suppressor->set_bypass(m_ns_bypass);
+    constexpr int kVadFrameMs = (128 * 1000) / SAMPLE_RATE;
+    m_vad = new VoiceActivityDetector(TX_VAD_HANGOVER_MS / kVadFrameMs);
+    m_vox_vad = new VoiceActivityDetector(VOX_HANG_TIME_MS / kVadFrameMs);
 }
 
 void Application::begin()
@@ -749,12 +743,11 @@ void Application::begin()
     Serial.print("My IDF Version is: ");
     Serial.println(esp_get_idf_version());
 
-#if AUDIO_DIAG_SOURCE == AUDIO_DIAG_SRC_MIC
     auto mic_cfg = M5.Mic.config();
     mic_cfg.magnification = MIC_MAGNIFICATION;
     mic_cfg.over_sampling = 2;
     M5.Mic.config(mic_cfg);
-#endif
+    setTxSource(AUDIO_DIAG_SOURCE);
 
 #if MIC_WAV_DUMP_TO_SPIFFS
     // Capture diagnostic WAV before enabling radio/transport.
@@ -796,7 +789,11 @@ void Application::begin()
 void Application::setChannel(uint16_t ch)
 {
     m_channel = ch;
-    m_transport->setWifiChannel(ch);
+    if (ch == kChannelScan) {
+        m_transport->start_scan();
+    } else {
+        m_transport->setWifiChannel(ch);
+    }
 }
 
 void Application::setSpeakerVolume(uint8_t volume)
@@ -823,6 +820,227 @@ uint8_t Application::getTxPitchMode() const
     return m_tx_pitch_mode;
 }
 
+void Application::setNoiseSuppressorBypass(bool bypass)
+{
+    // the TX loop owns the suppressor; it picks this up at key-up
+    m_ns_bypass = bypass;
+}
+
+bool Application::getNoiseSuppressorBypass() const
+{
+    return m_ns_bypass;
+}
+
+void Application::setVoxEnabled(bool enabled)
+{
+    m_vox_enabled = enabled;
+}
+
+bool Application::getVoxEnabled() const
+{
+    return m_vox_enabled;
+}
+
+void Application::setLatencyProfile(uint8_t profile)
+{
+    if (profile < kLatencyProfileCount) {
+        m_latency_profile = profile;
+    }
+}
+
+uint8_t Application::getLatencyProfile() const
+{
+    return m_latency_profile;
+}
+
+void Application::setRedundancy(bool enable)
+{
+    m_transport->set_redundancy(enable);
+}
+
+bool Application::getRedundancy() const
+{
+    return m_transport->get_redundancy();
+}
+
+void Application::setRepeater(bool enable)
+{
+    m_transport->set_repeater(enable);
+}
+
+bool Application::getRepeater() const
+{
+    return m_transport->get_repeater();
+}
+
+void Application::setDualWatch(uint8_t ch)
+{
+    m_transport->set_dual_watch(ch);
+}
+
+uint8_t Application::getDualWatch() const
+{
+    return m_transport->get_dual_watch();
+}
+
+void Application::setTxPowerControl(bool enable)
+{
+    m_transport->set_tx_power_control(enable);
+}
+
+bool Application::getTxPowerControl() const
+{
+    return m_transport->get_tx_power_control();
+}
+
+bool Application::setRecording(bool enable)
+{
+    if (!enable) {
+        m_recorder->stop();
+        return true;
+    }
+    if (!SPIFFS.begin(true)) {
+        Serial.println("REC: SPIFFS mount failed");
+        return false;
+    }
+    return m_recorder->start(SPIFFS, RECORDER_PATH);
+}
+
+bool Application::getRecording() const
+{
+    return m_recorder->recording();
+}
+
+void Application::logRecorderStats()
+{
+    m_recorder->log_stats();
+}
+
+bool Application::replay(int age)
+{
+    ReplayHistory::Talkspurt ts;
+    if (age < 0 || !m_history->get(static_cast<uint32_t>(age), ts)) {
+        return false;
+    }
+    m_replay_age = static_cast<int8_t>(age);
+    m_replay_request = static_cast<int8_t>(age);
+    return true;
+}
+
+void Application::stopReplay()
+{
+    if (m_replay_age >= 0) {
+        m_replay_request = kReplayStop;
+    }
+}
+
+int Application::getReplayAge() const
+{
+    return m_replay_age;
+}
+
+void Application::logReplayHistory()
+{
+    const uint32_t now = millis();
+    ReplayHistory::Talkspurt ts;
+    uint32_t age = 0;
+    for (; m_history->get(age, ts); ++age) {
+        Serial.printf("REPLAY: %2lu  from %04x  %5lu ms  %lu s ago\n",
+                      static_cast<unsigned long>(age + 1),
+                      static_cast<unsigned>(ts.sender),
+                      static_cast<unsigned long>(ts.length * 1000 / SAMPLE_RATE),
+                      static_cast<unsigned long>((now - ts.t_ms) / 1000));
+    }
+    Serial.printf("REPLAY: %lu talkspurts held (%lu s of history)\n",
+                  static_cast<unsigned long>(age),
+                  static_cast<unsigned long>(m_history->capacity() / SAMPLE_RATE));
+}
+
+bool Application::measureTalkspurt(uint8_t source, int age)
+{
+    ReplayHistory::Talkspurt ts;
+    if (age < 0 || !m_history->get(static_cast<uint32_t>(age), ts)) {
+        Serial.printf("AQ: talkspurt %d not held\n", age + 1);
+        return false;
+    }
+    if (source >= kTxSourceCount || source == kTxSourceMic || source == AUDIO_DIAG_SRC_SILENCE) {
+        Serial.println("AQ: needs a test signal or WAV source as reference");
+        return false;
+    }
+    if (source == AUDIO_DIAG_SRC_WAV && !SPIFFS.begin(true)) {
+        Serial.println("AQ: SPIFFS mount failed");
+        return false;
+    }
+    const size_t received_len = (ts.length < AQ_MAX_SAMPLES) ? ts.length : AQ_MAX_SAMPLES;
+    // the sender restarts the signal at key-up; leave room for the alignment search
+    const size_t stimulus_len = received_len + AudioQuality::kMaxDelay;
+    int16_t *received = static_cast<int16_t *>(malloc(received_len * sizeof(int16_t)));
+    int16_t *stimulus = static_cast<int16_t *>(malloc(stimulus_len * sizeof(int16_t)));
+    TxSource *reference = make_tx_source(source);
+    bool ok = received && stimulus && reference;
+    if (ok) {
+        // decoded 8 bit offset samples, widened in place from the back
+        uint8_t *raw = reinterpret_cast<uint8_t *>(received);
+        ok = m_history->read(ts, 0, raw, received_len) == received_len;
+        for (size_t i = received_len; ok && i-- > 0;) {
+            received[i] = static_cast<int16_t>((static_cast<int>(raw[i]) - 128) << 8);
+        }
+    }
+    if (ok) {
+        reference->reset();
+        ok = reference->read(stimulus, stimulus_len);
+    }
+    AudioQuality::Report report;
+    if (ok) {
+        const uint32_t tone_hz = (source == AUDIO_DIAG_SRC_TONE) ? TEST_SIGNAL_TONE_HZ : 0;
+        const uint32_t t0 = millis();
+        ok = AudioQuality::analyse(stimulus, stimulus_len, received, received_len, SAMPLE_RATE, tone_hz, report);
+        if (ok) {
+            char text[320];
+            AudioQuality::format(report, text, sizeof(text));
+            Serial.printf("AQ: talkspurt %d from %04x against %s (%lu ms)\n", age + 1,
+                          static_cast<unsigned>(ts.sender), reference->name(),
+                          static_cast<unsigned long>(millis() - t0));
+            Serial.print(text);
+        }
+    }
+    if (!ok) {
+        Serial.println("AQ: nothing to compare (too short, evicted, no correlation or out of memory)");
+    }
+    delete reference;
+    free(stimulus);
+    free(received);
+    return ok;
+}
+
+void Application::setTxSource(uint8_t source)
+{
+    if (source >= kTxSourceCount) {
+        return;
+    }
+    if (source == AUDIO_DIAG_SRC_WAV && !SPIFFS.begin(true)) {
+        Serial.println("TXSRC: SPIFFS mount failed");
+        return;
+    }
+    m_tx_source = source;
+    Serial.printf("TXSRC: %s\n", m_tx_sources[source]->name());
+}
+
+uint8_t Application::getTxSource() const
+{
+    return m_tx_source;
+}
+
+const char *Application::getTxSourceName(uint8_t source) const
+{
+    return (source < kTxSourceCount) ? m_tx_sources[source]->name() : "";
+}
+
+void Application::setOverlayHidden(bool hidden)
+{
+    m_overlay_hidden = hidden;
+}
+
 int16_t Application::getRSSI()
 {
     return m_transport->getRSSI();
@@ -830,6 +1048,9 @@ int16_t Application::getRSSI()
 
 void Application::dispRSSI(int16_t rssi)
 {
+    if (m_overlay_hidden) {
+        return;
+    }
     display_lock();
     const uint16_t kBarLeftOn = TFT_GREEN;
     const uint16_t kBarRightOn = TFT_RED;
@@ -880,15 +1101,22 @@ void Application::dispRSSI(int16_t rssi)
 
 void Application::dispStatus(bool transmitting)
 {
+    if (m_overlay_hidden) {
+        return;
+    }
+    // another station on the channel: while receiving, or talked over
+    const bool busy = m_transport->channel_busy(millis());
     display_lock();
     const uint16_t status_color = transmitting
         ? TFT_RED
-        : TFT_BLUE;
+        : (busy ? TFT_ORANGE : TFT_BLUE);
 
     M5.Display.fillRect(0, 0, M5.Display.width(), kUiLayout.status_h, status_color);
     M5.Display.setFont(&fonts::Font0);
     M5.Display.setTextDatum(middle_center);
-    const char* label = transmitting ? "Transmit" : "Receive";
+    const char* label = transmitting
+        ? (busy ? "TX Busy" : "Transmit")
+        : (busy ? "Busy" : "Receive");
     int status_text_area_w = M5.Display.width();
 #if TALKIE_TARGET_M5STICKS3
     constexpr int kBatteryAreaW = 31;  // battery icon + right margin on StickS3
@@ -926,6 +1154,9 @@ void Application::dispStatus(bool transmitting)
 
 void Application::dispTxPower(int16_t dbm)
 {
+    if (m_overlay_hidden) {
+        return;
+    }
     display_lock();
     const uint16_t kBarLeftOn = TFT_GREEN;
     const uint16_t kBarRightOn = TFT_RED;
@@ -978,9 +1209,12 @@ void Application::loop()
     constexpr size_t kRecordChunkSamples = 128;
     constexpr uint32_t kMaxRecordMs = 5000;
     constexpr size_t kMaxRecordSamples = (SAMPLE_RATE * kMaxRecordMs) / 1000;
-    int16_t *mic_chunk_samples = reinterpret_cast<int16_t *>(malloc(sizeof(int16_t) * kRecordChunkSamples));
-    int16_t *record_samples_i16 = reinterpret_cast<int16_t *>(malloc(sizeof(int16_t) * kMaxRecordSamples));
-    uint8_t *record_samples_u8 = reinterpret_cast<uint8_t *>(malloc(kMaxRecordSamples));
+    int16_t *mic_chunk_samples = reinterpret_cast<int16_t *>(
+        AudioArena::alloc("mic chunk", sizeof(int16_t) * kRecordChunkSamples, AudioArena::kInternal));
+    int16_t *record_samples_i16 = reinterpret_cast<int16_t *>(
+        AudioArena::alloc("record i16", sizeof(int16_t) * kMaxRecordSamples, AudioArena::kPsram));
+    uint8_t *record_samples_u8 = reinterpret_cast<uint8_t *>(
+        AudioArena::alloc("record u8", kMaxRecordSamples, AudioArena::kPsram));
     bool mic_active = false;
     bool mic_primed = false;
     bool spk_active = true;
@@ -992,11 +1226,9 @@ void Application::loop()
 
     if (!mic_chunk_samples || !record_samples_i16 || !record_samples_u8) {
         Serial.println("PTT test mode: failed to allocate record buffers");
-        if (mic_chunk_samples) free(mic_chunk_samples);
-        if (record_samples_i16) free(record_samples_i16);
-        if (record_samples_u8) free(record_samples_u8);
         vTaskDelete(nullptr);
     }
+    AudioArena::print_map();
 
     while (true) {
         if (!M5.BtnA.isPressed()) {
@@ -1048,7 +1280,7 @@ void Application::loop()
 #else
             {
                 // Match wireless TX path: int16 mic -> 8bit transport (no additional processing).
-                convert_i16_to_u8_tx_compatible(
+                s_tx_frontend.convert_i16_to_u8(
                     mic_chunk_samples,
                     record_samples_u8 + recorded_samples,
                     chunk_samples);
@@ -1131,16 +1363,21 @@ void Application::loop()
     }
 #else
     constexpr size_t mic_chunk_samples = 128;
+    static_assert(mic_chunk_samples == NoiseSuppressor::kHopSize,
+                  "noise suppressor runs one hop per mic chunk");
     constexpr size_t play_chunk_bytes = kRxPlayChunkBytes;
     constexpr size_t kRxPrefillChunks = 3;
     constexpr bool enable_tx_overlay = true;
     constexpr bool enable_rx_overlay = true;
     constexpr size_t rx_buffered_samples = SAMPLE_RATE * RX_RAM_BUFFERED_SECONDS;
-    constexpr TickType_t synth_chunk_delay_ticks =
-        pdMS_TO_TICKS((mic_chunk_samples * 1000 + SAMPLE_RATE - 1) / SAMPLE_RATE);
-    int16_t *mic_samples = reinterpret_cast<int16_t *>(malloc(sizeof(int16_t) * mic_chunk_samples));
-    uint8_t *mic_samples_u8 = reinterpret_cast<uint8_t *>(malloc(mic_chunk_samples));
-    uint8_t *rx_buffered_samples_u8 = reinterpret_cast<uint8_t *>(malloc(rx_buffered_samples));
+    int16_t *mic_samples = reinterpret_cast<int16_t *>(
+        AudioArena::alloc("mic chunk", sizeof(int16_t) * mic_chunk_samples, AudioArena::kInternal));
+    uint8_t *mic_samples_u8 = reinterpret_cast<uint8_t *>(
+        AudioArena::alloc("mic chunk u8", mic_chunk_samples, AudioArena::kInternal));
+#if RX_RAM_BUFFERED_PLAYBACK_MODE
+    uint8_t *rx_buffered_samples_u8 = reinterpret_cast<uint8_t *>(
+        AudioArena::alloc("rx ram buffer", rx_buffered_samples, AudioArena::kPsram));
+#endif
     uint8_t *rx_play_buffers[3] = { nullptr, nullptr, nullptr };
     bool mic_active = false;
     bool mic_primed = false;
@@ -1150,28 +1387,168 @@ void Application::loop()
     uint8_t rx_level_min = 255;
     uint8_t rx_level_max = 0;
     const uint32_t ptt_enable_after_ms = millis() + 1000;
-    float tone_phase = 0.0f;
-    constexpr float tone_freq_hz = 1000.0f;
-    constexpr float two_pi = 6.28318530718f;
-    const float tone_phase_step = two_pi * tone_freq_hz / static_cast<float>(SAMPLE_RATE);
-    constexpr int16_t tone_amplitude = 12000;
-
-    rx_play_buffers[0] = reinterpret_cast<uint8_t *>(malloc(kRxPlayChunkBytes));
-    rx_play_buffers[1] = reinterpret_cast<uint8_t *>(malloc(kRxPlayChunkBytes));
-    rx_play_buffers[2] = reinterpret_cast<uint8_t *>(malloc(kRxPlayChunkBytes));
+    uint32_t ns_cycles_total = 0;
+    uint32_t ns_cycles_max = 0;
+    uint32_t ns_hops = 0;
+    uint32_t last_ns_log_ms = millis();
+    DtxGate dtx(TX_DTX_SID_INTERVAL_MS);
+    constexpr size_t kVoxPrerollSamples = (SAMPLE_RATE / 1000) * VOX_PREROLL_MS;
+    PreRollRing vox_preroll;
+    bool vox_triggered = false;
+    uint32_t vox_trigger_ms = 0;
+    uint8_t vox_speech_run = 0;
+    uint32_t rx_last_audio_ms = millis();
+    uint32_t vox_listen_ms = 0;
+    uint32_t vox_last_listen_tick_ms = 0;
+    uint32_t vox_triggers = 0;
+    uint32_t vox_false_triggers = 0;
+    uint32_t vox_keyup_ms_total = 0;
+    uint32_t vox_keyup_ms_max = 0;
+
+    for (uint8_t *&buf : rx_play_buffers) {
+        buf = reinterpret_cast<uint8_t *>(AudioArena::alloc("rx play chunk", kRxPlayChunkBytes, AudioArena::kInternal));
+    }
     size_t rx_play_buf_index = 0;
+    size_t rx_play_chunk_bytes = kRxPlayChunkBytes;
+    uint8_t applied_profile = Application::kLatencyProfileCount;
+    // pick up a profile change from setLatencyProfile()
+    auto apply_latency_profile = [&]() {
+        const uint8_t profile = m_latency_profile;
+        if (profile == applied_profile) {
+            return;
+        }
+        const LatencyProfile &p = kLatencyProfiles[profile];
+        m_transport->set_frame_samples(p.frame_samples);
+        m_output_buffer->set_target_buffer_samples(p.jitter_target_samples);
+        m_transport->set_reorder_hold_ms(p.reorder_hold_ms);
+        rx_play_chunk_bytes = p.play_chunk_samples;
+        applied_profile = profile;
+        Serial.printf("Latency profile: %s (frame %u, jitter target %u, play chunk %u samples, reorder hold %u ms)\n",
+                      p.name,
+                      static_cast<unsigned>(m_transport->get_frame_samples()),
+                      static_cast<unsigned>(p.jitter_target_samples),
+                      static_cast<unsigned>(p.play_chunk_samples),
+                      static_cast<unsigned>(p.reorder_hold_ms));
+    };
+    apply_latency_profile();
+    // local replay from the history, one play chunk at a time
+    ReplayHistory::Talkspurt replay_ts = {};
+    uint32_t replay_offset = 0;
+    bool replay_active = false;
+    auto end_replay = [&](const char *why) {
+        if (replay_active) {
+            Serial.printf("REPLAY: %s\n", why);
+        }
+        replay_active = false;
+        m_replay_age = -1;
+    };
+    // fills chunk from the replayed talkspurt; false when not replaying
+    auto fill_from_replay = [&](uint8_t *chunk, size_t bytes) -> bool {
+        const int8_t request = m_replay_request;
+        if (request != -1) {
+            m_replay_request = -1;
+            end_replay("stopped");
+            if (request >= 0 && m_history->get(static_cast<uint32_t>(request), replay_ts)) {
+                replay_active = true;
+                replay_offset = 0;
+                m_replay_age = request;
+                Serial.printf("REPLAY: %d from %04x, %lu ms\n", request + 1,
+                              static_cast<unsigned>(replay_ts.sender),
+                              static_cast<unsigned long>(replay_ts.length * 1000 / SAMPLE_RATE));
+            }
+        }
+        if (!replay_active) {
+            return false;
+        }
+        if (m_output_buffer->get_available_samples() > 0) {
+            end_replay("interrupted by live audio");
+            return false;
+        }
+        const size_t n = m_history->read(replay_ts, replay_offset, chunk, bytes);
+        if (n == 0) {
+            end_replay("done");
+            return false;
+        }
+        memset(chunk + n, 0x80, bytes - n);
+        replay_offset += n;
+        return true;
+    };
     bool rx_play_pending = false;
     uint8_t *rx_play_pending_ptr = nullptr;
 
-    if (!mic_samples || !mic_samples_u8 || !rx_buffered_samples_u8 ||
+    if (!mic_samples || !mic_samples_u8 ||
+#if RX_RAM_BUFFERED_PLAYBACK_MODE
+        !rx_buffered_samples_u8 ||
+#endif
         !rx_play_buffers[0] || !rx_play_buffers[1] || !rx_play_buffers[2]) {
         Serial.println("Failed to allocate audio buffers");
         vTaskDelete(nullptr);
     }
+    if (!vox_preroll.allocate(kVoxPrerollSamples)) {
+        Serial.println("VOX: failed to allocate pre-roll buffer");
+    }
+    AudioArena::print_map();
+
+    // One VOX listen step: capture a chunk into the pre-roll ring and run the
+    // trigger VAD. Returns true when enough consecutive speech was heard.
+    auto vox_listen_step = [&]() -> bool {
+        if (spk_active) {
+            M5.Speaker.stop();
+            M5.Speaker.end();
+            spk_active = false;
+        }
+        if (!mic_active) {
+            M5.Mic.begin();
+            mic_active = true;
+            vox_speech_run = 0;
+            vox_last_listen_tick_ms = millis();
+        }
+        if (!M5.Mic.record(mic_samples, mic_chunk_samples, SAMPLE_RATE, false)) {
+            vTaskDelay(pdMS_TO_TICKS(1));
+            return false;
+        }
+        const uint32_t now = millis();
+        vox_listen_ms += now - vox_last_listen_tick_ms;
+        vox_last_listen_tick_ms = now;
+        if (vox_preroll.capacity > 0) {
+            vox_preroll.push(mic_samples, mic_chunk_samples);
+        }
+        m_vox_vad->process(mic_samples, mic_chunk_samples);
+        vox_speech_run = m_vox_vad->is_speech() ? static_cast<uint8_t>(vox_speech_run + 1) : 0;
+        return vox_speech_run >= VOX_TRIGGER_CHUNKS;
+    };
+    // listen before talk: with the hold policy PTT does nothing while another station talks
+    auto lbt_holding = [&]() -> bool {
+        return TX_LBT_POLICY == TX_LBT_POLICY_HOLD && m_transport->channel_busy(millis());
+    };
     while (true) {
-        bool ptt = (millis() > ptt_enable_after_ms) && M5.BtnA.isPressed();
+        const bool vox_session = vox_triggered;
+        vox_triggered = false;
+        bool ptt = vox_session || ((millis() > ptt_enable_after_ms) && M5.BtnA.isPressed() && !lbt_holding());
         if (ptt) {
+#if TX_LBT_POLICY == TX_LBT_POLICY_HOLD
+            // random start so two stations keyed together rarely start together;
+            // whoever hears the other before its first frame gives way. Without
+            // the hold nobody gives way, so the wait would only add latency.
+            vTaskDelay(pdMS_TO_TICKS(random(TX_LBT_BACKOFF_MAX_MS + 1)));
+#endif
+#if TX_LBT_POLICY != TX_LBT_POLICY_OFF
+            if (m_transport->channel_busy(millis())) {
+                Serial.printf("LBT: channel busy at key-up (%s)\n",
+                              (TX_LBT_POLICY == TX_LBT_POLICY_HOLD) ? "holding" : "warning");
+                if (lbt_holding() && !vox_session) {
+                    continue;
+                }
+            }
+#endif
+            end_replay("stopped by PTT");
             begin_tx_session();
+            m_transport->set_transmitting(true);
+            m_recorder->talkspurt(Recorder::kTx, m_transport->get_node_id(), true);
+            m_noise_suppressor->set_bypass(m_ns_bypass);
+            m_noise_suppressor->reset();
+            m_vad->reset();
+            dtx.reset();
             if (enable_tx_overlay) {
                 dispStatus(true);
                 int8_t tx_qdbm = 0;
@@ -1184,8 +1561,10 @@ void Application::loop()
                 M5.Speaker.end();
                 spk_active = false;
             }
-#if AUDIO_DIAG_SOURCE == AUDIO_DIAG_SRC_MIC
-            if (!mic_active) {
+            TxSource *const source = m_tx_sources[m_tx_source];
+            const bool from_mic = source->realtime();
+            source->reset();
+            if (from_mic && !mic_active) {
                 M5.Mic.begin();
                 mic_active = true;
                 if (!mic_primed) {
@@ -1199,10 +1578,41 @@ void Application::loop()
                     mic_primed = true;
                 }
             }
-#endif
 
             unsigned long start_time = millis();
-            while (millis() - start_time < 1000 || M5.BtnA.isPressed()) {
+            const uint32_t tx_session_start_ms = start_time;
+            const uint16_t tx_seq_start = m_transport->get_seq();
+            size_t preroll_pending = 0;
+            // live chunks after the pre-roll, and whether speech was heard early among them
+            uint32_t vox_live_chunks = 0;
+            bool vox_speech_heard = false;
+            uint32_t synth_samples = 0;
+            if (vox_session) {
+                ++vox_triggers;
+                preroll_pending = from_mic ? vox_preroll.count : 0;
+            }
+            bool lbt_yielded = false;
+            auto keep_transmitting = [&]() -> bool {
+                if (M5.BtnA.isPressed()) {
+                    return true;
+                }
+                if (vox_session && from_mic) {
+                    return preroll_pending > 0 || m_vox_vad->is_active();
+                }
+                return millis() - start_time < 1000;
+            };
+            while (keep_transmitting()) {
+                m_transport->service(millis());
+                apply_latency_profile();
+#if TX_LBT_POLICY == TX_LBT_POLICY_HOLD
+                if (m_transport->get_seq() == tx_seq_start && m_transport->channel_busy(millis())) {
+                    // another station got on air before our first frame
+                    m_transport->discard();
+                    lbt_yielded = true;
+                    Serial.println("LBT: yielded to another station");
+                    break;
+                }
+#endif
                 if (enable_tx_overlay) {
                     uint32_t now = millis();
                     if (now - last_rssi_draw_ms >= 500) {
@@ -1216,49 +1626,152 @@ void Application::loop()
                 }
                 bool ready = false;
                 size_t send_samples = mic_chunk_samples;
-#if AUDIO_DIAG_SOURCE == AUDIO_DIAG_SRC_MIC
-                ready = M5.Mic.record(mic_samples, mic_chunk_samples, SAMPLE_RATE, false);
-#elif AUDIO_DIAG_SOURCE == AUDIO_DIAG_SRC_SILENCE
-                memset(mic_samples, 0, sizeof(int16_t) * mic_chunk_samples);
-                ready = true;
-#elif AUDIO_DIAG_SOURCE == AUDIO_DIAG_SRC_TONE
-                for (size_t i = 0; i < mic_chunk_samples; ++i) {
-                    mic_samples[i] = static_cast<int16_t>(sinf(tone_phase) * tone_amplitude);
-                    tone_phase += tone_phase_step;
-                    if (tone_phase >= two_pi) {
-                        tone_phase -= two_pi;
+                if (!from_mic) {
+                    ready = source->read(mic_samples, mic_chunk_samples);
+                } else if (preroll_pending > 0) {
+                    // pre-roll first; mic DMA keeps filling meanwhile
+                    memset(mic_samples, 0, sizeof(int16_t) * mic_chunk_samples);
+                    vox_preroll.pop(mic_samples, mic_chunk_samples);
+                    preroll_pending = (preroll_pending > mic_chunk_samples) ? (preroll_pending - mic_chunk_samples) : 0;
+                    ready = true;
+                    if (preroll_pending == 0) {
+                        const uint32_t keyup_ms = millis() - vox_trigger_ms;
+                        vox_keyup_ms_total += keyup_ms;
+                        if (keyup_ms > vox_keyup_ms_max) vox_keyup_ms_max = keyup_ms;
+                    }
+                } else {
+                    ready = source->read(mic_samples, mic_chunk_samples);
+                    if (ready) {
+                        TRACE_EVENT(kTraceMicRead, mic_chunk_samples);
+                    }
+                    if (ready && vox_session) {
+                        constexpr uint32_t kChunkMs = (mic_chunk_samples * 1000) / SAMPLE_RATE;
+                        m_vox_vad->process(mic_samples, mic_chunk_samples);
+                        if (m_vox_vad->is_speech() && vox_live_chunks * kChunkMs < VOX_FALSE_TRIGGER_MS) {
+                            vox_speech_heard = true;
+                        }
+                        ++vox_live_chunks;
                     }
                 }
-                ready = true;
-#endif
 
-                if (ready) {
-#if AUDIO_DIAG_SOURCE == AUDIO_DIAG_SRC_MIC
-                    convert_i16_to_u8_tx_compatible(mic_samples, mic_samples_u8, send_samples);
-                    const uint8_t tx_pitch_mode = m_tx_pitch_mode;
-                    apply_tx_pitch_mode_u8_block(tx_pitch_mode, mic_samples_u8, send_samples);
+                if (ready && !from_mic) {
+                    // test signals: plain conversion with nothing adaptive, so runs repeat exactly
                     for (size_t i = 0; i < send_samples; ++i) {
+                        const int v = 128 + ((mic_samples[i] + 128) >> 8);
+                        mic_samples_u8[i] = static_cast<uint8_t>((v > 255) ? 255 : v);
                         m_transport->add_sample_u8(mic_samples_u8[i]);
                     }
-#else
-                    for (size_t i = 0; i < send_samples; ++i) {
-                        m_transport->add_sample(mic_samples[i]);
+                    m_recorder->audio(Recorder::kTx, m_transport->get_node_id(), mic_samples_u8, send_samples);
+                } else if (ready) {
+                    if (!m_noise_suppressor->is_bypassed()) {
+                        const uint32_t c0 = ESP.getCycleCount();
+                        m_noise_suppressor->process_hop(mic_samples);
+                        const uint32_t cycles = ESP.getCycleCount() - c0;
+                        ns_cycles_total += cycles;
+                        if (cycles > ns_cycles_max) ns_cycles_max = cycles;
+                        ++ns_hops;
+                        const uint32_t now_ms = millis();
+                        if (now_ms - last_ns_log_ms >= 1000) {
+                            const uint32_t avg = ns_cycles_total / ns_hops;
+                            Serial.printf("TX NS: avg=%lu max=%lu cycles/hop (budget=%lu%s)\n",
+                                          static_cast<unsigned long>(avg),
+                                          static_cast<unsigned long>(ns_cycles_max),
+                                          static_cast<unsigned long>(TX_NOISE_SUPPRESSOR_CYCLE_BUDGET),
+                                          (ns_cycles_max > TX_NOISE_SUPPRESSOR_CYCLE_BUDGET) ? ", OVER" : "");
+                            ns_cycles_total = 0;
+                            ns_cycles_max = 0;
+                            ns_hops = 0;
+                            last_ns_log_ms = now_ms;
+                        }
+                    }
+                    s_tx_frontend.convert_i16_to_u8(mic_samples, mic_samples_u8, send_samples);
+                    const uint8_t tx_pitch_mode = m_tx_pitch_mode;
+                    s_tx_frontend.apply_pitch_mode(tx_pitch_mode, mic_samples_u8, send_samples);
+                    const bool voiced = m_vad->process(mic_samples, send_samples);
+                    switch (dtx.step(!TX_DTX_ENABLE || voiced, millis())) {
+                    case DtxGate::kSendAudio:
+                        for (size_t i = 0; i < send_samples; ++i) {
+                            m_transport->add_sample_u8(mic_samples_u8[i]);
+                        }
+                        m_recorder->audio(Recorder::kTx, m_transport->get_node_id(), mic_samples_u8, send_samples);
+                        break;
+                    case DtxGate::kFlushAndSendSid:
+                        // push out the speech tail first
+                        m_transport->flush();
+                        m_transport->send_sid(m_vad->get_noise_rms());
+                        break;
+                    case DtxGate::kSendSid:
+                        m_transport->send_sid(m_vad->get_noise_rms());
+                        break;
+                    case DtxGate::kSkip:
+                        break;
                     }
-#endif
                 }
-#if AUDIO_DIAG_SOURCE == AUDIO_DIAG_SRC_MIC
-                vTaskDelay(pdMS_TO_TICKS(1));
-#else
-                vTaskDelay(synth_chunk_delay_ticks);
+                if (!from_mic) {
+                    // pace to the sample clock rather than a fixed delay per chunk
+                    synth_samples += mic_chunk_samples;
+                    const uint32_t due_ms = start_time + static_cast<uint32_t>(
+                        (static_cast<uint64_t>(synth_samples) * 1000) / SAMPLE_RATE);
+                    const int32_t wait_ms = static_cast<int32_t>(due_ms - millis());
+                    vTaskDelay((wait_ms > 0) ? pdMS_TO_TICKS(wait_ms) : 0);
+                } else if (preroll_pending == 0) {
+                    vTaskDelay(pdMS_TO_TICKS(1));
+                }
+            }
+            if (!lbt_yielded) {
+                m_transport->end_talkspurt();
+            }
+            m_transport->set_transmitting(false);
+            m_recorder->talkspurt(Recorder::kTx, m_transport->get_node_id(), false);
+            {
+                const uint32_t tx_ms = millis() - tx_session_start_ms;
+                const uint16_t frames = static_cast<uint16_t>(m_transport->get_seq() - tx_seq_start);
+                Serial.printf("LATENCY TX: profile=%s frame=%u samples, %u frames in %lums (%lu pps)\n",
+                              kLatencyProfiles[applied_profile].name,
+                              static_cast<unsigned>(m_transport->get_frame_samples()),
+                              static_cast<unsigned>(frames),
+                              static_cast<unsigned long>(tx_ms),
+                              static_cast<unsigned long>(tx_ms ? (frames * 1000ul) / tx_ms : 0));
+#if TX_PACER_ENABLE
+                AirtimePacer::Stats pacer;
+                m_transport->snapshot_pacer_stats(pacer);
+                Serial.printf("PACER: frames=%lu delay avg=%luus max=%luus deadline=%lu over_budget=%lu overflow=%lu\n",
+                              static_cast<unsigned long>(pacer.frames),
+                              static_cast<unsigned long>(pacer.frames ? pacer.delay_us_total / pacer.frames : 0),
+                              static_cast<unsigned long>(pacer.delay_us_max),
+                              static_cast<unsigned long>(pacer.deadline_sends),
+                              static_cast<unsigned long>(pacer.over_budget),
+                              static_cast<unsigned long>(pacer.overflows));
 #endif
             }
-            m_transport->flush();
-#if AUDIO_DIAG_SOURCE == AUDIO_DIAG_SRC_MIC
+            if (vox_session) {
+                // keyed up on a click or a burst of noise: nobody went on talking
+                if (from_mic && !vox_speech_heard) {
+                    ++vox_false_triggers;
+                }
+                const uint32_t listen_min = vox_listen_ms / 60000;
+                Serial.printf("VOX: triggers=%lu false=%lu (%lu per hour listening) keyup avg=%lu max=%lu ms\n",
+                              static_cast<unsigned long>(vox_triggers),
+                              static_cast<unsigned long>(vox_false_triggers),
+                              static_cast<unsigned long>(listen_min ? (vox_false_triggers * 60) / listen_min : 0),
+                              static_cast<unsigned long>(vox_keyup_ms_total / vox_triggers),
+                              static_cast<unsigned long>(vox_keyup_ms_max));
+                vox_preroll.count = 0;
+                vox_speech_run = 0;
+            }
+#if TX_DTX_ENABLE
+            if (dtx.voiced_chunks() + dtx.silent_chunks() > 0) {
+                Serial.printf("TX DTX: voiced=%lu silent=%lu chunks, sid=%lu, audio frames saved=%lu%%\n",
+                              static_cast<unsigned long>(dtx.voiced_chunks()),
+                              static_cast<unsigned long>(dtx.silent_chunks()),
+                              static_cast<unsigned long>(dtx.sid_frames()),
+                              static_cast<unsigned long>((dtx.silent_chunks() * 100) / (dtx.voiced_chunks() + dtx.silent_chunks())));
+            }
+#endif
             if (mic_active) {
                 M5.Mic.end();
                 mic_active = false;
             }
-#endif
             if (!spk_active) {
                 M5.Speaker.begin();
                 M5.Speaker.setVolume(m_speaker_volume);
@@ -1318,7 +1831,9 @@ void Application::loop()
             }
         }
 #else
-        while (!M5.BtnA.isPressed()) {
+        while (!M5.BtnA.isPressed() || lbt_holding()) {
+            m_transport->service(millis());
+            apply_latency_profile();
             if (enable_rx_overlay) {
                 uint32_t now = millis();
                 if (now - last_rssi_draw_ms >= 500) {  // lower UI refresh load
@@ -1328,6 +1843,26 @@ void Application::loop()
                 }
             }
 
+            if (m_vox_enabled && m_tx_source == kTxSourceMic) {
+                // Mic and speaker share the codec: the mic only listens once
+                // playback has drained and nothing has arrived for a while.
+                const uint32_t now = millis();
+                if (m_output_buffer->get_available_samples() > 0 || replay_active || m_replay_request != -1) {
+                    rx_last_audio_ms = now;
+                }
+                if (now - rx_last_audio_ms >= VOX_RX_IDLE_MS && (!spk_active || !M5.Speaker.isPlaying())) {
+                    if (vox_listen_step()) {
+                        vox_triggered = true;
+                        vox_trigger_ms = millis();
+                        break;
+                    }
+                    continue;
+                }
+            }
+            if (mic_active) {
+                M5.Mic.end();
+                mic_active = false;
+            }
             if (!spk_active) {
                 M5.Speaker.begin();
                 M5.Speaker.setVolume(m_speaker_volume);
@@ -1339,17 +1874,28 @@ void Application::loop()
             while (queued_now < kRxPrefillChunks) {
                 if (!rx_play_pending) {
                     uint8_t *chunk_ptr = rx_play_buffers[rx_play_buf_index];
-                    m_output_buffer->remove_samples(chunk_ptr, static_cast<int>(kRxPlayChunkBytes));
-                    for (size_t i = 0; i < kRxPlayChunkBytes; ++i) {
+                    if (!fill_from_replay(chunk_ptr, rx_play_chunk_bytes)) {
+                        m_output_buffer->remove_samples(chunk_ptr, static_cast<int>(rx_play_chunk_bytes));
+                    }
+                    for (size_t i = 0; i < rx_play_chunk_bytes; ++i) {
                         const uint8_t v = chunk_ptr[i];
                         if (v < rx_level_min) rx_level_min = v;
                         if (v > rx_level_max) rx_level_max = v;
                     }
                     uint32_t now_ms = millis();
                     if (now_ms - last_rx_level_log_ms >= 1000) {
-                        Serial.printf("RX u8 range: min=%u max=%u\n",
+                        Serial.printf("RX u8 range: min=%u max=%u fill=%d/%d drift=%dppm\n",
                                       static_cast<unsigned>(rx_level_min),
-                                      static_cast<unsigned>(rx_level_max));
+                                      static_cast<unsigned>(rx_level_max),
+                                      m_output_buffer->get_available_samples(),
+                                      m_output_buffer->get_target_buffer_samples(),
+                                      m_output_buffer->get_playout_ppm());
+                        const uint32_t rx_packets = log_link_stats(m_transport, now_ms - last_rx_level_log_ms);
+                        log_latency(kLatencyProfiles[applied_profile], m_transport, m_output_buffer,
+                                    rx_packets, now_ms - last_rx_level_log_ms);
+                        if (m_transport->get_repeater()) {
+                            log_relay_stats(m_transport);
+                        }
                         rx_level_min = 255;
                         rx_level_max = 0;
                         last_rx_level_log_ms = now_ms;
@@ -1359,10 +1905,11 @@ void Application::loop()
                 }
 
                 const bool queued = M5.Speaker.playRaw(
-                    rx_play_pending_ptr, kRxPlayChunkBytes, SAMPLE_RATE, false, 1, 0, false);
+                    rx_play_pending_ptr, rx_play_chunk_bytes, SAMPLE_RATE, false, 1, 0, false);
                 if (!queued) {
                     break;
                 }
+                TRACE_EVENT(kTracePlayRaw, m_output_buffer->get_available_samples());
                 rx_play_pending = false;
                 rx_play_pending_ptr = nullptr;
                 rx_play_buf_index = (rx_play_buf_index + 1) % 3;
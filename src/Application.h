@@ -1,18 +1,35 @@
 #pragma once
 
 #include <cstdint>
+#include "OutputBuffer.h"
 
-class Transport;
-class OutputBuffer;
+class EspNowTransport;
+class NoiseSuppressor;
+class Recorder;
+class ReplayHistory;
+class TxSource;
+class VoiceActivityDetector;
 
 class Application
 {
 private:
-    Transport       *m_transport;
-    OutputBuffer    *m_output_buffer;
+    EspNowTransport *m_transport;
+    RxOutputBuffer  *m_output_buffer;
+    NoiseSuppressor *m_noise_suppressor;
+    VoiceActivityDetector *m_vad;
+    VoiceActivityDetector *m_vox_vad;
+    Recorder        *m_recorder;
+    ReplayHistory   *m_history;
+    volatile bool   m_ns_bypass;        // applied at the next key-up
+    volatile bool   m_vox_enabled;
+    volatile uint8_t m_latency_profile;
     uint16_t        m_channel;
     uint8_t         m_speaker_volume;
     volatile uint8_t m_tx_pitch_mode;
+    volatile bool   m_overlay_hidden;
+    volatile int8_t m_replay_request;   // age to start, kReplayStop, or -1
+    volatile int8_t m_replay_age;       // age being replayed, -1 idle
+    static constexpr int8_t kReplayStop = -2;
 
 public:
     enum : uint8_t {
@@ -20,6 +37,16 @@ public:
         kTxPitchModeM2 = 2,
         kTxPitchModeM3 = 3,
     };
+    // TX sources, same numbers as AUDIO_DIAG_SRC_*
+    static constexpr uint8_t kTxSourceMic = 0;
+    static constexpr uint8_t kTxSourceCount = 9;
+    // setChannel() value that scans all channels
+    static constexpr uint16_t kChannelScan = 0;
+    enum : uint8_t {
+        kLatencyProfileThroughput = 0,
+        kLatencyProfileLow = 1,
+        kLatencyProfileCount,
+    };
 
     Application();
     int16_t getRSSI(void);
@@ -33,4 +60,43 @@ public:
     uint8_t getSpeakerVolume() const;
     void setTxPitchMode(uint8_t mode);
     uint8_t getTxPitchMode() const;
+    void setNoiseSuppressorBypass(bool bypass);
+    bool getNoiseSuppressorBypass() const;
+    void setVoxEnabled(bool enabled);
+    bool getVoxEnabled() const;
+    // takes effect at the next loop iteration
+    void setLatencyProfile(uint8_t profile);
+    uint8_t getLatencyProfile() const;
+    void setRedundancy(bool enable);
+    bool getRedundancy() const;
+    void setRepeater(bool enable);
+    bool getRepeater() const;
+    // priority channel for dual-watch, 0 = off
+    void setDualWatch(uint8_t ch);
+    uint8_t getDualWatch() const;
+    void setTxPowerControl(bool enable);
+    bool getTxPowerControl() const;
+    // stream TX and RX audio to RECORDER_PATH; false if it could not start
+    bool setRecording(bool enable);
+    bool getRecording() const;
+    void logRecorderStats();
+    // play a received talkspurt again, locally; age 0 = newest. Live audio
+    // and PTT take over. False if it is no longer held.
+    bool replay(int age);
+    void stopReplay();
+    int getReplayAge() const;
+    void logReplayHistory();
+    // compare a held talkspurt (age 0 = newest) against a fresh copy of the
+    // test signal the sender used and print "AQ:" lines. Blocks for the analysis.
+    bool measureTalkspurt(uint8_t source, int age);
+    // takes effect at the next key-up
+    void setTxSource(uint8_t source);
+    uint8_t getTxSource() const;
+    const char *getTxSourceName(uint8_t source) const;
+    // another screen owns the display; status/RSSI/TX power draws are skipped
+    void setOverlayHidden(bool hidden);
+
+private:
+    TxSource        *m_tx_sources[kTxSourceCount];
+    volatile uint8_t m_tx_source;
 };
@@ -33,7 +33,71 @@
 // ESP-NOW Long Range mode
 #define ESPNOW_LONG_RANGE
 // ESP-NOW payload magic header text for packet filtering
-#define ESPNOW_PACKET_MAGIC_TEXT  "ESPT1"
+#define ESPNOW_PACKET_MAGIC_TEXT  "ESPT2"
+// RSSI is read from the ESP-NOW receive info on IDF 5. IDF 4 (the shipped
+// espressif32 6.x builds) has no per-packet RSSI in the receive callback, so
+// there the RSSI bar stays empty and link adaptation and TX power control act
+// on loss alone (TX power stays at the top step). 1 enables a promiscuous
+// fallback filtered to ESP-NOW action frames; it runs in the WiFi task for
+// every frame on the channel, compare cb/promisc/wifi_cb in the LINK: log.
+#define ESPNOW_RSSI_PROMISCUOUS_FALLBACK 0
+// Link adaptation: the talker steps through FrameCodec::kModes (16k PCM,
+// 16k ADPCM, 8k ADPCM, 8k ADPCM short frames) from listener loss/RSSI reports.
+// -1 adapts, 0..3 pins the mode.
+#define LINK_ADAPT_FIXED_MODE    -1
+// Redundancy: every audio packet also carries the previous frame as 8 kHz
+// ADPCM so a single lost frame can be recovered (shrinks 16 kHz PCM frames to
+// fit). Switchable at runtime.
+#define TX_REDUNDANCY_ENABLE      0
+// Airtime pacer: audio frames leave at an even cadence (at most one frame of
+// added delay) within TX_PACER_AIRTIME_PERMILLE of the channel time.
+// TX_PACER_PHY_KBPS is the assumed PHY rate for the airtime estimate.
+#define TX_PACER_ENABLE           1
+#define TX_PACER_AIRTIME_PERMILLE 500
+#ifdef ESPNOW_LONG_RANGE
+#define TX_PACER_PHY_KBPS         500
+#else
+#define TX_PACER_PHY_KBPS         1000
+#endif
+// Repeater: re-broadcast other nodes' frames once each (duplicates are
+// suppressed by origin and sequence) while their hop budget lasts. Every frame
+// leaves with REPEATER_HOP_LIMIT hops. REPEATER_CHANNEL 0 relays on our own
+// channel; 1-13 relays there instead (one-way: nothing is heard on it).
+// Switchable at runtime.
+#define REPEATER_ENABLE           0
+#define REPEATER_HOP_LIMIT        2
+#define REPEATER_CHANNEL          0
+// Listen before talk: the channel is busy while another station's frames keep
+// arriving. OFF ignores it, WARN keys up anyway and shows "TX Busy", HOLD keeps
+// PTT from keying up until the channel is free and gives way if another station
+// gets on air before our first frame. With HOLD, key-up waits a random
+// 0..TX_LBT_BACKOFF_MAX_MS first.
+#define TX_LBT_POLICY_OFF         0
+#define TX_LBT_POLICY_WARN        1
+#define TX_LBT_POLICY_HOLD        2
+#define TX_LBT_POLICY             TX_LBT_POLICY_WARN
+#define TX_LBT_BACKOFF_MAX_MS     30
+// Transmit power control: the talker lowers esp_wifi_set_max_tx_power (0.25 dBm
+// units) until the worst listener's reported RSSI sits near
+// TX_POWER_TARGET_RSSI, kept above the RSSI link adaptation needs for full-rate
+// PCM, and steps back up at once on loss. Switchable at runtime.
+#define TX_POWER_CONTROL_ENABLE   1
+#define TX_POWER_MIN_QDBM         8     // 2 dBm
+#define TX_POWER_MAX_QDBM         84    // 21 dBm
+#define TX_POWER_TARGET_RSSI      -70
+
+// Event trace ring along the TX/RX audio paths ("trace dump" on serial).
+// 0 compiles the trace points out.
+#define TRACE_ENABLE              1
+
+// System monitor: core load, per-task stack high-water and heap figures every
+// SYSMON_INTERVAL_MS on serial ("SYSMON:" lines) and on the diagnostics screen
+// (BtnB hold past Mode). Without FreeRTOS run-time stats the load comes from
+// idle hooks that keep both idle tasks spinning instead of sleeping in waiti,
+// so it is off by default on this battery handheld; "sysmon on|off" switches
+// it at runtime for a measurement.
+#define SYSMON_ENABLE             0
+#define SYSMON_INTERVAL_MS        5000
 
 // Which channel is the I2S microphone on? I2S_CHANNEL_FMT_ONLY_LEFT or I2S_CHANNEL_FMT_ONLY_RIGHT
 // Generally they will default to LEFT - but you may need to attach the L/R pin to GND
@@ -51,12 +115,40 @@
 
 // On which wifi channel (1-11) should ESP-Now transmit? The default ESP-Now channel on ESP32 is channel 1
 #define ESP_NOW_WIFI_CHANNEL    1
+// Channel scan (channel "SCAN" in the UI): dwell SCAN_DWELL_MS on each channel
+// looking for ESPTalkie frames, lock on speech and resume once the channel
+// has been quiet for SCAN_RESUME_IDLE_MS.
+#define SCAN_DWELL_MS           120
+#define SCAN_RESUME_IDLE_MS     3000
+// Dual-watch: every DUAL_WATCH_INTERVAL_MS listen DUAL_WATCH_LISTEN_MS on the
+// priority channel (0 = off) and switch to it on traffic until it has been
+// quiet for DUAL_WATCH_RESUME_IDLE_MS. Each visit is a short receive gap on
+// the main channel, concealed by the jitter buffer. Switchable at runtime.
+#define DUAL_WATCH_PRIORITY_CHANNEL  0
+#define DUAL_WATCH_INTERVAL_MS       1000
+#define DUAL_WATCH_LISTEN_MS         30
+#define DUAL_WATCH_RESUME_IDLE_MS    3000
 
-// Audio diagnostic source selector
-#define AUDIO_DIAG_SRC_MIC      0
-#define AUDIO_DIAG_SRC_SILENCE  1
-#define AUDIO_DIAG_SRC_TONE     2
-#define AUDIO_DIAG_SOURCE       AUDIO_DIAG_SRC_MIC
+// TX audio source at boot; switchable at runtime ("txsrc <name>" on serial,
+// not saved). The test signals bypass noise suppression, pitch effect and
+// DTX so every run sends the same audio.
+#define AUDIO_DIAG_SRC_MIC        0
+#define AUDIO_DIAG_SRC_SILENCE    1
+#define AUDIO_DIAG_SRC_TONE       2
+#define AUDIO_DIAG_SRC_MULTITONE  3
+#define AUDIO_DIAG_SRC_SWEEP      4
+#define AUDIO_DIAG_SRC_WHITE      5
+#define AUDIO_DIAG_SRC_PINK       6
+#define AUDIO_DIAG_SRC_MLS        7
+#define AUDIO_DIAG_SRC_WAV        8     // TEST_SIGNAL_WAV_PATH on SPIFFS, looped
+#define AUDIO_DIAG_SOURCE         AUDIO_DIAG_SRC_MIC
+#define TEST_SIGNAL_LEVEL         12000 // peak, int16 units (about -9 dBFS)
+#define TEST_SIGNAL_TONE_HZ       1000
+#define TEST_SIGNAL_MULTITONE_HZ  300, 1000, 3100
+#define TEST_SIGNAL_SWEEP_START_HZ 100
+#define TEST_SIGNAL_SWEEP_END_HZ  7000
+#define TEST_SIGNAL_SWEEP_MS      5000
+#define TEST_SIGNAL_WAV_PATH      "/test.wav"
 
 // Transmit pitch effect mode
 #define TX_PITCH_MODE_NONE               0
@@ -89,6 +181,21 @@
 // RX playback chunk size (samples). Larger value reduces task wakeups but adds latency.
 #define RX_PLAY_CHUNK_SAMPLES 320
 
+// Latency profile at boot (switchable at runtime):
+// 0 = throughput (full-size frames, 120ms jitter target, RX_PLAY_CHUNK_SAMPLES chunks)
+// 1 = low latency (short frames, small jitter target and playout chunks)
+// Mouth to ear, as the LATENCY: log adds it up (capture 8 + frame + jitter
+// target + two play chunks): throughput ~183ms, low ~59ms (+8ms with the
+// noise suppressor). A lost frame holds the ones behind it for the reorder
+// hold plus up to one RX loop pass (one play chunk), which comes out of the
+// jitter target: 30+20ms of 120ms, and 5+8ms of 30ms in the low profile
+// (there a frame more than one frame late is concealed instead).
+#define LATENCY_PROFILE                  0
+#define LOW_LATENCY_FRAME_MS             5
+#define LOW_LATENCY_JITTER_MS            30
+#define LOW_LATENCY_PLAY_CHUNK_SAMPLES   128
+#define LOW_LATENCY_REORDER_HOLD_MS      5
+
 // Test mode audio path selector
 #define PTT_TEST_AUDIO_PATH_16BIT        0
 #define PTT_TEST_AUDIO_PATH_8BIT_LINEAR  1
@@ -98,6 +205,60 @@
 // 8-bit linear quantization compressor switch (used by conversion function)
 #define TX_8BIT_COMPRESSOR_ENABLE 0
 
+// TX spectral noise suppressor on mic audio (before 8-bit quantization).
+// 0 starts bypassed; "ns on|off" on the serial console switches it (saved).
+// tools/ns_wav.cpp runs it over a WAV on a host.
+#define TX_NOISE_SUPPRESSOR_ENABLE        1
+// CPU budget per 128-sample hop (8ms) in cycles: ~15% of one core @240MHz
+#define TX_NOISE_SUPPRESSOR_CYCLE_BUDGET  288000
+
+// Discontinuous transmission: while the VAD reports silence no audio frames are
+// sent, only a small silence descriptor (SID) every TX_DTX_SID_INTERVAL_MS so
+// receivers can play matching comfort noise.
+#define TX_DTX_ENABLE             1
+#define TX_DTX_SID_INTERVAL_MS    160
+#define TX_VAD_HANGOVER_MS        240
+
+// Voice-operated transmit (VOX). While receive is idle the mic keeps running
+// and a VAD keys up on speech; the last VOX_PREROLL_MS of audio (kept in PSRAM)
+// is sent ahead of live audio. "vox on|off" on the serial console switches
+// it at runtime (saved).
+#define VOX_MODE_ENABLE           0
+#define VOX_PREROLL_MS            200
+#define VOX_HANG_TIME_MS          1200
+#define VOX_TRIGGER_CHUNKS        3     // consecutive 8ms speech chunks to key up
+#define VOX_FALSE_TRIGGER_MS      300   // no speech this soon after the pre-roll: false trigger
+#define VOX_RX_IDLE_MS            500   // receive silence before the mic takes over
+
+// Recorder: TX and RX audio streamed to RECORDER_PATH on the SPIFFS data
+// partition ("rec start|stop|stats" on serial, tools/rec_to_wav.py to listen).
+// The ring holds RECORDER_RING_BLOCKS x 4 KB in PSRAM (about 250 ms of audio
+// each); blocks are dropped only when flash falls a whole ring behind.
+// The default 8 MB partition table leaves room for roughly 80 s.
+#define RECORDER_RING_BLOCKS      32
+#define RECORDER_PATH             "/rec.bin"
+
+// Replay: the last received talkspurts stay in PSRAM (REPLAY_HISTORY_BYTES,
+// 8 bit at SAMPLE_RATE: 4 MB is about 4.4 minutes, at most 64 talkspurts).
+// BtnB click replays the newest locally, each further click during replay
+// goes one older; also "replay <n>|stop|list" on serial.
+#define REPLAY_HISTORY_BYTES      (4 * 1024 * 1024)
+
+// Audio quality: "aq <txsrc> [n]" compares held talkspurt n against the test
+// signal the sender used (frequency response, THD+N, SNR, delay). At most
+// AQ_MAX_SAMPLES are analysed; tools/audio_quality.cpp does the same on a host.
+#define AQ_MAX_SAMPLES            (5 * SAMPLE_RATE)
+
+// Audio buffer arena, reserved once at boot (memory map on serial, "ARENA:").
+// Internal: TX frame, OutputBuffer, mic and play chunks. PSRAM: VOX pre-roll,
+// the recorder ring, the replay history and the buffers of the diagnostic modes
+// that are switched on. A buffer that does not fit falls back to the heap.
+#define AUDIO_ARENA_INTERNAL_BYTES  (12 * 1024)
+#define AUDIO_ARENA_PSRAM_BYTES     (256 + VOX_PREROLL_MS * (SAMPLE_RATE / 1000) * 2 + \
+                                     RECORDER_RING_BLOCKS * 4096 + REPLAY_HISTORY_BYTES + \
+                                     (RX_RAM_BUFFERED_PLAYBACK_MODE ? SAMPLE_RATE * RX_RAM_BUFFERED_SECONDS : 0) + \
+                                     (PTT_LOCAL_PLAYBACK_TEST_MODE ? SAMPLE_RATE * 5 * 3 : 0))
+
 // Horizontal shake to change current setting (same effect as BtnB click)
 #define SHAKE_SWITCH_ENABLED     1
 #define SHAKE_SENSITIVITY_LOW    1
@@ -6,9 +6,12 @@
 #include <M5Unified.h>
 #include <Preferences.h>
 #include <math.h>
+#include <string.h>
 
 #include "Application.h"
 #include "DisplaySync.h"
+#include "SystemMonitor.h"
+#include "Trace.h"
 #include "UiLayout.h"
 #include "config.h"
 
@@ -23,6 +26,7 @@ enum class EditMode : uint8_t {
     Volume = 1,
     Channel = 2,
     Mode = 3,
+    Diag = 4,
 };
 EditMode edit_mode = EditMode::None;
 uint32_t mode_selected_at_ms = 0;
@@ -34,6 +38,7 @@ constexpr uint8_t kVolumeTable[5] = { 80, 120, 160, 208, 255 };
 constexpr bool kMatchTestModeSpeakerGain = false;
 constexpr uint8_t kTestLikeSpeakerGain = 255;
 Preferences prefs;
+SystemMonitor monitor(SYSMON_INTERVAL_MS);
 #if TALKIE_TARGET_M5ATOMS3_ECHO_BASE
 constexpr int kDefaultVolumeLevel = 1;
 #else
@@ -159,8 +164,14 @@ void draw_channel()
     M5.Display.setFont(kUiLayout.channel_compact_font ? &fonts::Font6 : &fonts::Font7);
 #endif
     M5.Display.setTextSize(1);
-    char ch_text[4];
-    snprintf(ch_text, sizeof(ch_text), "%02d", channel);
+    char ch_text[5];
+    if (channel == Application::kChannelScan) {
+        // the 7-segment fonts have no letters
+        M5.Display.setFont(&fonts::Font4);
+        snprintf(ch_text, sizeof(ch_text), "SCAN");
+    } else {
+        snprintf(ch_text, sizeof(ch_text), "%02d", channel);
+    }
 #if TALKIE_TARGET_M5ATOMS3_ECHO_BASE
     const int channel_value_y = kUiLayout.channel_y + kUiLayout.channel_value_y - 13;
 #else
@@ -257,6 +268,99 @@ void draw_layout()
     display_unlock();
 }
 
+void draw_diagnostics()
+{
+    display_lock();
+    const uint16_t bg = M5.Display.color565(10, 18, 36);
+    const uint16_t text = TFT_WHITE;
+    const uint16_t warn = TFT_ORANGE;
+    constexpr int kLineH = 10;
+    constexpr uint32_t kLowStackBytes = 1024;
+
+    M5.Display.fillScreen(bg);
+    M5.Display.setFont(&fonts::Font0);
+    M5.Display.setTextSize(1);
+    M5.Display.setTextDatum(top_left);
+    M5.Display.setTextColor(TFT_GREEN, bg);
+    int y = 2;
+    M5.Display.drawString("DIAGNOSTICS", 2, y);
+    y += kLineH + 2;
+    if (!monitor.running()) {
+        M5.Display.setTextColor(text, bg);
+        M5.Display.drawString("sysmon off", 2, y);
+        display_unlock();
+        return;
+    }
+
+    const SystemMonitor::Snapshot &s = monitor.snapshot();
+    char line[48];
+    M5.Display.setTextColor(text, bg);
+    int n = snprintf(line, sizeof(line), "CPU");
+    for (int core = 0; core < SystemMonitor::kCores; ++core) {
+        n += snprintf(line + n, sizeof(line) - n, " %u%%", static_cast<unsigned>(s.core_load[core]));
+    }
+    M5.Display.drawString(line, 2, y);
+    y += kLineH;
+    snprintf(line, sizeof(line), "INT %luk big %luk f%u%%",
+             static_cast<unsigned long>(s.internal.free / 1024),
+             static_cast<unsigned long>(s.internal.largest_block / 1024),
+             static_cast<unsigned>(s.internal.fragmentation));
+    M5.Display.drawString(line, 2, y);
+    y += kLineH;
+    if (s.have_psram) {
+        snprintf(line, sizeof(line), "PSR %luk big %luk f%u%%",
+                 static_cast<unsigned long>(s.psram.free / 1024),
+                 static_cast<unsigned long>(s.psram.largest_block / 1024),
+                 static_cast<unsigned>(s.psram.fragmentation));
+        M5.Display.drawString(line, 2, y);
+        y += kLineH;
+    }
+    y += 2;
+
+    // tasks, least stack headroom first
+    bool shown[SystemMonitor::kMaxTasks] = {};
+    while (y + kLineH <= M5.Display.height()) {
+        int pick = -1;
+        for (int i = 0; i < s.task_count; ++i) {
+            if (!shown[i] && (pick < 0 || s.tasks[i].stack_free < s.tasks[pick].stack_free)) {
+                pick = i;
+            }
+        }
+        if (pick < 0) {
+            break;
+        }
+        shown[pick] = true;
+        const SystemMonitor::TaskInfo &t = s.tasks[pick];
+        if (t.cpu_percent != SystemMonitor::kCpuUnknown) {
+            snprintf(line, sizeof(line), "%-10.10s %5lu %2u%%", t.name,
+                     static_cast<unsigned long>(t.stack_free), static_cast<unsigned>(t.cpu_percent));
+        } else {
+            snprintf(line, sizeof(line), "%-10.10s %5lu", t.name, static_cast<unsigned long>(t.stack_free));
+        }
+        M5.Display.setTextColor((t.stack_free < kLowStackBytes) ? warn : text, bg);
+        M5.Display.drawString(line, 2, y);
+        y += kLineH;
+    }
+    display_unlock();
+}
+
+// leaves the diagnostics screen for the normal layout
+void close_diagnostics()
+{
+    application->setOverlayHidden(false);
+    draw_layout();
+    application->dispStatus(false);
+}
+
+// BtnB click: replay the newest received talkspurt, one older per click while replaying
+void replay_older()
+{
+    const int age = application->getReplayAge() + 1;
+    if (!application->replay(age)) {
+        application->stopReplay();
+    }
+}
+
 uint8_t current_speaker_gain()
 {
     if (kMatchTestModeSpeakerGain) {
@@ -265,6 +369,134 @@ uint8_t current_speaker_gain()
     return kVolumeTable[volume_level - 1];
 }
 
+// Line-based serial commands for settings that have no UI control.
+void handle_serial_command(const char *line)
+{
+    if (strcmp(line, "latency low") == 0 || strcmp(line, "latency throughput") == 0) {
+        const uint8_t profile = (strcmp(line, "latency low") == 0)
+            ? Application::kLatencyProfileLow
+            : Application::kLatencyProfileThroughput;
+        application->setLatencyProfile(profile);
+        prefs.putInt("latency", profile);
+    } else if (strcmp(line, "redundancy on") == 0 || strcmp(line, "redundancy off") == 0) {
+        const bool enable = (strcmp(line, "redundancy on") == 0);
+        application->setRedundancy(enable);
+        prefs.putBool("redundancy", enable);
+        Serial.printf("Redundancy %s\n", enable ? "on" : "off");
+    } else if (strcmp(line, "repeater on") == 0 || strcmp(line, "repeater off") == 0) {
+        const bool enable = (strcmp(line, "repeater on") == 0);
+        application->setRepeater(enable);
+        prefs.putBool("repeater", enable);
+        Serial.printf("Repeater %s\n", enable ? "on" : "off");
+    } else if (strcmp(line, "ns on") == 0 || strcmp(line, "ns off") == 0) {
+        // takes effect at the next key-up
+        const bool enable = (strcmp(line, "ns on") == 0);
+        application->setNoiseSuppressorBypass(!enable);
+        prefs.putBool("ns", enable);
+        Serial.printf("Noise suppressor %s\n", enable ? "on" : "off");
+    } else if (strcmp(line, "vox on") == 0 || strcmp(line, "vox off") == 0) {
+        const bool enable = (strcmp(line, "vox on") == 0);
+        application->setVoxEnabled(enable);
+        prefs.putBool("vox", enable);
+        Serial.printf("VOX %s\n", enable ? "on" : "off");
+    } else if (strncmp(line, "watch ", 6) == 0) {
+        // priority channel 1-13, "off" (or anything else) disables
+        const int ch = atoi(line + 6);
+        const uint8_t watch = (ch >= 1 && ch <= 13) ? static_cast<uint8_t>(ch) : 0;
+        application->setDualWatch(watch);
+        prefs.putInt("watch", watch);
+        if (watch) {
+            Serial.printf("Dual-watch on ch %u\n", watch);
+        } else {
+            Serial.println("Dual-watch off");
+        }
+    } else if (strcmp(line, "txpower auto") == 0 || strcmp(line, "txpower max") == 0) {
+        const bool enable = (strcmp(line, "txpower auto") == 0);
+        application->setTxPowerControl(enable);
+        prefs.putBool("txpower", enable);
+        Serial.printf("TX power %s\n", enable ? "auto" : "max");
+    } else if (strcmp(line, "trace dump") == 0) {
+        Trace::dump();
+    } else if (strcmp(line, "trace on") == 0 || strcmp(line, "trace off") == 0) {
+        Trace::set_enabled(strcmp(line, "trace on") == 0);
+        Serial.printf("Trace %s\n", Trace::get_enabled() ? "on" : "off");
+    } else if (strcmp(line, "trace bench") == 0) {
+        Serial.printf("Trace overhead: %lu cycles/event recording, %lu when off\n",
+                      static_cast<unsigned long>(Trace::measure_overhead_cycles(true)),
+                      static_cast<unsigned long>(Trace::measure_overhead_cycles(false)));
+    } else if (strcmp(line, "sysmon on") == 0 || strcmp(line, "sysmon off") == 0) {
+        if (strcmp(line, "sysmon on") == 0) {
+            monitor.begin();
+        } else {
+            monitor.end();
+        }
+        Serial.printf("Sysmon %s\n", monitor.running() ? "on" : "off");
+    } else if (strncmp(line, "txsrc ", 6) == 0) {
+        uint8_t source = 0;
+        while (source < Application::kTxSourceCount &&
+               strcmp(line + 6, application->getTxSourceName(source)) != 0) {
+            ++source;
+        }
+        if (source < Application::kTxSourceCount) {
+            application->setTxSource(source);
+        } else {
+            Serial.print("TX sources:");
+            for (uint8_t i = 0; i < Application::kTxSourceCount; ++i) {
+                Serial.printf(" %s", application->getTxSourceName(i));
+            }
+            Serial.println();
+        }
+    } else if (strcmp(line, "replay list") == 0) {
+        application->logReplayHistory();
+    } else if (strcmp(line, "replay stop") == 0) {
+        application->stopReplay();
+    } else if (strncmp(line, "replay ", 7) == 0) {
+        // 1 = newest
+        const int n = atoi(line + 7);
+        if (n < 1 || !application->replay(n - 1)) {
+            Serial.printf("Replay %d: not held\n", n);
+        }
+    } else if (strncmp(line, "aq ", 3) == 0) {
+        // aq <txsrc> [n], n: 1 = newest talkspurt
+        char name[16] = {};
+        int n = 1;
+        sscanf(line + 3, "%15s %d", name, &n);
+        uint8_t source = 0;
+        while (source < Application::kTxSourceCount && strcmp(name, application->getTxSourceName(source)) != 0) {
+            ++source;
+        }
+        application->measureTalkspurt(source, n - 1);
+    } else if (strcmp(line, "rec start") == 0) {
+        application->setRecording(true);
+    } else if (strcmp(line, "rec stop") == 0) {
+        // the file is closed (and a REC: line printed) once the ring drains
+        application->setRecording(false);
+    } else if (strcmp(line, "rec stats") == 0) {
+        application->logRecorderStats();
+    } else if (line[0] != '\0') {
+        Serial.printf("Unknown command: %s (latency low|throughput, redundancy on|off, repeater on|off, "
+                      "ns on|off, vox on|off, watch <ch>|off, txpower auto|max, trace dump|on|off|bench, "
+                      "sysmon on|off, rec start|stop|stats, replay <n>|stop|list, txsrc <name>, aq <txsrc> [n])\n",
+                      line);
+    }
+}
+
+void poll_serial_commands()
+{
+    static char line[48];
+    static size_t len = 0;
+    while (Serial.available() > 0) {
+        const int c = Serial.read();
+        if (c == '\r' || c == '\n') {
+            line[len] = '\0';
+            handle_serial_command(line);
+            len = 0;
+        } else if (len + 1 < sizeof(line)) {
+            line[len++] = static_cast<char>(c);
+        }
+    }
+}
+
 }  // namespace
 
 void setup()
@@ -283,7 +515,7 @@ void setup()
 
     prefs.begin("esptalkie", false);
     channel = prefs.getInt("channel", 1);
-    if (channel < 1 || channel > 13) channel = 1;
+    if (channel < 0 || channel > 13) channel = 1;
     volume_level = prefs.getInt("volume", kDefaultVolumeLevel);
     if (volume_level < 1 || volume_level > 5) volume_level = 3;
 #if PTT_LOCAL_PLAYBACK_TEST_MODE
@@ -310,12 +542,22 @@ void setup()
     application->setChannel(static_cast<uint16_t>(channel));
     application->setSpeakerVolume(current_speaker_gain());
     application->setTxPitchMode(tx_pitch_mode);
+    application->setLatencyProfile(static_cast<uint8_t>(prefs.getInt("latency", LATENCY_PROFILE)));
+    application->setRedundancy(prefs.getBool("redundancy", TX_REDUNDANCY_ENABLE));
+    application->setRepeater(prefs.getBool("repeater", REPEATER_ENABLE));
+    application->setNoiseSuppressorBypass(!prefs.getBool("ns", TX_NOISE_SUPPRESSOR_ENABLE));
+    application->setVoxEnabled(prefs.getBool("vox", VOX_MODE_ENABLE));
+    application->setDualWatch(static_cast<uint8_t>(prefs.getInt("watch", DUAL_WATCH_PRIORITY_CHANNEL)));
+    application->setTxPowerControl(prefs.getBool("txpower", TX_POWER_CONTROL_ENABLE));
     Serial.printf("VOL level=%d mapped=%u applied=%u\n",
                   volume_level,
                   static_cast<unsigned>(current_speaker_gain()),
                   static_cast<unsigned>(application->getSpeakerVolume()));
     mode_selected_at_ms = millis();
     application->begin();
+    if (SYSMON_ENABLE) {
+        monitor.begin();
+    }
 #if !PTT_LOCAL_PLAYBACK_TEST_MODE
     application->dispStatus(false);
 #endif
@@ -326,12 +568,19 @@ void setup()
 void loop()
 {
     M5.update();
+    poll_serial_commands();
+    if (monitor.update(millis())) {
+        monitor.log();
+        if (edit_mode == EditMode::Diag) {
+            draw_diagnostics();
+        }
+    }
 #if PTT_LOCAL_PLAYBACK_TEST_MODE
     vTaskDelay(pdMS_TO_TICKS(5));
     return;
 #endif
     const ShakeAction shake_action = detect_shake_action();
-    if (edit_mode != EditMode::None &&
+    if (edit_mode != EditMode::None && edit_mode != EditMode::Diag &&
         (millis() - mode_selected_at_ms >= kModeAutoClearMs)) {
         edit_mode = EditMode::None;
         draw_channel();
@@ -345,15 +594,23 @@ void loop()
             edit_mode = EditMode::Channel;
         } else if (edit_mode == EditMode::Channel) {
             edit_mode = EditMode::Mode;
+        } else if (edit_mode == EditMode::Mode) {
+            edit_mode = EditMode::Diag;
+            application->setOverlayHidden(true);
+            draw_diagnostics();
         } else {
             edit_mode = EditMode::Volume;
+            close_diagnostics();
         }
         mode_selected_at_ms = millis();
-        draw_channel();
-        draw_volume();
+        if (edit_mode != EditMode::Diag) {
+            draw_channel();
+            draw_volume();
+        }
     } else {
         int delta = 0;
-        if (M5.BtnB.wasClicked()) {
+        const bool clicked = M5.BtnB.wasClicked();
+        if (clicked) {
             delta = +1;
         } else if (shake_action == ShakeAction::Increase) {
             delta = +1;
@@ -365,18 +622,25 @@ void loop()
             return;
         }
         if (edit_mode == EditMode::None) {
+            if (clicked) {
+                replay_older();
+            }
             vTaskDelay(pdMS_TO_TICKS(5));
             return;
         }
 
-        if (edit_mode == EditMode::Volume) {
+        if (edit_mode == EditMode::Diag) {
+            edit_mode = EditMode::None;
+            close_diagnostics();
+        } else if (edit_mode == EditMode::Volume) {
             volume_level = wrapped_step(volume_level, 1, 5, delta);
             application->setSpeakerVolume(current_speaker_gain());
             prefs.putInt("volume", volume_level);
             mode_selected_at_ms = millis();
             draw_volume();
         } else if (edit_mode == EditMode::Channel) {
-            channel = wrapped_step(channel, 1, 13, delta);
+            // 0 = scan
+            channel = wrapped_step(channel, 0, 13, delta);
             application->setChannel(static_cast<uint16_t>(channel));
             prefs.putInt("channel", channel);
             mode_selected_at_ms = millis();
@@ -0,0 +1,403 @@
+#include <stdarg.h>
+#include <Arduino.h>
+#include <SPIFFS.h>
+#include <WiFi.h>
+#include <esp_heap_caps.h>
+#include <esp_now.h>
+#include <esp_timer.h>
+#include <esp_wifi.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <sys/stat.h>
+#include "host_platform.h"
+
+HostSerial Serial;
+HostEsp ESP;
+HostWiFi WiFi;
+fs::FS SPIFFS;
+
+static int64_t s_time_us = 1000000;
+static host_send_hook_t s_send_hook = nullptr;
+static host_serial_hook_t s_serial_hook = nullptr;
+static uint8_t s_channel = 1;
+
+struct esp_timer
+{
+  esp_timer_cb_t callback;
+  void *arg;
+  int64_t due_us;
+  uint64_t period_us;
+  bool active;
+  esp_timer *next;
+};
+static esp_timer *s_timers = nullptr;
+
+void host_set_time_us(int64_t t_us)
+{
+  s_time_us = t_us;
+}
+
+void host_advance_us(int64_t dt_us)
+{
+  const int64_t end = s_time_us + dt_us;
+  for (;;) {
+    esp_timer *due = nullptr;
+    for (esp_timer *t = s_timers; t; t = t->next) {
+      if (t->active && t->due_us <= end && (!due || t->due_us < due->due_us)) {
+        due = t;
+      }
+    }
+    if (!due) {
+      break;
+    }
+    if (due->due_us > s_time_us) {
+      s_time_us = due->due_us;
+    }
+    if (due->period_us) {
+      due->due_us += due->period_us;
+    } else {
+      due->active = false;
+    }
+    due->callback(due->arg);
+  }
+  s_time_us = end;
+}
+
+void host_set_esp_now_send_hook(host_send_hook_t hook)
+{
+  s_send_hook = hook;
+}
+
+void host_set_serial_hook(host_serial_hook_t hook)
+{
+  s_serial_hook = hook;
+}
+
+uint8_t host_wifi_channel()
+{
+  return s_channel;
+}
+
+uint32_t millis()
+{
+  return static_cast<uint32_t>(s_time_us / 1000);
+}
+
+uint32_t micros()
+{
+  return static_cast<uint32_t>(s_time_us);
+}
+
+void delay(uint32_t ms)
+{
+  host_advance_ms(ms);
+}
+
+long random(long max)
+{
+  return (max > 0) ? rand() % max : 0;
+}
+
+long random(long min, long max)
+{
+  return (max > min) ? min + rand() % (max - min) : min;
+}
+
+const char *esp_err_to_name(esp_err_t err)
+{
+  return (err == ESP_OK) ? "ESP_OK" : "ESP_FAIL";
+}
+
+int HostSerial::printf(const char *format, ...)
+{
+  const bool verbose = getenv("HOST_VERBOSE") != nullptr;
+  if (!verbose && !s_serial_hook) {
+    return 0;
+  }
+  char text[512];
+  va_list args;
+  va_start(args, format);
+  const int n = vsnprintf(text, sizeof(text), format, args);
+  va_end(args);
+  if (n < 0) {
+    return n;
+  }
+  const size_t len = (static_cast<size_t>(n) < sizeof(text)) ? static_cast<size_t>(n) : sizeof(text) - 1;
+  if (s_serial_hook) {
+    s_serial_hook(text, len);
+  }
+  if (verbose) {
+    fwrite(text, 1, len, stdout);
+  }
+  return n;
+}
+
+size_t HostSerial::print(const char *s)
+{
+  return static_cast<size_t>(printf("%s", s));
+}
+
+size_t HostSerial::println(const char *s)
+{
+  return static_cast<size_t>(printf("%s\n", s));
+}
+
+uint32_t HostEsp::getCycleCount()
+{
+  return static_cast<uint32_t>(s_time_us * 240);
+}
+
+size_t fs::File::size()
+{
+  if (!m_file) {
+    return 0;
+  }
+  const long pos = ftell(m_file);
+  fseek(m_file, 0, SEEK_END);
+  const long end = ftell(m_file);
+  fseek(m_file, pos, SEEK_SET);
+  return static_cast<size_t>(end);
+}
+
+fs::File fs::FS::open(const char *path, const char *mode)
+{
+  // "/x" is the root of the flash file system: keep it in the working directory
+  const char *local = (path[0] == '/') ? path + 1 : path;
+  const char *stdio_mode = (strcmp(mode, FILE_WRITE) == 0) ? "wb" : (strcmp(mode, FILE_APPEND) == 0) ? "ab" : "rb";
+  return fs::File(fopen(local, stdio_mode));
+}
+
+bool fs::FS::exists(const char *path)
+{
+  struct stat st;
+  return stat((path[0] == '/') ? path + 1 : path, &st) == 0;
+}
+
+bool fs::FS::remove(const char *path)
+{
+  return ::remove((path[0] == '/') ? path + 1 : path) == 0;
+}
+
+void *heap_caps_malloc(size_t size, uint32_t)
+{
+  return malloc(size);
+}
+
+void *heap_caps_aligned_alloc(size_t alignment, size_t size, uint32_t)
+{
+  return aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+}
+
+void heap_caps_free(void *p)
+{
+  free(p);
+}
+
+size_t heap_caps_get_free_size(uint32_t)
+{
+  return 0;
+}
+
+size_t heap_caps_get_largest_free_block(uint32_t)
+{
+  return 0;
+}
+
+size_t heap_caps_get_minimum_free_size(uint32_t)
+{
+  return 0;
+}
+
+size_t heap_caps_get_total_size(uint32_t)
+{
+  return 0;
+}
+
+esp_err_t esp_now_init()
+{
+  return ESP_OK;
+}
+
+esp_err_t esp_now_register_recv_cb(esp_now_recv_cb_t)
+{
+  return ESP_OK;
+}
+
+esp_err_t esp_now_register_send_cb(esp_now_send_cb_t)
+{
+  return ESP_OK;
+}
+
+esp_err_t esp_now_add_peer(const esp_now_peer_info_t *)
+{
+  return ESP_OK;
+}
+
+bool esp_now_is_peer_exist(const uint8_t *)
+{
+  return true;
+}
+
+esp_err_t esp_now_send(const uint8_t *mac, const uint8_t *data, size_t len)
+{
+  if (s_send_hook) {
+    s_send_hook(mac, data, len);
+  }
+  return ESP_OK;
+}
+
+int64_t esp_timer_get_time()
+{
+  return s_time_us;
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *out)
+{
+  esp_timer *t = new esp_timer{ args->callback, args->arg, 0, 0, false, s_timers };
+  s_timers = t;
+  *out = t;
+  return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us)
+{
+  timer->due_us = s_time_us + static_cast<int64_t>(timeout_us);
+  timer->period_us = 0;
+  timer->active = true;
+  return ESP_OK;
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period_us)
+{
+  timer->due_us = s_time_us + static_cast<int64_t>(period_us);
+  timer->period_us = period_us;
+  timer->active = true;
+  return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer)
+{
+  const bool was_active = timer->active;
+  timer->active = false;
+  return was_active ? ESP_OK : ESP_FAIL;
+}
+
+bool esp_timer_is_active(esp_timer_handle_t timer)
+{
+  return timer->active;
+}
+
+esp_err_t esp_wifi_set_promiscuous(bool)
+{
+  return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_promiscuous_rx_cb(wifi_promiscuous_cb_t)
+{
+  return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_promiscuous_filter(const wifi_promiscuous_filter_t *)
+{
+  return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_channel(uint8_t primary, wifi_second_chan_t)
+{
+  s_channel = primary;
+  return ESP_OK;
+}
+
+esp_err_t esp_wifi_get_channel(uint8_t *primary, wifi_second_chan_t *second)
+{
+  *primary = s_channel;
+  *second = WIFI_SECOND_CHAN_NONE;
+  return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_protocol(wifi_interface_t, uint8_t)
+{
+  return ESP_OK;
+}
+
+esp_err_t esp_wifi_get_max_tx_power(int8_t *power)
+{
+  *power = 80;
+  return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_max_tx_power(int8_t)
+{
+  return ESP_OK;
+}
+
+esp_err_t esp_wifi_get_mac(wifi_interface_t, uint8_t *mac)
+{
+  static const uint8_t kMac[6] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x01 };
+  memcpy(mac, kMac, sizeof(kMac));
+  return ESP_OK;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary()
+{
+  static int token;
+  return &token;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex()
+{
+  return xSemaphoreCreateBinary();
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t)
+{
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t, TickType_t)
+{
+  return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t)
+{
+  return pdTRUE;
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+  host_advance_ms(ticks * portTICK_PERIOD_MS);
+}
+
+TickType_t xTaskGetTickCount()
+{
+  return millis() / portTICK_PERIOD_MS;
+}
+
+BaseType_t xPortGetCoreID()
+{
+  return 0;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t, const char *, uint32_t, void *, UBaseType_t, TaskHandle_t *out,
+                                   BaseType_t)
+{
+  static int task;
+  if (out) {
+    *out = &task;
+  }
+  return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t)
+{
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t)
+{
+  return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t, TickType_t)
+{
+  return 0;
+}
@@ -0,0 +1,21 @@
+// Control of the host stand-ins in stubs/: simulated clock, esp_timer
+// callbacks and the ESP-NOW send path.
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+void host_set_time_us(int64_t t_us);
+// moves the clock forward, running esp_timer callbacks as they fall due
+void host_advance_us(int64_t dt_us);
+static inline void host_advance_ms(uint32_t dt_ms) { host_advance_us(static_cast<int64_t>(dt_ms) * 1000); }
+
+// receives every esp_now_send(); nullptr discards
+typedef void (*host_send_hook_t)(const uint8_t *mac, const uint8_t *data, size_t len);
+void host_set_esp_now_send_hook(host_send_hook_t hook);
+uint8_t host_wifi_channel();
+
+// receives everything printed on Serial, whether or not HOST_VERBOSE is set;
+// nullptr discards
+typedef void (*host_serial_hook_t)(const char *text, size_t len);
+void host_set_serial_hook(host_serial_hook_t hook);
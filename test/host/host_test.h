@@ -0,0 +1,38 @@
+// Minimal checks for the host tests: a failed check is reported and the
+// test carries on; host_test_exit() gives the process exit status.
+#pragma once
+
+#include <stdio.h>
+
+inline int g_host_checks = 0;
+inline int g_host_failures = 0;
+
+inline bool host_check(bool ok, const char *what, const char *file, int line)
+{
+  ++g_host_checks;
+  if (!ok) {
+    ++g_host_failures;
+    printf("%s:%d: FAILED %s\n", file, line, what);
+  }
+  return ok;
+}
+
+inline bool host_check_range(double value, double lo, double hi, const char *what, const char *file, int line)
+{
+  const bool ok = value >= lo && value <= hi;
+  if (!ok) {
+    printf("%s:%d: %s = %g, expected %g..%g\n", file, line, what, value, lo, hi);
+  }
+  return host_check(ok, what, file, line);
+}
+
+#define CHECK(cond) host_check((cond), #cond, __FILE__, __LINE__)
+#define CHECK_EQ(a, b) host_check_range(static_cast<double>(a), static_cast<double>(b), static_cast<double>(b), \
+                                        #a " == " #b, __FILE__, __LINE__)
+#define CHECK_RANGE(v, lo, hi) host_check_range(static_cast<double>(v), (lo), (hi), #v, __FILE__, __LINE__)
+
+inline int host_test_exit(const char *name)
+{
+  printf("%s: %d checks, %s\n", name, g_host_checks, g_host_failures ? "FAILED" : "ok");
+  return g_host_failures ? 1 : 0;
+}
@@ -0,0 +1,290 @@
+// The uint8_t OutputBuffer as it was before it became a template, with its
+// ring carved from the arena at runtime and wrapped with a modulo. Kept as the
+// baseline for test_output_buffer; only the receive-path calls are left. The
+// drift control law follows OutputBuffer's, so the two differ only in storage.
+#pragma once
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include "AudioArena.h"
+
+class LegacyOutputBuffer
+{
+private:
+  static constexpr int kComfortNoiseHoldSamples = 8000;
+  // Drift compensation: playout rate follows the smoothed fill level
+  // (PI control, limited to +-300ppm).
+  static constexpr int kFillAvgShift = 6;   // EWMA over ~64 remove_samples() calls
+  static constexpr int kMaxDriftPpm = 300;
+  static constexpr int kDriftIntegralShift = 21;
+  static constexpr int64_t kMaxDriftIntegral = int64_t(kMaxDriftPpm) << kDriftIntegralShift;
+  static constexpr int64_t kPpmToStepQ32 = 4295;   // 2^32 / 1e6
+
+  // how many samples should we buffer before outputting data?
+  int m_number_samples_to_buffer;
+  // where are we reading from
+  int m_read_head;
+  // where are we writing to
+  int m_write_head;
+  // keep track of how many samples we have
+  int m_available_samples;
+  // the total size of the buffer
+  int m_buffer_size;
+  // are we currently buffering samples?
+  bool m_buffering;
+  // talker signalled end of talkspurt: play out the tail, then re-prefill
+  bool m_draining;
+  // diagnostics
+  uint32_t m_underrun_events;
+  uint32_t m_overflow_events;
+  // last emitted sample for smooth concealment / recovery
+  uint8_t m_last_output_sample;
+  int m_recover_samples;
+  // comfort noise requested by SID frames (RMS in the int16 domain)
+  uint16_t m_comfort_noise_rms;
+  int m_comfort_noise_samples;
+  uint32_t m_noise_seed;
+  // fractional resampler state
+  int32_t m_fill_avg_q8;
+  int64_t m_drift_integral;
+  int m_playout_ppm;
+  uint32_t m_resample_phase;   // Q32 position between read head and next sample
+  uint64_t m_resample_step;    // Q32, 1.0 = nominal rate
+  // the sample buffer
+  uint8_t *m_buffer;
+  // thread safety
+  SemaphoreHandle_t m_semaphore;
+
+  uint8_t add_comfort_noise(uint8_t center)
+  {
+    m_noise_seed ^= m_noise_seed << 13;
+    m_noise_seed ^= m_noise_seed >> 17;
+    m_noise_seed ^= m_noise_seed << 5;
+    // uniform noise has RMS = amplitude / sqrt(3)
+    const int32_t amp = (static_cast<int32_t>(m_comfort_noise_rms) * 443) >> 8;
+    const int32_t r = static_cast<int32_t>(m_noise_seed & 0xFFFF) - 32768;
+    int v = ((static_cast<int>(center) << 8) + ((r * amp) >> 15) + 128) >> 8;
+    if (v < 0) v = 0;
+    if (v > 255) v = 255;
+    return static_cast<uint8_t>(v);
+  }
+
+  // Sender and receiver sample clocks differ by tens of ppm, which slowly
+  // walks the fill level into underrun or overflow over a long talkspurt.
+  void update_playout_rate(int count)
+  {
+    m_fill_avg_q8 += ((m_available_samples << 8) - m_fill_avg_q8) >> kFillAvgShift;
+    const int error = (m_fill_avg_q8 >> 8) - m_number_samples_to_buffer;
+    m_drift_integral += error * count;
+    if (m_drift_integral > kMaxDriftIntegral) m_drift_integral = kMaxDriftIntegral;
+    if (m_drift_integral < -kMaxDriftIntegral) m_drift_integral = -kMaxDriftIntegral;
+    int ppm = error + static_cast<int>(m_drift_integral >> kDriftIntegralShift);
+    if (ppm > kMaxDriftPpm) ppm = kMaxDriftPpm;
+    if (ppm < -kMaxDriftPpm) ppm = -kMaxDriftPpm;
+    m_playout_ppm = ppm;
+    m_resample_step = static_cast<uint64_t>((1ll << 32) + ppm * kPpmToStepQ32);
+  }
+
+public:
+  LegacyOutputBuffer(int number_samples_to_buffer) : m_number_samples_to_buffer(number_samples_to_buffer)
+  {
+    // create a semaphore and make it available for locking
+    m_semaphore = xSemaphoreCreateBinary();
+    xSemaphoreGive(m_semaphore);
+    // set reading and writing to the beginning of the buffer
+    m_read_head = 0;
+    m_write_head = 0;
+    m_available_samples = 0;
+    // we'll start off buffering data as we have no samples yet
+    m_buffering = true;
+    m_draining = false;
+    m_underrun_events = 0;
+    m_overflow_events = 0;
+    m_last_output_sample = 128;
+    m_recover_samples = 0;
+    m_comfort_noise_rms = 0;
+    m_comfort_noise_samples = 0;
+    m_noise_seed = 0x2545F491u;
+    m_fill_avg_q8 = number_samples_to_buffer << 8;
+    m_drift_integral = 0;
+    m_playout_ppm = 0;
+    m_resample_phase = 0;
+    m_resample_step = 1ull << 32;
+    // make sufficient space for the bufferring and incoming data
+    m_buffer_size = 3 * number_samples_to_buffer;
+    m_buffer = (uint8_t *)AudioArena::alloc("legacy output buffer", m_buffer_size, AudioArena::kInternal);
+    if (!m_buffer)
+    {
+      Serial.println("Failed to allocate buffer");
+      return;
+    }
+    memset(m_buffer, 0, m_buffer_size);
+  }
+
+  // keep the silence between talkspurts from going dead: uniform noise at the
+  // given RMS is mixed into concealment until the next SID or ~0.5s passes
+  void set_comfort_noise(uint16_t rms)
+  {
+    xSemaphoreTake(m_semaphore, portMAX_DELAY);
+    m_comfort_noise_rms = rms;
+    m_comfort_noise_samples = (rms > 0) ? kComfortNoiseHoldSamples : 0;
+    xSemaphoreGive(m_semaphore);
+  }
+
+  // End of talkspurt: whatever is buffered (even below the prefill target) is
+  // played out, then the buffer goes straight back to prefill without counting
+  // an underrun, so the next talker doesn't start on stale samples.
+  void end_of_stream()
+  {
+    xSemaphoreTake(m_semaphore, portMAX_DELAY);
+    m_comfort_noise_samples = 0;
+    if (m_available_samples > 0) {
+      m_buffering = false;
+      m_draining = true;
+    } else {
+      m_buffering = true;
+      m_draining = false;
+    }
+    xSemaphoreGive(m_semaphore);
+  }
+
+  // we're adding samples that are 8 bit as they are coming from the transport
+  void add_samples(const uint8_t *samples, int count)
+  {
+    xSemaphoreTake(m_semaphore, portMAX_DELAY);
+    // copy the samples into the buffer wrapping around as needed
+    for (int i = 0; i < count; i++)
+    {
+      m_buffer[m_write_head] = samples[i];
+      m_write_head = (m_write_head + 1) % m_buffer_size;
+      if (m_available_samples < m_buffer_size) {
+        m_available_samples++;
+      } else {
+        // drop the oldest sample on overflow to keep buffer state consistent
+        m_read_head = (m_read_head + 1) % m_buffer_size;
+        ++m_overflow_events;
+      }
+    }
+    xSemaphoreGive(m_semaphore);
+  }
+
+  // Stand-in for a lost frame so later audio keeps its timing: eases from the
+  // last queued sample toward silence, like buffering concealment.
+  void add_concealment(int count)
+  {
+    xSemaphoreTake(m_semaphore, portMAX_DELAY);
+    int s = (m_available_samples > 0)
+        ? m_buffer[(m_write_head + m_buffer_size - 1) % m_buffer_size]
+        : m_last_output_sample;
+    for (int i = 0; i < count; i++)
+    {
+      int d = 128 - s;
+      if (d > 4) d = 4;
+      if (d < -4) d = -4;
+      s += d;
+      m_buffer[m_write_head] = static_cast<uint8_t>(s);
+      m_write_head = (m_write_head + 1) % m_buffer_size;
+      if (m_available_samples < m_buffer_size) {
+        m_available_samples++;
+      } else {
+        m_read_head = (m_read_head + 1) % m_buffer_size;
+        ++m_overflow_events;
+      }
+    }
+    xSemaphoreGive(m_semaphore);
+  }
+
+  void remove_samples(uint8_t *samples, int count)
+  {
+    xSemaphoreTake(m_semaphore, portMAX_DELAY);
+    if (!m_buffering) {
+      update_playout_rate(count);
+    }
+    for (int i = 0; i < count; i++)
+    {
+      samples[i] = m_last_output_sample;
+      // if we have no samples and we aren't already buffering then we need to start buffering
+      if (m_available_samples == 0 && !m_buffering)
+      {
+        m_buffering = true;
+        if (m_draining) {
+          m_draining = false;
+        } else {
+          ++m_underrun_events;
+        }
+        m_recover_samples = 32;
+        m_fill_avg_q8 = m_number_samples_to_buffer << 8;
+        m_resample_phase = 0;
+      }
+      // are we buffering?
+      if (m_buffering && m_available_samples < m_number_samples_to_buffer)
+      {
+        // conceal gap smoothly by easing toward center instead of hard 128.
+        int s = static_cast<int>(m_last_output_sample);
+        int d = 128 - s;
+        if (d > 4) d = 4;
+        if (d < -4) d = -4;
+        s += d;
+        if (s < 0) s = 0;
+        if (s > 255) s = 255;
+        samples[i] = static_cast<uint8_t>(s);
+        m_last_output_sample = samples[i];
+        if (m_comfort_noise_samples > 0) {
+          --m_comfort_noise_samples;
+          samples[i] = add_comfort_noise(samples[i]);
+        }
+      }
+      else
+      {
+        // we've buffered enough samples so no need to buffer anymore
+        if (m_buffering) {
+          m_buffering = false;
+          m_recover_samples = 32;
+        }
+        // send buffered sample and move the read head forward
+        int out;
+        if (m_available_samples >= 2) {
+          // linear interpolation at the fractional playout position
+          const int s0 = m_buffer[m_read_head];
+          const int s1 = m_buffer[(m_read_head + 1) % m_buffer_size];
+          out = s0 + static_cast<int>((static_cast<int64_t>(s1 - s0) * m_resample_phase) >> 32);
+          const uint64_t next = static_cast<uint64_t>(m_resample_phase) + m_resample_step;
+          const int advance = static_cast<int>(next >> 32);
+          m_resample_phase = static_cast<uint32_t>(next);
+          m_read_head = (m_read_head + advance) % m_buffer_size;
+          m_available_samples -= advance;
+        } else {
+          out = m_buffer[m_read_head];
+          m_read_head = (m_read_head + 1) % m_buffer_size;
+          m_available_samples--;
+          m_resample_phase = 0;
+        }
+
+        if (m_recover_samples > 0) {
+          // Slew-limit immediately after recovery to avoid sharp click.
+          const int prev = static_cast<int>(m_last_output_sample);
+          int diff = out - prev;
+          const int kMaxStep = 12;
+          if (diff > kMaxStep) out = prev + kMaxStep;
+          if (diff < -kMaxStep) out = prev - kMaxStep;
+          --m_recover_samples;
+        }
+        if (out < 0) out = 0;
+        if (out > 255) out = 255;
+        samples[i] = static_cast<uint8_t>(out);
+        m_last_output_sample = samples[i];
+      }
+    }
+    xSemaphoreGive(m_semaphore);
+  }
+
+  void snapshot_and_reset_stats(uint32_t &underruns, uint32_t &overflows)
+  {
+    xSemaphoreTake(m_semaphore, portMAX_DELAY);
+    underruns = m_underrun_events;
+    overflows = m_overflow_events;
+    m_underrun_events = 0;
+    m_overflow_events = 0;
+    xSemaphoreGive(m_semaphore);
+  }
+};
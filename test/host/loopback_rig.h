@@ -0,0 +1,69 @@
+// The TX -> RX chain without a radio: packets built by a LoopbackTransport
+// are handed to an EspNowTransport that was never begun, which plays them
+// into an RxOutputBuffer.
+#pragma once
+
+#include <string.h>
+#include "EspNowTransport.h"
+#include "LoopbackTransport.h"
+#include "OutputBuffer.h"
+#include "config.h"
+
+class LoopbackRig
+{
+public:
+  static constexpr uint16_t kTalkerId = 0x7a1c;
+  static constexpr uint16_t kListenerId = 0x1157;
+
+  explicit LoopbackRig(int prefill_samples = 120 * 16) : buffer(prefill_samples), rx(&buffer, 1)
+  {
+    set_header(rx);
+    rx.set_node_id(kListenerId);
+    add_talker(tx, kTalkerId);
+  }
+
+  // another station on the same channel
+  static void add_talker(LoopbackTransport &talker, uint16_t id)
+  {
+    set_header(talker);
+    talker.set_node_id(id);
+  }
+
+  // hands the packets queued by talker to the receiver; drop(i) true loses packet i
+  template <typename Drop>
+  int deliver_from(LoopbackTransport &talker, Drop drop)
+  {
+    const int n = talker.packet_count();
+    for (int i = 0; i < n; ++i) {
+      ++sent[talker.packet(i)[strlen(ESPNOW_PACKET_MAGIC_TEXT)] & 0x0f];
+      if (!drop(i)) {
+        rx.handle_receive(nullptr, EspNowTransport::kRssiUnknown, talker.packet(i),
+                          static_cast<int>(talker.packet_length(i)));
+      }
+    }
+    talker.clear();
+    return n;
+  }
+  template <typename Drop>
+  int deliver(Drop drop)
+  {
+    return deliver_from(tx, drop);
+  }
+  int deliver()
+  {
+    return deliver_from(tx, [](int) { return false; });
+  }
+
+  RxOutputBuffer buffer;
+  EspNowTransport rx;
+  LoopbackTransport tx;
+  // packets delivered (or dropped) per frame type
+  uint32_t sent[16] = {};
+
+private:
+  static void set_header(Transport &t)
+  {
+    const char *magic = ESPNOW_PACKET_MAGIC_TEXT;
+    t.set_header(static_cast<int>(strlen(magic)), reinterpret_cast<const uint8_t *>(magic));
+  }
+};
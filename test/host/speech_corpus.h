@@ -0,0 +1,105 @@
+// Synthetic speech-like test material: phrases of voiced syllables (a
+// harmonic series on a gliding pitch under a raised-cosine envelope), some
+// led by a fricative burst, separated by short gaps and longer pauses, over
+// white background noise. Deterministic for a given seed.
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+#include <vector>
+
+struct SpeechCorpusItem
+{
+  const char *name;
+  uint32_t seed;
+  int seconds;
+  int speech_rms;       // level of a syllable peak, int16 domain
+  int background_rms;
+};
+
+class SpeechCorpus
+{
+public:
+  static constexpr uint32_t kSampleRate = 16000;
+
+  // samples and, per sample, whether it is audible speech (fricative, or syllable
+  // above a quarter of its peak)
+  static void generate(const SpeechCorpusItem &item, std::vector<int16_t> &out, std::vector<uint8_t> &speech)
+  {
+    SpeechCorpus g(item.seed);
+    const size_t total = static_cast<size_t>(item.seconds) * kSampleRate;
+    std::vector<float> s(total, 0.0f);
+    speech.assign(total, 0);
+    // lead-in of background only, so the VAD has seen the noise floor
+    size_t t = static_cast<size_t>(g.uniform(0.4f, 0.8f) * kSampleRate);
+    while (t < total) {
+      const int syllables = 3 + static_cast<int>(g.uniform(0.0f, 5.0f));
+      for (int k = 0; k < syllables && t < total; ++k) {
+        if (g.uniform(0.0f, 1.0f) < 0.3f) {
+          t = g.fricative(s, speech, t, item.speech_rms * 0.35f);
+        }
+        t = g.syllable(s, speech, t, item.speech_rms);
+        t += static_cast<size_t>(g.uniform(0.04f, 0.12f) * kSampleRate);
+      }
+      t += static_cast<size_t>(g.uniform(0.4f, 1.4f) * kSampleRate);
+    }
+    out.resize(total);
+    const float noise_amp = item.background_rms * 1.7320508f;
+    for (size_t i = 0; i < total; ++i) {
+      float v = s[i] + noise_amp * g.uniform(-1.0f, 1.0f);
+      if (v > 32767.0f) v = 32767.0f;
+      if (v < -32768.0f) v = -32768.0f;
+      out[i] = static_cast<int16_t>(lrintf(v));
+    }
+  }
+
+private:
+  explicit SpeechCorpus(uint32_t seed) : m_state(seed ? seed : 1) {}
+
+  float uniform(float lo, float hi)
+  {
+    m_state = m_state * 1664525u + 1013904223u;
+    return lo + (hi - lo) * static_cast<float>(m_state >> 8) / 16777216.0f;
+  }
+
+  size_t syllable(std::vector<float> &s, std::vector<uint8_t> &speech, size_t t, float rms)
+  {
+    const size_t len = static_cast<size_t>(uniform(0.16f, 0.32f) * kSampleRate);
+    const float f0_start = uniform(100.0f, 220.0f);
+    const float f0_end = f0_start * uniform(0.8f, 1.2f);
+    const int harmonics = static_cast<int>(3500.0f / f0_start);
+    // sum of 1/k harmonics has RMS ~ 0.9
+    const float amp = rms * 1.414f / 1.15f;
+    float phase = 0.0f;
+    for (size_t n = 0; n < len && t + n < s.size(); ++n) {
+      const float x = static_cast<float>(n) / len;
+      const float f0 = f0_start + (f0_end - f0_start) * x;
+      phase += 2.0f * static_cast<float>(M_PI) * f0 / kSampleRate;
+      float v = 0.0f;
+      for (int h = 1; h <= harmonics; ++h) {
+        v += sinf(phase * h) / h;
+      }
+      const float env = 0.5f - 0.5f * cosf(2.0f * static_cast<float>(M_PI) * x);
+      s[t + n] += amp * env * v;
+      // the faint ends of the envelope don't count as speech that must get through
+      speech[t + n] = env >= 0.25f;
+    }
+    return t + len;
+  }
+
+  size_t fricative(std::vector<float> &s, std::vector<uint8_t> &speech, size_t t, float rms)
+  {
+    const size_t len = static_cast<size_t>(uniform(0.06f, 0.1f) * kSampleRate);
+    float prev = 0.0f;
+    for (size_t n = 0; n < len && t + n < s.size(); ++n) {
+      // first difference of white noise: a high-pass hiss
+      const float w = uniform(-1.0f, 1.0f);
+      s[t + n] += rms * 1.22f * (w - prev);
+      prev = w;
+      speech[t + n] = 1;
+    }
+    return t + len;
+  }
+
+  uint32_t m_state;
+};
@@ -0,0 +1,43 @@
+// Host stand-in for the parts of Arduino-ESP32 the libraries use.
+#pragma once
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+
+typedef int esp_err_t;
+#define ESP_OK 0
+#define ESP_FAIL -1
+const char *esp_err_to_name(esp_err_t err);
+
+// host_platform.cpp: a simulated clock, see host_set_time_us()
+uint32_t millis();
+uint32_t micros();
+void delay(uint32_t ms);
+long random(long max);
+long random(long min, long max);
+
+// console output goes to stdout only when HOST_VERBOSE is set in the environment
+struct HostSerial
+{
+  void begin(unsigned long) {}
+  int printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+  size_t print(const char *s);
+  size_t println(const char *s = "");
+  int available() { return 0; }
+  int read() { return -1; }
+  void flush() {}
+};
+extern HostSerial Serial;
+
+struct HostEsp
+{
+  // scaled from the simulated clock at 240 MHz
+  uint32_t getCycleCount();
+  uint32_t getFreeHeap() { return 0; }
+};
+extern HostEsp ESP;
@@ -0,0 +1,46 @@
+// Host stand-in for the Arduino file system API, backed by stdio.
+#pragma once
+
+#include "Arduino.h"
+
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+#define FILE_APPEND "a"
+
+namespace fs {
+
+class File
+{
+public:
+  File() : m_file(nullptr) {}
+  explicit File(FILE *file) : m_file(file) {}
+  size_t write(const uint8_t *data, size_t len) { return m_file ? fwrite(data, 1, len, m_file) : 0; }
+  size_t read(uint8_t *data, size_t len) { return m_file ? fread(data, 1, len, m_file) : 0; }
+  size_t size();
+  void flush() { if (m_file) fflush(m_file); }
+  void close()
+  {
+    if (m_file) fclose(m_file);
+    m_file = nullptr;
+  }
+  operator bool() const { return m_file != nullptr; }
+
+private:
+  FILE *m_file;
+};
+
+// paths are taken relative to the working directory
+class FS
+{
+public:
+  bool begin(bool = false) { return true; }
+  File open(const char *path, const char *mode = FILE_READ);
+  bool exists(const char *path);
+  bool remove(const char *path);
+  size_t totalBytes() { return 0; }
+  size_t usedBytes() { return 0; }
+};
+
+}  // namespace fs
+
+using fs::File;
@@ -0,0 +1,13 @@
+#pragma once
+
+#include "Arduino.h"
+
+#define WIFI_STA 1
+
+struct HostWiFi
+{
+  void mode(int) {}
+  void disconnect() {}
+  void setSleep(bool) {}
+};
+extern HostWiFi WiFi;
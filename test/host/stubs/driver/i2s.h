@@ -0,0 +1,3 @@
+#pragma once
+
+// config.h names pins and I2S settings only in macros
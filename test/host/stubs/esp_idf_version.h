@@ -0,0 +1,7 @@
+#pragma once
+
+// the IDF 4.4 that espressif32@6.x (Arduino-ESP32 2.x) ships
+#ifndef ESP_IDF_VERSION_MAJOR
+#define ESP_IDF_VERSION_MAJOR 4
+#endif
+#define ESP_IDF_VERSION_MINOR 4
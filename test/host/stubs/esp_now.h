@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdint.h>
+#include "Arduino.h"
+#include "esp_idf_version.h"
+#include "esp_wifi.h"
+
+typedef struct
+{
+  uint8_t peer_addr[6];
+  uint8_t channel;
+  int ifidx;
+  bool encrypt;
+} esp_now_peer_info_t;
+
+typedef enum { ESP_NOW_SEND_SUCCESS = 0, ESP_NOW_SEND_FAIL } esp_now_send_status_t;
+typedef void (*esp_now_send_cb_t)(const uint8_t *mac, esp_now_send_status_t status);
+#if ESP_IDF_VERSION_MAJOR >= 5
+typedef struct
+{
+  uint8_t *src_addr;
+  uint8_t *des_addr;
+  wifi_pkt_rx_ctrl_t *rx_ctrl;
+} esp_now_recv_info_t;
+typedef void (*esp_now_recv_cb_t)(const esp_now_recv_info_t *info, const uint8_t *data, int len);
+#else
+typedef void (*esp_now_recv_cb_t)(const uint8_t *mac, const uint8_t *data, int len);
+#endif
+
+esp_err_t esp_now_init();
+esp_err_t esp_now_register_recv_cb(esp_now_recv_cb_t cb);
+esp_err_t esp_now_register_send_cb(esp_now_send_cb_t cb);
+esp_err_t esp_now_add_peer(const esp_now_peer_info_t *peer);
+bool esp_now_is_peer_exist(const uint8_t *mac);
+// handed to the hook set with host_set_esp_now_send_hook()
+esp_err_t esp_now_send(const uint8_t *mac, const uint8_t *data, size_t len);
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "Arduino.h"
+
+typedef enum { WIFI_PKT_MGMT, WIFI_PKT_CTRL, WIFI_PKT_DATA, WIFI_PKT_MISC } wifi_promiscuous_pkt_type_t;
+typedef struct
+{
+  signed rssi : 8;
+  unsigned channel : 4;
+  unsigned sig_len : 12;
+} wifi_pkt_rx_ctrl_t;
+typedef struct
+{
+  wifi_pkt_rx_ctrl_t rx_ctrl;
+  uint8_t payload[0];
+} wifi_promiscuous_pkt_t;
+typedef struct
+{
+  uint32_t filter_mask;
+} wifi_promiscuous_filter_t;
+#define WIFI_PROMIS_FILTER_MASK_MGMT (1 << 0)
+#define WIFI_PROMIS_FILTER_MASK_DATA (1 << 2)
+typedef enum { WIFI_SECOND_CHAN_NONE } wifi_second_chan_t;
+typedef enum { WIFI_IF_STA } wifi_interface_t;
+#define WIFI_PROTOCOL_LR 8
+typedef void (*wifi_promiscuous_cb_t)(void *buf, wifi_promiscuous_pkt_type_t type);
+
+esp_err_t esp_wifi_set_promiscuous(bool enable);
+esp_err_t esp_wifi_set_promiscuous_rx_cb(wifi_promiscuous_cb_t cb);
+esp_err_t esp_wifi_set_promiscuous_filter(const wifi_promiscuous_filter_t *filter);
+// host_wifi_channel() reports the last one set
+esp_err_t esp_wifi_set_channel(uint8_t primary, wifi_second_chan_t second);
+esp_err_t esp_wifi_get_channel(uint8_t *primary, wifi_second_chan_t *second);
+esp_err_t esp_wifi_set_protocol(wifi_interface_t ifx, uint8_t protocol);
+esp_err_t esp_wifi_get_max_tx_power(int8_t *power);
+esp_err_t esp_wifi_set_max_tx_power(int8_t power);
+esp_err_t esp_wifi_get_mac(wifi_interface_t ifx, uint8_t *mac);
@@ -0,0 +1,44 @@
+// Host stand-in for the FreeRTOS API the libraries use. The tests are single
+// threaded: semaphores and critical sections are no-ops, tasks are not run.
+#pragma once
+
+#include <stdint.h>
+
+typedef void *SemaphoreHandle_t;
+typedef void *TaskHandle_t;
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned UBaseType_t;
+typedef void (*TaskFunction_t)(void *);
+
+#define portMAX_DELAY 0xffffffffu
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms) (ms)
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS 1
+
+typedef struct
+{
+  int owner;
+} portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED { 0 }
+static inline void portENTER_CRITICAL(portMUX_TYPE *) {}
+static inline void portEXIT_CRITICAL(portMUX_TYPE *) {}
+
+SemaphoreHandle_t xSemaphoreCreateBinary();
+SemaphoreHandle_t xSemaphoreCreateMutex();
+void vSemaphoreDelete(SemaphoreHandle_t sem);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t wait);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem);
+
+// vTaskDelay() advances the simulated clock
+void vTaskDelay(TickType_t ticks);
+TickType_t xTaskGetTickCount();
+BaseType_t xPortGetCoreID();
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack, void *arg,
+                                   UBaseType_t priority, TaskHandle_t *out, BaseType_t core);
+void vTaskDelete(TaskHandle_t task);
+// tasks never run on the host; notifications go nowhere
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t wait);
@@ -0,0 +1,4 @@
+#pragma once
+
+// nothing on the host counts as PSRAM
+static inline bool esp_ptr_external_ram(const void *) { return false; }
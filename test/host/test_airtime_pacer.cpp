@@ -0,0 +1,217 @@
+// AirtimePacer fed the way the mic loop feeds the transport: a frame is
+// complete at the end of the 8 ms chunk holding its last sample, with some
+// scheduling jitter on top. The pacer releases from a timer armed at
+// head_due_us(), and a push into a full queue sends the head early, as
+// EspNowTransport does.
+#include <math.h>
+#include <stdio.h>
+#include <vector>
+#include "AirtimePacer.h"
+#include "host_test.h"
+
+namespace {
+
+constexpr uint32_t kChunkUs = 8000;
+constexpr int kChunkSamples = 128;
+constexpr uint16_t kBudgetPermille = 500;
+constexpr uint16_t kPhyKbps = 1000;
+
+struct Lcg
+{
+  uint32_t state;
+  uint32_t next() { state = state * 1664525u + 1013904223u; return state >> 8; }
+};
+
+struct Run
+{
+  std::vector<uint32_t> released;
+  AirtimePacer::Stats stats;
+  uint32_t airtime_us;
+};
+
+// arrivals must be sorted; returns the release times
+Run pace(const std::vector<uint32_t> &arrivals, uint32_t cadence_us, size_t len)
+{
+  AirtimePacer pacer;
+  pacer.configure(kBudgetPermille, kPhyKbps);
+  pacer.set_cadence_us(cadence_us);
+  Run run = {};
+  uint8_t packet[AirtimePacer::kMaxPacketSize] = {};
+  uint8_t out[AirtimePacer::kMaxPacketSize];
+  size_t next = 0;
+  while (next < arrivals.size() || !pacer.empty()) {
+    if (!pacer.empty() && (next == arrivals.size() ||
+                           static_cast<int32_t>(pacer.head_due_us() - arrivals[next]) <= 0)) {
+      const uint32_t now = pacer.head_due_us();
+      pacer.pop(out, now);
+      run.released.push_back(now);
+      run.airtime_us += pacer.airtime_us(len);
+      continue;
+    }
+    const uint32_t now = arrivals[next++];
+    if (pacer.full()) {
+      pacer.pop(out, now);
+      pacer.count_overflow();
+      run.released.push_back(now);
+      run.airtime_us += pacer.airtime_us(len);
+    }
+    pacer.push(packet, len, now);
+  }
+  pacer.snapshot_and_reset_stats(run.stats);
+  return run;
+}
+
+// standard deviation of the gaps between consecutive times, skipping warm-up
+double spacing_sd_ms(const std::vector<uint32_t> &t, size_t skip)
+{
+  double sum = 0.0;
+  double sum2 = 0.0;
+  int n = 0;
+  for (size_t i = skip + 1; i < t.size(); ++i) {
+    const double gap = (t[i] - t[i - 1]) / 1000.0;
+    sum += gap;
+    sum2 += gap * gap;
+    ++n;
+  }
+  const double mean = sum / n;
+  return sqrt(sum2 / n - mean * mean);
+}
+
+// frames of frame_samples at 16 kHz, 0..2 ms of mic loop jitter per chunk
+std::vector<uint32_t> chunk_arrivals(int frame_samples, int frames, uint32_t t0)
+{
+  Lcg rng{ 5 };
+  const int chunks = (frames * frame_samples) / kChunkSamples + 2;
+  std::vector<uint32_t> chunk_end(chunks);
+  for (int j = 0; j < chunks; ++j) {
+    chunk_end[j] = t0 + (j + 1) * kChunkUs + rng.next() % 2001;
+  }
+  std::vector<uint32_t> arrivals;
+  for (int k = 0; k < frames; ++k) {
+    const int chunk = ((k + 1) * frame_samples + kChunkSamples - 1) / kChunkSamples - 1;
+    arrivals.push_back(chunk_end[chunk]);
+  }
+  return arrivals;
+}
+
+// cadence locks to the latest chunk phase: departures one frame apart,
+// no frame held longer than one frame, the airtime budget never exceeded
+void test_cadence(int frame_samples, double max_sd_ms)
+{
+  constexpr int kFrames = 2000;
+  const uint32_t cadence_us = frame_samples * 1000000u / 16000u;
+  const size_t len = frame_samples / 2 + 12;   // ADPCM payload and header
+  // start near the 32-bit microsecond wrap
+  const std::vector<uint32_t> arrivals = chunk_arrivals(frame_samples, kFrames, 0xfff00000u);
+  const Run run = pace(arrivals, cadence_us, len);
+  const double raw_sd = spacing_sd_ms(arrivals, 10);
+  const double paced_sd = spacing_sd_ms(run.released, 10);
+  const uint32_t span_us = run.released.back() - run.released.front();
+  AirtimePacer probe;
+  probe.configure(kBudgetPermille, kPhyKbps);
+  const uint32_t bucket_us = 2 * probe.airtime_us(AirtimePacer::kMaxPacketSize);
+  printf("%2d ms frames: departure sd %.2f -> %.2f ms, delay avg %.2f max %.2f ms, "
+         "deadline %lu, over budget %lu, airtime %.1f%%\n",
+         static_cast<int>(cadence_us / 1000), raw_sd, paced_sd,
+         run.stats.delay_us_total / 1000.0 / run.stats.frames, run.stats.delay_us_max / 1000.0,
+         static_cast<unsigned long>(run.stats.deadline_sends),
+         static_cast<unsigned long>(run.stats.over_budget), 100.0 * run.airtime_us / span_us);
+  CHECK_EQ(run.stats.frames, kFrames);
+  CHECK_EQ(run.stats.overflows, 0);
+  CHECK_EQ(run.stats.over_budget, 0);
+  CHECK(raw_sd > 1.0);
+  CHECK_RANGE(paced_sd, 0.0, max_sd_ms);
+  CHECK(run.stats.delay_us_max <= cadence_us);
+  CHECK(run.airtime_us <= bucket_us + static_cast<uint64_t>(span_us) * kBudgetPermille / 1000);
+}
+
+// exact token arithmetic: an empty bucket refills at the budget rate and
+// holds the head back until its airtime is there
+void test_token_refill()
+{
+  AirtimePacer pacer;
+  pacer.configure(kBudgetPermille, kPhyKbps);
+  pacer.set_cadence_us(5000);
+  const size_t len = AirtimePacer::kMaxPacketSize;
+  const uint32_t need = pacer.airtime_us(len);
+  uint8_t packet[AirtimePacer::kMaxPacketSize] = {};
+  uint8_t out[AirtimePacer::kMaxPacketSize];
+  // the bucket holds two full-size frames
+  pacer.push(packet, len, 0);
+  pacer.push(packet, len, 0);
+  CHECK_EQ(pacer.head_due_us(), 0);
+  pacer.pop(out, 0);
+  pacer.pop(out, 0);
+  // empty bucket: need / budget of waiting, inside the one-frame deadline
+  pacer.push(packet, len, 5000);
+  const uint32_t wait = (need * 1000 + kBudgetPermille - 1) / kBudgetPermille;
+  CHECK_EQ(pacer.head_due_us(), wait);
+  CHECK(wait < 5000 + 5000);
+  pacer.pop(out, wait);
+  // a frame that would wait past its deadline goes at the deadline
+  pacer.push(packet, len, wait);
+  CHECK_EQ(pacer.head_due_us(), wait + 5000);
+  pacer.pop(out, wait + 5000);
+  AirtimePacer::Stats stats;
+  pacer.snapshot_and_reset_stats(stats);
+  printf("token refill: %lu us airtime per frame, %lu us to refill an empty bucket, %lu over budget\n",
+         static_cast<unsigned long>(need), static_cast<unsigned long>(wait),
+         static_cast<unsigned long>(stats.over_budget));
+  CHECK_EQ(stats.over_budget, 1);
+  CHECK_EQ(stats.deadline_sends, 1);
+}
+
+// VOX pre-roll: six frames handed over at once. The queue bounds the
+// burst, nothing waits more than one frame, and the live frames behind it
+// are back on the cadence within a few frames.
+void test_preroll_burst()
+{
+  constexpr int kFrameSamples = 240;
+  constexpr uint32_t kCadenceUs = 15000;
+  constexpr int kPreroll = 6;
+  constexpr int kLive = 200;
+  const size_t len = kFrameSamples / 2 + 12;
+  std::vector<uint32_t> arrivals(kPreroll, 100000);
+  for (uint32_t t : chunk_arrivals(kFrameSamples, kLive, 100000)) {
+    arrivals.push_back(t);
+  }
+  const Run run = pace(arrivals, kCadenceUs, len);
+  int worst_burst = 0;
+  for (size_t i = 0; i < run.released.size(); ++i) {
+    int n = 0;
+    while (i + n < run.released.size() && run.released[i + n] - run.released[i] < 1000) {
+      ++n;
+    }
+    if (n > worst_burst) {
+      worst_burst = n;
+    }
+  }
+  size_t settled = run.released.size();
+  for (size_t i = run.released.size() - 1; i > 0; --i) {
+    if (run.released[i] - run.released[i - 1] != kCadenceUs) {
+      settled = i;
+      break;
+    }
+  }
+  printf("pre-roll of %d frames: at most %d frames within 1 ms, %lu sent early on overflow, "
+         "max delay %.2f ms, on cadence from frame %u\n",
+         kPreroll, worst_burst, static_cast<unsigned long>(run.stats.overflows),
+         run.stats.delay_us_max / 1000.0, static_cast<unsigned>(settled));
+  CHECK_EQ(run.stats.frames, kPreroll + kLive);
+  CHECK_RANGE(worst_burst, 1, AirtimePacer::kQueueSlots);
+  CHECK(run.stats.delay_us_max <= kCadenceUs);
+  CHECK_RANGE(settled, 1, kPreroll + 8);
+}
+
+}  // namespace
+
+int main()
+{
+  test_cadence(80, 1.5);
+  test_cadence(160, 0.2);
+  test_cadence(240, 0.2);
+  test_cadence(320, 0.2);
+  test_token_refill();
+  test_preroll_burst();
+  return host_test_exit("airtime_pacer");
+}
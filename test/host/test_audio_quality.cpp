@@ -0,0 +1,179 @@
+// AudioQuality against channels built here with known properties: a delay
+// either way, a gain and added noise, a harmonic on a tone, a one-pole
+// lowpass. The analyser has to give back what went in; the golden run and
+// "aq" on the device rely on these numbers.
+#include <math.h>
+#include <stdio.h>
+#include <vector>
+#include "AudioQuality.h"
+#include "TestSignal.h"
+#include "config.h"
+#include "host_test.h"
+
+namespace {
+
+constexpr size_t kLength = 3 * SAMPLE_RATE;
+
+struct Lcg
+{
+  uint32_t state;
+  uint32_t next() { state = state * 1664525u + 1013904223u; return state >> 8; }
+  // about Gaussian, unit variance
+  double gauss()
+  {
+    double s = 0.0;
+    for (int i = 0; i < 12; ++i) {
+      s += next() / 16777216.0;
+    }
+    return s - 6.0;
+  }
+};
+
+std::vector<int16_t> take(TxSource &source, size_t count)
+{
+  std::vector<int16_t> out(count);
+  source.reset();
+  source.read(out.data(), count);
+  return out;
+}
+
+struct Channel
+{
+  int32_t delay;      // > 0: received lags; < 0: the start of the stimulus is lost
+  double gain_db;
+  double snr_db;      // added Gaussian noise against the scaled stimulus, 0 = none
+};
+
+// received audio, and the SNR it actually has over the overlap
+std::vector<int16_t> transmit(const std::vector<int16_t> &x, const Channel &c, double &snr_db)
+{
+  Lcg rng{ static_cast<uint32_t>(1000 + c.delay) };
+  const double g = pow(10.0, c.gain_db / 20.0);
+  double power = 0.0;
+  for (int16_t v : x) {
+    power += g * g * v * v;
+  }
+  power /= x.size();
+  const double sigma = (c.snr_db > 0.0) ? sqrt(power / pow(10.0, c.snr_db / 10.0)) : 0.0;
+  const size_t len = x.size() + (c.delay > 0 ? c.delay : 0) - (c.delay < 0 ? -c.delay : 0);
+  std::vector<int16_t> y(len);
+  double sig = 0.0;
+  double err = 0.0;
+  for (size_t n = 0; n < len; ++n) {
+    const int64_t i = static_cast<int64_t>(n) - c.delay;
+    const double clean = (i >= 0 && i < static_cast<int64_t>(x.size())) ? g * x[i] : 0.0;
+    const double v = clean + sigma * rng.gauss();
+    y[n] = static_cast<int16_t>(lrint(v < -32768.0 ? -32768.0 : (v > 32767.0 ? 32767.0 : v)));
+    if (i >= 0 && i < static_cast<int64_t>(x.size())) {
+      sig += clean * clean;
+      err += (y[n] - clean) * (y[n] - clean);
+    }
+  }
+  snr_db = 10.0 * log10(sig / (err > 0.0 ? err : 1e-9));
+  return y;
+}
+
+void test_channel(const char *name, const std::vector<int16_t> &x, const Channel &c)
+{
+  double snr_db;
+  const std::vector<int16_t> y = transmit(x, c, snr_db);
+  AudioQuality::Report r;
+  const bool ok = AudioQuality::analyse(x.data(), x.size(), y.data(), y.size(), SAMPLE_RATE, 0, r);
+  printf("%-5s delay %+5ld gain %+4.1f dB SNR %4.1f dB -> delay %+5ld gain %+5.2f dB SNR %5.2f dB corr %.3f\n",
+         name, static_cast<long>(c.delay), c.gain_db, snr_db, static_cast<long>(r.delay_samples), r.gain_db,
+         r.snr_db, r.correlation);
+  CHECK(ok);
+  CHECK_EQ(r.delay_samples, c.delay);
+  CHECK_RANGE(r.gain_db, c.gain_db - 0.05, c.gain_db + 0.05);
+  if (c.snr_db > 0.0) {
+    CHECK_RANGE(r.snr_db, snr_db - 0.3, snr_db + 0.3);
+  } else {
+    // rounding to int16 only
+    CHECK(r.snr_db > 70.0);
+  }
+}
+
+// a tone with a known harmonic and noise floor: THD+N is their sum
+void test_thd()
+{
+  static const uint16_t kTone[] = { TEST_SIGNAL_TONE_HZ };
+  ToneSource tone("tone", kTone, 1, TEST_SIGNAL_LEVEL, SAMPLE_RATE);
+  const std::vector<int16_t> x = take(tone, kLength);
+  const double harmonic_db = -40.0;
+  const double noise_db = -35.0;
+  const double a = TEST_SIGNAL_LEVEL * pow(10.0, harmonic_db / 20.0);
+  const double sigma = TEST_SIGNAL_LEVEL / M_SQRT2 * pow(10.0, noise_db / 20.0);
+  Lcg rng{ 3 };
+  std::vector<int16_t> y(x.size() + 500);
+  for (size_t n = 0; n < y.size(); ++n) {
+    const double clean = (n >= 500) ? x[n - 500] + a * sin(2.0 * M_PI * 3 * TEST_SIGNAL_TONE_HZ * n / SAMPLE_RATE) : 0.0;
+    y[n] = static_cast<int16_t>(lrint(clean + sigma * rng.gauss()));
+  }
+  AudioQuality::Report r;
+  CHECK(AudioQuality::analyse(x.data(), x.size(), y.data(), y.size(), SAMPLE_RATE, TEST_SIGNAL_TONE_HZ, r));
+  const double expect = 10.0 * log10(pow(10.0, harmonic_db / 10.0) + pow(10.0, noise_db / 10.0));
+  const int period = SAMPLE_RATE / TEST_SIGNAL_TONE_HZ;
+  printf("tone + %.0f dB 3rd harmonic + %.0f dB noise: THD+N %.2f dB (%.2f expected), delay %ld (500 mod %d)\n",
+         harmonic_db, noise_db, r.thd_n_db, expect, static_cast<long>(r.delay_samples), period);
+  CHECK_RANGE(r.thd_n_db, expect - 0.5, expect + 0.5);
+  // a tone only fixes the delay modulo its period
+  CHECK_EQ(((r.delay_samples - 500) % period + period) % period, 0);
+}
+
+// white noise through a one-pole lowpass: octave bands follow |H(f)|
+void test_response()
+{
+  NoiseSource white(NoiseSource::kWhite, TEST_SIGNAL_LEVEL);
+  const std::vector<int16_t> x = take(white, kLength);
+  const double fc = 3000.0;
+  const double p = exp(-2.0 * M_PI * fc / SAMPLE_RATE);
+  std::vector<int16_t> y(x.size() + 200);
+  double state = 0.0;
+  for (size_t n = 0; n < y.size(); ++n) {
+    const double in = (n >= 200) ? x[n - 200] : 0.0;
+    state = p * state + (1.0 - p) * in;
+    y[n] = static_cast<int16_t>(lrint(state));
+  }
+  AudioQuality::Report r;
+  CHECK(AudioQuality::analyse(x.data(), x.size(), y.data(), y.size(), SAMPLE_RATE, 0, r));
+  auto h_db = [&](double f) {
+    const double w = 2.0 * M_PI * f / SAMPLE_RATE;
+    const double re = 1.0 - p * cos(w);
+    const double im = p * sin(w);
+    return 20.0 * log10((1.0 - p) / sqrt(re * re + im * im));
+  };
+  printf("one-pole %.0f Hz lowpass, dB re 1 kHz:", fc);
+  for (int b = 0; b < AudioQuality::kBands; ++b) {
+    const double expect = h_db(AudioQuality::kBandHz[b]) - h_db(1000.0);
+    printf(" %u:%+.1f (%+.1f)", AudioQuality::kBandHz[b], r.response_db[b], expect);
+    CHECK_RANGE(r.response_db[b], expect - 0.5, expect + 0.5);
+  }
+  printf("\n");
+  CHECK_EQ(r.delay_samples, 200);
+}
+
+}  // namespace
+
+int main()
+{
+  NoiseSource pink(NoiseSource::kPink, TEST_SIGNAL_LEVEL);
+  MlsSource mls(TEST_SIGNAL_LEVEL);
+  const std::vector<int16_t> noise = take(pink, kLength);
+  const std::vector<int16_t> sequence = take(mls, kLength);
+  const Channel channels[] = {
+    { 1200, -6.0, 30.0 },
+    { 37, 3.0, 40.0 },
+    { 0, 0.0, 0.0 },
+    { -300, -12.0, 20.0 },
+    { -2000, -3.0, 10.0 },
+    { AudioQuality::kMaxDelay, 0.0, 30.0 },
+  };
+  for (const Channel &c : channels) {
+    test_channel("pink", noise, c);
+  }
+  test_channel("mls", sequence, { 1200, -6.0, 30.0 });
+  test_channel("mls", sequence, { -700, 0.0, 15.0 });
+  test_thd();
+  test_response();
+  return host_test_exit("audio_quality");
+}
@@ -0,0 +1,158 @@
+// Back-to-back talkspurts: the end-of-talkspurt marker lets the listener play
+// out the tail, skip the underrun path and prefill afresh for the next one.
+#include <math.h>
+#include <stdio.h>
+#include <vector>
+#include "host_platform.h"
+#include "host_test.h"
+#include "loopback_rig.h"
+
+namespace {
+
+constexpr int kChunk = 128;
+constexpr uint32_t kChunkMs = kChunk * 1000 / SAMPLE_RATE;
+constexpr int kSpurtSamples = SAMPLE_RATE;   // 1 s each
+constexpr int kPrefill = 120 * 16;
+constexpr uint16_t kSecondTalkerId = 0x2b2b;
+
+struct Result
+{
+  uint32_t underruns;
+  int first_spurt_played;    // samples from the first onset to the end of its tail
+  int second_start_latency;  // samples from the second talker's first sample to hearing it
+  int second_dropouts;       // silent blocks once the second talkspurt has started
+  double stale_db;           // first tone in the second talkspurt, relative to the second tone
+};
+
+double tone_power(const std::vector<int> &x, size_t from, size_t to, double hz)
+{
+  // Goertzel
+  const double w = 2.0 * M_PI * hz / SAMPLE_RATE;
+  double s1 = 0;
+  double s2 = 0;
+  for (size_t i = from; i < to && i < x.size(); ++i) {
+    const double s0 = x[i] + 2.0 * cos(w) * s1 - s2;
+    s2 = s1;
+    s1 = s0;
+  }
+  return s1 * s1 + s2 * s2 - 2.0 * cos(w) * s1 * s2;
+}
+
+// first talkspurt at 500 Hz, gap_ms of nothing, second at 1500 Hz; eot_lost
+// of the first talkspurt's EOT copies never arrive
+Result run(bool same_talker, int eot_lost, uint32_t gap_ms)
+{
+  LoopbackRig rig(kPrefill);
+  LoopbackTransport other;
+  LoopbackRig::add_talker(other, kSecondTalkerId);
+  LoopbackTransport &second = same_talker ? rig.tx : other;
+  std::vector<int> out;
+  uint8_t played[kChunk];
+  auto tick = [&]() {
+    rig.buffer.remove_samples(played, kChunk);
+    for (int i = 0; i < kChunk; ++i) {
+      out.push_back(static_cast<int>(played[i]) - 128);
+    }
+    host_advance_ms(kChunkMs);
+  };
+  auto talk = [&](LoopbackTransport &t, double hz, int eot_drop) {
+    for (int pos = 0; pos < kSpurtSamples; pos += kChunk) {
+      for (int i = 0; i < kChunk; ++i) {
+        const double v = 8000.0 * sin(2.0 * M_PI * hz * (pos + i) / SAMPLE_RATE);
+        t.add_sample_u8(static_cast<uint8_t>((static_cast<int>(lrint(v)) >> 8) + 128));
+      }
+      rig.deliver_from(t, [](int) { return false; });
+      tick();
+    }
+    t.end_talkspurt();
+    int eot_seen = 0;
+    rig.deliver_from(t, [&](int i) {
+      return t.packet(i)[strlen(ESPNOW_PACKET_MAGIC_TEXT)] == Transport::kFrameTypeEot && eot_seen++ < eot_drop;
+    });
+  };
+
+  talk(rig.tx, 500.0, eot_lost);
+  for (uint32_t t = 0; t < gap_ms; t += kChunkMs) {
+    tick();
+  }
+  const size_t second_start = out.size();
+  talk(second, 1500.0, 0);
+  for (int i = 0; i < 40; ++i) {
+    tick();
+  }
+
+  Result r = {};
+  uint32_t overflows = 0;
+  rig.buffer.snapshot_and_reset_stats(r.underruns, overflows);
+  // which tone dominates each 64-sample block: 1 = first, 2 = second, 0 = neither
+  constexpr size_t kBlock = 64;
+  auto tone_in = [&](size_t block) {
+    const size_t from = block * kBlock;
+    const double p1 = tone_power(out, from, from + kBlock, 500.0);
+    const double p2 = tone_power(out, from, from + kBlock, 1500.0);
+    // a tone of amplitude a gives about (a * kBlock / 2)^2: ask for at least 8 steps
+    const double floor = 16.0 * kBlock * kBlock;
+    return (p1 > floor && p1 > 10 * p2) ? 1 : (p2 > floor && p2 > 10 * p1) ? 2 : 0;
+  };
+  const size_t blocks = out.size() / kBlock;
+  size_t first_on = 0;
+  while (first_on < blocks && tone_in(first_on) != 1) ++first_on;
+  size_t second_on = second_start / kBlock;
+  while (second_on < blocks && tone_in(second_on) != 2) ++second_on;
+  size_t first_end = second_on;
+  while (first_end > first_on && tone_in(first_end - 1) != 1) --first_end;
+  r.first_spurt_played = static_cast<int>((first_end - first_on) * kBlock);
+  r.second_start_latency = static_cast<int>(second_on * kBlock - second_start);
+  for (size_t b = second_on; b < second_on + (kSpurtSamples - 256) / kBlock && b < blocks; ++b) {
+    r.second_dropouts += (tone_in(b) == 0) ? 1 : 0;
+  }
+  second_on *= kBlock;
+  const double p_old = tone_power(out, second_on, second_on + kSpurtSamples / 2, 500.0);
+  const double p_new = tone_power(out, second_on, second_on + kSpurtSamples / 2, 1500.0);
+  r.stale_db = 10.0 * log10((p_old + 1e-9) / (p_new + 1e-9));
+  return r;
+}
+
+}  // namespace
+
+int main()
+{
+  struct Case
+  {
+    const char *name;
+    bool same_talker;
+    int eot_lost;
+    uint32_t gap_ms;
+  };
+  const Case cases[] = {
+    { "other talker, 200 ms gap", false, 0, 200 },
+    { "other talker, no gap", false, 0, 0 },
+    // arrives just before the tail has played out
+    { "other talker, 100 ms gap", false, 0, 100 },
+    { "same talker, 200 ms gap", true, 0, 200 },
+    { "2 of 3 EOT copies lost", false, 2, 200 },
+    { "every EOT lost", false, 3, 200 },
+  };
+  for (const Case &c : cases) {
+    const Result r = run(c.same_talker, c.eot_lost, c.gap_ms);
+    printf("%-26s underruns=%u first played=%5d second starts after %4d samples (%5.1f ms), "
+           "dropouts=%d, stale %6.1f dB\n",
+           c.name, static_cast<unsigned>(r.underruns), r.first_spurt_played, r.second_start_latency,
+           r.second_start_latency * 1000.0 / SAMPLE_RATE, r.second_dropouts, r.stale_db);
+    // the tail of the first talkspurt is played out to the end
+    CHECK_RANGE(r.first_spurt_played, kSpurtSamples - 128, kSpurtSamples + 128);
+    // the second talkspurt plays without holes, and nothing of the first leaks into it
+    CHECK_EQ(r.second_dropouts, 0);
+    CHECK_RANGE(r.stale_db, -200.0, -30.0);
+    if (c.eot_lost < Transport::kEotRepeat) {
+      // no underrun at the end of a talkspurt, and the next one starts after a
+      // plain prefill plus one frame of packetization
+      CHECK_EQ(r.underruns, 0);
+      CHECK_RANGE(r.second_start_latency, kPrefill - 64, kPrefill + 236 + 2 * kChunk);
+    } else {
+      // without an EOT the end is only found by running dry
+      CHECK_EQ(r.underruns, 1);
+    }
+  }
+  return host_test_exit("back_to_back");
+}
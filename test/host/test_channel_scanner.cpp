@@ -0,0 +1,194 @@
+// ChannelScanner against a talker on one channel: 15 ms audio frames in
+// speech, a SID every TX_DTX_SID_INTERVAL_MS in pauses. The scan runs on a
+// 1 ms tick with the config.h dwell and resume times; a frame is heard only
+// while the scanner is tuned to the talker's channel and not in the first
+// millisecond after a hop.
+#include <stdio.h>
+#include <algorithm>
+#include <vector>
+#include "ChannelScanner.h"
+#include "config.h"
+#include "host_test.h"
+
+namespace {
+
+constexpr uint32_t kFrameMs = 15;
+constexpr uint32_t kRetuneMs = 1;
+constexpr uint32_t kSweepMs = ChannelScanner::kNumChannels * SCAN_DWELL_MS;
+
+struct Talker
+{
+  uint8_t channel;
+  uint32_t phase_ms;
+  uint32_t speech_from_ms;
+  uint32_t speech_until_ms;   // then SIDs until sid_until_ms
+  uint32_t sid_until_ms;
+
+  // frame sent at now_ms: 0 none, 1 audio, 2 SID
+  int frame(uint32_t now_ms) const
+  {
+    if (now_ms < phase_ms) {
+      return 0;
+    }
+    if (now_ms >= speech_from_ms && now_ms < speech_until_ms) {
+      return ((now_ms - phase_ms) % kFrameMs == 0) ? 1 : 0;
+    }
+    if (now_ms >= speech_until_ms && now_ms < sid_until_ms) {
+      return ((now_ms - speech_until_ms) % TX_DTX_SID_INTERVAL_MS == 0) ? 2 : 0;
+    }
+    return 0;
+  }
+};
+
+struct Scan
+{
+  ChannelScanner scanner{ SCAN_DWELL_MS, SCAN_RESUME_IDLE_MS };
+  uint32_t tuned_ms = 0;
+
+  // one millisecond: the talker's frame (if heard), then the schedule
+  void tick(const Talker &talker, uint32_t now_ms)
+  {
+    const int f = talker.frame(now_ms);
+    if (f && scanner.channel() == talker.channel && now_ms - tuned_ms >= kRetuneMs) {
+      scanner.on_frame(f == 1, now_ms);
+    }
+    if (scanner.update(now_ms)) {
+      tuned_ms = now_ms;
+    }
+  }
+};
+
+// a talker anywhere, any frame phase, any scan start: locked on its
+// channel within one sweep
+void test_lock_time()
+{
+  std::vector<uint32_t> lock_ms;
+  for (uint8_t ch = ChannelScanner::kFirstChannel; ch <= ChannelScanner::kLastChannel; ++ch) {
+    for (uint8_t start = ChannelScanner::kFirstChannel; start <= ChannelScanner::kLastChannel; ++start) {
+      for (uint32_t phase = 0; phase < kFrameMs; phase += 4) {
+        const Talker talker{ ch, phase, 0, 0xffffffffu, 0 };
+        Scan scan;
+        scan.scanner.start(start, 0);
+        uint32_t now = 0;
+        while (scan.scanner.state() != ChannelScanner::kLocked && now < 3 * kSweepMs) {
+          scan.tick(talker, now++);
+        }
+        CHECK_EQ(scan.scanner.channel(), ch);
+        lock_ms.push_back(now);
+      }
+    }
+  }
+  std::sort(lock_ms.begin(), lock_ms.end());
+  const uint32_t median = lock_ms[lock_ms.size() / 2];
+  const uint32_t worst = lock_ms.back();
+  printf("lock on a talker: median %lu ms, worst %lu ms over %u cases (sweep %lu ms)\n",
+         static_cast<unsigned long>(median), static_cast<unsigned long>(worst),
+         static_cast<unsigned>(lock_ms.size()), static_cast<unsigned long>(kSweepMs));
+  // the last channel of the sweep, plus two frames to lock
+  CHECK(worst <= kSweepMs + kRetuneMs + 2 * kFrameMs);
+  CHECK(median <= kSweepMs / 2 + 2 * kFrameMs);
+}
+
+// a SID doubles the dwell once; audio alone locks, SIDs alone never do
+void test_sid_dwell()
+{
+  ChannelScanner scanner(SCAN_DWELL_MS, SCAN_RESUME_IDLE_MS);
+  scanner.start(5, 1000);
+  scanner.on_frame(false, 1010);
+  scanner.on_frame(false, 1100);
+  CHECK_EQ(scanner.update(1000 + SCAN_DWELL_MS), 0);
+  CHECK_EQ(scanner.update(1000 + 2 * SCAN_DWELL_MS - 1), 0);
+  CHECK_EQ(scanner.update(1000 + 2 * SCAN_DWELL_MS), 6);
+  CHECK_EQ(scanner.state(), ChannelScanner::kScanning);
+  // the next channel is back to the plain dwell
+  CHECK_EQ(scanner.update(1000 + 3 * SCAN_DWELL_MS - 1), 0);
+  CHECK_EQ(scanner.update(1000 + 3 * SCAN_DWELL_MS), 7);
+  CHECK_EQ(scanner.entry(5).frames, 2);
+  CHECK_EQ(scanner.entry(5).audio_frames, 0);
+
+  // a talker pausing on channel 9: dwell there is doubled whenever a SID
+  // lands in it, and the scan never locks on SIDs
+  const Talker talker{ 9, 0, 0, 0, 30000 };
+  Scan scan;
+  scan.scanner.start(1, 0);
+  uint32_t entered = 0;
+  int visits = 0;
+  int doubled = 0;
+  bool locked = false;
+  uint8_t prev = scan.scanner.channel();
+  for (uint32_t now = 0; now < 30000; ++now) {
+    scan.tick(talker, now);
+    locked |= scan.scanner.state() == ChannelScanner::kLocked;
+    const uint8_t ch = scan.scanner.channel();
+    if (ch != prev) {
+      if (prev == talker.channel) {
+        const uint32_t dwell = now - entered;
+        ++visits;
+        doubled += (dwell == 2 * SCAN_DWELL_MS);
+        CHECK(dwell == SCAN_DWELL_MS || dwell == 2 * SCAN_DWELL_MS);
+      } else {
+        CHECK_EQ(now - entered, SCAN_DWELL_MS);
+      }
+      entered = now;
+      prev = ch;
+    }
+  }
+  printf("talker in a pause (SID every %d ms): %d visits, dwell doubled on %d\n",
+         TX_DTX_SID_INTERVAL_MS, visits, doubled);
+  CHECK(!locked);
+  CHECK(visits > 10);
+  CHECK_RANGE(doubled, 1, visits - 1);
+}
+
+// locked while speech and SIDs come in; SCAN_RESUME_IDLE_MS after the last
+// frame it moves on, and a hold (own talkspurt) keeps it in place
+void test_resume()
+{
+  const uint32_t speech_until = 5000;
+  const uint32_t sid_until = 8000;
+  const Talker talker{ 4, 0, 0, speech_until, sid_until };
+  Scan scan;
+  scan.scanner.start(4, 0);
+  uint32_t last_frame = 0;
+  uint32_t resumed = 0;
+  for (uint32_t now = 0; now < 20000 && !resumed; ++now) {
+    if (talker.frame(now)) {
+      last_frame = now;
+    }
+    scan.tick(talker, now);
+    if (now > 100 && scan.scanner.state() == ChannelScanner::kScanning) {
+      resumed = now;
+    }
+  }
+  printf("speech until %lu ms, SIDs until %lu ms, last frame %lu ms: scan resumed at %lu ms on channel %u\n",
+         static_cast<unsigned long>(speech_until), static_cast<unsigned long>(sid_until),
+         static_cast<unsigned long>(last_frame), static_cast<unsigned long>(resumed),
+         static_cast<unsigned>(scan.scanner.channel()));
+  CHECK(last_frame >= speech_until);
+  CHECK_EQ(resumed, last_frame + SCAN_RESUME_IDLE_MS);
+  CHECK_EQ(scan.scanner.channel(), 5);
+
+  ChannelScanner held(SCAN_DWELL_MS, SCAN_RESUME_IDLE_MS);
+  held.start(4, 0);
+  held.on_frame(true, 10);
+  held.on_frame(true, 25);
+  CHECK_EQ(held.state(), ChannelScanner::kLocked);
+  held.set_hold(true);
+  for (uint32_t now = 25; now < 25 + 2 * SCAN_RESUME_IDLE_MS; now += 10) {
+    CHECK_EQ(held.update(now), 0);
+  }
+  held.set_hold(false);
+  const uint32_t released = 25 + 2 * SCAN_RESUME_IDLE_MS;
+  CHECK_EQ(held.update(released + SCAN_RESUME_IDLE_MS - 20), 0);
+  CHECK_EQ(held.update(released + SCAN_RESUME_IDLE_MS), 5);
+}
+
+}  // namespace
+
+int main()
+{
+  test_lock_time();
+  test_sid_dwell();
+  test_resume();
+  return host_test_exit("channel_scanner");
+}
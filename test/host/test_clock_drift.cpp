@@ -0,0 +1,137 @@
+// Ten minutes of one talkspurt between a sender and a listener whose sample
+// clocks differ: the playout rate control must hold the fill near the
+// prefill target with no underrun and no overflow, for the 120 ms target of
+// the throughput profile and the 30 ms one of the low-latency profile. Once
+// the integral term has learned the offset, the fill averages out on the
+// target whatever the drift.
+//
+// Usage: test_clock_drift [ppm...]   (default: a fixed set within +-250 ppm)
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <vector>
+#include "host_platform.h"
+#include "host_test.h"
+#include "loopback_rig.h"
+
+namespace {
+
+constexpr int kChunk = 128;
+constexpr int kPrefill = 120 * 16;
+constexpr int kLowPrefill = LOW_LATENCY_JITTER_MS * 16;
+constexpr uint64_t kRunUs = 600ull * 1000000;
+constexpr uint64_t kSettleUs = 60ull * 1000000;
+// averages span the second half: the 8 ms chunks of the two clocks beat with
+// a period of minutes at tens of ppm
+constexpr uint64_t kAverageUs = 300ull * 1000000;
+
+struct Result
+{
+  uint32_t underruns;
+  uint32_t overflows;
+  int fill_min;      // after settling
+  int fill_max;
+  double ppm_avg;    // playout correction over the second half
+  double fill_avg;   // fill over the second half
+  int fill_peak;     // largest distance from the target after settling
+};
+
+// the sender's clock runs ppm fast relative to the listener's
+Result run(double ppm, int prefill, int frame_samples)
+{
+  LoopbackRig rig(prefill);
+  if (frame_samples) {
+    rig.tx.set_frame_samples(frame_samples);
+  }
+  const double send_period_us = kChunk * 1e6 / (SAMPLE_RATE * (1.0 + ppm * 1e-6));
+  const double play_period_us = kChunk * 1e6 / SAMPLE_RATE;
+  const uint64_t start = esp_timer_get_time();
+  double next_send = 0;
+  double next_arrival = 0;
+  uint32_t seed = 12345;
+  double next_play = 0;
+  uint32_t phase = 0;
+  uint8_t played[kChunk];
+  Result r = {};
+  r.fill_min = RxOutputBuffer::get_buffer_size();
+  double ppm_sum = 0;
+  double fill_sum = 0;
+  int ppm_n = 0;
+  while (next_play < kRunUs) {
+    if (next_arrival <= next_play) {
+      host_set_time_us(start + static_cast<uint64_t>(next_arrival));
+      for (int i = 0; i < kChunk; ++i) {
+        // a slow ramp keeps every sample different
+        rig.tx.add_sample_u8(static_cast<uint8_t>(96 + ((phase++ >> 4) & 63)));
+      }
+      rig.deliver();
+      next_send += send_period_us;
+      // 0..4 ms of air and scheduling delay; without it the two clocks beat
+      // against each other and the fill samples alias
+      seed = seed * 1664525u + 1013904223u;
+      next_arrival = next_send + (seed >> 8) % 4000;
+    } else {
+      host_set_time_us(start + static_cast<uint64_t>(next_play));
+      // the fill the controller steers: what is there when playout asks
+      const int fill = rig.buffer.get_available_samples();
+      rig.buffer.remove_samples(played, kChunk);
+      next_play += play_period_us;
+      if (next_play > kSettleUs) {
+        if (fill < r.fill_min) r.fill_min = fill;
+        if (fill > r.fill_max) r.fill_max = fill;
+      }
+      if (next_play > kRunUs - kAverageUs) {
+        ppm_sum += rig.buffer.get_playout_ppm();
+        fill_sum += fill;
+        ++ppm_n;
+      }
+    }
+  }
+  rig.buffer.snapshot_and_reset_stats(r.underruns, r.overflows);
+  r.ppm_avg = ppm_n ? ppm_sum / ppm_n : 0;
+  r.fill_avg = ppm_n ? fill_sum / ppm_n : 0;
+  r.fill_peak = std::max(prefill - r.fill_min, r.fill_max - prefill);
+  return r;
+}
+
+void check(const char *profile, double ppm, int prefill, int frame_samples)
+{
+  const Result r = run(ppm, prefill, frame_samples);
+  printf("%-10s %+5.0f ppm: fill %4d..%4d, average %6.1f (target %d, uncorrected drift %+5.0f samples), "
+         "playout %+6.1f ppm, underruns=%u overflows=%u\n",
+         profile, ppm, r.fill_min, r.fill_max, r.fill_avg, prefill, ppm * 1e-6 * SAMPLE_RATE * (kRunUs / 1e6),
+         r.ppm_avg, static_cast<unsigned>(r.underruns), static_cast<unsigned>(r.overflows));
+  CHECK_EQ(r.underruns, 0);
+  CHECK_EQ(r.overflows, 0);
+  // the fill wanders by a play chunk, a frame and the packet jitter, plus
+  // the controller's transient: under one sample per ppm of drift (a P-only
+  // law at 0.5 ppm per sample would stand two samples per ppm off instead)
+  const double sawtooth = kChunk + (frame_samples ? frame_samples : 236) + 4 * 16;
+  CHECK_RANGE(r.fill_peak, 0.0, sawtooth + fabs(ppm));
+  // no standing offset: the fill averages out on the target...
+  CHECK_RANGE(r.fill_avg, prefill - 16.0, prefill + 16.0);
+  // ...and the correction settles on the actual offset (the integral is
+  // still closing the last few percent of a 250 ppm step)
+  CHECK_RANGE(r.ppm_avg, ppm - 10 - 0.1 * fabs(ppm), ppm + 10 + 0.1 * fabs(ppm));
+}
+
+}  // namespace
+
+int main(int argc, char **argv)
+{
+  std::vector<double> ppms;
+  for (int i = 1; i < argc; ++i) {
+    ppms.push_back(atof(argv[i]));
+  }
+  if (ppms.empty()) {
+    ppms = { 0, 40, -40, 100, -100, 250, -250 };
+  }
+  for (double ppm : ppms) {
+    check("throughput", ppm, kPrefill, 0);
+  }
+  for (double ppm : ppms) {
+    check("low", ppm, kLowPrefill, LOW_LATENCY_FRAME_MS * 16);
+  }
+  return host_test_exit("clock_drift");
+}
@@ -0,0 +1,148 @@
+// Dual-watch through the receive path: a talker on the main channel and one
+// on the priority channel feed an EspNowTransport on a 1 ms tick. A packet
+// reaches the receiver only while host_wifi_channel() is the sender's
+// channel and not in the millisecond after a hop (the assumed retune time).
+#include <stdio.h>
+#include <algorithm>
+#include <vector>
+#include "FrameCodec.h"
+#include "host_platform.h"
+#include "host_test.h"
+#include "loopback_rig.h"
+
+namespace {
+
+constexpr uint8_t kMainChannel = 1;
+constexpr uint8_t kPriorityChannel = 6;
+constexpr uint16_t kPriorityTalkerId = 0x2b2b;
+constexpr int kSamplesPerMs = SAMPLE_RATE / 1000;
+constexpr uint32_t kHopMs = 1;
+
+struct Watch
+{
+  LoopbackRig rig;
+  LoopbackTransport priority;
+  uint8_t played[kSamplesPerMs];
+  uint8_t channel = 0;
+  uint32_t tuned_ms = 0;
+  uint32_t visits = 0;
+  uint32_t priority_frames = 0;
+
+  Watch()
+  {
+    LoopbackRig::add_talker(priority, kPriorityTalkerId);
+    rig.tx.set_link_mode(0);
+    priority.set_link_mode(0);
+    rig.rx.setWifiChannel(kMainChannel);
+    channel = host_wifi_channel();
+    rig.rx.set_dual_watch(kPriorityChannel);
+  }
+
+  bool hears(uint8_t ch, uint32_t now_ms) const { return channel == ch && now_ms - tuned_ms >= kHopMs; }
+
+  // one millisecond of both talkers (when talking), playout and service()
+  void tick(bool main_talks, bool priority_talks)
+  {
+    const uint32_t now_ms = millis();
+    if (main_talks) {
+      for (int i = 0; i < kSamplesPerMs; ++i) {
+        rig.tx.add_sample_u8(static_cast<uint8_t>(128 + ((now_ms + i) & 31)));
+      }
+    }
+    if (priority_talks) {
+      for (int i = 0; i < kSamplesPerMs; ++i) {
+        priority.add_sample_u8(static_cast<uint8_t>(128 - ((now_ms + i) & 31)));
+      }
+    }
+    const bool main_heard = hears(kMainChannel, now_ms);
+    rig.deliver([&](int) { return !main_heard; });
+    const bool priority_heard = hears(kPriorityChannel, now_ms);
+    priority_frames += rig.deliver_from(priority, [&](int) { return !priority_heard; }) && priority_heard;
+    rig.buffer.remove_samples(played, kSamplesPerMs);
+    rig.rx.service(now_ms);
+    const uint8_t ch = host_wifi_channel();
+    if (ch != channel) {
+      visits += (ch == kPriorityChannel);
+      channel = ch;
+      tuned_ms = now_ms;
+    }
+    host_advance_ms(1);
+  }
+};
+
+// quiet priority channel: each visit costs the main channel a couple of
+// 15 ms frames, concealed by playout, and nothing else
+void test_visit_cost()
+{
+  constexpr uint32_t kSeconds = 60;
+  host_set_time_us(1000000);
+  Watch w;
+  for (uint32_t ms = 0; ms < kSeconds * 1000; ++ms) {
+    w.tick(true, false);
+  }
+  EspNowTransportStats stats;
+  w.rig.rx.snapshot_and_reset_stats(stats);
+  const double frame_ms = FrameCodec::kModes[0].frame_samples * 1000.0 / SAMPLE_RATE;
+  const double per_visit = static_cast<double>(stats.rx_concealed_frames) / w.visits;
+  // away for the window plus the hop back; frames sent in that time are lost
+  const double expected = (DUAL_WATCH_LISTEN_MS + kHopMs) / frame_ms;
+  printf("%u ms window every %u ms, %.2f ms frames: %lu visits, %lu frames concealed (%.2f per visit, %.2f expected), "
+         "%lu received\n",
+         static_cast<unsigned>(DUAL_WATCH_LISTEN_MS), static_cast<unsigned>(DUAL_WATCH_INTERVAL_MS), frame_ms,
+         static_cast<unsigned long>(w.visits), static_cast<unsigned long>(stats.rx_concealed_frames), per_visit,
+         expected, static_cast<unsigned long>(stats.rx_ok_packets));
+  CHECK_RANGE(w.visits, kSeconds * 1000 / (DUAL_WATCH_INTERVAL_MS + DUAL_WATCH_LISTEN_MS) - 1,
+              kSeconds * 1000 / DUAL_WATCH_INTERVAL_MS);
+  CHECK_RANGE(per_visit, expected - 0.3, expected + 0.3);
+  CHECK_EQ(w.priority_frames, 0);
+  CHECK_EQ(w.channel, kMainChannel);
+}
+
+// priority traffic starting at any point of the interval is found on the
+// next visit, switches us over, and hands back after it has been quiet
+void test_detection()
+{
+  constexpr int kStarts = 50;
+  constexpr uint32_t kTalkMs = 4000;
+  std::vector<uint32_t> detect_ms;
+  for (int k = 0; k < kStarts; ++k) {
+    host_set_time_us(1000000);
+    Watch w;
+    // settle into the visit cadence, then start the priority talker
+    const uint32_t start = 2000 + k * DUAL_WATCH_INTERVAL_MS / kStarts + k % 7;
+    for (uint32_t ms = 0; ms < start; ++ms) {
+      w.tick(true, false);
+    }
+    uint32_t detected = 0;
+    uint32_t back = 0;
+    for (uint32_t ms = 0; ms < kTalkMs + DUAL_WATCH_RESUME_IDLE_MS + 500; ++ms) {
+      w.tick(true, ms < kTalkMs);
+      if (!detected && w.priority_frames) {
+        detected = ms;
+      }
+      if (detected && !back && w.channel == kMainChannel) {
+        back = ms;
+      }
+    }
+    detect_ms.push_back(detected);
+    CHECK(detected > 0);
+    // switched over: stayed for the whole talkspurt, back once it went quiet
+    CHECK_RANGE(back, kTalkMs + DUAL_WATCH_RESUME_IDLE_MS - 20, kTalkMs + DUAL_WATCH_RESUME_IDLE_MS + 20);
+  }
+  std::sort(detect_ms.begin(), detect_ms.end());
+  const uint32_t median = detect_ms[detect_ms.size() / 2];
+  printf("priority traffic found after median %lu ms, min %lu, max %lu over %d start times\n",
+         static_cast<unsigned long>(median), static_cast<unsigned long>(detect_ms.front()),
+         static_cast<unsigned long>(detect_ms.back()), kStarts);
+  CHECK_RANGE(median, DUAL_WATCH_INTERVAL_MS / 2 - 100, DUAL_WATCH_INTERVAL_MS / 2 + 100);
+  CHECK(detect_ms.back() <= DUAL_WATCH_INTERVAL_MS + DUAL_WATCH_LISTEN_MS);
+}
+
+}  // namespace
+
+int main()
+{
+  test_visit_cost();
+  test_detection();
+  return host_test_exit("dual_watch");
+}
@@ -0,0 +1,234 @@
+// Flooding through repeaters on chain, ring, mesh and grid topologies: every
+// node within the hop budget hears every frame, each repeater relays a frame
+// at most once, and loops die out.
+#include <stdio.h>
+#include <queue>
+#include <vector>
+#include "FloodRelay.h"
+#include "host_test.h"
+
+namespace {
+
+using Topology = std::vector<std::vector<int>>;
+
+constexpr uint32_t kAirUs = 1000;        // one frame on air
+constexpr uint32_t kFrameIntervalUs = 15000;
+constexpr uint8_t kType = 1;
+
+// a transmission by node (packet = [ttl, origin, seq lo, seq hi]) or, with
+// node < 0, relay queue service for node -node - 1
+struct Event
+{
+  uint32_t at_us;
+  int node;
+  std::vector<uint8_t> packet;
+  bool operator<(const Event &o) const { return at_us > o.at_us; }
+};
+
+Topology chain(int n)
+{
+  Topology t(n);
+  for (int i = 0; i + 1 < n; ++i) {
+    t[i].push_back(i + 1);
+    t[i + 1].push_back(i);
+  }
+  return t;
+}
+
+Topology ring(int n)
+{
+  Topology t = chain(n);
+  t[0].push_back(n - 1);
+  t[n - 1].push_back(0);
+  return t;
+}
+
+Topology mesh(int n)
+{
+  Topology t(n);
+  for (int i = 0; i < n; ++i) {
+    for (int j = 0; j < n; ++j) {
+      if (i != j) t[i].push_back(j);
+    }
+  }
+  return t;
+}
+
+Topology grid(int w)
+{
+  Topology t(w * w);
+  for (int y = 0; y < w; ++y) {
+    for (int x = 0; x < w; ++x) {
+      const int i = y * w + x;
+      if (x + 1 < w) {
+        t[i].push_back(i + 1);
+        t[i + 1].push_back(i);
+      }
+      if (y + 1 < w) {
+        t[i].push_back(i + w);
+        t[i + w].push_back(i);
+      }
+    }
+  }
+  return t;
+}
+
+std::vector<int> hop_distance(const Topology &t, int src)
+{
+  std::vector<int> d(t.size(), -1);
+  std::queue<int> q;
+  d[src] = 0;
+  q.push(src);
+  while (!q.empty()) {
+    const int a = q.front();
+    q.pop();
+    for (int b : t[a]) {
+      if (d[b] < 0) {
+        d[b] = d[a] + 1;
+        q.push(b);
+      }
+    }
+  }
+  return d;
+}
+
+void run(const char *name, const Topology &t, uint8_t hops, int frames)
+{
+  const int n = static_cast<int>(t.size());
+  const int src = 0;
+  std::vector<FloodRelay> relays;
+  for (int i = 0; i < n; ++i) {
+    relays.emplace_back(static_cast<uint32_t>(i * 7919 + 11));
+  }
+  std::vector<std::vector<int>> heard(n, std::vector<int>(frames, 0));
+  int transmissions = 0;
+  int same_time = 0;   // two repeaters starting the same frame in the same slot
+  std::priority_queue<Event> q;
+  for (int f = 0; f < frames; ++f) {
+    q.push({ static_cast<uint32_t>(f) * kFrameIntervalUs, src,
+             { hops, static_cast<uint8_t>(src), static_cast<uint8_t>(f), static_cast<uint8_t>(f >> 8) } });
+  }
+  std::vector<uint32_t> last_start(n, 0xffffffffu);
+  while (!q.empty()) {
+    const Event e = q.top();
+    q.pop();
+    if (e.node < 0) {
+      const int k = -e.node - 1;
+      FloodRelay &r = relays[k];
+      uint8_t out[FloodRelay::kMaxPacketSize];
+      while (!r.empty() && static_cast<int32_t>(e.at_us - r.head_due_us()) >= 0) {
+        const size_t len = r.pop(out, e.at_us);
+        q.push({ e.at_us, k, std::vector<uint8_t>(out, out + len) });
+      }
+      continue;
+    }
+    ++transmissions;
+    if (e.node != src) {
+      for (int other = 0; other < n; ++other) {
+        if (other != e.node && last_start[other] == e.at_us) ++same_time;
+      }
+      last_start[e.node] = e.at_us;
+    }
+    const uint16_t origin = e.packet[1];
+    const uint16_t seq = static_cast<uint16_t>(e.packet[2] | (e.packet[3] << 8));
+    const uint32_t rx_us = e.at_us + kAirUs;
+    for (int nb : t[e.node]) {
+      if (nb == origin) {
+        continue;   // our own frame heard back
+      }
+      ++heard[nb][seq];
+      FloodRelay &r = relays[nb];
+      if (r.offer(e.packet.data(), e.packet.size(), 0, origin, kType, seq, rx_us) == FloodRelay::kRelay) {
+        q.push({ rx_us, -nb - 1, {} });
+        q.push({ r.head_due_us(), -nb - 1, {} });
+      }
+    }
+  }
+
+  const std::vector<int> d = hop_distance(t, src);
+  int expected_reach = 0;
+  int reached = 0;
+  int expected_relays = 0;
+  for (int i = 0; i < n; ++i) {
+    if (i == src) continue;
+    // the source's copy goes one hop; each relay spends one of the budget
+    const bool in_range = d[i] >= 0 && d[i] <= hops + 1;
+    expected_reach += in_range ? 1 : 0;
+    expected_relays += (d[i] >= 1 && d[i] <= hops) ? 1 : 0;
+    int got_all = 1;
+    for (int f = 0; f < frames; ++f) {
+      if (heard[i][f] == 0) got_all = 0;
+    }
+    reached += got_all;
+    if (!in_range) {
+      CHECK_EQ(got_all, 0);
+    }
+  }
+  FloodRelay::Stats total = {};
+  for (FloodRelay &r : relays) {
+    FloodRelay::Stats s;
+    r.snapshot_and_reset_stats(s);
+    total.relayed += s.relayed;
+    total.duplicates += s.duplicates;
+    total.expired += s.expired;
+    total.dropped += s.dropped;
+    if (s.delay_us_max > total.delay_us_max) total.delay_us_max = s.delay_us_max;
+  }
+  printf("%-8s n=%2d hops=%u: reached %2d/%2d, %.2f transmissions per frame, relayed %5u, duplicates %5u, "
+         "expired %4u, dropped %u, relay delay max %4u us, same-slot starts %d\n",
+         name, n, hops, reached, n - 1, static_cast<double>(transmissions) / frames,
+         static_cast<unsigned>(total.relayed), static_cast<unsigned>(total.duplicates),
+         static_cast<unsigned>(total.expired), static_cast<unsigned>(total.dropped),
+         static_cast<unsigned>(total.delay_us_max), same_time);
+  CHECK_EQ(reached, expected_reach);
+  // every repeater within the budget relays each frame exactly once; the
+  // queue never overflows at this frame rate
+  CHECK_EQ(total.relayed, static_cast<uint32_t>(expected_relays * frames));
+  CHECK_EQ(total.dropped, 0);
+  CHECK_RANGE(total.delay_us_max, 0, FloodRelay::kMaxHoldoffUs);
+}
+
+// a burst faster than the hold-off fills the queue; the rest are dropped, not reordered
+void test_queue_overflow()
+{
+  FloodRelay r(5);
+  uint8_t packet[4] = { 2, 9, 0, 0 };
+  int queued = 0;
+  for (uint16_t seq = 0; seq < 10; ++seq) {
+    packet[2] = static_cast<uint8_t>(seq);
+    queued += r.offer(packet, sizeof(packet), 0, 9, kType, seq, 1000) == FloodRelay::kRelay ? 1 : 0;
+  }
+  CHECK_EQ(queued, FloodRelay::kQueueSlots);
+  uint8_t out[FloodRelay::kMaxPacketSize];
+  uint32_t prev_due = 0;
+  for (int i = 0; i < queued; ++i) {
+    const uint32_t due = r.head_due_us();
+    CHECK(due >= prev_due);
+    prev_due = due;
+    CHECK_EQ(r.pop(out, due), sizeof(packet));
+    CHECK_EQ(out[2], i);
+    // the relayed copy has one hop less
+    CHECK_EQ(out[0], 1);
+  }
+  FloodRelay::Stats s;
+  r.snapshot_and_reset_stats(s);
+  CHECK_EQ(s.dropped, 10 - FloodRelay::kQueueSlots);
+  // the same key again is a duplicate, a TTL of 0 is not relayed
+  CHECK(r.offer(packet, sizeof(packet), 0, 9, kType, 9, 2000) == FloodRelay::kDuplicate);
+  packet[0] = 0;
+  CHECK(r.offer(packet, sizeof(packet), 0, 9, kType, 10, 2000) == FloodRelay::kExpired);
+}
+
+}  // namespace
+
+int main()
+{
+  run("chain", chain(6), 2, 300);
+  run("chain", chain(6), 4, 300);
+  run("ring", ring(8), 2, 300);
+  run("ring", ring(8), 4, 300);
+  run("mesh", mesh(6), 2, 300);
+  run("grid", grid(4), 4, 300);
+  test_queue_overflow();
+  return host_test_exit("flood_relay");
+}
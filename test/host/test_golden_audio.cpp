@@ -0,0 +1,338 @@
+// Golden audio: the committed fixtures in fixtures/ go through the TX -> RX
+// chain (TxFrontEnd conversion and pitch mode, Transport packetization,
+// EspNowTransport::handle_receive, the jitter buffer and OutputBuffer playout)
+// for every link mode, pitch mode and compressor setting, and the playout is
+// compared with golden/. Tone and multitone in M1 must also survive the chain
+// in correlation and SNR. Prints the time spent per stage.
+//
+// HOST_GOLDEN_RECORD=1 rewrites golden/ from the current chain (and writes a
+// fixture that is missing from the TestSignal sources). A mismatch leaves the
+// actual playout in build/golden_actual/.
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "AudioQuality.h"
+#include "FrameCodec.h"
+#include "TestSignal.h"
+#include "TxFrontEnd.h"
+#include "host_platform.h"
+#include "host_test.h"
+#include "loopback_rig.h"
+#include "wav_io.h"
+
+namespace {
+
+constexpr size_t kChunk = 128;   // TX loop chunk, 8 ms
+constexpr uint32_t kChunkMs = kChunk * 1000 / SAMPLE_RATE;
+constexpr uint32_t kFixtureMs = 500;
+constexpr size_t kFixtureSamples = (SAMPLE_RATE / 1000) * kFixtureMs;
+// loose on purpose: the 8 kHz link modes cut the 3.1 kHz multitone component
+// and the playout resampler costs a few dB, a broken chain lands far below
+constexpr float kMinCorrelation = 0.90f;
+constexpr float kMinSnrDb = 6.0f;
+
+const char *const kFixtureDir = HOST_REPO_DIR "/test/host/fixtures/";
+const char *const kGoldenDir = HOST_REPO_DIR "/test/host/golden/";
+const char *const kGoldenList = HOST_REPO_DIR "/test/host/golden/golden_audio.txt";
+
+enum { kConvert, kPitch, kPacketize, kParse, kPlayout, kStageCount };
+const char *const kStageNames[kStageCount] = { "convert", "pitch", "packetize", "parse", "playout" };
+const uint8_t kPitchModes[] = { TxFrontEnd::kPitchM1, TxFrontEnd::kPitchM2, TxFrontEnd::kPitchM3 };
+
+struct Fixture
+{
+  const char *name;
+  bool band_limited;   // below 4 kHz, so every link mode carries it
+  uint32_t tone_hz;    // single tone for AudioQuality, 0 otherwise
+};
+
+const Fixture kFixtures[] = {
+  { "tone", true, TEST_SIGNAL_TONE_HZ },
+  { "multitone", true, 0 },
+  { "sweep", false, 0 },
+  { "pink", false, 0 },
+  { "mls", false, 0 },
+};
+
+bool g_record = false;
+double g_stage_ns[kStageCount] = {};
+size_t g_samples_total = 0;
+
+uint32_t crc32(const std::vector<uint8_t> &data)
+{
+  uint32_t crc = 0xffffffffu;
+  for (uint8_t b : data) {
+    crc ^= b;
+    for (int k = 0; k < 8; ++k) {
+      crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+    }
+  }
+  return ~crc;
+}
+
+std::vector<int16_t> widen(const std::vector<uint8_t> &u8)
+{
+  std::vector<int16_t> v;
+  for (uint8_t s : u8) {
+    v.push_back(static_cast<int16_t>((s - 128) << 8));
+  }
+  return v;
+}
+
+// the sources the fixtures were written from
+TxSource *make_source(int i)
+{
+  static const uint16_t kTone[] = { TEST_SIGNAL_TONE_HZ };
+  static const uint16_t kMultiTone[] = { TEST_SIGNAL_MULTITONE_HZ };
+  switch (i) {
+  case 0:
+    return new ToneSource("tone", kTone, 1, TEST_SIGNAL_LEVEL, SAMPLE_RATE);
+  case 1:
+    return new ToneSource("multitone", kMultiTone, sizeof(kMultiTone) / sizeof(kMultiTone[0]), TEST_SIGNAL_LEVEL,
+                          SAMPLE_RATE);
+  case 2:
+    return new SweepSource(TEST_SIGNAL_SWEEP_START_HZ, TEST_SIGNAL_SWEEP_END_HZ, kFixtureMs, TEST_SIGNAL_LEVEL,
+                           SAMPLE_RATE);
+  case 3:
+    return new NoiseSource(NoiseSource::kPink, TEST_SIGNAL_LEVEL);
+  default:
+    return new MlsSource(TEST_SIGNAL_LEVEL);
+  }
+}
+
+bool load_fixture(int i, std::vector<int16_t> &pcm)
+{
+  const std::string path = std::string(kFixtureDir) + kFixtures[i].name + ".wav";
+  struct stat st;
+  if (g_record && stat(path.c_str(), &st) != 0) {
+    std::unique_ptr<TxSource> source(make_source(i));
+    source->reset();
+    pcm.assign(kFixtureSamples, 0);
+    source->read(pcm.data(), pcm.size());
+    printf("wrote fixture %s\n", path.c_str());
+    return write_wav(path.c_str(), pcm, 16);
+  }
+  return read_wav(path.c_str(), pcm);
+}
+
+// one talkspurt: playout keeps pace with the input, one chunk per chunk, then
+// the tail drains after the end-of-talkspurt marker
+std::vector<uint8_t> run_chain(const std::vector<int16_t> &in, uint8_t mode, uint8_t pitch, bool compressor,
+                               uint32_t &dropped)
+{
+  using clock = std::chrono::steady_clock;
+  std::unique_ptr<LoopbackRig> rig(new LoopbackRig());
+  TxFrontEnd front(compressor);
+  front.begin_session();
+  rig->tx.set_link_mode(mode);
+  std::vector<uint8_t> out;
+  uint8_t u8[kChunk];
+  uint8_t play[kChunk];
+  double ns[kStageCount] = {};
+  auto lap = [&](clock::time_point &t, int stage) {
+    const clock::time_point now = clock::now();
+    ns[stage] += std::chrono::duration<double, std::nano>(now - t).count();
+    t = now;
+  };
+  for (size_t pos = 0; pos < in.size(); pos += kChunk) {
+    const size_t n = std::min(kChunk, in.size() - pos);
+    clock::time_point t = clock::now();
+    front.convert_i16_to_u8(in.data() + pos, u8, n);
+    lap(t, kConvert);
+    front.apply_pitch_mode(pitch, u8, n);
+    lap(t, kPitch);
+    for (size_t i = 0; i < n; ++i) {
+      rig->tx.add_sample_u8(u8[i]);
+    }
+    if (pos + n == in.size()) {
+      rig->tx.end_talkspurt();
+    }
+    lap(t, kPacketize);
+    rig->deliver();
+    lap(t, kParse);
+    rig->buffer.remove_samples(play, static_cast<int>(n));
+    lap(t, kPlayout);
+    out.insert(out.end(), play, play + n);
+    host_advance_ms(kChunkMs);
+  }
+  const size_t capacity = in.size() + RxOutputBuffer::get_buffer_size();
+  while (out.size() + kChunk <= capacity && rig->buffer.get_available_samples() > 0) {
+    clock::time_point t = clock::now();
+    rig->buffer.remove_samples(play, kChunk);
+    lap(t, kPlayout);
+    out.insert(out.end(), play, play + kChunk);
+    host_advance_ms(kChunkMs);
+  }
+  for (int s = 0; s < kStageCount; ++s) {
+    g_stage_ns[s] += ns[s];
+  }
+  g_samples_total += in.size();
+  dropped = rig->tx.dropped();
+  return out;
+}
+
+// golden_audio.txt lines are "<fixture> m<mode> M<pitch> c<compressor> <samples> <crc hex>"
+std::map<std::string, std::string> load_golden_list()
+{
+  std::map<std::string, std::string> list;
+  FILE *f = fopen(kGoldenList, "r");
+  char line[128];
+  while (f && fgets(line, sizeof(line), f)) {
+    std::string s(line);
+    while (!s.empty() && (s.back() == '\n' || s.back() == '\r')) {
+      s.pop_back();
+    }
+    // the key is the first four fields
+    size_t at = 0;
+    for (int field = 0; field < 4 && at != std::string::npos; ++field) {
+      at = s.find(' ', at + 1);
+    }
+    if (at != std::string::npos) {
+      list[s.substr(0, at)] = s.substr(at + 1);
+    }
+  }
+  if (f) {
+    fclose(f);
+  }
+  return list;
+}
+
+std::string file_key(const std::string &key)
+{
+  std::string k = key;
+  for (char &c : k) {
+    c = (c == ' ') ? '_' : c;
+  }
+  return k;
+}
+
+// the mode 0, M1 outputs are kept sample for sample: a mismatch there names
+// the first sample that differs
+bool keep_samples(uint8_t mode, uint8_t pitch)
+{
+  return mode == 0 && pitch == TxFrontEnd::kPitchM1;
+}
+
+void report_first_difference(const std::string &key, const std::vector<uint8_t> &actual)
+{
+  std::vector<int16_t> want;
+  if (!read_wav((std::string(kGoldenDir) + file_key(key) + ".wav").c_str(), want)) {
+    return;
+  }
+  const std::vector<int16_t> got = widen(actual);
+  size_t i = 0;
+  while (i < want.size() && i < got.size() && want[i] == got[i]) {
+    ++i;
+  }
+  printf("  %s: first difference at sample %zu of %zu (golden %zu)\n", key.c_str(), i, got.size(), want.size());
+}
+
+void test_golden()
+{
+  const std::map<std::string, std::string> golden = g_record ? std::map<std::string, std::string>()
+                                                             : load_golden_list();
+  FILE *list = g_record ? fopen(kGoldenList, "w") : nullptr;
+  CHECK(!g_record || list != nullptr);
+  if (!g_record) {
+    mkdir("golden_actual", 0755);
+  }
+  int runs = 0;
+  int matched = 0;
+  int metric_runs = 0;
+  uint32_t dropped_total = 0;
+  for (int f = 0; f < static_cast<int>(sizeof(kFixtures) / sizeof(kFixtures[0])); ++f) {
+    const Fixture &fx = kFixtures[f];
+    std::vector<int16_t> in;
+    if (!CHECK(load_fixture(f, in))) {
+      continue;
+    }
+    CHECK_EQ(in.size(), kFixtureSamples);
+    for (int compressor = 0; compressor <= 1; ++compressor) {
+      for (uint8_t mode = 0; mode < FrameCodec::kNumModes; ++mode) {
+        for (uint8_t pitch : kPitchModes) {
+          uint32_t dropped = 0;
+          const std::vector<uint8_t> out = run_chain(in, mode, pitch, compressor != 0, dropped);
+          dropped_total += dropped;
+          ++runs;
+          char key[48];
+          snprintf(key, sizeof(key), "%s m%u M%u c%d", fx.name, static_cast<unsigned>(mode),
+                   static_cast<unsigned>(pitch), compressor);
+          char value[32];
+          snprintf(value, sizeof(value), "%zu %08x", out.size(), static_cast<unsigned>(crc32(out)));
+          const bool keep = keep_samples(mode, pitch);
+          if (g_record) {
+            fprintf(list, "%s %s\n", key, value);
+            if (keep) {
+              write_wav((std::string(kGoldenDir) + file_key(key) + ".wav").c_str(), widen(out), 8);
+            }
+          } else {
+            const auto it = golden.find(key);
+            const bool same = it != golden.end() && it->second == value;
+            if (same) {
+              ++matched;
+            } else {
+              printf("  %s: %s, golden %s\n", key, value, it == golden.end() ? "missing" : it->second.c_str());
+              write_wav(("golden_actual/" + file_key(key) + ".wav").c_str(), widen(out), 8);
+              if (keep) {
+                report_first_difference(key, out);
+              }
+            }
+          }
+          // bit-exactness says nothing about quality: band-limited fixtures
+          // without a pitch effect must also survive the chain
+          if (fx.band_limited && pitch == TxFrontEnd::kPitchM1) {
+            const std::vector<int16_t> received = widen(out);
+            AudioQuality::Report report = {};
+            const bool analysed = AudioQuality::analyse(in.data(), in.size(), received.data(), received.size(),
+                                                        SAMPLE_RATE, fx.tone_hz, report);
+            printf("%-16s corr %.3f, SNR %4.1f dB, delay %d samples\n", key, report.correlation, report.snr_db,
+                   static_cast<int>(report.delay_samples));
+            CHECK(analysed);
+            CHECK_RANGE(report.correlation, kMinCorrelation, 1.0);
+            CHECK_RANGE(report.snr_db, kMinSnrDb, 200.0);
+            ++metric_runs;
+          }
+        }
+      }
+    }
+  }
+  if (list) {
+    fclose(list);
+    printf("%d outputs recorded to %s\n", runs, kGoldenList);
+  } else {
+    printf("%d runs, %d bit-exact against golden/, %d with tone/multitone metrics\n", runs, matched, metric_runs);
+    CHECK_EQ(matched, runs);
+  }
+  CHECK_EQ(dropped_total, 0);
+}
+
+void report_stages()
+{
+  double total = 0;
+  for (int s = 0; s < kStageCount; ++s) {
+    printf("stage %-9s %8.0f us total, %6.1f ns/sample\n", kStageNames[s], g_stage_ns[s] / 1000.0,
+           g_stage_ns[s] / g_samples_total);
+    total += g_stage_ns[s];
+  }
+  // every run is far faster than the audio it carries
+  const double audio_ns = 1e9 * g_samples_total / SAMPLE_RATE;
+  printf("chain %.1f ns/sample, %.0fx real time\n", total / g_samples_total, audio_ns / total);
+  CHECK_RANGE(total, 0.0, audio_ns / 10);
+}
+
+}  // namespace
+
+int main()
+{
+  const char *record = getenv("HOST_GOLDEN_RECORD");
+  g_record = record && record[0] == '1';
+  test_golden();
+  report_stages();
+  return host_test_exit("golden_audio");
+}
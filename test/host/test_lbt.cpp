@@ -0,0 +1,160 @@
+// Listen before talk with two stations: both press PTT at nearly the same
+// moment, or one presses while the other is already talking. Frames from the
+// other station reach ChannelActivity a few milliseconds after they are sent.
+#include <stdio.h>
+#include "ChannelActivity.h"
+#include "EspNowTransport.h"
+#include "host_test.h"
+#include "config.h"
+
+namespace {
+
+constexpr uint32_t kFrameMs = 15;     // first frame leaves one frame after key-up
+constexpr uint32_t kHearMs = 3;       // send to on_frame() at the other station
+constexpr uint32_t kTalkMs = 400;
+constexpr int kTrials = 20000;
+
+struct Lcg
+{
+  uint32_t state;
+  uint32_t next() { state = state * 1664525u + 1013904223u; return state >> 8; }
+};
+
+struct Station
+{
+  ChannelActivity activity{ EspNowTransport::kChannelBusyHoldMs };
+  uint32_t key_up_ms = 0;    // after the backoff
+  uint32_t first_ms = 0;     // first frame on air
+  bool keyed = false;
+  bool on_air = false;
+  bool yielded = false;
+};
+
+struct Result
+{
+  int collisions = 0;    // both stations on air
+  int yields = 0;
+  int nobody = 0;        // both gave way
+  int detected = 0;      // collisions seen as tx_collisions
+  uint32_t key_up_delay_ms = 0;
+};
+
+// both press within press_jitter_ms; hold: TX_LBT_POLICY_HOLD (backoff, give
+// way before the first frame), otherwise TX_LBT_POLICY_WARN (key up at once)
+Result simultaneous(bool hold, uint32_t press_jitter_ms, uint32_t backoff_max_ms)
+{
+  Lcg rng{ 12345 };
+  Result r;
+  for (int trial = 0; trial < kTrials; ++trial) {
+    Station s[2];
+    for (Station &st : s) {
+      const uint32_t press = 1000 + rng.next() % (press_jitter_ms + 1);
+      const uint32_t backoff = hold ? rng.next() % (backoff_max_ms + 1) : 0;
+      st.key_up_ms = press + backoff;
+      st.first_ms = st.key_up_ms + kFrameMs;
+      r.key_up_delay_ms += backoff;
+    }
+    for (uint32_t now = 1000; now < 1000 + press_jitter_ms + backoff_max_ms + kTalkMs; ++now) {
+      for (int i = 0; i < 2; ++i) {
+        const Station &o = s[1 - i];
+        if (o.on_air && now >= o.first_ms + kHearMs && (now - o.first_ms - kHearMs) % kFrameMs == 0) {
+          s[i].activity.on_frame(static_cast<uint16_t>(1 - i), now);
+        }
+      }
+      for (Station &st : s) {
+        if (st.yielded || st.on_air) {
+          continue;
+        }
+        if (now == st.key_up_ms) {
+          st.keyed = true;
+          st.activity.set_transmitting(true);
+        }
+        if (!st.keyed) {
+          continue;
+        }
+        if (hold && st.activity.busy(now)) {
+          st.yielded = true;
+        } else if (now == st.first_ms) {
+          st.on_air = true;
+        }
+      }
+    }
+    const bool collision = s[0].on_air && s[1].on_air;
+    r.collisions += collision ? 1 : 0;
+    r.yields += (s[0].yielded ? 1 : 0) + (s[1].yielded ? 1 : 0);
+    r.nobody += (!s[0].on_air && !s[1].on_air) ? 1 : 0;
+    ChannelActivity::Stats st0;
+    ChannelActivity::Stats st1;
+    s[0].activity.snapshot_and_reset_stats(st0);
+    s[1].activity.snapshot_and_reset_stats(st1);
+    r.detected += (collision && st0.tx_collisions + st1.tx_collisions > 0) ? 1 : 0;
+  }
+  printf("%s, presses within %2u ms, backoff 0-%2u ms: collisions %5.1f%%, yields %5.1f%%, "
+         "mean key-up delay %4.1f ms\n",
+         hold ? "hold" : "warn", static_cast<unsigned>(press_jitter_ms), static_cast<unsigned>(hold ? backoff_max_ms : 0),
+         100.0 * r.collisions / kTrials, 100.0 * r.yields / kTrials, r.key_up_delay_ms / (2.0 * kTrials));
+  return r;
+}
+
+void test_simultaneous()
+{
+  const uint32_t press_jitters[] = { 0, 20 };
+  for (uint32_t jitter : press_jitters) {
+    const Result warn = simultaneous(false, jitter, TX_LBT_BACKOFF_MAX_MS);
+    const Result hold_no_backoff = simultaneous(true, jitter, 0);
+    const Result hold = simultaneous(true, jitter, TX_LBT_BACKOFF_MAX_MS);
+    // without the hold nobody gives way: a backoff could only add delay
+    CHECK_EQ(warn.collisions, kTrials);
+    CHECK_EQ(warn.yields, 0);
+    CHECK_EQ(warn.key_up_delay_ms, 0);
+    CHECK_EQ(warn.detected, warn.collisions);
+    // with the hold one station always gets through and the backoff spreads
+    // the key-ups so that the other mostly hears it in time
+    CHECK_EQ(hold.nobody, 0);
+    CHECK_EQ(hold.detected, hold.collisions);
+    CHECK(hold.collisions < hold_no_backoff.collisions);
+    CHECK_RANGE(100.0 * hold.collisions / kTrials, 0.0, 25.0);
+    CHECK_RANGE(hold.key_up_delay_ms / (2.0 * kTrials), TX_LBT_BACKOFF_MAX_MS / 2.0 - 1, TX_LBT_BACKOFF_MAX_MS / 2.0 + 1);
+  }
+}
+
+// B presses 100 ms into A's talkspurt
+void test_busy_at_press(bool hold)
+{
+  Station b;
+  const uint32_t a_first = 1000;
+  const uint32_t a_end = a_first + 900;
+  const uint32_t press = a_first + 100;
+  uint32_t b_first = 0;
+  for (uint32_t now = a_first; now < a_end + 500 && b_first == 0; ++now) {
+    if (now < a_end && now >= a_first + kHearMs && (now - a_first - kHearMs) % kFrameMs == 0) {
+      b.activity.on_frame(1, now);
+    }
+    if (now == a_end + kHearMs) {
+      b.activity.on_end(1);
+    }
+    // PTT held from press on; under the hold it does nothing while the channel is busy
+    if (now >= press && !b.keyed && !(hold && b.activity.busy(now))) {
+      b.keyed = true;
+      b.activity.set_transmitting(true);
+      b_first = now + kFrameMs;
+    }
+  }
+  printf("%s, pressed 100 ms into another station's talkspurt: first frame %d ms after its end\n",
+         hold ? "hold" : "warn", static_cast<int>(b_first - a_end));
+  if (hold) {
+    CHECK_RANGE(b_first, a_end + kHearMs, a_end + kHearMs + kFrameMs);
+  } else {
+    CHECK_EQ(b_first, press + kFrameMs);
+  }
+}
+
+}  // namespace
+
+int main()
+{
+  test_simultaneous();
+  test_busy_at_press(false);
+  test_busy_at_press(true);
+  return host_test_exit("lbt");
+}
@@ -0,0 +1,222 @@
+// Link adaptation against a loss model: packet error rate grows as RSSI
+// falls and with packet length, so the short-frame modes really do lose
+// less. Also checks what each mode costs in quality.
+#include <math.h>
+#include <stdio.h>
+#include "FrameCodec.h"
+#include "LinkAdaptation.h"
+#include "host_test.h"
+
+namespace {
+
+// packet error rate at a given RSSI for a packet of this many bytes on air
+double packet_error_rate(double rssi, double bytes)
+{
+  // 50% for a 100 byte packet at -92 dBm, 2.5 dB per e-fold
+  const double per_100 = 1.0 / (1.0 + exp((rssi + 92.0) / 2.5));
+  return 1.0 - pow(1.0 - per_100, bytes / 100.0);
+}
+
+struct Lcg
+{
+  uint32_t state;
+  double next() { state = state * 1664525u + 1013904223u; return (state >> 8) / 16777216.0; }
+};
+
+struct Link
+{
+  LinkAdaptation la{ FrameCodec::kNumModes };
+  Lcg rng{ 1 };
+  int changes = 0;
+  uint32_t sent = 0;
+  uint32_t lost = 0;
+
+  // one second of talking at this RSSI; report_rssi false models a
+  // listener that cannot measure RSSI
+  void second(uint32_t sec, double rssi, bool report_rssi = true)
+  {
+    const LinkMode &mode = FrameCodec::kModes[la.get_mode()];
+    const double bytes = FrameCodec::payload_size(mode, mode.frame_samples) + 9;
+    const double per = packet_error_rate(rssi, bytes);
+    const int packets = 16000 / mode.frame_samples;
+    int period_lost = 0;
+    for (int i = 0; i < packets; ++i) {
+      la.on_send_result(true);
+      if (rng.next() < per) {
+        ++period_lost;
+      }
+    }
+    sent += packets;
+    lost += period_lost;
+    la.on_report(static_cast<uint16_t>(period_lost * 1000 / packets),
+                 report_rssi ? static_cast<int8_t>(lrint(rssi)) : LinkAdaptation::kRssiUnknown, sec * 1000 + 500);
+    if (la.update(sec * 1000 + 1000)) {
+      ++changes;
+    }
+  }
+};
+
+void test_codec_modes()
+{
+  // two tones, 60 and 30 steps
+  for (int m = 0; m < FrameCodec::kNumModes; ++m) {
+    const LinkMode &mode = FrameCodec::kModes[m];
+    FrameCodec enc;
+    FrameCodec dec;
+    double signal = 0;
+    double noise = 0;
+    uint8_t in[FrameCodec::kMaxFrameSamples];
+    uint8_t payload[256];
+    uint8_t out[FrameCodec::kMaxFrameSamples];
+    int t = 0;
+    int bad_frames = 0;
+    for (int f = 0; f < 200; ++f) {
+      for (int i = 0; i < mode.frame_samples; ++i, ++t) {
+        const double v = 60 * sin(2 * M_PI * 500 * t / 16000.0) + 30 * sin(2 * M_PI * 1500 * t / 16000.0);
+        in[i] = static_cast<uint8_t>(lrint(128 + v));
+      }
+      const size_t n = enc.encode(mode, in, mode.frame_samples, payload);
+      const size_t k = dec.decode(mode, payload, n, out, sizeof(out));
+      if (n != FrameCodec::payload_size(mode, mode.frame_samples) || k != mode.frame_samples) {
+        ++bad_frames;
+        continue;
+      }
+      if (f < 5) {
+        continue;
+      }
+      for (int i = 2; i < static_cast<int>(k) - 2; ++i) {
+        // the 8 kHz path lags by one sample
+        const double a = in[i] - 128.0;
+        const double b = out[i + (mode.rate_div == 2 ? 1 : 0)] - 128.0;
+        signal += a * a;
+        noise += (a - b) * (a - b);
+      }
+    }
+    CHECK_EQ(bad_frames, 0);
+    const size_t bytes = FrameCodec::payload_size(mode, mode.frame_samples);
+    if (mode.codec == FrameCodec::kCodecPcm8) {
+      printf("mode %d: %3zu byte payload, lossless\n", m, bytes);
+      CHECK_EQ(noise, 0);
+      continue;
+    }
+    const double snr = 10 * log10(signal / noise);
+    printf("mode %d: %3zu byte payload, %4.1f dB SNR\n", m, bytes, snr);
+    CHECK_RANGE(snr, mode.rate_div == 1 ? 25.0 : 15.0, 200.0);
+  }
+  // every step down the ladder sends shorter packets
+  for (int m = 1; m < FrameCodec::kNumModes; ++m) {
+    const LinkMode &a = FrameCodec::kModes[m - 1];
+    const LinkMode &b = FrameCodec::kModes[m];
+    CHECK(FrameCodec::payload_size(b, b.frame_samples) < FrameCodec::payload_size(a, a.frame_samples));
+  }
+}
+
+// walk away from the listener and back, 0.33 dB/s
+void test_walk(bool report_rssi)
+{
+  Link link;
+  link.la.reset(0);
+  int down_at[FrameCodec::kNumModes] = {};
+  int up_at[FrameCodec::kNumModes] = {};
+  for (uint32_t sec = 0; sec < 180; ++sec) {
+    const int rssi = -60 - static_cast<int>(sec < 90 ? sec : 180 - sec) / 3;
+    const int before = link.la.get_mode();
+    link.second(sec, rssi, report_rssi);
+    const int after = link.la.get_mode();
+    if (after > before) down_at[after] = rssi;
+    if (after < before) up_at[after] = rssi;
+  }
+  printf("walk, %-12s steps down at %d/%d/%d dBm, back up at %d/%d/%d dBm, %d changes, %.1f%% lost\n",
+         report_rssi ? "RSSI+loss" : "loss only", down_at[1], down_at[2], down_at[3], up_at[2], up_at[1], up_at[0],
+         link.changes, 100.0 * link.lost / link.sent);
+  // reaches the most robust mode at the far end and is back at full quality
+  CHECK(down_at[3] != 0);
+  CHECK_EQ(link.la.get_mode(), 0);
+  // each step at most once each way, give or take a loss spike
+  CHECK_RANGE(link.changes, 6, 10);
+  CHECK_RANGE(100.0 * link.lost / link.sent, 0.0, 5.0);
+  if (report_rssi) {
+    // RSSI steps down before loss shows, and up only with 6 dB of margin
+    CHECK_RANGE(down_at[1], -82, -78);
+    CHECK_RANGE(up_at[0], -75, -70);
+  }
+}
+
+void test_holdoff()
+{
+  Link link;
+  link.la.reset(0);
+  // clean, then one bad second
+  for (uint32_t sec = 0; sec < 5; ++sec) link.second(sec, -60);
+  for (int i = 0; i < 50; ++i) link.la.on_send_result(true);
+  link.la.on_report(200, -60, 5500);
+  CHECK(link.la.update(6000));
+  CHECK_EQ(link.la.get_mode(), 1);
+  // clean again: three clean periods are not enough inside the 5 s hold-off
+  int up_after = 0;
+  for (uint32_t sec = 6; sec < 20 && link.la.get_mode() == 1; ++sec) {
+    link.second(sec, -60);
+    up_after = static_cast<int>(sec + 1 - 6);
+  }
+  printf("after one bad second: back to mode 0 %d s later\n", up_after);
+  CHECK_EQ(link.la.get_mode(), 0);
+  CHECK_RANGE(up_after, 5, 6);
+}
+
+void test_no_reports()
+{
+  LinkAdaptation la(FrameCodec::kNumModes);
+  la.reset(0);
+  // nobody has ever reported: keep the mode
+  for (uint32_t sec = 1; sec <= 10; ++sec) {
+    la.on_send_result(true);
+    la.update(sec * 1000);
+  }
+  CHECK_EQ(la.get_mode(), 0);
+  // reports stop while talking: one step per report timeout
+  la.on_send_result(true);
+  la.on_report(0, -60, 10500);
+  la.update(11000);
+  for (uint32_t sec = 12; sec <= 21; ++sec) {
+    la.on_send_result(true);
+    la.update(sec * 1000);
+  }
+  CHECK_EQ(la.get_mode(), 3);
+  // between talkspurts the mode is held, and after a long pause too
+  LinkAdaptation idle(FrameCodec::kNumModes);
+  idle.reset(0);
+  idle.on_send_result(true);
+  idle.on_report(0, -60, 500);
+  idle.update(1000);
+  for (uint32_t sec = 2; sec <= 30; ++sec) {
+    idle.update(sec * 1000);
+  }
+  CHECK_EQ(idle.get_mode(), 0);
+  idle.on_send_result(true);
+  idle.update(31000);
+  CHECK_EQ(idle.get_mode(), 0);
+}
+
+void test_local_failures()
+{
+  LinkAdaptation la(FrameCodec::kNumModes);
+  la.reset(0);
+  // the listener hears everything, but one send in ten fails locally
+  for (int i = 0; i < 60; ++i) la.on_send_result(i % 10 != 0);
+  la.on_report(0, -60, 500);
+  CHECK(la.update(1000));
+  CHECK_EQ(la.get_worst_loss(), 100);
+}
+
+}  // namespace
+
+int main()
+{
+  test_codec_modes();
+  test_walk(true);
+  test_walk(false);
+  test_holdoff();
+  test_no_reports();
+  test_local_failures();
+  return host_test_exit("link_adaptation");
+}
@@ -0,0 +1,123 @@
+// Per-sender RSSI estimator: EWMA and window min/max, the LRU sender table,
+// and getRSSI() fed by received audio packets.
+#include <stdio.h>
+#include "LinkQuality.h"
+#include "host_platform.h"
+#include "host_test.h"
+#include "loopback_rig.h"
+
+namespace {
+
+void test_estimator()
+{
+  LinkQualityEstimator e;
+  e.reset();
+  CHECK_EQ(e.get_count(), 0);
+  CHECK_EQ(e.get_min(), -127);
+  CHECK_EQ(e.get_max(), -127);
+
+  // the first packet seeds the average
+  e.add(-60);
+  CHECK_EQ(e.get_ewma(), -60);
+  CHECK_EQ(e.get_min(), -60);
+  CHECK_EQ(e.get_max(), -60);
+
+  // a 20 dB step: alpha 1/8 covers about two thirds of it in 8 packets
+  for (int i = 0; i < 8; ++i) {
+    e.add(-80);
+  }
+  CHECK_RANGE(e.get_ewma(), -75, -72);
+  for (int i = 0; i < 56; ++i) {
+    e.add(-80);
+  }
+  CHECK_RANGE(e.get_ewma(), -80, -79);
+  // the -60 packet has left the 32-packet window
+  CHECK_EQ(e.get_max(), -80);
+  CHECK_EQ(e.get_count(), 65);
+
+  // fading between -70 and -90: the average sits in the middle
+  for (int i = 0; i < 64; ++i) {
+    e.add(static_cast<int8_t>(i & 1 ? -90 : -70));
+  }
+  CHECK_RANGE(e.get_ewma(), -82, -78);
+  CHECK_EQ(e.get_min(), -90);
+  CHECK_EQ(e.get_max(), -70);
+
+  e.reset();
+  CHECK_EQ(e.get_count(), 0);
+  CHECK_EQ(e.get_min(), -127);
+}
+
+void test_sender_table()
+{
+  SenderLinkTable t;
+  t.reset();
+  const uint8_t macs[5][6] = { { 1 }, { 2 }, { 3 }, { 4 }, { 5 } };
+  CHECK(t.most_recent(0, 2000) == nullptr);
+
+  for (int i = 0; i < 40; ++i) {
+    t.update(macs[0], static_cast<int8_t>(-60 - i % 5), i * 10);
+  }
+  t.update(macs[1], -80, 500);
+  t.update(macs[2], -70, 510);
+  t.update(macs[3], -70, 520);
+  // the table is full: the fifth sender evicts the one heard least recently
+  t.update(macs[4], -50, 530);
+  CHECK(t.find(macs[0]) == nullptr);
+  CHECK(t.find(macs[1]) != nullptr);
+
+  const SenderLinkTable::Entry *recent = t.most_recent(600, 2000);
+  CHECK(recent != nullptr && recent->mac[0] == 5);
+  CHECK(recent != nullptr && recent->rssi.get_ewma() == -50);
+  // a returning sender starts from scratch
+  t.update(macs[0], -90, 540);
+  const SenderLinkTable::Entry *back = t.find(macs[0]);
+  CHECK(back != nullptr && back->rssi.get_count() == 1 && back->rssi.get_ewma() == -90);
+  CHECK(t.find(macs[1]) == nullptr);
+
+  // nobody heard for longer than the timeout
+  CHECK(t.most_recent(5000, 2000) == nullptr);
+
+  // millis() wrapping between two senders
+  t.reset();
+  t.update(macs[0], -60, 0xfffffff0u);
+  t.update(macs[1], -70, 0x10);
+  recent = t.most_recent(0x20, 2000);
+  CHECK(recent != nullptr && recent->mac[0] == 2);
+}
+
+// RSSI reaches the display through accepted audio packets only
+void test_transport()
+{
+  LoopbackRig rig;
+  CHECK_EQ(rig.rx.getRSSI(), EspNowTransport::kRssiUnknown);
+  const uint8_t mac[6] = { 0x24, 0x0a, 0xc4, 0x00, 0x7a, 0x1c };
+  for (int frame = 0; frame < 20; ++frame) {
+    for (int i = 0; i < 236; ++i) {
+      rig.tx.add_sample_u8(128);
+    }
+    for (int p = 0; p < rig.tx.packet_count(); ++p) {
+      rig.rx.handle_receive(mac, -67, rig.tx.packet(p), static_cast<int>(rig.tx.packet_length(p)));
+    }
+    rig.tx.clear();
+    host_advance_ms(15);
+  }
+  CHECK_EQ(rig.rx.getRSSI(), -67);
+  // a packet from someone else's network does not count
+  const uint8_t junk[32] = { 'x' };
+  rig.rx.handle_receive(mac, -30, junk, sizeof(junk));
+  CHECK_EQ(rig.rx.getRSSI(), -67);
+  // stale after 2 s without audio
+  host_advance_ms(2500);
+  CHECK_EQ(rig.rx.getRSSI(), EspNowTransport::kRssiUnknown);
+}
+
+}  // namespace
+
+int main()
+{
+  test_estimator();
+  test_sender_table();
+  test_transport();
+  return host_test_exit("link_quality");
+}
@@ -0,0 +1,137 @@
+// The templated OutputBuffer against the runtime-sized ring it replaced:
+// identical 8-bit output on the receive path, and the cost per sample of
+// in-object storage with mask wrap versus arena storage with modulo wrap.
+#include <stdio.h>
+#include <chrono>
+#include <new>
+#include <vector>
+#include "AudioArena.h"
+#include "OutputBuffer.h"
+#include "config.h"
+#include "host_test.h"
+#include "legacy_output_buffer.h"
+
+namespace {
+
+using RxOutputBuffer = OutputBuffer<uint8_t, 8192>;
+using Pcm16OutputBuffer = OutputBuffer<int16_t, 8192>;
+
+constexpr int kTarget = 120 * 16;
+constexpr int kFrame = 236;
+constexpr int kChunk = 128;
+constexpr int kFrames = 40000;
+constexpr int kRuns = 5;
+
+struct Lcg
+{
+  uint32_t state;
+  uint32_t next() { state = state * 1664525u + 1013904223u; return state >> 8; }
+};
+
+// talker frames with 1% lost and an occasional SID; playout keeps up
+template <typename Buffer, typename SampleT>
+double run(Buffer &b, std::vector<SampleT> *out)
+{
+  Lcg rng{ 42 };
+  SampleT frame[kFrame];
+  SampleT chunk[kChunk];
+  int pending = 0;
+  const auto start = std::chrono::steady_clock::now();
+  for (int f = 0; f < kFrames; ++f) {
+    if (rng.next() % 100 == 0) {
+      b.add_concealment(kFrame);
+    } else {
+      for (int i = 0; i < kFrame; ++i) {
+        frame[i] = static_cast<SampleT>(rng.next());
+      }
+      b.add_samples(frame, kFrame);
+    }
+    if (f % 500 == 0) {
+      b.set_comfort_noise(static_cast<uint16_t>(200 + f % 1000));
+    }
+    pending += kFrame;
+    while (pending >= kChunk) {
+      b.remove_samples(chunk, kChunk);
+      pending -= kChunk;
+      if (out) {
+        out->insert(out->end(), chunk, chunk + kChunk);
+      }
+    }
+  }
+  const std::chrono::duration<double, std::nano> ns = std::chrono::steady_clock::now() - start;
+  return ns.count() / (2.0 * kFrames * kFrame);
+}
+
+template <typename Buffer, typename SampleT>
+double best_of(Buffer &b)
+{
+  double best = 1e9;
+  for (int r = 0; r < kRuns; ++r) {
+    const double ns = run<Buffer, SampleT>(b, nullptr);
+    best = ns < best ? ns : best;
+  }
+  return best;
+}
+
+void test_same_output()
+{
+  LegacyOutputBuffer legacy(kTarget);
+  RxOutputBuffer *rx = new (AudioArena::alloc("output buffer", sizeof(RxOutputBuffer), AudioArena::kInternal))
+      RxOutputBuffer(kTarget);
+  std::vector<uint8_t> a;
+  std::vector<uint8_t> b;
+  run(legacy, &a);
+  run(*rx, &b);
+  int mismatches = 0;
+  for (size_t i = 0; i < a.size() && i < b.size(); ++i) {
+    mismatches += (a[i] != b[i]) ? 1 : 0;
+  }
+  printf("%zu output samples, %d mismatches against the previous ring\n", b.size(), mismatches);
+  CHECK_EQ(a.size(), b.size());
+  CHECK_EQ(mismatches, 0);
+  uint32_t underruns = 0;
+  uint32_t overflows = 0;
+  rx->snapshot_and_reset_stats(underruns, overflows);
+  CHECK_EQ(overflows, 0);
+  rx->~RxOutputBuffer();
+}
+
+void test_speed()
+{
+  LegacyOutputBuffer legacy(kTarget);
+  RxOutputBuffer *rx = new (AudioArena::alloc("output buffer", sizeof(RxOutputBuffer), AudioArena::kInternal))
+      RxOutputBuffer(kTarget);
+  Pcm16OutputBuffer *pcm16 = new Pcm16OutputBuffer(kTarget);
+  const double ns_legacy = best_of<LegacyOutputBuffer, uint8_t>(legacy);
+  const double ns_rx = best_of<RxOutputBuffer, uint8_t>(*rx);
+  const double ns_pcm16 = best_of<Pcm16OutputBuffer, int16_t>(*pcm16);
+  printf("per sample in and out: %.1f ns previous ring (arena storage, %% %d), %.1f ns uint8_t template "
+         "(in-object, & %d), %.1f ns int16_t template\n",
+         ns_legacy, 3 * kTarget, ns_rx, RxOutputBuffer::get_buffer_size() - 1, ns_pcm16);
+  // matches or beats the loop it replaced; generous for a loaded machine
+  CHECK_RANGE(ns_rx, 0.0, ns_legacy * 1.1);
+  rx->~RxOutputBuffer();
+  delete pcm16;
+}
+
+// what Application relies on when it places the ring
+void test_arena_placement()
+{
+  void *p = AudioArena::alloc("output buffer", sizeof(RxOutputBuffer), AudioArena::kInternal);
+  CHECK(p != nullptr);
+  CHECK_EQ(reinterpret_cast<uintptr_t>(p) % AudioArena::kAlign, 0);
+  // a region that is full falls back to the heap instead of failing
+  void *q = AudioArena::alloc("too big", AUDIO_ARENA_INTERNAL_BYTES, AudioArena::kInternal);
+  CHECK(q != nullptr);
+}
+
+}  // namespace
+
+int main()
+{
+  AudioArena::begin(AUDIO_ARENA_INTERNAL_BYTES, AUDIO_ARENA_PSRAM_BYTES);
+  test_same_output();
+  test_speed();
+  test_arena_placement();
+  return host_test_exit("output_buffer");
+}
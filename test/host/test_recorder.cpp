@@ -0,0 +1,246 @@
+// Recorder into a MemoryRecordSink: talkspurts come back sample for sample
+// through tools/rec_to_wav.py, a writer that falls a whole ring behind loses
+// whole blocks (counted, and seen as a sequence gap by the tool), and a full
+// flash stops the recording cleanly.
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "Recorder.h"
+#include "host_platform.h"
+#include "host_test.h"
+#include "wav_io.h"
+
+namespace {
+
+constexpr int kRingBlocks = 8;
+constexpr size_t kChunk = 128;   // TX loop chunk, 8 ms
+constexpr uint32_t kChunkMs = kChunk * 1000 / 16000;
+constexpr uint32_t kWriterPollMs = Recorder::kWriterIdleMs;
+
+uint8_t g_ring[kRingBlocks * RecordRing::kBlockSize];
+uint32_t g_flash_ms_per_write = 0;
+
+void slow_flash(size_t)
+{
+  host_advance_ms(g_flash_ms_per_write);
+}
+
+struct Spurt
+{
+  Recorder::Direction dir;
+  uint16_t sender;
+  std::vector<uint8_t> samples;
+};
+
+std::vector<uint8_t> tone(size_t n, int period)
+{
+  std::vector<uint8_t> v(n);
+  for (size_t i = 0; i < n; ++i) {
+    v[i] = static_cast<uint8_t>(128 + 60 * ((static_cast<int>(i) % period) - period / 2) / period);
+  }
+  return v;
+}
+
+// one talkspurt in 8 ms chunks; the writer polls every kWriterPollMs unless
+// it is stalled
+void record(Recorder &rec, const Spurt &s, bool writer_running)
+{
+  rec.talkspurt(s.dir, s.sender, true);
+  uint32_t since_poll = 0;
+  for (size_t at = 0; at < s.samples.size(); at += kChunk) {
+    rec.audio(s.dir, s.sender, s.samples.data() + at, std::min(kChunk, s.samples.size() - at));
+    host_advance_ms(kChunkMs);
+    since_poll += kChunkMs;
+    if (writer_running && since_poll >= kWriterPollMs) {
+      rec.write_pending();
+      since_poll = 0;
+    }
+  }
+  rec.talkspurt(s.dir, s.sender, false);
+}
+
+void finish(Recorder &rec)
+{
+  rec.stop();
+  rec.write_pending();
+}
+
+struct Split
+{
+  std::vector<std::string> names;
+  std::vector<std::vector<uint8_t>> audio;
+  std::string log;
+};
+
+// runs tools/rec_to_wav.py on what the sink holds
+bool split_with_tool(const char *name, const MemoryRecordSink &sink, Split &out)
+{
+  const std::string bin = std::string(name) + ".bin";
+  FILE *f = fopen(bin.c_str(), "wb");
+  if (!f) {
+    return false;
+  }
+  fwrite(sink.data(), 1, sink.size(), f);
+  fclose(f);
+  const std::string cmd = "rm -rf " + std::string(name) + " && python3 " HOST_REPO_DIR "/tools/rec_to_wav.py " +
+                          bin + " " + name + " > " + name + ".log 2>&1";
+  if (system(cmd.c_str()) != 0) {
+    return false;
+  }
+  DIR *d = opendir(name);
+  if (!d) {
+    return false;
+  }
+  while (const dirent *e = readdir(d)) {
+    if (strstr(e->d_name, ".wav")) {
+      out.names.push_back(e->d_name);
+    }
+  }
+  closedir(d);
+  std::sort(out.names.begin(), out.names.end());
+  for (const std::string &wav : out.names) {
+    std::vector<int16_t> pcm;
+    if (!read_wav((std::string(name) + "/" + wav).c_str(), pcm)) {
+      return false;
+    }
+    std::vector<uint8_t> u8;
+    for (int16_t s : pcm) {
+      u8.push_back(static_cast<uint8_t>((s >> 8) + 128));
+    }
+    out.audio.push_back(u8);
+  }
+  FILE *log = fopen((std::string(name) + ".log").c_str(), "r");
+  char line[256];
+  while (log && fgets(line, sizeof(line), log)) {
+    out.log += line;
+  }
+  if (log) {
+    fclose(log);
+  }
+  return true;
+}
+
+void test_round_trip()
+{
+  static uint8_t flash[256 * 1024];
+  MemoryRecordSink sink(flash, sizeof(flash));
+  g_flash_ms_per_write = 6;
+  sink.set_write_hook(slow_flash);
+  Recorder rec(g_ring, sizeof(g_ring));
+  const Spurt spurts[] = {
+    { Recorder::kTx, 0x0001, tone(16000, 40) },
+    { Recorder::kRx, 0xbeef, tone(8000 + 77, 23) },
+    { Recorder::kTx, 0x0001, tone(4000, 61) },
+  };
+  CHECK(rec.start(&sink));
+  for (const Spurt &s : spurts) {
+    record(rec, s, true);
+  }
+  finish(rec);
+  Recorder::Stats stats;
+  rec.snapshot_stats(stats);
+  printf("round trip: %zu bytes in %u block writes, slowest %u ms, queued max %u/%d, dropped %u\n", sink.size(),
+         static_cast<unsigned>(sink.writes()), static_cast<unsigned>(stats.write_us_max / 1000),
+         static_cast<unsigned>(stats.max_queued), kRingBlocks, static_cast<unsigned>(stats.dropped_blocks));
+  CHECK(sink.closed());
+  CHECK(!rec.recording());
+  CHECK_EQ(stats.dropped_blocks, 0);
+  CHECK_EQ(stats.write_errors, 0);
+  CHECK_EQ(stats.bytes_written, sink.size());
+  CHECK_EQ(sink.size() % RecordRing::kBlockSize, 0);
+  CHECK_EQ(stats.write_us_max, g_flash_ms_per_write * 1000);
+
+  Split split;
+  CHECK(split_with_tool("rec_round_trip", sink, split));
+  CHECK_EQ(split.names.size(), 3);
+  for (size_t i = 0; i < split.names.size() && i < 3; ++i) {
+    printf("  %s: %zu samples\n", split.names[i].c_str(), split.audio[i].size());
+    CHECK(split.audio[i] == spurts[i].samples);
+  }
+  if (split.names.size() == 3) {
+    CHECK(split.names[0].find("_tx_0001_") != std::string::npos);
+    CHECK(split.names[1].find("_rx_beef_") != std::string::npos);
+  }
+  CHECK(split.log.find("dropped") == std::string::npos);
+}
+
+// the writer stalls for a talkspurt three rings long, then catches up
+void test_writer_behind()
+{
+  static uint8_t flash[256 * 1024];
+  MemoryRecordSink sink(flash, sizeof(flash));
+  Recorder rec(g_ring, sizeof(g_ring));
+  const Spurt stalled = { Recorder::kRx, 0x0042, tone(3 * kRingBlocks * RecordRing::kBlockSize, 50) };
+  const Spurt after = { Recorder::kTx, 0x0001, tone(16000, 33) };
+  CHECK(rec.start(&sink));
+  record(rec, stalled, false);
+  rec.write_pending();
+  record(rec, after, true);
+  finish(rec);
+  Recorder::Stats stats;
+  rec.snapshot_stats(stats);
+  Split split;
+  CHECK(split_with_tool("rec_writer_behind", sink, split));
+  const size_t kept = split.audio.empty() ? 0 : split.audio[0].size();
+  printf("writer behind: %u blocks dropped, queued max %u/%d, %zu of %zu samples of the stalled talkspurt kept\n",
+         static_cast<unsigned>(stats.dropped_blocks), static_cast<unsigned>(stats.max_queued), kRingBlocks, kept,
+         stalled.samples.size());
+  // all but one block waits for the writer; every later block is lost
+  CHECK_EQ(stats.max_queued, kRingBlocks - 1);
+  CHECK_RANGE(stats.dropped_blocks, 2 * kRingBlocks - 2, 2 * kRingBlocks + 3);
+  CHECK_EQ(stats.write_errors, 0);
+  char expect[64];
+  snprintf(expect, sizeof(expect), "%u blocks dropped on the device", static_cast<unsigned>(stats.dropped_blocks));
+  CHECK(split.log.find(expect) != std::string::npos);
+  // what survived is the start of the talkspurt and, once the writer caught
+  // up, its tail, both intact; the next talkspurt is whole
+  CHECK_EQ(split.names.size(), 2);
+  if (split.audio.size() == 2) {
+    const std::vector<uint8_t> &a = split.audio[0];
+    const size_t head = std::mismatch(a.begin(), a.end(), stalled.samples.begin()).first - a.begin();
+    const size_t tail = a.size() - head;
+    printf("  kept %zu samples from the start and %zu from the end\n", head, tail);
+    CHECK_RANGE(head, (kRingBlocks - 2) * RecordRing::kBlockSize, (kRingBlocks - 1) * RecordRing::kBlockSize);
+    CHECK_RANGE(tail, 0, RecordRing::kBlockSize);
+    CHECK(std::equal(a.begin() + head, a.end(), stalled.samples.end() - tail));
+    CHECK(split.audio[1] == after.samples);
+  }
+}
+
+// the flash fills up: the recording stops and the rest of the ring is thrown away
+void test_flash_full()
+{
+  static uint8_t flash[3 * RecordRing::kBlockSize];
+  MemoryRecordSink sink(flash, sizeof(flash));
+  Recorder rec(g_ring, sizeof(g_ring));
+  CHECK(rec.start(&sink));
+  record(rec, { Recorder::kTx, 0x0001, tone(16000 * 3, 40) }, true);
+  rec.write_pending();
+  Recorder::Stats stats;
+  rec.snapshot_stats(stats);
+  printf("flash full: %zu bytes kept, %u write errors, recording %s\n", sink.size(),
+         static_cast<unsigned>(stats.write_errors), rec.recording() ? "on" : "stopped");
+  CHECK_EQ(sink.size(), sizeof(flash));
+  CHECK_EQ(stats.write_errors, 1);
+  CHECK(!rec.recording());
+  CHECK(sink.closed());
+  // and it can start again
+  MemoryRecordSink next(flash, sizeof(flash));
+  CHECK(rec.start(&next));
+  finish(rec);
+  CHECK(next.closed());
+}
+
+}  // namespace
+
+int main()
+{
+  test_round_trip();
+  test_writer_behind();
+  test_flash_full();
+  return host_test_exit("recorder");
+}
@@ -0,0 +1,131 @@
+// Redundant previous-frame copies under random and burst loss: how many lost
+// frames come back, and how many audible dropouts that saves.
+#include <math.h>
+#include <stdio.h>
+#include <vector>
+#include "FrameCodec.h"
+#include "host_platform.h"
+#include "host_test.h"
+#include "loopback_rig.h"
+
+namespace {
+
+constexpr int kChunk = 128;
+constexpr uint32_t kChunkMs = kChunk * 1000 / SAMPLE_RATE;
+constexpr int kSeconds = 20;
+
+struct Lcg
+{
+  uint32_t state;
+  double next() { state = state * 1664525u + 1013904223u; return (state >> 8) / 16777216.0; }
+};
+
+// Gilbert-Elliott channel: every packet is lost in the bad state
+struct LossModel
+{
+  const char *name;
+  double p_enter_bad;   // per packet, from the good state
+  double p_stay_bad;
+};
+
+struct Result
+{
+  uint32_t audio_packets;
+  uint32_t lost;
+  uint32_t recovered;
+  uint32_t concealed;
+  double dropout_ms;   // played blocks that fell well below the source level
+};
+
+// a warbling tone: nothing repeats within the longest frame
+uint8_t source_sample(int t)
+{
+  const double f = 400.0 + 150.0 * sin(2.0 * M_PI * 0.7 * t / SAMPLE_RATE);
+  static double phase = 0;
+  if (t == 0) phase = 0;
+  phase += 2.0 * M_PI * f / SAMPLE_RATE;
+  return static_cast<uint8_t>(lrint(128.0 + 50.0 * sin(phase)));
+}
+
+Result run(int mode, bool redundancy, const LossModel &loss)
+{
+  LoopbackRig rig;
+  rig.tx.set_link_mode(static_cast<uint8_t>(mode));
+  rig.tx.set_redundancy(redundancy);
+  Lcg rng{ 7 };
+  bool bad = false;
+  std::vector<uint8_t> out;
+  uint8_t played[kChunk];
+  Result r = {};
+  for (int t = 0; t < kSeconds * SAMPLE_RATE; t += kChunk) {
+    for (int i = 0; i < kChunk; ++i) {
+      rig.tx.add_sample_u8(source_sample(t + i));
+    }
+    rig.deliver([&](int i) {
+      if (rig.tx.packet(i)[strlen(ESPNOW_PACKET_MAGIC_TEXT)] != Transport::kFrameTypeAudio) {
+        return false;
+      }
+      ++r.audio_packets;
+      bad = rng.next() < (bad ? loss.p_stay_bad : loss.p_enter_bad);
+      r.lost += bad ? 1 : 0;
+      return bad;
+    });
+    rig.buffer.remove_samples(played, kChunk);
+    out.insert(out.end(), played, played + kChunk);
+    host_advance_ms(kChunkMs);
+  }
+  EspNowTransportStats stats;
+  rig.rx.snapshot_and_reset_stats(stats);
+  r.recovered = stats.rx_recovered_frames;
+  r.concealed = stats.rx_concealed_frames;
+
+  // the source is 50 steps peak everywhere; concealment eases toward silence
+  constexpr int kBlock = 64;
+  for (size_t b = SAMPLE_RATE; b + kBlock <= out.size(); b += kBlock) {
+    double power = 0;
+    for (int i = 0; i < kBlock; ++i) {
+      const double v = out[b + i] - 128.0;
+      power += v * v;
+    }
+    if (sqrt(power / kBlock) < 50.0 / M_SQRT2 / 2) {
+      r.dropout_ms += kBlock * 1000.0 / SAMPLE_RATE;
+    }
+  }
+  return r;
+}
+
+}  // namespace
+
+int main()
+{
+  const LossModel models[] = {
+    { "random 5%", 0.05, 0.05 },
+    { "random 15%", 0.15, 0.15 },
+    // about 5% loss in bursts of three
+    { "bursts of ~3", 0.0175, 0.667 },
+  };
+  for (const LossModel &loss : models) {
+    for (int mode = 0; mode < FrameCodec::kNumModes; ++mode) {
+      const Result off = run(mode, false, loss);
+      const Result on = run(mode, true, loss);
+      const double recovered = on.lost ? 100.0 * on.recovered / on.lost : 0;
+      printf("%-13s mode %d: lost %4.1f%%, recovered %5.1f%% of them, dropouts %5.0f ms -> %5.0f ms with redundancy\n",
+             loss.name, mode, 100.0 * on.lost / on.audio_packets, recovered, off.dropout_ms, on.dropout_ms);
+      // without redundancy nothing is recovered and every loss is concealed
+      CHECK_EQ(off.recovered, 0);
+      CHECK_RANGE(off.concealed, off.lost * 0.9, off.lost * 1.1);
+      // every lost frame is either recovered or concealed
+      CHECK_RANGE(on.recovered + on.concealed, on.lost * 0.9, on.lost * 1.1);
+      if (loss.p_enter_bad == loss.p_stay_bad) {
+        // independent loss: the copy is there unless the next packet went too
+        CHECK_RANGE(recovered, 100.0 * (1.0 - loss.p_stay_bad) - 6.0, 100.0);
+        CHECK_RANGE(on.dropout_ms, 0.0, off.dropout_ms * (loss.p_stay_bad + 0.1));
+      } else {
+        // only the last frame of each burst comes back
+        CHECK_RANGE(recovered, 100.0 * (1.0 - loss.p_stay_bad) - 10.0, 100.0 * (1.0 - loss.p_stay_bad) + 15.0);
+        CHECK_RANGE(on.dropout_ms, 0.0, off.dropout_ms);
+      }
+    }
+  }
+  return host_test_exit("redundancy");
+}
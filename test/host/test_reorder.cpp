@@ -0,0 +1,199 @@
+// ReorderWindow behind a shuffling channel (jitter, loss, duplicates), and
+// the receiver letting go of a held frame when no further packet comes.
+#include <stdio.h>
+#include <algorithm>
+#include <vector>
+#include "ReorderWindow.h"
+#include "host_platform.h"
+#include "host_test.h"
+#include "loopback_rig.h"
+
+namespace {
+
+constexpr uint32_t kHoldMs = EspNowTransport::kReorderHoldMs;
+
+struct Lcg
+{
+  uint32_t state;
+  uint32_t next() { state = state * 1664525u + 1013904223u; return state >> 8; }
+  double uniform() { return next() / 16777216.0; }
+};
+
+struct Arrival
+{
+  uint32_t at_ms;
+  uint16_t seq;
+};
+
+// frames every frame_ms with 0..jitter_ms of delay; pop() runs every millisecond
+void test_shuffling_channel(uint32_t frame_ms, uint32_t jitter_ms, double loss, double dup)
+{
+  constexpr int kFrames = 5000;
+  Lcg rng{ 99 };
+  std::vector<Arrival> arrivals;
+  int lost = 0;
+  int duplicated = 0;
+  // start near the wrap of both counters
+  const uint16_t seq0 = 65000;
+  const uint32_t t0 = 0xfffff000u;
+  for (int i = 0; i < kFrames; ++i) {
+    const uint16_t seq = static_cast<uint16_t>(seq0 + i);
+    const uint32_t sent = t0 + i * frame_ms;
+    if (rng.uniform() < loss) {
+      ++lost;
+      continue;
+    }
+    arrivals.push_back({ sent + rng.next() % (jitter_ms + 1), seq });
+    if (rng.uniform() < dup) {
+      ++duplicated;
+      arrivals.push_back({ sent + rng.next() % (jitter_ms + 1), seq });
+    }
+  }
+  std::stable_sort(arrivals.begin(), arrivals.end(),
+                   [&](const Arrival &a, const Arrival &b) { return a.at_ms - t0 < b.at_ms - t0; });
+
+  ReorderWindow w(kHoldMs);
+  uint8_t payload[16] = {};
+  uint16_t expect = seq0;
+  int frames = 0;
+  int gaps = 0;
+  int out_of_order = 0;
+  uint32_t max_wait_ms = 0;
+  size_t next = 0;
+  const uint32_t end = t0 + kFrames * frame_ms + jitter_ms + kHoldMs + 10;
+  for (uint32_t now = t0; now != end; ++now) {
+    auto take = [&](const ReorderWindow::Release &r) {
+      out_of_order += (r.seq != expect) ? 1 : 0;
+      expect = static_cast<uint16_t>(r.seq + 1);
+      if (r.kind == ReorderWindow::kFrame) {
+        ++frames;
+        max_wait_ms = std::max(max_wait_ms, now - r.frame->arrival_ms);
+      } else {
+        ++gaps;
+      }
+    };
+    for (; next < arrivals.size() && arrivals[next].at_ms == now; ++next) {
+      while (!w.fits(arrivals[next].seq)) {
+        take(w.make_room());
+      }
+      w.insert(arrivals[next].seq, 0, payload, sizeof(payload), now);
+    }
+    for (;;) {
+      const ReorderWindow::Release r = w.pop(now, false);
+      if (r.kind == ReorderWindow::kNone) {
+        break;
+      }
+      take(r);
+    }
+  }
+  ReorderWindow::Stats stats;
+  w.snapshot_and_reset_stats(stats);
+  printf("%2u ms frames, 0-%2u ms jitter, %.0f%% loss, %.0f%% dup: %d frames, %d gaps, reordered %u, "
+         "duplicates %u, late %u, longest hold %u ms\n",
+         static_cast<unsigned>(frame_ms), static_cast<unsigned>(jitter_ms), loss * 100, dup * 100, frames, gaps,
+         static_cast<unsigned>(stats.reordered), static_cast<unsigned>(stats.duplicates),
+         static_cast<unsigned>(stats.late), static_cast<unsigned>(max_wait_ms));
+  // every slot comes out once, in order, each lost frame as a gap
+  CHECK_EQ(out_of_order, 0);
+  CHECK_EQ(frames + gaps, kFrames);
+  CHECK_EQ(gaps, lost);
+  CHECK_EQ(stats.duplicates, duplicated);
+  CHECK_EQ(stats.late, 0);
+  CHECK(stats.reordered > 0);
+  // released on time with pop() polled, never held past the limit
+  CHECK_RANGE(max_wait_ms, 0, kHoldMs);
+}
+
+// the last frames of a talkspurt: frame 8 is lost and frame 9 waits for it,
+// with no packet after it to trigger the release
+void test_held_frame_released_by_service()
+{
+  LoopbackRig rig;
+  const int frame_samples = FrameCodec::kModes[0].frame_samples;
+  for (int frame = 0; frame < 10; ++frame) {
+    for (int i = 0; i < frame_samples; ++i) {
+      rig.tx.add_sample_u8(static_cast<uint8_t>(100 + i % 50));
+    }
+    rig.deliver([&](int) { return frame == 8; });
+  }
+  const int before = rig.buffer.get_available_samples();
+  CHECK_EQ(before, 8 * frame_samples);
+
+  host_advance_ms(kHoldMs / 2);
+  rig.rx.service(millis());
+  CHECK_EQ(rig.buffer.get_available_samples(), before);
+
+  host_advance_ms(kHoldMs / 2);
+  rig.rx.service(millis());
+  // the gap is concealed, frame 9 follows it
+  CHECK_EQ(rig.buffer.get_available_samples(), before + 2 * frame_samples);
+  EspNowTransportStats stats;
+  rig.rx.snapshot_and_reset_stats(stats);
+  CHECK_EQ(stats.rx_concealed_frames, 1);
+  printf("held frame released by service() after %u ms\n", static_cast<unsigned>(kHoldMs));
+}
+
+// the low-latency profile: 5 ms frames, 30 ms jitter target, 8 ms play chunks
+// with service() once per chunk; one frame in 50 lost, its successor held
+uint32_t low_latency_underruns(uint32_t hold_ms)
+{
+  constexpr int kChunk = 128;
+  LoopbackRig rig(30 * 16);
+  rig.tx.set_frame_samples(5 * 16);
+  rig.rx.set_reorder_hold_ms(hold_ms);
+  int audio = 0;
+  uint8_t played[kChunk];
+  for (int t = 0; t < 10 * SAMPLE_RATE; t += kChunk) {
+    for (int i = 0; i < kChunk; ++i) {
+      rig.tx.add_sample_u8(static_cast<uint8_t>(100 + (t + i) % 50));
+    }
+    rig.deliver([&](int i) {
+      return rig.tx.packet(i)[strlen(ESPNOW_PACKET_MAGIC_TEXT)] == Transport::kFrameTypeAudio && ++audio % 50 == 0;
+    });
+    rig.buffer.remove_samples(played, kChunk);
+    host_advance_ms(kChunk * 1000 / SAMPLE_RATE);
+    rig.rx.service(millis());
+  }
+  uint32_t underruns = 0;
+  uint32_t overflows = 0;
+  rig.buffer.snapshot_and_reset_stats(underruns, overflows);
+  return underruns;
+}
+
+void test_low_latency_hold()
+{
+  const uint32_t with_default = low_latency_underruns(kHoldMs);
+  const uint32_t with_profile = low_latency_underruns(LOW_LATENCY_REORDER_HOLD_MS);
+  printf("low latency profile, 2%% loss: %u underruns with a %u ms hold, %u with %u ms\n",
+         static_cast<unsigned>(with_default), static_cast<unsigned>(kHoldMs),
+         static_cast<unsigned>(with_profile), static_cast<unsigned>(LOW_LATENCY_REORDER_HOLD_MS));
+  // the hold plus one service pass fits inside the 30 ms target
+  CHECK_EQ(with_profile, 0);
+  CHECK(with_default > 0);
+}
+
+// a frame stored after the caller read the clock has not waited at all
+void test_clock_read_before_insert()
+{
+  ReorderWindow w(kHoldMs);
+  uint8_t payload[4] = {};
+  w.insert(0, 0, payload, sizeof(payload), 1000);
+  w.pop(1000, false);
+  w.insert(2, 0, payload, sizeof(payload), 1005);
+  CHECK(w.pop(1004, false).kind == ReorderWindow::kNone);
+  CHECK(w.pop(1005 + kHoldMs - 1, false).kind == ReorderWindow::kNone);
+  CHECK(w.pop(1005 + kHoldMs, false).kind == ReorderWindow::kGap);
+}
+
+}  // namespace
+
+int main()
+{
+  test_shuffling_channel(10, 25, 0.03, 0.02);
+  test_shuffling_channel(5, 20, 0.05, 0.0);
+  test_shuffling_channel(15, 28, 0.01, 0.05);
+  test_held_frame_released_by_service();
+  test_low_latency_hold();
+  test_clock_read_before_insert();
+  return host_test_exit("reorder");
+}
@@ -0,0 +1,224 @@
+// ReplayHistory with a small ring (8 KB) so that sample wrap, eviction by an
+// overwritten first sample and eviction by a reused index slot all happen
+// many times. A reference list of every talkspurt appended says what get()
+// must still find, and whatever it finds must read back bit-exact.
+#include <stdio.h>
+#include <vector>
+#include "ReplayHistory.h"
+#include "host_test.h"
+
+namespace {
+
+constexpr size_t kMemoryBytes = 10000;   // capacity rounds down to 8192
+constexpr uint32_t kFrame = 128;
+constexpr uint32_t kFrameMs = 8;
+
+struct Lcg
+{
+  uint32_t state;
+  uint32_t next() { state = state * 1664525u + 1013904223u; return state >> 8; }
+};
+
+struct Reference
+{
+  uint32_t start;
+  uint32_t length;
+  uint16_t sender;
+  uint32_t t_ms;
+};
+
+uint8_t sample(uint32_t talkspurt, uint32_t i)
+{
+  return static_cast<uint8_t>((talkspurt * 73u) ^ (i * 29u) ^ (i >> 7));
+}
+
+class Feed
+{
+public:
+  explicit Feed(ReplayHistory &h) : m_h(h) {}
+
+  // one talkspurt of length samples in 128-sample frames; how it is set off
+  // from the previous one: 0 EOT, 1 another sender, 2 a pause over kGapMs
+  void talkspurt(uint32_t length, uint16_t sender, int split)
+  {
+    if (split == 0) {
+      m_h.end();
+    } else if (split == 2) {
+      m_t_ms += ReplayHistory::kGapMs + 1;
+    }
+    const uint32_t k = static_cast<uint32_t>(ref.size());
+    ref.push_back({ m_write_pos, length, sender, m_t_ms });
+    uint8_t frame[kFrame];
+    for (uint32_t done = 0; done < length; done += kFrame) {
+      const uint32_t n = (length - done < kFrame) ? length - done : kFrame;
+      for (uint32_t i = 0; i < n; ++i) {
+        frame[i] = sample(k, done + i);
+      }
+      m_h.append(sender, m_t_ms, frame, n);
+      m_t_ms += kFrameMs;
+    }
+    m_write_pos += length;
+  }
+
+  uint32_t write_pos() const { return m_write_pos; }
+  uint32_t t_ms() const { return m_t_ms; }
+  std::vector<Reference> ref;
+
+private:
+  ReplayHistory &m_h;
+  uint32_t m_write_pos = 0;
+  uint32_t m_t_ms = 1000;
+};
+
+struct Tally
+{
+  int found = 0;
+  int evicted = 0;
+  int wrong = 0;        // found when evicted or the other way round, or wrong metadata
+  int mismatched = 0;   // found, but samples differ
+};
+
+// every age up to past the index: found exactly when the model says so,
+// and then bit-exact, read in odd-sized pieces
+void verify(ReplayHistory &h, const Feed &feed, Tally &tally)
+{
+  const uint32_t n = static_cast<uint32_t>(feed.ref.size());
+  for (uint32_t age = 0; age < n + 4; ++age) {
+    ReplayHistory::Talkspurt ts;
+    const bool found = h.get(age, ts);
+    bool expect = false;
+    if (age < n) {
+      const Reference &r = feed.ref[n - 1 - age];
+      expect = age < ReplayHistory::kMaxTalkspurts && feed.write_pos() - r.start <= h.capacity();
+    }
+    tally.wrong += (found != expect);
+    if (!found) {
+      tally.evicted += (age < n);
+      continue;
+    }
+    ++tally.found;
+    const uint32_t k = n - 1 - age;
+    const Reference &r = feed.ref[k];
+    tally.wrong += (ts.id != k + 1 || ts.length != r.length || ts.sender != r.sender || ts.t_ms != r.t_ms);
+    uint8_t buf[300];
+    uint32_t offset = 0;
+    bool same = true;
+    while (offset < r.length) {
+      const size_t got = h.read(ts, offset, buf, 97 + offset % 200);
+      if (got == 0) {
+        same = false;
+        break;
+      }
+      for (size_t i = 0; i < got; ++i) {
+        same &= buf[i] == sample(k, offset + static_cast<uint32_t>(i));
+      }
+      offset += static_cast<uint32_t>(got);
+    }
+    same &= h.read(ts, r.length, buf, sizeof(buf)) == 0;
+    tally.mismatched += !same;
+  }
+}
+
+// 200 talkspurts of 300..3000 samples, split every way, checked after each
+void test_wrap_and_eviction()
+{
+  static uint8_t memory[kMemoryBytes];
+  ReplayHistory h;
+  h.init(memory, sizeof(memory));
+  CHECK_EQ(h.capacity(), 8192);
+  Feed feed(h);
+  Lcg rng{ 47 };
+  Tally tally;
+  uint16_t sender = 0x0101;
+  for (int i = 0; i < 200; ++i) {
+    int split = static_cast<int>(rng.next() % 3);
+    if (split == 1) {
+      sender = (sender == 0x0101) ? 0x0202 : 0x0101;
+    }
+    feed.talkspurt(300 + rng.next() % 2701, sender, split);
+    verify(h, feed, tally);
+  }
+  printf("200 talkspurts through %lu bytes (%lu samples, %.1f wraps): %d found, %d evicted, "
+         "%d wrong, %d mismatched\n",
+         static_cast<unsigned long>(h.capacity()), static_cast<unsigned long>(feed.write_pos()),
+         static_cast<double>(feed.write_pos()) / h.capacity(), tally.found, tally.evicted, tally.wrong,
+         tally.mismatched);
+  CHECK(feed.write_pos() > 30 * h.capacity());
+  CHECK(tally.found > 200);
+  CHECK_EQ(tally.wrong, 0);
+  CHECK_EQ(tally.mismatched, 0);
+}
+
+// more talkspurts than index slots, all still in the sample ring: the
+// oldest go with their slot
+void test_index_eviction()
+{
+  static uint8_t memory[kMemoryBytes];
+  ReplayHistory h;
+  h.init(memory, sizeof(memory));
+  Feed feed(h);
+  for (int i = 0; i < 80; ++i) {
+    feed.talkspurt(50, 0x0303, 0);
+  }
+  Tally tally;
+  verify(h, feed, tally);
+  printf("80 talkspurts of 50 samples: %d found, %d evicted with their index slot\n", tally.found, tally.evicted);
+  CHECK(feed.write_pos() < h.capacity());
+  CHECK_EQ(tally.found, ReplayHistory::kMaxTalkspurts);
+  CHECK_EQ(tally.evicted, 80 - static_cast<int>(ReplayHistory::kMaxTalkspurts));
+  CHECK_EQ(tally.wrong, 0);
+  CHECK_EQ(tally.mismatched, 0);
+}
+
+// a replay in progress: the open talkspurt grows under it, and an old one
+// stops reading once its samples are overwritten, even mid-way
+void test_live_reads()
+{
+  static uint8_t memory[kMemoryBytes];
+  ReplayHistory h;
+  h.init(memory, sizeof(memory));
+  Feed feed(h);
+  feed.talkspurt(2000, 0x0404, 0);
+  feed.talkspurt(1000, 0x0505, 1);
+  ReplayHistory::Talkspurt open;
+  CHECK(h.get(0, open));
+  CHECK_EQ(open.length, 1000);
+  // the same talkspurt goes on: no EOT, same sender, no pause
+  uint8_t more[kFrame];
+  for (uint32_t i = 0; i < kFrame; ++i) {
+    more[i] = static_cast<uint8_t>(i);
+  }
+  h.append(0x0505, feed.t_ms(), more, kFrame);
+  uint8_t buf[kFrame];
+  CHECK_EQ(h.read(open, 1000, buf, sizeof(buf)), kFrame);
+  CHECK_EQ(buf[5], 5);
+
+  ReplayHistory::Talkspurt old;
+  CHECK(h.get(1, old));
+  CHECK_EQ(h.read(old, 0, buf, 100), 100);
+  // 6000 more samples take the ring to 9128: the first 936 of it are gone
+  h.end();
+  for (int i = 0; i < 60; ++i) {
+    h.append(0x0606, feed.t_ms() + i * kFrameMs, more, 100);
+  }
+  CHECK_EQ(h.read(old, 0, buf, 100), 0);
+  CHECK_EQ(h.read(old, 1500, buf, 100), 100);
+  CHECK(!h.get(2, old));
+
+  // too little memory: history off, nothing kept
+  ReplayHistory off;
+  off.init(memory, 4000);
+  CHECK_EQ(off.capacity(), 0);
+  off.append(0x0707, 0, more, kFrame);
+  CHECK(!off.get(0, old));
+}
+
+}  // namespace
+
+int main()
+{
+  test_wrap_and_eviction();
+  test_index_eviction();
+  test_live_reads();
+  return host_test_exit("replay_history");
+}
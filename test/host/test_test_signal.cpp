@@ -0,0 +1,227 @@
+// The fixed-point TX test signals against their analytic definitions: the
+// NCO against an exact sine, tone level and period, the sweep frequency law
+// 100 Hz * 70^(t / 5 s) and its restart, the noise levels and spectra, and
+// the MLS period. The golden fixtures are written from these sources, so a
+// change here shows up first as a failure here rather than as a changed
+// golden.
+#include <math.h>
+#include <stdio.h>
+#include <algorithm>
+#include <vector>
+#include "TestSignal.h"
+#include "config.h"
+#include "host_test.h"
+
+namespace {
+
+std::vector<int16_t> take(TxSource &source, size_t count)
+{
+  std::vector<int16_t> out(count);
+  source.reset();
+  source.read(out.data(), count);
+  return out;
+}
+
+double rms(const std::vector<int16_t> &x, size_t from, size_t count)
+{
+  double sum = 0.0;
+  for (size_t i = from; i < from + count; ++i) {
+    sum += static_cast<double>(x[i]) * x[i];
+  }
+  return sqrt(sum / count);
+}
+
+int peak(const std::vector<int16_t> &x)
+{
+  int p = 0;
+  for (int16_t v : x) {
+    p = (abs(v) > p) ? abs(v) : p;
+  }
+  return p;
+}
+
+// upward zero crossings in [from, to), interpolated to a fraction of a sample
+std::vector<double> crossings(const std::vector<int16_t> &x, size_t from, size_t to)
+{
+  std::vector<double> t;
+  for (size_t i = from + 1; i < to; ++i) {
+    if (x[i - 1] < 0 && x[i] >= 0) {
+      t.push_back(i - 1 + static_cast<double>(-x[i - 1]) / (x[i] - x[i - 1]));
+    }
+  }
+  return t;
+}
+
+// mean frequency over a window centred on t_s
+double frequency_at(const std::vector<int16_t> &x, double t_s, double window_s)
+{
+  const size_t c = static_cast<size_t>(t_s * SAMPLE_RATE);
+  const size_t half = static_cast<size_t>(window_s * SAMPLE_RATE / 2);
+  const std::vector<double> t = crossings(x, c - half, c + half);
+  if (t.size() < 2) {
+    return 0.0;
+  }
+  return (t.size() - 1) * SAMPLE_RATE / (t.back() - t.front());
+}
+
+// Hann-windowed power at hz, averaged over blocks of 1024 samples (dB)
+double band_db(const std::vector<int16_t> &x, double hz)
+{
+  constexpr int kBlock = 1024;
+  const double w = 2.0 * M_PI * hz / SAMPLE_RATE;
+  double total = 0.0;
+  int blocks = 0;
+  for (size_t b = 0; b + kBlock <= x.size(); b += kBlock) {
+    double s1 = 0.0;
+    double s2 = 0.0;
+    for (int i = 0; i < kBlock; ++i) {
+      const double hann = 0.5 - 0.5 * cos(2.0 * M_PI * i / kBlock);
+      const double s = x[b + i] * hann + 2.0 * cos(w) * s1 - s2;
+      s2 = s1;
+      s1 = s;
+    }
+    total += s1 * s1 + s2 * s2 - 2.0 * cos(w) * s1 * s2;
+    ++blocks;
+  }
+  return 10.0 * log10(total / blocks);
+}
+
+void test_nco()
+{
+  int worst = 0;
+  for (uint32_t phase = 0; phase < 0xffff0000u; phase += 0x10001u) {
+    const double exact = 32767.0 * sin(2.0 * M_PI * phase / 4294967296.0);
+    const int err = static_cast<int>(fabs(Nco::sine_q15(phase) - exact) + 0.5);
+    worst = (err > worst) ? err : worst;
+  }
+  Nco nco;
+  nco.set_frequency(1000, SAMPLE_RATE);
+  printf("NCO: worst error %d LSB against an exact Q15 sine, 1 kHz increment 0x%08lx\n", worst,
+         static_cast<unsigned long>(nco.increment()));
+  CHECK_RANGE(worst, 0, 4);
+  CHECK_EQ(nco.increment(), 1u << 28);
+}
+
+void test_tone()
+{
+  static const uint16_t kTone[] = { TEST_SIGNAL_TONE_HZ };
+  ToneSource tone("tone", kTone, 1, TEST_SIGNAL_LEVEL, SAMPLE_RATE);
+  const std::vector<int16_t> x = take(tone, SAMPLE_RATE);
+  const int period = SAMPLE_RATE / TEST_SIGNAL_TONE_HZ;
+  int repeats = 0;
+  for (size_t i = period; i < x.size(); ++i) {
+    repeats += (x[i] == x[i - period]);
+  }
+  const double level_rms = rms(x, 0, x.size());
+  printf("tone %d Hz: peak %d, rms %.1f (%.1f expected), period %d samples exact for %d of %d\n",
+         TEST_SIGNAL_TONE_HZ, peak(x), level_rms, TEST_SIGNAL_LEVEL / M_SQRT2, period, repeats,
+         static_cast<int>(x.size()) - period);
+  CHECK_RANGE(peak(x), TEST_SIGNAL_LEVEL - 3, TEST_SIGNAL_LEVEL);
+  CHECK_RANGE(level_rms, TEST_SIGNAL_LEVEL / M_SQRT2 * 0.999, TEST_SIGNAL_LEVEL / M_SQRT2 * 1.001);
+  CHECK_EQ(repeats, static_cast<int>(x.size()) - period);
+  CHECK_RANGE(frequency_at(x, 0.5, 0.1), TEST_SIGNAL_TONE_HZ - 0.5, TEST_SIGNAL_TONE_HZ + 0.5);
+  // reset() restarts the same audio
+  CHECK(take(tone, 64) == std::vector<int16_t>(x.begin(), x.begin() + 64));
+
+  static const uint16_t kMultiTone[] = { TEST_SIGNAL_MULTITONE_HZ };
+  constexpr int kTones = sizeof(kMultiTone) / sizeof(kMultiTone[0]);
+  ToneSource multi("multitone", kMultiTone, kTones, TEST_SIGNAL_LEVEL, SAMPLE_RATE);
+  const std::vector<int16_t> m = take(multi, SAMPLE_RATE);
+  // equal shares: each tone at level / count, powers add
+  const double expect = TEST_SIGNAL_LEVEL / kTones / M_SQRT2 * sqrt(static_cast<double>(kTones));
+  printf("multitone: peak %d, rms %.1f (%.1f expected)\n", peak(m), rms(m, 0, m.size()), expect);
+  CHECK_RANGE(peak(m), 0, TEST_SIGNAL_LEVEL);
+  CHECK_RANGE(rms(m, 0, m.size()), expect * 0.99, expect * 1.01);
+}
+
+void test_sweep()
+{
+  SweepSource sweep(TEST_SIGNAL_SWEEP_START_HZ, TEST_SIGNAL_SWEEP_END_HZ, TEST_SIGNAL_SWEEP_MS, TEST_SIGNAL_LEVEL,
+                    SAMPLE_RATE);
+  const double period_s = TEST_SIGNAL_SWEEP_MS / 1000.0;
+  const double ratio = static_cast<double>(TEST_SIGNAL_SWEEP_END_HZ) / TEST_SIGNAL_SWEEP_START_HZ;
+  const std::vector<int16_t> x = take(sweep, static_cast<size_t>(2.2 * period_s * SAMPLE_RATE));
+  const double times[] = { 0.25, 1.0, 2.5, 4.0, 4.9, 5.25, 7.5 };
+  for (double t : times) {
+    const double expect = TEST_SIGNAL_SWEEP_START_HZ * pow(ratio, fmod(t, period_s) / period_s);
+    const double f = frequency_at(x, t, 0.04);
+    printf("sweep at %.2f s: %7.1f Hz (%7.1f expected)\n", t, f, expect);
+    CHECK_RANGE(f, expect * 0.99, expect * 1.01);
+  }
+  // the restart: the first long half period after the fast end of the sweep
+  const std::vector<double> c = crossings(x, static_cast<size_t>(4.9 * SAMPLE_RATE),
+                                          static_cast<size_t>(5.2 * SAMPLE_RATE));
+  double restart_s = 0.0;
+  for (size_t i = 1; i < c.size(); ++i) {
+    if (c[i] - c[i - 1] > 20.0) {
+      restart_s = c[i - 1] / SAMPLE_RATE;
+      break;
+    }
+  }
+  printf("sweep restarts at %.4f s, peak %d\n", restart_s, peak(x));
+  CHECK_RANGE(restart_s, period_s - 0.002, period_s + 0.002);
+  CHECK_RANGE(peak(x), TEST_SIGNAL_LEVEL - 3, TEST_SIGNAL_LEVEL);
+}
+
+void test_noise()
+{
+  NoiseSource white(NoiseSource::kWhite, TEST_SIGNAL_LEVEL);
+  NoiseSource pink(NoiseSource::kPink, TEST_SIGNAL_LEVEL);
+  const std::vector<int16_t> w = take(white, 20 * SAMPLE_RATE);
+  const std::vector<int16_t> p = take(pink, 20 * SAMPLE_RATE);
+  // uniform over +-level
+  const double white_rms = TEST_SIGNAL_LEVEL / sqrt(3.0);
+  printf("white: rms %.1f (%.1f expected), peak %d; pink: rms %.1f, peak %d\n", rms(w, 0, w.size()), white_rms,
+         peak(w), rms(p, 0, p.size()), peak(p));
+  CHECK_RANGE(rms(w, 0, w.size()), white_rms * 0.99, white_rms * 1.01);
+  CHECK_RANGE(peak(w), 0, TEST_SIGNAL_LEVEL);
+  CHECK_RANGE(peak(p), 0, TEST_SIGNAL_LEVEL);
+  CHECK(take(pink, 1000) == std::vector<int16_t>(p.begin(), p.begin() + 1000));
+
+  const double bands[] = { 250, 500, 1000, 2000, 4000 };
+  printf("octave steps, dB:");
+  for (int i = 1; i < 5; ++i) {
+    const double white_step = band_db(w, bands[i]) - band_db(w, bands[i - 1]);
+    const double pink_step = band_db(p, bands[i]) - band_db(p, bands[i - 1]);
+    printf(" %g Hz white %+.2f pink %+.2f;", bands[i], white_step, pink_step);
+    CHECK_RANGE(white_step, -1.0, 1.0);
+    CHECK_RANGE(pink_step, -4.5, -2.0);
+  }
+  const double pink_slope = (band_db(p, bands[4]) - band_db(p, bands[0])) / 4;
+  printf(" pink %.2f dB/octave\n", pink_slope);
+  CHECK_RANGE(pink_slope, -4.0, -3.0);
+}
+
+void test_mls()
+{
+  MlsSource mls(TEST_SIGNAL_LEVEL);
+  const std::vector<int16_t> x = take(mls, 2 * MlsSource::kPeriod + 10);
+  int ones = 0;
+  int repeats = 0;
+  for (uint32_t i = 0; i < MlsSource::kPeriod; ++i) {
+    ones += (x[i] == TEST_SIGNAL_LEVEL);
+    repeats += (x[i] == x[i + MlsSource::kPeriod]);
+  }
+  // the sequence does not repeat before its period
+  int earlier = 0;
+  for (uint32_t d = 1; d < MlsSource::kPeriod; d += 97) {
+    earlier += std::equal(x.begin(), x.begin() + 64, x.begin() + d);
+  }
+  printf("MLS: %d of %lu samples high, period %lu exact for %d\n", ones,
+         static_cast<unsigned long>(MlsSource::kPeriod), static_cast<unsigned long>(MlsSource::kPeriod), repeats);
+  CHECK_EQ(ones, (MlsSource::kPeriod + 1) / 2);
+  CHECK_EQ(repeats, MlsSource::kPeriod);
+  CHECK_EQ(earlier, 0);
+}
+
+}  // namespace
+
+int main()
+{
+  test_nco();
+  test_tone();
+  test_sweep();
+  test_noise();
+  test_mls();
+  return host_test_exit("test_signal");
+}
@@ -0,0 +1,221 @@
+// Trace ring across the 32-bit microsecond clock wrap: more events than the
+// ring holds, recorded either side of the wrap, dumped over Serial and
+// checked oldest first. The dump then goes through
+// tools/trace_to_chrome.py, which has to unwrap the clock. Host wall time
+// per record() call is printed for reference; "trace bench" gives the
+// device figure in cycles.
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "Trace.h"
+#include "host_platform.h"
+#include "host_test.h"
+
+namespace {
+
+constexpr uint32_t kEvents = 3000;
+constexpr uint32_t kStepUs = 2;
+// the wrap falls between events 1499 and 1500
+constexpr int64_t kStartUs = (int64_t(1) << 32) - 1500 * kStepUs;
+
+std::string g_serial;
+
+void capture(const char *text, size_t len)
+{
+  g_serial.append(text, len);
+}
+
+struct Event
+{
+  uint32_t t_us;
+  unsigned id;
+  unsigned core;
+  unsigned arg;
+};
+
+struct Dump
+{
+  unsigned long events = 0;
+  unsigned long overwritten = 0;
+  int names = 0;
+  bool ended = false;
+  std::vector<Event> list;
+};
+
+Dump parse(const std::string &text)
+{
+  Dump d;
+  size_t pos = 0;
+  while (pos < text.size()) {
+    size_t end = text.find('\n', pos);
+    if (end == std::string::npos) {
+      end = text.size();
+    }
+    const std::string line = text.substr(pos, end - pos);
+    pos = end + 1;
+    unsigned long t;
+    Event e;
+    char name[32];
+    char phase;
+    if (sscanf(line.c_str(), "TRACE BEGIN events=%lu overwritten=%lu", &d.events, &d.overwritten) == 2) {
+      continue;
+    }
+    if (sscanf(line.c_str(), "TRACE NAME %u %31s %c", &e.id, name, &phase) == 3) {
+      ++d.names;
+      continue;
+    }
+    if (line == "TRACE END") {
+      d.ended = true;
+      continue;
+    }
+    if (sscanf(line.c_str(), "TRACE %lu %u %u %u", &t, &e.id, &e.core, &e.arg) == 4) {
+      e.t_us = static_cast<uint32_t>(t);
+      d.list.push_back(e);
+    }
+  }
+  return d;
+}
+
+Dump dump()
+{
+  g_serial.clear();
+  Trace::dump();
+  return parse(g_serial);
+}
+
+// newest kCapacity events, oldest first, one clock wrap between them
+void test_wrap_order()
+{
+  host_set_time_us(kStartUs);
+  Trace::clear();
+  Trace::set_enabled(true);
+  for (uint32_t i = 0; i < kEvents; ++i) {
+    Trace::record(kTraceRxFrame, static_cast<uint16_t>(i));
+    host_advance_us(kStepUs);
+  }
+  const Dump d = dump();
+  int wraps = 0;
+  int out_of_order = 0;
+  uint64_t prev = 0;
+  for (size_t i = 0; i < d.list.size(); ++i) {
+    if (i > 0 && d.list[i].t_us < d.list[i - 1].t_us) {
+      ++wraps;
+    }
+    const uint64_t t = d.list[i].t_us + (static_cast<uint64_t>(wraps) << 32);
+    const unsigned expect_arg = kEvents - Trace::kCapacity + i;
+    if (d.list[i].arg != expect_arg || d.list[i].id != kTraceRxFrame || (i > 0 && t != prev + kStepUs)) {
+      ++out_of_order;
+    }
+    prev = t;
+  }
+  printf("%lu events recorded across the clock wrap: dump holds %lu (overwritten %lu), %d wrap, %d out of order\n",
+         static_cast<unsigned long>(kEvents), d.events, d.overwritten, wraps, out_of_order);
+  CHECK_EQ(d.events, Trace::kCapacity);
+  CHECK_EQ(d.overwritten, kEvents - Trace::kCapacity);
+  CHECK_EQ(d.names, kTraceEventCount);
+  CHECK(d.ended);
+  CHECK_EQ(d.list.size(), Trace::kCapacity);
+  CHECK_EQ(wraps, 1);
+  CHECK_EQ(out_of_order, 0);
+
+  // the dump empties the ring and leaves recording as it was
+  CHECK(Trace::get_enabled());
+  CHECK_EQ(dump().events, 0);
+  Trace::set_enabled(false);
+  for (int i = 0; i < 100; ++i) {
+    TRACE_EVENT(kTraceMicRead, i);
+  }
+  CHECK_EQ(dump().events, 0);
+  CHECK(!Trace::get_enabled());
+}
+
+// the converter unwraps the clock: ts rises by kStepUs in recording order
+void test_converter()
+{
+  host_set_time_us(kStartUs);
+  Trace::clear();
+  Trace::set_enabled(true);
+  for (uint32_t i = 0; i < kEvents; ++i) {
+    Trace::record(kTraceRxFrame, static_cast<uint16_t>(i));
+    host_advance_us(kStepUs);
+  }
+  g_serial.clear();
+  Trace::dump();
+  FILE *f = fopen("trace_wrap.log", "w");
+  CHECK(f != nullptr);
+  if (!f) {
+    return;
+  }
+  fwrite(g_serial.data(), 1, g_serial.size(), f);
+  fclose(f);
+  const int rc = system("python3 " HOST_REPO_DIR "/tools/trace_to_chrome.py trace_wrap.log trace_wrap.json > /dev/null");
+  if (rc != 0) {
+    printf("trace_to_chrome.py did not run (exit %d), converter not checked\n", rc);
+    return;
+  }
+  f = fopen("trace_wrap.json", "r");
+  CHECK(f != nullptr);
+  if (!f) {
+    return;
+  }
+  std::string json;
+  char buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+    json.append(buf, n);
+  }
+  fclose(f);
+  // events follow the thread_name metadata, sorted by ts
+  int events = 0;
+  int bad = 0;
+  uint64_t first_ts = 0;
+  uint64_t prev_ts = 0;
+  unsigned prev_arg = 0;
+  for (size_t pos = json.find("\"ts\": "); pos != std::string::npos; pos = json.find("\"ts\": ", pos + 1)) {
+    const uint64_t ts = strtoull(json.c_str() + pos + 6, nullptr, 10);
+    const size_t a = json.find("\"arg\": ", pos);
+    const unsigned arg = static_cast<unsigned>(strtoul(json.c_str() + a + 7, nullptr, 10));
+    if (events == 0) {
+      first_ts = ts;
+      bad += (arg != kEvents - Trace::kCapacity);
+    } else {
+      bad += (ts != prev_ts + kStepUs || arg != prev_arg + 1);
+    }
+    prev_ts = ts;
+    prev_arg = arg;
+    ++events;
+  }
+  printf("trace_to_chrome.py: %d events, ts %llu..%llu us, %d out of order\n", events,
+         static_cast<unsigned long long>(first_ts), static_cast<unsigned long long>(prev_ts), bad);
+  CHECK_EQ(events, Trace::kCapacity);
+  CHECK_EQ(bad, 0);
+  CHECK(prev_ts > (uint64_t(1) << 32));
+}
+
+double ns_per_record(bool enabled)
+{
+  constexpr int kRuns = 1000000;
+  Trace::clear();
+  Trace::set_enabled(enabled);
+  const auto t0 = std::chrono::steady_clock::now();
+  for (int i = 0; i < kRuns; ++i) {
+    TRACE_EVENT(kTraceMicRead, i);
+  }
+  const auto t1 = std::chrono::steady_clock::now();
+  Trace::clear();
+  return std::chrono::duration<double, std::nano>(t1 - t0).count() / kRuns;
+}
+
+}  // namespace
+
+int main()
+{
+  host_set_serial_hook(capture);
+  test_wrap_order();
+  test_converter();
+  printf("host record(): %.1f ns/event recording, %.1f ns when off\n", ns_per_record(true), ns_per_record(false));
+  host_set_serial_hook(nullptr);
+  return host_test_exit("trace");
+}
@@ -0,0 +1,235 @@
+// TxPowerControl against a path-loss model: RSSI at the listener is the
+// transmit power minus the path loss, the listener reports the period's RSSI
+// and loss once a second, and the control law has to settle near the target,
+// recover from fades at once and save current without costing packets.
+#include <math.h>
+#include <stdio.h>
+#include "TxPowerControl.h"
+#include "config.h"
+#include "host_test.h"
+
+namespace {
+
+constexpr uint32_t kFrameMs = 15;
+constexpr int kTarget = TX_POWER_TARGET_RSSI;
+
+struct Lcg
+{
+  uint32_t state;
+  double uniform() { state = state * 1664525u + 1013904223u; return ((state >> 8) + 0.5) / 16777216.0; }
+  double normal() { return sqrt(-2.0 * log(uniform())) * cos(2.0 * M_PI * uniform()); }
+};
+
+// packet error rate at the listener: 50% at -95 dBm, 1.5 dB per e-fold
+double packet_error_rate(double rssi)
+{
+  return 1.0 / (1.0 + exp((rssi + 95.0) / 1.5));
+}
+
+double dbm(int qdbm)
+{
+  return qdbm / 4.0;
+}
+
+struct Link
+{
+  TxPowerControl pc{ TX_POWER_MIN_QDBM, TX_POWER_MAX_QDBM, kTarget };
+  Lcg rng{ 3 };
+  int changes = 0;
+  uint32_t frames = 0;
+  uint32_t lost = 0;
+  uint32_t period_frames = 0;
+  uint32_t period_lost = 0;
+  double period_rssi = 0;
+  double current = 0;
+
+  Link() { pc.reset(0); }
+
+  // talk for one frame at this path loss; the listener reports each second
+  void frame(uint32_t now_ms, double path_loss_db)
+  {
+    const double rssi = dbm(pc.get_qdbm()) - path_loss_db;
+    const bool lost_frame = rng.uniform() < packet_error_rate(rssi);
+    pc.on_send();
+    ++frames;
+    ++period_frames;
+    current += TxPowerControl::estimate_tx_current_ma(pc.get_qdbm());
+    if (lost_frame) {
+      ++lost;
+      ++period_lost;
+    } else {
+      period_rssi += rssi;
+    }
+    if (now_ms % 1000 < kFrameMs && period_frames > period_lost) {
+      const int8_t reported = static_cast<int8_t>(lrint(period_rssi / (period_frames - period_lost)));
+      pc.on_report(static_cast<uint16_t>(period_lost * 1000 / period_frames), reported, now_ms);
+      period_frames = 0;
+      period_lost = 0;
+      period_rssi = 0;
+    }
+    if (pc.update(now_ms)) {
+      ++changes;
+    }
+  }
+
+  void talk(uint32_t from_ms, uint32_t to_ms, double path_loss_db)
+  {
+    for (uint32_t ms = from_ms; ms < to_ms; ms += kFrameMs) {
+      frame(ms, path_loss_db);
+    }
+  }
+
+  double rssi(double path_loss_db) const { return dbm(pc.get_qdbm()) - path_loss_db; }
+};
+
+// fixed path loss: from full power down to the target, then no hunting
+void test_settles(double path_loss_db)
+{
+  Link link;
+  link.talk(0, 60000, path_loss_db);
+  const int changes_settling = link.changes;
+  link.talk(60000, 120000, path_loss_db);
+  const double rssi = link.rssi(path_loss_db);
+  printf("path loss %3.0f dB: %4.1f dBm TX, %5.1f dBm at the listener, %2d changes to settle, %d after\n",
+         path_loss_db, dbm(link.pc.get_qdbm()), rssi, changes_settling, link.changes - changes_settling);
+  const double wanted = kTarget + path_loss_db;
+  if (wanted >= dbm(TX_POWER_MAX_QDBM)) {
+    CHECK_EQ(link.pc.get_qdbm(), TX_POWER_MAX_QDBM);
+  } else if (wanted <= dbm(TX_POWER_MIN_QDBM)) {
+    CHECK_EQ(link.pc.get_qdbm(), TX_POWER_MIN_QDBM);
+  } else {
+    // inside the hysteresis band; the last 2 dB down step may land just below it
+    CHECK_RANGE(rssi, kTarget - TxPowerControl::kHysteresisDb - 1.0,
+                kTarget + TxPowerControl::kHysteresisDb + 1.0);
+  }
+  CHECK_EQ(link.changes - changes_settling, 0);
+  CHECK_EQ(link.lost, 0);
+}
+
+// a 15 dB fade while settled: the next report closes the whole shortfall
+void test_fade()
+{
+  Link link;
+  const double path_loss = 70;
+  link.talk(0, 60000, path_loss);
+  const int before = link.pc.get_qdbm();
+  bool restored = false;
+  uint32_t restored_ms = 0;
+  for (uint32_t ms = 60000; ms < 70000; ms += kFrameMs) {
+    link.frame(ms, path_loss + 15);
+    if (!restored && link.rssi(path_loss + 15) >= kTarget - TxPowerControl::kHysteresisDb) {
+      restored = true;
+      restored_ms = ms - 60000;
+    }
+  }
+  printf("15 dB fade at %3.0f dB path loss: %4.1f -> %4.1f dBm TX, back above target-%d dB after %u ms\n",
+         path_loss, dbm(before), dbm(link.pc.get_qdbm()), TxPowerControl::kHysteresisDb,
+         static_cast<unsigned>(restored_ms));
+  CHECK(restored);
+  CHECK_RANGE(restored_ms, 0, 2 * TxPowerControl::kPeriodMs);
+}
+
+// heavy loss goes straight to maximum; so does silence from every listener
+void test_loss_and_timeout()
+{
+  TxPowerControl pc(TX_POWER_MIN_QDBM, TX_POWER_MAX_QDBM, kTarget);
+  pc.reset(0);
+  uint32_t now = 0;
+  for (int i = 0; i < 30 && pc.get_qdbm() > TX_POWER_MIN_QDBM; ++i) {
+    now += 1000;
+    pc.on_send();
+    pc.on_report(0, -40, now - 500);
+    pc.update(now);
+  }
+  CHECK_EQ(pc.get_qdbm(), TX_POWER_MIN_QDBM);
+  now += 1000;
+  pc.on_send();
+  pc.on_report(TxPowerControl::kMaxLossPermille, -40, now - 500);
+  CHECK(pc.update(now));
+  CHECK_EQ(pc.get_qdbm(), TX_POWER_MAX_QDBM);
+
+  pc.set_applied_qdbm(TX_POWER_MIN_QDBM);
+  const uint32_t last_report = now;
+  while (pc.get_qdbm() != TX_POWER_MAX_QDBM && now - last_report < 10000) {
+    now += 1000;
+    pc.on_send();
+    pc.update(now);
+  }
+  CHECK_EQ(now - last_report, TxPowerControl::kReportTimeoutMs);
+
+  // between talkspurts nothing changes, however long
+  pc.set_applied_qdbm(40);
+  for (int i = 0; i < 20; ++i) {
+    now += 1000;
+    pc.update(now);
+  }
+  CHECK_EQ(pc.get_qdbm(), 40);
+}
+
+// a listener walking 5..200 m and back with log-normal shadowing and
+// 15 dB body fades: close to full-power loss for less current
+void test_walk()
+{
+  Link link;
+  Lcg shadow_rng{ 11 };
+  double shadow = 0;
+  uint32_t lost_max_power = 0;
+  double current_max = 0;
+  for (uint32_t ms = 0; ms < 600000; ms += kFrameMs) {
+    const double t = ms / 1000.0;
+    const double distance = 5 + 195 * (0.5 - 0.5 * cos(2 * M_PI * t / 300));
+    shadow = 0.995 * shadow + sqrt(1 - 0.995 * 0.995) * 4 * shadow_rng.normal();
+    double path_loss = 40 + 27 * log10(distance) + shadow;
+    if (fmod(t, 60) > 30 && fmod(t, 60) < 40) {
+      path_loss += 15;
+    }
+    lost_max_power += link.rng.uniform() < packet_error_rate(dbm(TX_POWER_MAX_QDBM) - path_loss) ? 1 : 0;
+    current_max += TxPowerControl::estimate_tx_current_ma(TX_POWER_MAX_QDBM);
+    link.frame(ms, path_loss);
+  }
+  const double loss = 100.0 * link.lost / link.frames;
+  const double loss_max = 100.0 * lost_max_power / link.frames;
+  const double saving = 100.0 * (1.0 - link.current / current_max);
+  printf("walk 5-200 m with fades: %.2f%% lost (%.2f%% at full power), TX current -%.0f%%, %d changes in 10 min\n",
+         loss, loss_max, saving, link.changes);
+  CHECK_RANGE(loss, 0.0, loss_max + 0.1);
+  CHECK_RANGE(saving, 10.0, 100.0);
+}
+
+// without RSSI (IDF 4, ESPNOW_RSSI_PROMISCUOUS_FALLBACK 0) clean reports never
+// step the power down, and loss alone still brings it back up
+void test_no_rssi()
+{
+  TxPowerControl pc(TX_POWER_MIN_QDBM, TX_POWER_MAX_QDBM, kTarget);
+  pc.reset(0);
+  uint32_t now = 0;
+  for (int i = 0; i < 30; ++i) {
+    now += 1000;
+    pc.on_send();
+    pc.on_report(0, TxPowerControl::kRssiUnknown, now - 500);
+    CHECK(!pc.update(now));
+  }
+  CHECK_EQ(pc.get_qdbm(), TX_POWER_MAX_QDBM);
+
+  pc.set_applied_qdbm(TX_POWER_MIN_QDBM);
+  now += 1000;
+  pc.on_send();
+  pc.on_report(TxPowerControl::kMaxLossPermille, TxPowerControl::kRssiUnknown, now - 500);
+  CHECK(pc.update(now));
+  CHECK_EQ(pc.get_qdbm(), TX_POWER_MAX_QDBM);
+}
+
+}  // namespace
+
+int main()
+{
+  test_settles(50);
+  test_settles(75);
+  test_settles(85);
+  test_settles(100);
+  test_fade();
+  test_loss_and_timeout();
+  test_no_rssi();
+  test_walk();
+  return host_test_exit("tx_power_control");
+}
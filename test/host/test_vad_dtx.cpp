@@ -0,0 +1,132 @@
+// VAD + DTX over a speech-like corpus: how many audio frames DTX saves, that
+// speech still goes out, and that listeners hear comfort noise at the
+// talker's background level during pauses.
+#include <math.h>
+#include <stdio.h>
+#include <vector>
+#include "DtxGate.h"
+#include "VoiceActivityDetector.h"
+#include "host_platform.h"
+#include "host_test.h"
+#include "loopback_rig.h"
+#include "speech_corpus.h"
+
+namespace {
+
+constexpr size_t kChunk = 128;   // TX loop chunk, 8 ms
+constexpr uint32_t kChunkMs = kChunk * 1000 / SAMPLE_RATE;
+
+const SpeechCorpusItem kCorpus[] = {
+  { "quiet room", 11, 30, 5000, 60 },
+  { "office", 22, 30, 5000, 250 },
+  { "street", 33, 30, 6000, 700 },
+  { "soft talker", 44, 30, 1800, 150 },
+};
+
+struct Result
+{
+  uint32_t audio_frames;
+  uint32_t sid_frames;
+  uint32_t speech_chunks;
+  uint32_t speech_chunks_sent;
+  double pause_rms;   // playout during long pauses, int16 domain
+};
+
+// one talkspurt through VAD, DTX, packetizer and a listener
+Result run(const std::vector<int16_t> &audio, const std::vector<uint8_t> &speech, bool dtx_enabled)
+{
+  LoopbackRig rig;
+  VoiceActivityDetector vad(TX_VAD_HANGOVER_MS / kChunkMs);
+  DtxGate dtx(TX_DTX_SID_INTERVAL_MS);
+  vad.reset();
+  dtx.reset();
+  Result r = {};
+  double pause_energy = 0;
+  size_t pause_samples = 0;
+  size_t silent_run = 0;
+  uint8_t u8[kChunk];
+  uint8_t played[kChunk];
+  for (size_t pos = 0; pos + kChunk <= audio.size(); pos += kChunk) {
+    const int16_t *chunk = &audio[pos];
+    for (size_t i = 0; i < kChunk; ++i) {
+      u8[i] = static_cast<uint8_t>((chunk[i] >> 8) + 128);
+    }
+    bool truth = false;
+    for (size_t i = 0; i < kChunk; ++i) {
+      truth = truth || speech[pos + i];
+    }
+    const bool voiced = vad.process(chunk, kChunk);
+    const DtxGate::Action action = dtx.step(!dtx_enabled || voiced, millis());
+    if (action == DtxGate::kSendAudio) {
+      for (size_t i = 0; i < kChunk; ++i) {
+        rig.tx.add_sample_u8(u8[i]);
+      }
+    } else if (action == DtxGate::kFlushAndSendSid) {
+      rig.tx.flush();
+      rig.tx.send_sid(vad.get_noise_rms());
+    } else if (action == DtxGate::kSendSid) {
+      rig.tx.send_sid(vad.get_noise_rms());
+    }
+    r.speech_chunks += truth ? 1 : 0;
+    r.speech_chunks_sent += (truth && action == DtxGate::kSendAudio) ? 1 : 0;
+    rig.deliver();
+    rig.buffer.remove_samples(played, kChunk);
+    // measure once the pause is well established (the jitter buffer has played out)
+    silent_run = truth ? 0 : silent_run + kChunk;
+    if (silent_run > SAMPLE_RATE / 2) {
+      for (size_t i = 0; i < kChunk; ++i) {
+        const double v = (static_cast<int>(played[i]) - 128) * 256.0;
+        pause_energy += v * v;
+      }
+      pause_samples += kChunk;
+    }
+    host_advance_ms(kChunkMs);
+  }
+  rig.tx.end_talkspurt();
+  rig.deliver();
+  r.audio_frames = rig.sent[Transport::kFrameTypeAudio];
+  r.sid_frames = rig.sent[Transport::kFrameTypeSid];
+  r.pause_rms = pause_samples ? sqrt(pause_energy / pause_samples) : 0;
+  return r;
+}
+
+}  // namespace
+
+int main()
+{
+  uint32_t total_frames = 0;
+  uint32_t total_dtx_frames = 0;
+  for (const SpeechCorpusItem &item : kCorpus) {
+    std::vector<int16_t> audio;
+    std::vector<uint8_t> speech;
+    SpeechCorpus::generate(item, audio, speech);
+    const Result full = run(audio, speech, false);
+    const Result dtx = run(audio, speech, true);
+    const double saved = 100.0 * (1.0 - static_cast<double>(dtx.audio_frames) / full.audio_frames);
+    const double airtime_saved =
+        100.0 * (1.0 - static_cast<double>(dtx.audio_frames + dtx.sid_frames) / full.audio_frames);
+    const double speech_sent = 100.0 * dtx.speech_chunks_sent / dtx.speech_chunks;
+    const double speech_share = 100.0 * dtx.speech_chunks / (audio.size() / kChunk);
+    printf("%-12s speech %4.1f%%: audio frames %4u -> %4u (-%4.1f%%), +%3u SID, packets -%4.1f%%, "
+           "speech sent %5.1f%%, pause playout %4.0f rms (background %d)\n",
+           item.name, speech_share, static_cast<unsigned>(full.audio_frames), static_cast<unsigned>(dtx.audio_frames),
+           saved, static_cast<unsigned>(dtx.sid_frames), airtime_saved, speech_sent, dtx.pause_rms,
+           item.background_rms);
+    total_frames += full.audio_frames;
+    total_dtx_frames += dtx.audio_frames + dtx.sid_frames;
+
+    CHECK(full.sid_frames == 0);
+    // faint fricatives in street noise look like the background and are lost
+    CHECK_RANGE(speech_sent, 96.0, 100.0);
+    // pauses make up about half the corpus; the hangover keeps some of it
+    CHECK_RANGE(saved, 25.0, 100.0);
+    // comfort noise at the talker's background level (SIDs carry it in 16-step units;
+    // the 8 bit output can't show less than about one step)
+    if (item.background_rms >= 250) {
+      CHECK_RANGE(20 * log10(dtx.pause_rms / item.background_rms), -3.0, 3.0);
+    }
+  }
+  printf("corpus: %u packets with DTX vs %u without (-%.1f%%)\n", static_cast<unsigned>(total_dtx_frames),
+         static_cast<unsigned>(total_frames), 100.0 * (1.0 - static_cast<double>(total_dtx_frames) / total_frames));
+  return host_test_exit("vad_dtx");
+}
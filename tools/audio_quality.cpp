@@ -0,0 +1,88 @@
+// Host build of the audio quality measurement (lib/audio_quality).
+//
+// Build (one line):
+//   g++ -O2 -Ilib/audio_quality/src -Ilib/test_signal/src -o audio_quality tools/audio_quality.cpp
+//       lib/audio_quality/src/AudioQuality.cpp lib/test_signal/src/TestSignal.cpp
+//
+// Usage: audio_quality <stimulus.wav | tone | multitone | sweep | white | pink | mls> received.wav [tone_hz]
+//
+// The stimulus is either a WAV (e.g. the TX recording of the sending device,
+// split by tools/rec_to_wav.py) or a test signal generated here with the
+// defaults of src/config.h. received.wav is typically the RX recording.
+// Mono 8 or 16 bit WAVs at 16 kHz. Exit status 1 if nothing could be
+// measured, so scripts can gate on it.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "AudioQuality.h"
+#include "TestSignal.h"
+#include "wav_io.h"
+
+static const uint32_t kSampleRate = kWavSampleRate;
+// as in src/config.h
+static const int16_t kLevel = 12000;
+static const uint16_t kToneHz = 1000;
+static const uint16_t kMultiToneHz[] = { 300, 1000, 3100 };
+
+static TxSource *make_signal(const std::string &name)
+{
+  if (name == "tone") {
+    return new ToneSource("tone", &kToneHz, 1, kLevel, kSampleRate);
+  }
+  if (name == "multitone") {
+    return new ToneSource("multitone", kMultiToneHz, 3, kLevel, kSampleRate);
+  }
+  if (name == "sweep") {
+    return new SweepSource(100, 7000, 5000, kLevel, kSampleRate);
+  }
+  if (name == "white") {
+    return new NoiseSource(NoiseSource::kWhite, kLevel);
+  }
+  if (name == "pink") {
+    return new NoiseSource(NoiseSource::kPink, kLevel);
+  }
+  if (name == "mls") {
+    return new MlsSource(kLevel);
+  }
+  return nullptr;
+}
+
+int main(int argc, char **argv)
+{
+  if (argc < 3) {
+    fprintf(stderr, "usage: %s <stimulus.wav|tone|multitone|sweep|white|pink|mls> received.wav [tone_hz]\n", argv[0]);
+    return 2;
+  }
+  std::vector<int16_t> received;
+  if (!read_wav(argv[2], received)) {
+    return 1;
+  }
+  std::vector<int16_t> stimulus;
+  uint32_t tone_hz = (argc > 3) ? static_cast<uint32_t>(atoi(argv[3])) : 0;
+  TxSource *source = make_signal(argv[1]);
+  if (source) {
+    // the sender restarts the signal at key-up: generate as much as was received
+    stimulus.resize(received.size() + AudioQuality::kMaxDelay);
+    source->reset();
+    source->read(stimulus.data(), stimulus.size());
+    if (strcmp(argv[1], "tone") == 0 && tone_hz == 0) {
+      tone_hz = kToneHz;
+    }
+    delete source;
+  } else if (!read_wav(argv[1], stimulus)) {
+    return 1;
+  }
+  AudioQuality::Report report;
+  if (!AudioQuality::analyse(stimulus.data(), stimulus.size(), received.data(), received.size(),
+                             kSampleRate, tone_hz, report)) {
+    fprintf(stderr, "nothing to compare (too short, or no correlation)\n");
+    return 1;
+  }
+  char text[512];
+  AudioQuality::format(report, text, sizeof(text));
+  fputs(text, stdout);
+  return 0;
+}
@@ -0,0 +1,57 @@
+// Host build of the TX noise suppressor (lib/noise_suppressor).
+//
+// Build (one line):
+//   g++ -O2 -Ilib/noise_suppressor/src -o ns_wav tools/ns_wav.cpp
+//       lib/noise_suppressor/src/NoiseSuppressor.cpp
+//
+// Usage: ns_wav in.wav out.wav [bypass]
+//
+// Runs the suppressor over in.wav exactly as the TX path does (128-sample
+// hops) and writes the result as 16 bit; the one-hop lag is removed so the
+// two files line up. Prints the time per hop: the device budget is
+// TX_NOISE_SUPPRESSOR_CYCLE_BUDGET cycles at 240 MHz, 8 ms of audio.
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+
+#include "NoiseSuppressor.h"
+#include "wav_io.h"
+
+int main(int argc, char **argv)
+{
+  if (argc < 3) {
+    fprintf(stderr, "usage: %s in.wav out.wav [bypass]\n", argv[0]);
+    return 2;
+  }
+  std::vector<int16_t> in;
+  if (!read_wav(argv[1], in)) {
+    return 1;
+  }
+  const size_t hop = NoiseSuppressor::kHopSize;
+  const size_t hops = (in.size() + hop - 1) / hop;
+  // one extra hop of silence flushes the lag
+  std::vector<int16_t> work((hops + 1) * hop, 0);
+  memcpy(work.data(), in.data(), in.size() * sizeof(int16_t));
+
+  static NoiseSuppressor ns;
+  ns.set_bypass(argc > 3 && strcmp(argv[3], "bypass") == 0);
+  double total_us = 0;
+  double max_us = 0;
+  for (size_t h = 0; h <= hops; ++h) {
+    const auto start = std::chrono::steady_clock::now();
+    ns.process_hop(work.data() + h * hop);
+    const double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    total_us += us;
+    if (us > max_us) max_us = us;
+  }
+  const size_t lag = ns.is_bypassed() ? 0 : hop;
+  const std::vector<int16_t> out(work.begin() + lag, work.begin() + lag + in.size());
+  if (!write_wav(argv[2], out)) {
+    return 1;
+  }
+  printf("%zu hops of %zu samples%s: %.2f us/hop average, %.2f us max (%.2f%% of real time)\n",
+         hops + 1, hop, ns.is_bypassed() ? " (bypassed)" : "", total_us / (hops + 1), max_us,
+         100.0 * total_us / (hops + 1) / (1e6 * hop / kWavSampleRate));
+  return 0;
+}
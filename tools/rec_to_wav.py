@@ -0,0 +1,89 @@
+#!/usr/bin/env python3
+"""Split a recorder file ("rec start" on serial, RECORDER_PATH) into WAVs.
+
+Usage: rec_to_wav.py rec.bin [out_dir]
+
+Writes one 16 kHz 8-bit WAV per talkspurt, named
+<index>_<rx|tx>_<sender>_<start ms>.wav, and reports blocks lost to a slow
+flash (gaps in the block sequence).
+"""
+import os
+import struct
+import sys
+import wave
+
+BLOCK_SIZE = 4096
+BLOCK_HEADER = struct.Struct("<4sIHH")
+RECORD_HEADER = struct.Struct("<BBHIH")
+AUDIO, TALKSPURT_START, TALKSPURT_END = 1, 2, 3
+SAMPLE_RATE = 16000
+
+
+def records(data):
+    expected_seq = None
+    lost = 0
+    for off in range(0, len(data) - BLOCK_SIZE + 1, BLOCK_SIZE):
+        magic, seq, used, _ = BLOCK_HEADER.unpack_from(data, off)
+        if magic != b"ESRB" or used > BLOCK_SIZE:
+            print("block at %d: bad header, skipped" % off, file=sys.stderr)
+            continue
+        if expected_seq is not None and seq != expected_seq:
+            lost += seq - expected_seq
+        expected_seq = seq + 1
+        pos = off + BLOCK_HEADER.size
+        end = off + used
+        while pos + RECORD_HEADER.size <= end:
+            rtype, flags, sender, t_ms, length = RECORD_HEADER.unpack_from(data, pos)
+            pos += RECORD_HEADER.size
+            yield rtype, flags, sender, t_ms, data[pos:pos + length]
+            pos += length
+    if lost:
+        print("%d blocks dropped on the device" % lost, file=sys.stderr)
+
+
+def split(data, out_dir):
+    open_spurts = {}
+    index = 0
+
+    def close(key):
+        nonlocal index
+        spurt = open_spurts.pop(key, None)
+        if not spurt or not spurt["audio"]:
+            return
+        flags, sender = key
+        name = "%03d_%s_%04x_%d.wav" % (index, "tx" if flags & 1 else "rx", sender, spurt["t_ms"])
+        index += 1
+        with wave.open(os.path.join(out_dir, name), "wb") as w:
+            w.setnchannels(1)
+            w.setsampwidth(1)
+            w.setframerate(SAMPLE_RATE)
+            w.writeframes(bytes(spurt["audio"]))
+        print("%s: %.2f s" % (name, len(spurt["audio"]) / SAMPLE_RATE))
+
+    for rtype, flags, sender, t_ms, payload in records(data):
+        key = (flags, sender)
+        if rtype == TALKSPURT_START:
+            close(key)
+            open_spurts[key] = {"t_ms": t_ms, "audio": bytearray()}
+        elif rtype == TALKSPURT_END:
+            close(key)
+        elif rtype == AUDIO:
+            # audio without a start marker: its start was in a dropped block
+            spurt = open_spurts.setdefault(key, {"t_ms": t_ms, "audio": bytearray()})
+            spurt["audio"] += payload
+    for key in list(open_spurts):
+        close(key)
+
+
+def main():
+    if len(sys.argv) < 2:
+        print(__doc__, file=sys.stderr)
+        sys.exit(1)
+    out_dir = sys.argv[2] if len(sys.argv) > 2 else "."
+    os.makedirs(out_dir, exist_ok=True)
+    with open(sys.argv[1], "rb") as f:
+        split(f.read(), out_dir)
+
+
+if __name__ == "__main__":
+    main()
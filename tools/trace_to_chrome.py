@@ -0,0 +1,66 @@
+#!/usr/bin/env python3
+"""Convert a "trace dump" serial log into Chrome/Perfetto trace JSON.
+
+Usage: trace_to_chrome.py serial.log [out.json]
+
+Open the result in chrome://tracing or https://ui.perfetto.dev. Each CPU
+core becomes one track; timestamps are device microseconds.
+"""
+import json
+import sys
+
+
+def convert(lines):
+    names = {}
+    events = []
+    last_t = None
+    wraps = 0
+    for line in lines:
+        parts = line.strip().split()
+        if len(parts) < 2 or parts[0] != "TRACE":
+            continue
+        if parts[1] == "NAME" and len(parts) == 5:
+            names[int(parts[2])] = (parts[3], parts[4])
+            continue
+        if parts[1] == "BEGIN":
+            last_t = None
+            wraps = 0
+            continue
+        if not parts[1].isdigit() or len(parts) != 5:
+            continue
+        t, event_id, core, arg = (int(p) for p in parts[1:])
+        # 32-bit microsecond clock wraps every ~71 minutes
+        if last_t is not None and t < last_t and last_t - t > 1 << 31:
+            wraps += 1
+        last_t = t
+        name, phase = names.get(event_id, ("event_%d" % event_id, "i"))
+        ev = {
+            "name": name,
+            "ph": phase,
+            "ts": t + (wraps << 32),
+            "pid": 0,
+            "tid": core,
+            "args": {"arg": arg},
+        }
+        if phase == "i":
+            ev["s"] = "t"
+        events.append(ev)
+    events.sort(key=lambda e: e["ts"])
+    meta = [{"name": "thread_name", "ph": "M", "pid": 0, "tid": c,
+             "args": {"name": "core %d" % c}} for c in sorted({e["tid"] for e in events})]
+    return {"traceEvents": meta + events, "displayTimeUnit": "ms"}
+
+
+def main():
+    if len(sys.argv) < 2:
+        sys.exit(__doc__)
+    with open(sys.argv[1], errors="replace") as f:
+        trace = convert(f)
+    out = sys.argv[2] if len(sys.argv) > 2 else sys.argv[1].rsplit(".", 1)[0] + ".json"
+    with open(out, "w") as f:
+        json.dump(trace, f)
+    print("%d events -> %s" % (len(trace["traceEvents"]), out))
+
+
+if __name__ == "__main__":
+    main()
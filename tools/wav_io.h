@@ -0,0 +1,97 @@
+// WAV reading and writing for the host tools (mono, 16 kHz, 8 or 16 bit).
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+static const uint32_t kWavSampleRate = 16000;
+
+// 8 bit samples are widened to 16 bit
+static inline bool read_wav(const char *path, std::vector<int16_t> &out)
+{
+  FILE *f = fopen(path, "rb");
+  if (!f) {
+    fprintf(stderr, "%s: cannot open\n", path);
+    return false;
+  }
+  std::vector<uint8_t> data;
+  uint8_t chunk[4096];
+  size_t n;
+  while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) {
+    data.insert(data.end(), chunk, chunk + n);
+  }
+  fclose(f);
+  if (data.size() < 12 || memcmp(data.data(), "RIFF", 4) != 0 || memcmp(data.data() + 8, "WAVE", 4) != 0) {
+    fprintf(stderr, "%s: not a WAV file\n", path);
+    return false;
+  }
+  int bits = 0;
+  size_t pos = 12;
+  while (pos + 8 <= data.size()) {
+    const uint8_t *c = data.data() + pos;
+    const uint32_t size = c[4] | (c[5] << 8) | (c[6] << 16) | (static_cast<uint32_t>(c[7]) << 24);
+    if (memcmp(c, "fmt ", 4) == 0 && size >= 16) {
+      const int channels = c[10] | (c[11] << 8);
+      const uint32_t rate = c[12] | (c[13] << 8) | (c[14] << 16) | (static_cast<uint32_t>(c[15]) << 24);
+      bits = c[22] | (c[23] << 8);
+      if (channels != 1 || rate != kWavSampleRate || (bits != 8 && bits != 16)) {
+        fprintf(stderr, "%s: need mono 8/16 bit at %u Hz\n", path, static_cast<unsigned>(kWavSampleRate));
+        return false;
+      }
+    } else if (memcmp(c, "data", 4) == 0 && bits) {
+      const uint8_t *p = c + 8;
+      const size_t len = (pos + 8 + size <= data.size()) ? size : data.size() - pos - 8;
+      for (size_t i = 0; i + bits / 8 <= len; i += bits / 8) {
+        out.push_back(bits == 16 ? static_cast<int16_t>(p[i] | (p[i + 1] << 8))
+                                 : static_cast<int16_t>((p[i] - 128) << 8));
+      }
+      return true;
+    }
+    pos += 8 + size + (size & 1);
+  }
+  fprintf(stderr, "%s: no audio data\n", path);
+  return false;
+}
+
+static inline void put_le(std::vector<uint8_t> &out, uint32_t v, int bytes)
+{
+  for (int i = 0; i < bytes; ++i) {
+    out.push_back(static_cast<uint8_t>(v >> (8 * i)));
+  }
+}
+
+// bits 8 (offset binary, as played by the speaker) or 16
+static inline bool write_wav(const char *path, const std::vector<int16_t> &samples, int bits = 16)
+{
+  const uint32_t bytes = static_cast<uint32_t>(samples.size() * bits / 8);
+  std::vector<uint8_t> out;
+  out.insert(out.end(), { 'R', 'I', 'F', 'F' });
+  put_le(out, 36 + bytes, 4);
+  out.insert(out.end(), { 'W', 'A', 'V', 'E', 'f', 'm', 't', ' ' });
+  put_le(out, 16, 4);
+  put_le(out, 1, 2);
+  put_le(out, 1, 2);
+  put_le(out, kWavSampleRate, 4);
+  put_le(out, kWavSampleRate * bits / 8, 4);
+  put_le(out, bits / 8, 2);
+  put_le(out, bits, 2);
+  out.insert(out.end(), { 'd', 'a', 't', 'a' });
+  put_le(out, bytes, 4);
+  for (int16_t s : samples) {
+    if (bits == 16) {
+      put_le(out, static_cast<uint16_t>(s), 2);
+    } else {
+      out.push_back(static_cast<uint8_t>((s >> 8) + 128));
+    }
+  }
+  FILE *f = fopen(path, "wb");
+  if (!f) {
+    fprintf(stderr, "%s: cannot create\n", path);
+    return false;
+  }
+  const bool ok = fwrite(out.data(), 1, out.size(), f) == out.size();
+  fclose(f);
+  return ok;
+}